@@ -0,0 +1,113 @@
+import copy
+import os
+import signal
+from typing import Dict
+
+from app import App
+from common import XRP
+from sidechain import Params
+import sidechain
+import test_utils
+import tst_common
+
+# Ledgers. Short, so the transfers span turns of several aggregators.
+turn_ledgers = 2
+fallback_ledgers = 20
+
+
+def _aggregation_configs(bases: list, tmp_path) -> list:
+    '''Configs of witnesses that aggregate each other's attestations'''
+    configs = [copy.deepcopy(b) for b in bases]
+    for i, c in enumerate(configs):
+        d = tmp_path / f'aggregation_{i}'
+        d.mkdir()
+        c['DBDir'] = str(d)
+        c['LogFile'] = str(d / 'witness.log')
+    for i, c in enumerate(configs):
+        peers = []
+        for j, p in enumerate(configs):
+            if j == i:
+                continue
+            peer = {'RPCEndpoint': p['RPCEndpoint']}
+            if admin := p.get('Admin'):
+                if 'Username' in admin:
+                    peer['Username'] = admin['Username']
+                    peer['Password'] = admin['Password']
+            peers.append(peer)
+        c['Aggregation'] = {
+            'Peers': peers,
+            'Position': i,
+            'TurnLedgers': turn_ledgers,
+            'FallbackLedgers': fallback_ledgers,
+        }
+    return configs
+
+
+def _aggregation_info(config: dict) -> dict:
+    info = tst_common.witness_request(config, 'server_info')
+    return info['info'].get('aggregation', {}) if info else {}
+
+
+def _errored(config: dict) -> int:
+    info = tst_common.witness_request(config, 'server_info')
+    if not info:
+        return 0
+    errored = info['info'].get('issuing', {}).get('errored', {})
+    return errored.get('commit_attests_size', 0) + errored.get(
+        'create_account_attests_size', 0)
+
+
+def aggregation_test(mc_app: App, sc_app: App, params: Params, configs: list,
+                     tmp_path):
+    alice = mc_app.account_from_alias('alice')
+    adam = sc_app.account_from_alias('adam')
+
+    exe = params.witness_exe
+    procs = []
+    try:
+        for i, c in enumerate(configs):
+            procs.append(
+                tst_common.start_witness(
+                    exe, c, str(tmp_path / f'aggregation_{i}.json')))
+        for c in configs:
+            tst_common.wait_for(lambda: _aggregation_info(c), 30,
+                                'the witnesses to start')
+
+        with test_utils.test_context(mc_app, sc_app):
+            pre_bal = sc_app.get_balance(adam, XRP(0))
+            sidechain.main_to_side_transfer(mc_app, sc_app, alice, adam,
+                                            XRP(1000), params)
+            test_utils.wait_for_balance_change(sc_app, adam, pre_bal,
+                                               XRP(1000))
+
+        # Spread over the turns of several aggregators
+        pre_bal = sc_app.get_balance(adam, XRP(0))
+        values = list(range(11, 11 + 2 * len(configs)))
+        for value in values:
+            sidechain.main_to_side_transfer(mc_app, sc_app, alice, adam,
+                                            XRP(value), params)
+        test_utils.wait_for_balance_change(sc_app, adam, pre_bal,
+                                           XRP(sum(values)))
+
+        infos = [_aggregation_info(c) for c in configs]
+        # Every attestation a peer sent was signed by a witness of the bridge
+        assert sum(i.get('rejected', 0) for i in infos) == 0
+        assert sum(i.get('aggregated', 0) for i in infos) > 0
+        assert sum(_errored(c) for c in configs) == 0
+    finally:
+        for p in procs:
+            if p.poll() is None:
+                os.kill(p.pid, signal.SIGKILL)
+                p.wait()
+
+
+def test_aggregation(configs_dirs_dict: Dict[int, str], tmp_path):
+    params = tst_common.test_params(configs_dirs_dict)
+    # All the witnesses aggregate, started here with their peers configured
+    configs = _aggregation_configs(params.witness_configs, tmp_path)
+    params.witness_config_filenames = []
+
+    def test_case(mc_app: App, sc_app: App, params: Params):
+        aggregation_test(mc_app, sc_app, params, configs, tmp_path)
+
+    tst_common.test_start_with_params(params, test_case)
@@ -0,0 +1,142 @@
+import copy
+import os
+import signal
+from typing import Dict
+
+from app import App
+from command import AccountInfo
+from common import Account, XRP
+from sidechain import Params
+import sidechain
+import test_utils
+import tst_common
+
+# Seconds. Short, so the standby takes over soon after the active dies.
+lease_ttl = 3
+
+
+def _pair_configs(base: dict, tmp_path) -> list:
+    '''Configs of an active/standby pair sharing the keys of `base`'''
+    configs = [copy.deepcopy(base), copy.deepcopy(base)]
+    port = base['RPCEndpoint']['Port']
+    for i, c in enumerate(configs):
+        d = tmp_path / f'standby_pair_{i}'
+        d.mkdir()
+        c['DBDir'] = str(d)
+        c['LogFile'] = str(d / 'witness.log')
+        c['RPCEndpoint']['Port'] = type(port)(int(port) + 100 + i)
+    for i, c in enumerate(configs):
+        c['Standby'] = {
+            'LeaseFile': str(tmp_path / 'standby_pair.lease'),
+            'LeaseTTLSeconds': lease_ttl,
+            'PeerRPCEndpoint': configs[1 - i]['RPCEndpoint'],
+        }
+        if admin := c.get('Admin'):
+            if 'Username' in admin:
+                c['Standby']['PeerUsername'] = admin['Username']
+                c['Standby']['PeerPassword'] = admin['Password']
+    return configs
+
+
+def _standby_info(config: dict) -> dict:
+    info = tst_common.witness_request(config, 'server_info')
+    return info['info'] if info else {}
+
+
+def _role(config: dict) -> str:
+    return _standby_info(config).get('standby', {}).get('role', '')
+
+
+def _journal(config: dict) -> list:
+    r = tst_common.witness_request(config, 'submission_journal')
+    return r['submissions'] if r else None
+
+
+def _errored(config: dict) -> int:
+    errored = _standby_info(config).get('issuing', {}).get('errored', {})
+    return errored.get('commit_attests_size', 0) + errored.get(
+        'create_account_attests_size', 0)
+
+
+def standby_test(mc_app: App, sc_app: App, params: Params, configs: list,
+                 tmp_path):
+    alice = mc_app.account_from_alias('alice')
+    adam = sc_app.account_from_alias('adam')
+    submitting = Account(account_id=configs[0]['IssuingChain']['TxnSubmit']
+                         ['SubmittingAccount'])
+
+    def transfer(value: int):
+        pre_bal = sc_app.get_balance(adam, XRP(0))
+        sidechain.main_to_side_transfer(mc_app, sc_app, alice, adam,
+                                        XRP(value), params)
+        return pre_bal
+
+    exe = params.witness_exe
+    procs = [
+        tst_common.start_witness(exe, configs[0],
+                                 str(tmp_path / 'standby_pair_0.json'))
+    ]
+    try:
+        tst_common.wait_for(lambda: _role(configs[0]) == 'active', 30,
+                            'the first witness to take the lease')
+        procs.append(
+            tst_common.start_witness(exe, configs[1],
+                                     str(tmp_path / 'standby_pair_1.json')))
+        tst_common.wait_for(
+            lambda: _standby_info(configs[1]).get('standby', {}).get(
+                'following'), 30, 'the second witness to follow the first')
+
+        # Funds adam's account and lets the active submit with its sequences
+        with test_utils.test_context(mc_app, sc_app):
+            pre_bal = transfer(1000)
+            test_utils.wait_for_balance_change(sc_app, adam, pre_bal,
+                                               XRP(1000))
+
+        # Kill the active with its next submissions in flight
+        pre_bal = sc_app.get_balance(adam, XRP(0))
+        for value in (11, 12, 13):
+            transfer(value)
+        os.kill(procs[0].pid, signal.SIGKILL)
+        procs[0].wait()
+
+        # Anything the killed witness got applied counts, validated or not
+        floor = sc_app(AccountInfo(submitting,
+                                   ledger_index='current'))['account_data'][
+                                       'Sequence']
+
+        tst_common.wait_for(lambda: _role(configs[1]) == 'active',
+                            lease_ttl * 4, 'the standby to take over')
+
+        for value in (21, 22, 23):
+            transfer(value)
+        test_utils.wait_for_balance_change(sc_app, adam, pre_bal,
+                                           XRP(11 + 12 + 13 + 21 + 22 + 23))
+
+        # A reused sequence fails with tefPAST_SEQ and errors the batch
+        assert _errored(configs[1]) == 0
+        tst_common.wait_for(lambda: _journal(configs[1]) == [], 60,
+                            'the new active to drain its journal')
+        current = sc_app(AccountInfo(submitting,
+                                     ledger_index='current'))['account_data']
+        validated = sc_app(AccountInfo(
+            submitting, ledger_index='validated'))['account_data']
+        assert current['Sequence'] == validated['Sequence']
+        assert validated['Sequence'] > floor
+    finally:
+        for p in procs:
+            if p.poll() is None:
+                os.kill(p.pid, signal.SIGKILL)
+                p.wait()
+
+
+def test_standby_takeover(configs_dirs_dict: Dict[int, str], tmp_path):
+    params = tst_common.test_params(configs_dirs_dict)
+    # The first witness runs as an active/standby pair, started here so the
+    # active can be killed
+    configs = _pair_configs(params.witness_configs[0], tmp_path)
+    params.witness_config_filenames = params.witness_config_filenames[1:]
+
+    def test_case(mc_app: App, sc_app: App, params: Params):
+        standby_test(mc_app, sc_app, params, configs, tmp_path)
+
+    tst_common.test_start_with_params(params, test_case)
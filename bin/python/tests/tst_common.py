@@ -1,9 +1,14 @@
+import asyncio
+import json
 import logging
+import os
 import pprint
 import pytest
 from multiprocessing import Process, Value
-from typing import Callable, Dict
+import subprocess
+from typing import Callable, Dict, Optional
 import sys
+import websockets
 
 from app import App
 from common import eprint, disable_eprint, XRP
@@ -52,14 +57,25 @@ def multinode_test(params: Params, test_case: Callable[[App, App, Params],
                                        setup_user_accounts=False)
 
 
-def test_start(configs_dirs_dict: Dict[int, str],
-               test_case: Callable[[App, App, Params], None]):
+def test_params(configs_dirs_dict: Dict[int, str]) -> Params:
     params = sidechain.Params(configs_dir=configs_dirs_dict[1])
 
     if err_str := params.check_error():
         eprint(err_str)
         sys.exit(1)
+    return params
+
+
+def test_start(configs_dirs_dict: Dict[int, str],
+               test_case: Callable[[App, App, Params], None]):
+    test_start_with_params(test_params(configs_dirs_dict), test_case)
 
+
+# Start the chains and the witness servers in `params` and run `test_case`.
+# Tests that start some of the witness servers themselves remove them from
+# `params.witness_config_filenames` first.
+def test_start_with_params(params: Params,
+                           test_case: Callable[[App, App, Params], None]):
     if params.verbose:
         print("eprint enabled")
     else:
@@ -72,3 +88,50 @@ def test_start(configs_dirs_dict: Dict[int, str],
         standalone_test(params, test_case)
     else:
         multinode_test(params, test_case)
+
+
+# A witness server started by a test, so the test can kill it
+def start_witness(exe: str, config: dict, config_filename: str,
+                  server_out=os.devnull) -> subprocess.Popen:
+    with open(config_filename, 'w') as f:
+        json.dump(config, f, indent=2)
+    fout = open(server_out, 'w')
+    p = subprocess.Popen([exe, '--verbose', '--conf', config_filename],
+                         stdout=fout,
+                         stderr=subprocess.STDOUT)
+    print(f'started witness server: config: {config_filename} PID: {p.pid}',
+          flush=True)
+    return p
+
+
+# Send a command to a witness server's RPC websocket. Returns the result, or
+# None if the server can not be reached.
+def witness_request(config: dict, command: str, **params) -> Optional[dict]:
+    ep = config['RPCEndpoint']
+    uri = f'ws://{ep["IP"]}:{ep["Port"]}'
+    request = {'command': command, **params}
+    if admin := config.get('Admin'):
+        if 'Username' in admin:
+            request['Username'] = admin['Username']
+            request['Password'] = admin['Password']
+
+    async def send():
+        async with websockets.connect(uri) as ws:
+            await ws.send(json.dumps(request))
+            return json.loads(await ws.recv())
+
+    try:
+        reply = asyncio.get_event_loop().run_until_complete(send())
+    except (OSError, websockets.exceptions.WebSocketException):
+        return None
+    return reply.get('result', {}).get('result')
+
+
+# Wait until `f` returns a true value, and return it
+def wait_for(f: Callable, timeout: float, what: str, period: float = 0.5):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        if r := f():
+            return r
+        time.sleep(period)
+    raise ValueError(f'Timed out waiting for {what}')
@@ -0,0 +1,171 @@
+#include <xbwd/federator/GapDetector.h>
+
+#include <ripple/beast/unit_test.h>
+
+#include <vector>
+
+namespace xbwd {
+namespace tests {
+
+class GapDetector_test : public beast::unit_test::suite
+{
+    static std::uint32_t constexpr ledgers = 10;
+
+    using Ids = std::vector<std::uint64_t>;
+
+    void
+    testDisabled()
+    {
+        testcase("disabled");
+        GapDetector d{0};
+        BEAST_EXPECT(!d.enabled());
+        d.observe(1, 100);
+        d.observe(5, 100);
+        BEAST_EXPECT(d.due(1000).empty());
+        BEAST_EXPECT(!d.getInfo()["enabled"].asBool());
+    }
+
+    void
+    testWindow()
+    {
+        testcase("window");
+        GapDetector d{ledgers};
+        d.observe(1, 100);
+        d.observe(2, 100);
+        d.observe(5, 101);
+
+        auto info = d.getInfo();
+        BEAST_EXPECT(info["open_gaps"].asUInt() == 1);
+        BEAST_EXPECT(info["missing_upto"].asUInt() == 2);
+        BEAST_EXPECT(info["detected"].asUInt() == 2);
+        BEAST_EXPECT(info["lowest_missing"].asString() == "3");
+
+        // Not due until `ledgers` ledgers after it was found
+        BEAST_EXPECT(d.due(101 + ledgers - 1).empty());
+        auto const due = d.due(101 + ledgers);
+        if (BEAST_EXPECT(due.size() == 1))
+        {
+            BEAST_EXPECT(due[0].ids == Ids({3, 4}));
+            // From a little before the commit that revealed it
+            BEAST_EXPECT(due[0].fromLedger == 101 - ledgers);
+            BEAST_EXPECT(due[0].toLedger == 101 + ledgers);
+        }
+        // In flight
+        BEAST_EXPECT(d.due(200).empty());
+
+        // A late commit narrows the gap
+        d.observe(4, 102);
+        info = d.getInfo();
+        BEAST_EXPECT(info["filled"].asUInt() == 1);
+        BEAST_EXPECT(info["missing_upto"].asUInt() == 1);
+
+        // Large gaps are searched for a bounded number of ids at a time
+        GapDetector big{ledgers};
+        big.observe(1, 100);
+        big.observe(1000, 100);
+        auto const bigDue = big.due(100 + ledgers);
+        if (BEAST_EXPECT(bigDue.size() == 1))
+        {
+            BEAST_EXPECT(bigDue[0].ids.size() == 256);
+            BEAST_EXPECT(bigDue[0].ids.front() == 2);
+        }
+
+        // An id too far above the lowest missing one restarts the detector
+        GapDetector far{ledgers};
+        far.observe(1, 100);
+        far.observe(3, 100);
+        far.observe(3 + (1u << 20), 101);
+        info = far.getInfo();
+        BEAST_EXPECT(info["open_gaps"].asUInt() == 0);
+        BEAST_EXPECT(info["lowest_missing"].asString() == "100004");
+        BEAST_EXPECT(far.due(1000).empty());
+    }
+
+    void
+    testCompact()
+    {
+        testcase("compact");
+        GapDetector d{ledgers};
+        d.observe(7, 100);
+        BEAST_EXPECT(d.getInfo()["lowest_missing"].asString() == "8");
+
+        d.observe(8, 100);
+        d.observe(9, 100);
+        auto info = d.getInfo();
+        BEAST_EXPECT(info["lowest_missing"].asString() == "A");
+        BEAST_EXPECT(info["open_gaps"].asUInt() == 0);
+        BEAST_EXPECT(info["detected"].asUInt() == 0);
+
+        // Out of order: the bitmap shrinks once the run below it fills
+        d.observe(12, 101);
+        d.observe(11, 101);
+        info = d.getInfo();
+        BEAST_EXPECT(info["lowest_missing"].asString() == "A");
+        BEAST_EXPECT(info["open_gaps"].asUInt() == 1);
+        d.observe(10, 101);
+        info = d.getInfo();
+        BEAST_EXPECT(info["lowest_missing"].asString() == "D");
+        BEAST_EXPECT(info["open_gaps"].asUInt() == 0);
+        BEAST_EXPECT(info["filled"].asUInt() == 2);
+
+        // Seen again
+        d.observe(11, 102);
+        BEAST_EXPECT(d.getInfo()["filled"].asUInt() == 2);
+    }
+
+    void
+    testGiveUp()
+    {
+        testcase("give up");
+        GapDetector d{ledgers};
+        d.observe(1, 100);
+        d.observe(5, 100);
+        auto due = d.due(100 + ledgers);
+        if (!BEAST_EXPECT(due.size() == 1))
+            return;
+        BEAST_EXPECT(due[0].ids == Ids({2, 3, 4}));
+
+        // 3 was found and is seen once its event is handled. The others are
+        // given up on and not searched for again.
+        auto const givenUp = d.backfilled(due[0], {3});
+        BEAST_EXPECT(givenUp == Ids({2, 4}));
+        auto info = d.getInfo();
+        BEAST_EXPECT(info["given_up"].asUInt() == 2);
+        BEAST_EXPECT(info["open_gaps"].asUInt() == 1);
+        BEAST_EXPECT(info["missing_upto"].asUInt() == 1);
+
+        d.observe(3, 101);
+        info = d.getInfo();
+        BEAST_EXPECT(info["open_gaps"].asUInt() == 0);
+        BEAST_EXPECT(info["lowest_missing"].asString() == "6");
+        BEAST_EXPECT(d.due(1000).empty());
+
+        // A failed backfill is retried once due again
+        d.observe(8, 200);
+        due = d.due(200 + ledgers);
+        if (!BEAST_EXPECT(due.size() == 1))
+            return;
+        d.failed(due[0]);
+        BEAST_EXPECT(d.getInfo()["backfill_failures"].asUInt() == 1);
+        BEAST_EXPECT(d.due(200 + 2 * ledgers - 1).empty());
+        due = d.due(200 + 2 * ledgers);
+        if (BEAST_EXPECT(due.size() == 1))
+            BEAST_EXPECT(due[0].ids == Ids({6, 7}));
+        BEAST_EXPECT(d.getInfo()["backfills"].asUInt() == 3);
+    }
+
+public:
+    void
+    run() override
+    {
+        testDisabled();
+        testWindow();
+        testCompact();
+        testGiveUp();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(GapDetector, federator, xbwd);
+
+}  // namespace tests
+}  // namespace xbwd
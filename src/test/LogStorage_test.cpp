@@ -0,0 +1,328 @@
+#include <xbwd/core/Storage.h>
+
+#include <ripple/beast/unit_test.h>
+#include <ripple/protocol/Issue.h>
+#include <ripple/protocol/SecretKey.h>
+#include <ripple/protocol/digest.h>
+
+#include <boost/filesystem.hpp>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace xbwd {
+namespace tests {
+
+// Recovery of the log backend from what a crash leaves behind
+class LogStorage_test : public beast::unit_test::suite
+{
+    // A temporary directory, removed when the test is done
+    struct TempDir
+    {
+        boost::filesystem::path path =
+            boost::filesystem::temp_directory_path() /
+            boost::filesystem::unique_path();
+
+        ~TempDir()
+        {
+            boost::system::error_code ec;
+            boost::filesystem::remove_all(path, ec);
+        }
+    };
+
+    static auto constexpr dir = ChainDir::lockingToIssuing;
+    static auto constexpr table = AttestationTable::claim;
+    static std::size_t constexpr segmentSize = 4096;
+
+    beast::Journal const j_{beast::Journal::getNullSink()};
+    std::pair<ripple::PublicKey, ripple::SecretKey> const keys_ =
+        ripple::randomKeyPair(ripple::KeyType::ed25519);
+
+    AttestationRecord
+    makeRecord(std::uint64_t id)
+    {
+        auto const& [pk, sk] = keys_;
+        AttestationRecord r;
+        r.txnHash = ripple::sha512Half(id);
+        r.ledgerSeq = 1000 + id;
+        r.id = id;
+        r.success = true;
+        r.deliveredAmt = ripple::STAmount{
+            ripple::XRPAmount{static_cast<std::int64_t>(1000000 + id)}};
+        r.bridge = ripple::STXChainBridge{
+            ripple::calcAccountID(pk),
+            ripple::xrpIssue(),
+            ripple::calcAccountID(pk),
+            ripple::xrpIssue()};
+        r.sendingAccount = ripple::calcAccountID(pk);
+        r.rewardAccount = r.sendingAccount;
+        r.publicKey = pk;
+        r.signature = ripple::sign(pk, sk, ripple::makeSlice(r.txnHash));
+        return r;
+    }
+
+    static boost::filesystem::path
+    segmentPath(boost::filesystem::path const& d, std::uint32_t n)
+    {
+        return d / fmt::format("{:08x}.seg", n);
+    }
+
+    static std::vector<char>
+    readFile(boost::filesystem::path const& p)
+    {
+        std::ifstream f(p.string(), std::ios::binary);
+        return {std::istreambuf_iterator<char>(f), {}};
+    }
+
+    static void
+    writeFile(boost::filesystem::path const& p, std::vector<char> const& data)
+    {
+        std::ofstream f(p.string(), std::ios::binary | std::ios::trunc);
+        f.write(data.data(), data.size());
+    }
+
+    // The segment files as they are now, as a crash would leave them
+    static void
+    copySegments(
+        boost::filesystem::path const& from,
+        boost::filesystem::path const& to)
+    {
+        boost::filesystem::create_directories(to);
+        for (auto const& e : boost::filesystem::directory_iterator(from))
+            boost::filesystem::copy_file(e.path(), to / e.path().filename());
+    }
+
+    // Offset just past the last non zero byte of a segment
+    static std::size_t
+    usedSize(std::vector<char> const& data)
+    {
+        auto const it = std::find_if(
+            data.rbegin(), data.rend(), [](char c) { return c != 0; });
+        return data.rend() - it;
+    }
+
+    void
+    testTornRecord()
+    {
+        testcase("torn record");
+        TempDir tmp;
+        auto const a = makeRecord(1);
+        auto const b = makeRecord(2);
+        auto const c = makeRecord(3);
+        {
+            auto s = make_LogStorage(tmp.path, segmentSize, j_);
+            BEAST_EXPECT(s->insert(dir, table, a));
+            BEAST_EXPECT(s->insert(dir, table, b));
+        }
+
+        // Damage the last byte of the last record, as if the crash came
+        // before all of it reached the disk
+        auto const path = segmentPath(tmp.path, 0);
+        auto data = readFile(path);
+        auto const used = usedSize(data);
+        if (!BEAST_EXPECT(used > 0))
+            return;
+        data[used - 1] ^= 0x5a;
+        writeFile(path, data);
+
+        {
+            auto s = make_LogStorage(tmp.path, segmentSize, j_);
+            BEAST_EXPECT(s->find(dir, table, a.txnHash));
+            BEAST_EXPECT(!s->find(dir, table, b.txnHash));
+            // Written where the torn record was
+            BEAST_EXPECT(s->insert(dir, table, c));
+        }
+        auto s = make_LogStorage(tmp.path, segmentSize, j_);
+        BEAST_EXPECT(s->find(dir, table, a.txnHash));
+        BEAST_EXPECT(!s->find(dir, table, b.txnHash));
+        BEAST_EXPECT(s->find(dir, table, c.txnHash));
+    }
+
+    void
+    testGarbageTail()
+    {
+        testcase("garbage tail");
+        TempDir tmp;
+        auto const a = makeRecord(1);
+        auto const b = makeRecord(2);
+        {
+            auto s = make_LogStorage(tmp.path, segmentSize, j_);
+            BEAST_EXPECT(s->insert(dir, table, a));
+        }
+
+        // Bytes past the end marker, from a write that never completed
+        auto const path = segmentPath(tmp.path, 0);
+        auto data = readFile(path);
+        auto const used = usedSize(data);
+        if (!BEAST_EXPECT(used + 64 < data.size()))
+            return;
+        for (std::size_t i = used + 16; i < used + 64; ++i)
+            data[i] = static_cast<char>(i);
+        writeFile(path, data);
+
+        {
+            auto s = make_LogStorage(tmp.path, segmentSize, j_);
+            BEAST_EXPECT(s->find(dir, table, a.txnHash));
+            BEAST_EXPECT(s->insert(dir, table, b));
+        }
+        BEAST_EXPECT(usedSize(readFile(path)) > used);
+        auto s = make_LogStorage(tmp.path, segmentSize, j_);
+        BEAST_EXPECT(s->find(dir, table, a.txnHash));
+        BEAST_EXPECT(s->find(dir, table, b.txnHash));
+    }
+
+    void
+    testUncommittedBatch()
+    {
+        testcase("uncommitted batch");
+        TempDir tmp;
+        TempDir crashed;
+        TempDir spanning;
+        auto const a = makeRecord(1);
+        std::vector<AttestationRecord> batch;
+        for (std::uint64_t id = 2; id < 40; ++id)
+            batch.push_back(makeRecord(id));
+        auto const hash = ripple::sha512Half(std::uint32_t{7});
+        {
+            auto s = make_LogStorage(tmp.path, segmentSize, j_);
+            BEAST_EXPECT(s->insert(dir, table, a));
+            Storage::Batch b{*s};
+            BEAST_EXPECT(s->insert(dir, table, batch.front()));
+            s->setSyncState(ChainType::locking, SyncState{hash, 5});
+            copySegments(tmp.path, crashed.path);
+
+            // Enough to go on in the next segment
+            for (std::size_t i = 1; i < batch.size(); ++i)
+                BEAST_EXPECT(s->insert(dir, table, batch[i]));
+            BEAST_EXPECT(boost::filesystem::exists(segmentPath(tmp.path, 1)));
+            copySegments(tmp.path, spanning.path);
+        }
+
+        for (auto const& path : {crashed.path, spanning.path})
+        {
+            {
+                auto s = make_LogStorage(path, segmentSize, j_);
+                BEAST_EXPECT(s->find(dir, table, a.txnHash));
+                for (auto const& r : batch)
+                    BEAST_EXPECT(!s->find(dir, table, r.txnHash));
+                BEAST_EXPECT(!s->getSyncState(ChainType::locking));
+                BEAST_EXPECT(!boost::filesystem::exists(segmentPath(path, 1)));
+                // Written where the batch was, so not taken for part of it
+                BEAST_EXPECT(s->insert(dir, table, batch.back()));
+            }
+            auto s = make_LogStorage(path, segmentSize, j_);
+            BEAST_EXPECT(s->find(dir, table, a.txnHash));
+            BEAST_EXPECT(!s->find(dir, table, batch.front().txnHash));
+            BEAST_EXPECT(s->find(dir, table, batch.back().txnHash));
+        }
+
+        // Committed, across both segments
+        auto s = make_LogStorage(tmp.path, segmentSize, j_);
+        for (auto const& r : batch)
+            BEAST_EXPECT(s->find(dir, table, r.txnHash));
+        auto const sync = s->getSyncState(ChainType::locking);
+        BEAST_EXPECT(sync && sync->txnHash == hash && sync->ledgerSeq == 5);
+    }
+
+    void
+    testUnsizedSegment()
+    {
+        testcase("unsized segment");
+        TempDir tmp;
+        std::vector<AttestationRecord> records;
+        {
+            auto s = make_LogStorage(tmp.path, segmentSize, j_);
+            records.push_back(makeRecord(1));
+            BEAST_EXPECT(s->insert(dir, table, records.back()));
+        }
+
+        // A crash after creating the next segment but before sizing it
+        writeFile(segmentPath(tmp.path, 1), {});
+        {
+            auto s = make_LogStorage(tmp.path, segmentSize, j_);
+            BEAST_EXPECT(!boost::filesystem::exists(segmentPath(tmp.path, 1)));
+            BEAST_EXPECT(s->find(dir, table, records[0].txnHash));
+
+            // Enough to need the next segment again
+            for (std::uint64_t id = 2; id < 40; ++id)
+            {
+                records.push_back(makeRecord(id));
+                BEAST_EXPECT(s->insert(dir, table, records.back()));
+            }
+            BEAST_EXPECT(boost::filesystem::exists(segmentPath(tmp.path, 1)));
+        }
+
+        // Shorter than a record header
+        auto const last = [&] {
+            std::uint32_t n = 0;
+            while (boost::filesystem::exists(segmentPath(tmp.path, n + 1)))
+                ++n;
+            return n;
+        }();
+        writeFile(segmentPath(tmp.path, last + 1), std::vector<char>(4, 1));
+
+        auto s = make_LogStorage(tmp.path, segmentSize, j_);
+        BEAST_EXPECT(
+            !boost::filesystem::exists(segmentPath(tmp.path, last + 1)));
+        for (auto const& r : records)
+            BEAST_EXPECT(s->find(dir, table, r.txnHash));
+    }
+
+    void
+    testRollover()
+    {
+        testcase("rollover");
+        TempDir tmp;
+        auto const hash = ripple::sha512Half(std::uint32_t{7});
+        std::vector<AttestationRecord> records;
+        {
+            auto s = make_LogStorage(tmp.path, segmentSize, j_);
+            s->setSyncState(ChainType::locking, SyncState{hash, 5});
+            SubmissionRecord sub;
+            sub.chain = ChainType::issuing;
+            sub.accountSqn = 9;
+            sub.batch = ripple::Blob(64, 1);
+            sub.signedTxn = ripple::Blob(128, 2);
+            s->putSubmission(sub);
+            for (std::uint64_t id = 1; id < 100; ++id)
+            {
+                records.push_back(makeRecord(id));
+                BEAST_EXPECT(s->insert(dir, table, records.back()));
+            }
+            BEAST_EXPECT(boost::filesystem::exists(segmentPath(tmp.path, 2)));
+
+            // Erasing the oldest attestations frees their segment
+            for (std::uint64_t id = 1; id < 30; ++id)
+                s->erase(dir, table, id);
+            BEAST_EXPECT(!boost::filesystem::exists(segmentPath(tmp.path, 0)));
+        }
+
+        auto s = make_LogStorage(tmp.path, segmentSize, j_);
+        for (auto const& r : records)
+            BEAST_EXPECT(bool(s->find(dir, table, r.txnHash)) == (r.id >= 30));
+        auto const sync = s->getSyncState(ChainType::locking);
+        BEAST_EXPECT(sync && sync->txnHash == hash && sync->ledgerSeq == 5);
+        auto const subs = s->getSubmissions();
+        BEAST_EXPECT(subs.size() == 1 && subs[0].accountSqn == 9);
+    }
+
+public:
+    void
+    run() override
+    {
+        testTornRecord();
+        testGarbageTail();
+        testUncommittedBatch();
+        testUnsizedSegment();
+        testRollover();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(LogStorage, core, xbwd);
+
+}  // namespace tests
+}  // namespace xbwd
@@ -0,0 +1,145 @@
+#include <xbwd/federator/Reconciliation.h>
+
+#include <ripple/beast/unit_test.h>
+#include <ripple/protocol/jss.h>
+
+#include <vector>
+
+namespace xbwd {
+namespace tests {
+
+class Reconciliation_test : public beast::unit_test::suite
+{
+    static std::uint32_t constexpr ttlLedgers = 4;
+
+    static ripple::uint256
+    hash(std::uint32_t i)
+    {
+        return ripple::uint256{i};
+    }
+
+    // An account_tx entry
+    static Json::Value
+    entry(
+        std::uint32_t sqn,
+        ripple::uint256 const& h,
+        std::string const& result = "tesSUCCESS",
+        bool validated = true)
+    {
+        Json::Value e{Json::objectValue};
+        e[ripple::jss::validated] = validated;
+        e[ripple::jss::tx][ripple::jss::Sequence] = sqn;
+        e[ripple::jss::tx][ripple::jss::hash] = to_string(h);
+        e[ripple::jss::meta]["TransactionResult"] = result;
+        return e;
+    }
+
+    void
+    testWindow()
+    {
+        testcase("window");
+        auto w = reconciliation::window({100, 107, 103}, ttlLedgers);
+        BEAST_EXPECT(w.first == 100 - ttlLedgers);
+        BEAST_EXPECT(w.second == 107);
+
+        w = reconciliation::window({50}, ttlLedgers);
+        BEAST_EXPECT(w.first == 50 - ttlLedgers);
+        BEAST_EXPECT(w.second == 50);
+
+        // Near the genesis ledger
+        w = reconciliation::window({3, 20}, ttlLedgers);
+        BEAST_EXPECT(w.first == 0);
+        BEAST_EXPECT(w.second == 20);
+    }
+
+    void
+    testMatch()
+    {
+        testcase("match");
+        std::vector<reconciliation::Expired> const expired{
+            {5, hash(1)}, {6, hash(2)}, {7, hash(3)}, {8, hash(4)}};
+
+        Json::Value page{Json::arrayValue};
+        // Found
+        page.append(entry(5, hash(1)));
+        // Not validated
+        page.append(entry(6, hash(2), "tesSUCCESS", false));
+        // Same sequence, another hash: a later submission's
+        page.append(entry(7, hash(9)));
+        // Same hash, another sequence
+        page.append(entry(9, hash(4)));
+        // Not the witness's
+        page.append(entry(10, hash(10)));
+        // Found with a result that is retried
+        page.append(entry(8, hash(4), "tecINSUFFICIENT_FUNDS"));
+        // Not a transaction
+        Json::Value bad{Json::objectValue};
+        bad[ripple::jss::validated] = true;
+        page.append(bad);
+
+        reconciliation::Landed landed;
+        reconciliation::match(expired, page, landed);
+        if (BEAST_EXPECT(landed.size() == 2))
+        {
+            BEAST_EXPECT(landed[0].first == 5);
+            BEAST_EXPECT(landed[0].second == ripple::tesSUCCESS);
+            BEAST_EXPECT(landed[1].first == 8);
+            BEAST_EXPECT(landed[1].second == ripple::tecINSUFFICIENT_FUNDS);
+        }
+
+        // A later page. What already landed is not added again.
+        Json::Value next{Json::arrayValue};
+        next.append(entry(5, hash(1)));
+        next.append(entry(6, hash(2)));
+        reconciliation::match(expired, next, landed);
+        if (BEAST_EXPECT(landed.size() == 3))
+            BEAST_EXPECT(landed[2].first == 6);
+    }
+
+    void
+    testOutcome()
+    {
+        testcase("outcome");
+        std::unordered_set<ripple::TERUnderlyingType> const skippable{
+            ripple::tesSUCCESS, ripple::tecXCHAIN_NO_CLAIM_ID};
+
+        event::SubmissionsReconciled e;
+        e.checked_ = {5, 6, 7, 8};
+        e.landed_ = {
+            {5, ripple::tesSUCCESS},
+            {6, ripple::tecXCHAIN_NO_CLAIM_ID},
+            {7, ripple::tecINSUFFICIENT_FUNDS}};
+
+        using reconciliation::Outcome;
+        BEAST_EXPECT(
+            reconciliation::outcome(e, 5, skippable) == Outcome::landed);
+        BEAST_EXPECT(
+            reconciliation::outcome(e, 6, skippable) == Outcome::landed);
+        BEAST_EXPECT(
+            reconciliation::outcome(e, 7, skippable) == Outcome::failed);
+        BEAST_EXPECT(
+            reconciliation::outcome(e, 8, skippable) == Outcome::missing);
+        // Expired while the others were looked up
+        BEAST_EXPECT(
+            reconciliation::outcome(e, 9, skippable) == Outcome::unchecked);
+
+        // A lookup that failed finds nothing, so all are resubmitted
+        e.landed_.clear();
+        BEAST_EXPECT(
+            reconciliation::outcome(e, 5, skippable) == Outcome::missing);
+    }
+
+public:
+    void
+    run() override
+    {
+        testWindow();
+        testMatch();
+        testOutcome();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(Reconciliation, federator, xbwd);
+
+}  // namespace tests
+}  // namespace xbwd
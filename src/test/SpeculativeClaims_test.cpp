@@ -0,0 +1,225 @@
+#include <xbwd/federator/SpeculativeClaims.h>
+
+#include <ripple/beast/unit_test.h>
+#include <ripple/protocol/Issue.h>
+#include <ripple/protocol/SecretKey.h>
+#include <ripple/protocol/digest.h>
+
+#include <functional>
+#include <vector>
+
+namespace xbwd {
+namespace tests {
+
+class SpeculativeClaims_test : public beast::unit_test::suite
+{
+    static std::uint32_t constexpr ledgers = 5;
+
+    beast::Journal const j_{beast::Journal::getNullSink()};
+    std::pair<ripple::PublicKey, ripple::SecretKey> const keys_ =
+        ripple::randomKeyPair(ripple::KeyType::ed25519);
+    ripple::AccountID const account_ = ripple::calcAccountID(keys_.first);
+    ripple::STXChainBridge const bridge_{
+        account_,
+        ripple::xrpIssue(),
+        ripple::calcAccountID(
+            ripple::randomKeyPair(ripple::KeyType::ed25519).first),
+        ripple::xrpIssue()};
+
+    // A commit on the locking chain, in ledger 100
+    event::XChainCommitDetected
+    commit(std::uint64_t i)
+    {
+        return event::XChainCommitDetected{
+            ChainDir::lockingToIssuing,
+            account_,
+            bridge_,
+            ripple::STAmount{ripple::XRPAmount{1000000}},
+            i,
+            std::nullopt,
+            100,
+            ripple::sha512Half(i),
+            ripple::tesSUCCESS,
+            std::nullopt,
+            false};
+    }
+
+    SpeculativeClaims::Claim
+    sign(event::XChainCommitDetected const& e)
+    {
+        return SpeculativeClaims::Claim{
+            e.bridge_,
+            keys_.first,
+            keys_.second,
+            e.src_,
+            *e.deliveredAmt_,
+            account_,
+            e.dir_ == ChainDir::lockingToIssuing,
+            e.claimID_,
+            e.otherChainDst_};
+    }
+
+    void
+    testDisabled()
+    {
+        testcase("disabled");
+        SpeculativeClaims s{0, j_};
+        BEAST_EXPECT(!s.enabled());
+        auto const e = commit(1);
+        BEAST_EXPECT(!s.mark(e));
+        s.fill(e, sign(e));
+        BEAST_EXPECT(!s.take(e));
+        BEAST_EXPECT(s.getInfo()["misses"].asUInt() == 0);
+    }
+
+    void
+    testTake()
+    {
+        testcase("take");
+        SpeculativeClaims s{ledgers, j_};
+        auto const e = commit(1);
+        BEAST_EXPECT(s.mark(e));
+        // Marked once
+        BEAST_EXPECT(!s.mark(e));
+        auto const claim = sign(e);
+        s.fill(e, claim);
+
+        // The validated commit matches its hash and fields
+        auto const taken = s.take(e);
+        if (BEAST_EXPECT(taken))
+            BEAST_EXPECT(*taken == claim);
+        auto info = s.getInfo();
+        BEAST_EXPECT(info["hits"].asUInt() == 1);
+        BEAST_EXPECT(info["pending"].asUInt() == 0);
+
+        // Taken once
+        BEAST_EXPECT(!s.take(e));
+        BEAST_EXPECT(s.getInfo()["misses"].asUInt() == 1);
+    }
+
+    void
+    testMismatch()
+    {
+        testcase("mismatch");
+        SpeculativeClaims s{ledgers, j_};
+
+        // Each field the claim is signed from
+        auto const changes = std::vector<
+            std::function<void(event::XChainCommitDetected&)>>{
+            [](auto& e) { e.dir_ = ChainDir::issuingToLocking; },
+            [](auto& e) {
+                e.src_ = ripple::calcAccountID(
+                    ripple::randomKeyPair(ripple::KeyType::ed25519).first);
+            },
+            [&](auto& e) {
+                e.bridge_ = ripple::STXChainBridge{
+                    bridge_.lockingChainDoor(),
+                    ripple::xrpIssue(),
+                    account_,
+                    ripple::xrpIssue()};
+            },
+            [](auto& e) {
+                e.deliveredAmt_ = ripple::STAmount{ripple::XRPAmount{999999}};
+            },
+            [](auto& e) { ++e.claimID_; },
+            [&](auto& e) { e.otherChainDst_ = account_; }};
+
+        std::uint64_t i = 10;
+        for (auto const& change : changes)
+        {
+            auto const proposed = commit(i++);
+            BEAST_EXPECT(s.mark(proposed));
+            s.fill(proposed, sign(proposed));
+
+            // Validated with the same hash, but another field
+            auto validated = proposed;
+            change(validated);
+            BEAST_EXPECT(!s.take(validated));
+            // The mark is removed either way
+            BEAST_EXPECT(!s.take(proposed));
+        }
+        auto const info = s.getInfo();
+        BEAST_EXPECT(info["hits"].asUInt() == 0);
+        BEAST_EXPECT(info["misses"].asUInt() == 2 * changes.size());
+        BEAST_EXPECT(info["pending"].asUInt() == 0);
+    }
+
+    void
+    testPending()
+    {
+        testcase("pending");
+        SpeculativeClaims s{ledgers, j_};
+
+        // Validated while still being signed: signed inline, and the claim
+        // signed later is not kept
+        auto const e = commit(1);
+        BEAST_EXPECT(s.mark(e));
+        BEAST_EXPECT(!s.take(e));
+        s.fill(e, sign(e));
+        BEAST_EXPECT(s.getInfo()["pending"].asUInt() == 0);
+        BEAST_EXPECT(!s.take(e));
+
+        // Proposed again with other fields while the first was signed: the
+        // first claim does not fill the new mark
+        auto const first = commit(2);
+        auto second = first;
+        second.claimID_ = 3;
+        BEAST_EXPECT(s.mark(first));
+        BEAST_EXPECT(!s.take(first));
+        BEAST_EXPECT(s.mark(second));
+        s.fill(first, sign(first));
+        BEAST_EXPECT(!s.take(first));
+
+        // Nor is a mark filled twice
+        BEAST_EXPECT(s.mark(second));
+        auto const claim = sign(second);
+        s.fill(second, claim);
+        s.fill(second, sign(second));
+        auto const taken = s.take(second);
+        if (BEAST_EXPECT(taken))
+            BEAST_EXPECT(*taken == claim);
+    }
+
+    void
+    testDropExpire()
+    {
+        testcase("drop and expire");
+        SpeculativeClaims s{ledgers, j_};
+
+        // Attested without its claim
+        auto const e = commit(1);
+        BEAST_EXPECT(s.mark(e));
+        s.drop(e.txnHash_);
+        s.fill(e, sign(e));
+        BEAST_EXPECT(!s.take(e));
+
+        // Not validated in time. Only commits on the chain are dropped.
+        auto const late = commit(2);
+        BEAST_EXPECT(s.mark(late));
+        s.fill(late, sign(late));
+        s.expire(ChainType::issuing, 100 + ledgers + 1);
+        s.expire(ChainType::locking, 100 + ledgers);
+        BEAST_EXPECT(s.getInfo()["pending"].asUInt() == 1);
+        s.expire(ChainType::locking, 100 + ledgers + 1);
+        auto const info = s.getInfo();
+        BEAST_EXPECT(info["pending"].asUInt() == 0);
+        BEAST_EXPECT(info["dropped"].asUInt() == 1);
+        BEAST_EXPECT(!s.take(late));
+    }
+
+public:
+    void
+    run() override
+    {
+        testDisabled();
+        testTake();
+        testMismatch();
+        testPending();
+        testDropExpire();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(SpeculativeClaims, federator, xbwd);
+
+}  // namespace tests
+}  // namespace xbwd
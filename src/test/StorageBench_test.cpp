@@ -0,0 +1,157 @@
+#include <xbwd/app/DBInit.h>
+#include <xbwd/core/DatabaseCon.h>
+#include <xbwd/core/Storage.h>
+
+#include <ripple/basics/random.h>
+#include <ripple/beast/unit_test.h>
+#include <ripple/protocol/Issue.h>
+#include <ripple/protocol/SecretKey.h>
+#include <ripple/protocol/digest.h>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace xbwd {
+namespace tests {
+
+// Write and lookup throughput of the storage backends. Manual, since it
+// only reports numbers: run it with --unittest=StorageBench
+class StorageBench_test : public beast::unit_test::suite
+{
+    // Attestations written per batch commit, about what the federator
+    // writes for one ledger
+    static std::size_t constexpr batchSize = 100;
+    static std::size_t constexpr count = 50000;
+
+    // A temporary directory, removed when the test is done
+    struct TempDir
+    {
+        boost::filesystem::path path =
+            boost::filesystem::temp_directory_path() /
+            boost::filesystem::unique_path();
+
+        ~TempDir()
+        {
+            boost::system::error_code ec;
+            boost::filesystem::remove_all(path, ec);
+        }
+    };
+
+    std::vector<AttestationRecord>
+    makeRecords()
+    {
+        auto const [pk, sk] = ripple::randomKeyPair(ripple::KeyType::ed25519);
+        ripple::STXChainBridge const bridge{
+            ripple::calcAccountID(pk),
+            ripple::xrpIssue(),
+            ripple::calcAccountID(
+                ripple::randomKeyPair(ripple::KeyType::ed25519).first),
+            ripple::xrpIssue()};
+
+        std::vector<AttestationRecord> r(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto& a = r[i];
+            a.txnHash = ripple::sha512Half(i);
+            a.ledgerSeq = 1000 + i / batchSize;
+            a.id = i;
+            a.success = true;
+            a.deliveredAmt = ripple::STAmount{
+                ripple::XRPAmount{static_cast<std::int64_t>(1000000 + i)}};
+            a.bridge = bridge;
+            a.sendingAccount = ripple::calcAccountID(pk);
+            a.rewardAccount = a.sendingAccount;
+            a.publicKey = pk;
+            a.signature = ripple::sign(pk, sk, ripple::makeSlice(a.txnHash));
+        }
+        return r;
+    }
+
+    void
+    bench(Storage& storage, std::vector<AttestationRecord> const& records)
+    {
+        using clock = std::chrono::steady_clock;
+        auto const rate = [](std::size_t n, clock::duration d) {
+            return static_cast<std::uint64_t>(
+                n / std::chrono::duration<double>(d).count());
+        };
+        auto const dir = ChainDir::lockingToIssuing;
+        auto const t = AttestationTable::claim;
+
+        auto start = clock::now();
+        for (std::size_t i = 0; i < records.size(); i += batchSize)
+        {
+            Storage::Batch batch{storage};
+            auto const end = std::min(i + batchSize, records.size());
+            for (std::size_t k = i; k < end; ++k)
+                BEAST_EXPECT(storage.insert(dir, t, records[k]));
+        }
+        auto const writes = rate(records.size(), clock::now() - start);
+
+        // Lookups in random order, as RPC clients make them
+        std::vector<std::size_t> order(records.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+            order[i] = ripple::rand_int(order.size() - 1);
+
+        start = clock::now();
+        for (auto const i : order)
+        {
+            auto const r = storage.find(dir, t, records[i].txnHash);
+            BEAST_EXPECT(r && r->id == records[i].id);
+        }
+        auto const lookups = rate(order.size(), clock::now() - start);
+
+        start = clock::now();
+        std::size_t scanned = 0;
+        storage.scan(dir, t, AttestationQuery{}, [&](auto const&) {
+            ++scanned;
+            return true;
+        });
+        BEAST_EXPECT(scanned == records.size());
+        auto const scans = rate(scanned, clock::now() - start);
+
+        log << storage.name() << ": " << writes << " writes/s, " << lookups
+            << " lookups/s, " << scans << " scanned/s" << std::endl;
+    }
+
+public:
+    void
+    run() override
+    {
+        auto const records = makeRecords();
+        beast::Journal const j{beast::Journal::getNullSink()};
+
+        testcase("sqlite");
+        {
+            TempDir tmp;
+            DatabaseCon db{
+                tmp.path,
+                db_init::xChainDBName(),
+                db_init::xChainDBPragma(),
+                db_init::xChainDBInit(),
+                1,
+                j};
+            bench(*make_SQLiteStorage(db, j), records);
+        }
+
+        testcase("lmdb");
+        {
+            TempDir tmp;
+            bench(*make_LMDBStorage(tmp.path, 1ull << 30, j), records);
+        }
+
+        testcase("log");
+        {
+            TempDir tmp;
+            bench(*make_LogStorage(tmp.path, 64ull << 20, j), records);
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(StorageBench, core, xbwd);
+
+}  // namespace tests
+}  // namespace xbwd
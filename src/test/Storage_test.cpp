@@ -0,0 +1,401 @@
+#include <xbwd/app/DBInit.h>
+#include <xbwd/core/DatabaseCon.h>
+#include <xbwd/core/Storage.h>
+
+#include <ripple/beast/unit_test.h>
+#include <ripple/protocol/Issue.h>
+#include <ripple/protocol/SecretKey.h>
+#include <ripple/protocol/digest.h>
+
+#include <boost/filesystem.hpp>
+
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace xbwd {
+namespace tests {
+
+// The same checks against every storage backend, including reopening one
+// to see what it kept
+class Storage_test : public beast::unit_test::suite
+{
+    // A temporary directory, removed when the test is done
+    struct TempDir
+    {
+        boost::filesystem::path path =
+            boost::filesystem::temp_directory_path() /
+            boost::filesystem::unique_path();
+
+        ~TempDir()
+        {
+            boost::system::error_code ec;
+            boost::filesystem::remove_all(path, ec);
+        }
+    };
+
+    // A backend and the database it lives in, if it needs one
+    struct Opened
+    {
+        std::unique_ptr<DatabaseCon> db;
+        std::unique_ptr<Storage> storage;
+
+        Storage*
+        operator->()
+        {
+            return storage.get();
+        }
+    };
+
+    using Open = std::function<Opened(boost::filesystem::path const&)>;
+
+    static auto constexpr dir = ChainDir::lockingToIssuing;
+    static auto constexpr table = AttestationTable::claim;
+
+    beast::Journal const j_{beast::Journal::getNullSink()};
+    std::string backend_;
+    std::pair<ripple::PublicKey, ripple::SecretKey> const keys_ =
+        ripple::randomKeyPair(ripple::KeyType::ed25519);
+
+    AttestationRecord
+    makeRecord(std::uint64_t id, std::uint64_t n = 0)
+    {
+        auto const& [pk, sk] = keys_;
+        AttestationRecord r;
+        r.txnHash = ripple::sha512Half(id, n);
+        r.ledgerSeq = 1000 + id;
+        r.id = id;
+        r.success = true;
+        r.deliveredAmt = ripple::STAmount{
+            ripple::XRPAmount{static_cast<std::int64_t>(1000000 + id)}};
+        r.bridge = ripple::STXChainBridge{
+            ripple::calcAccountID(pk),
+            ripple::xrpIssue(),
+            ripple::calcAccountID(pk),
+            ripple::xrpIssue()};
+        r.sendingAccount = ripple::calcAccountID(pk);
+        r.rewardAccount = r.sendingAccount;
+        r.otherChainDst = r.sendingAccount;
+        r.publicKey = pk;
+        r.signature = ripple::sign(pk, sk, ripple::makeSlice(r.txnHash));
+        return r;
+    }
+
+    SubmissionRecord
+    makeSubmission(ChainType ct, std::uint32_t accountSqn)
+    {
+        SubmissionRecord r;
+        r.chain = ct;
+        r.accountSqn = accountSqn;
+        r.lastLedgerSeq = accountSqn + 4;
+        r.retriesAllowed = 3;
+        r.batch = ripple::Blob(16, static_cast<std::uint8_t>(accountSqn));
+        r.signedTxn = ripple::Blob(32, static_cast<std::uint8_t>(~accountSqn));
+        return r;
+    }
+
+    void
+    expectSame(
+        std::optional<AttestationRecord> const& r,
+        AttestationRecord const& expected)
+    {
+        if (!BEAST_EXPECT(r))
+            return;
+        BEAST_EXPECT(r->txnHash == expected.txnHash);
+        BEAST_EXPECT(r->ledgerSeq == expected.ledgerSeq);
+        BEAST_EXPECT(r->id == expected.id);
+        BEAST_EXPECT(r->success == expected.success);
+        BEAST_EXPECT(r->deliveredAmt == expected.deliveredAmt);
+        BEAST_EXPECT(!r->rewardAmt);
+        BEAST_EXPECT(r->bridge == expected.bridge);
+        BEAST_EXPECT(r->sendingAccount == expected.sendingAccount);
+        BEAST_EXPECT(r->rewardAccount == expected.rewardAccount);
+        BEAST_EXPECT(r->otherChainDst == expected.otherChainDst);
+        BEAST_EXPECT(r->publicKey == expected.publicKey);
+        BEAST_EXPECT(r->signature == expected.signature);
+    }
+
+    std::vector<std::uint64_t>
+    scanIDs(Storage& storage, AttestationQuery const& q = {})
+    {
+        std::vector<std::uint64_t> ids;
+        storage.scan(dir, table, q, [&](AttestationRecord const& r) {
+            ids.push_back(r.id);
+            return true;
+        });
+        return ids;
+    }
+
+    void
+    testRoundTrip(Open const& open)
+    {
+        testcase(backend_ + " round trip");
+        TempDir tmp;
+        std::vector<AttestationRecord> records;
+        for (std::uint64_t id : {3, 1, 2})
+            records.push_back(makeRecord(id));
+        {
+            auto s = open(tmp.path);
+            for (auto const& r : records)
+                BEAST_EXPECT(s->insert(dir, table, r));
+            for (auto const& r : records)
+                expectSame(s->find(dir, table, r.txnHash), r);
+            BEAST_EXPECT(!s->find(dir, table, makeRecord(4).txnHash));
+            BEAST_EXPECT(!s->find(
+                ChainDir::issuingToLocking, table, records[0].txnHash));
+            BEAST_EXPECT(
+                scanIDs(*s.storage) == std::vector<std::uint64_t>({1, 2, 3}));
+
+            AttestationQuery q;
+            q.minID = 2;
+            BEAST_EXPECT(
+                scanIDs(*s.storage, q) == std::vector<std::uint64_t>({2, 3}));
+
+            // A page, and the one after it
+            q = {};
+            q.limit = 2;
+            BEAST_EXPECT(
+                scanIDs(*s.storage, q) == std::vector<std::uint64_t>({1, 2}));
+            auto const& second = records[2];
+            q.after = std::make_pair(second.id, second.txnHash);
+            BEAST_EXPECT(
+                scanIDs(*s.storage, q) == std::vector<std::uint64_t>({3}));
+        }
+        auto s = open(tmp.path);
+        for (auto const& r : records)
+            expectSame(s->find(dir, table, r.txnHash), r);
+    }
+
+    void
+    testDuplicate(Open const& open)
+    {
+        testcase(backend_ + " insert duplicate");
+        TempDir tmp;
+        auto s = open(tmp.path);
+        auto const r = makeRecord(1);
+        BEAST_EXPECT(s->insert(dir, table, r));
+
+        auto changed = r;
+        changed.ledgerSeq += 1;
+        BEAST_EXPECT(!s->insert(dir, table, changed));
+        expectSame(s->find(dir, table, r.txnHash), r);
+
+        // Another transaction for the same id is stored beside it
+        BEAST_EXPECT(s->insert(dir, table, makeRecord(1, 1)));
+        BEAST_EXPECT(
+            scanIDs(*s.storage) == std::vector<std::uint64_t>({1, 1}));
+    }
+
+    void
+    testErase(Open const& open)
+    {
+        testcase(backend_ + " erase");
+        TempDir tmp;
+        auto const a = makeRecord(1);
+        auto const b = makeRecord(1, 1);
+        auto const c = makeRecord(2);
+        {
+            auto s = open(tmp.path);
+            for (auto const& r : {a, b, c})
+                BEAST_EXPECT(s->insert(dir, table, r));
+            s->erase(dir, table, 1);
+            // Nothing to erase
+            s->erase(dir, table, 7);
+            s->erase(ChainDir::issuingToLocking, table, 2);
+
+            BEAST_EXPECT(!s->find(dir, table, a.txnHash));
+            BEAST_EXPECT(!s->find(dir, table, b.txnHash));
+            expectSame(s->find(dir, table, c.txnHash), c);
+            BEAST_EXPECT(scanIDs(*s.storage) == std::vector<std::uint64_t>{2});
+
+            // An erased transaction may be stored again
+            BEAST_EXPECT(s->insert(dir, table, a));
+        }
+        auto s = open(tmp.path);
+        expectSame(s->find(dir, table, a.txnHash), a);
+        BEAST_EXPECT(!s->find(dir, table, b.txnHash));
+        BEAST_EXPECT(
+            scanIDs(*s.storage) == std::vector<std::uint64_t>({1, 2}));
+    }
+
+    void
+    testSyncState(Open const& open)
+    {
+        testcase(backend_ + " sync state");
+        TempDir tmp;
+        auto const hash = ripple::sha512Half(std::uint32_t{42});
+        {
+            auto s = open(tmp.path);
+            BEAST_EXPECT(!s->getSyncState(ChainType::locking));
+            BEAST_EXPECT(!s->getSyncState(ChainType::issuing));
+
+            s->setSyncTxnHash(ChainType::locking, hash);
+            s->setSyncLedgerSeq(ChainType::locking, 7);
+            s->setSyncState(ChainType::issuing, SyncState{hash, 9});
+            s->setSyncLedgerSeq(ChainType::issuing, 11);
+        }
+        auto s = open(tmp.path);
+        auto const locking = s->getSyncState(ChainType::locking);
+        auto const issuing = s->getSyncState(ChainType::issuing);
+        if (BEAST_EXPECT(locking && issuing))
+        {
+            BEAST_EXPECT(locking->txnHash == hash);
+            BEAST_EXPECT(locking->ledgerSeq == 7);
+            BEAST_EXPECT(issuing->txnHash == hash);
+            BEAST_EXPECT(issuing->ledgerSeq == 11);
+        }
+    }
+
+    void
+    testSubmissions(Open const& open)
+    {
+        testcase(backend_ + " submissions");
+        TempDir tmp;
+        {
+            auto s = open(tmp.path);
+            BEAST_EXPECT(s->getSubmissions().empty());
+            s->putSubmission(makeSubmission(ChainType::issuing, 5));
+            s->putSubmission(makeSubmission(ChainType::locking, 8));
+            s->putSubmission(makeSubmission(ChainType::locking, 6));
+            s->putSubmission(makeSubmission(ChainType::locking, 7));
+            s->eraseSubmission(ChainType::locking, 7);
+            s->eraseSubmission(ChainType::issuing, 7);
+
+            // Replaced, not added
+            auto replaced = makeSubmission(ChainType::locking, 8);
+            replaced.retriesAllowed = 1;
+            s->putSubmission(replaced);
+        }
+        auto s = open(tmp.path);
+        auto const subs = s->getSubmissions();
+        if (!BEAST_EXPECT(subs.size() == 3))
+            return;
+        BEAST_EXPECT(subs[0].chain == ChainType::locking);
+        BEAST_EXPECT(subs[0].accountSqn == 6);
+        BEAST_EXPECT(subs[1].chain == ChainType::locking);
+        BEAST_EXPECT(subs[1].accountSqn == 8);
+        BEAST_EXPECT(subs[1].retriesAllowed == 1);
+        BEAST_EXPECT(subs[2].chain == ChainType::issuing);
+        BEAST_EXPECT(subs[2].accountSqn == 5);
+
+        auto const expected = makeSubmission(ChainType::issuing, 5);
+        BEAST_EXPECT(subs[2].lastLedgerSeq == expected.lastLedgerSeq);
+        BEAST_EXPECT(subs[2].batch == expected.batch);
+        BEAST_EXPECT(subs[2].signedTxn == expected.signedTxn);
+    }
+
+    void
+    testBatch(Open const& open)
+    {
+        testcase(backend_ + " batch");
+        TempDir tmp;
+        auto const a = makeRecord(1);
+        auto const b = makeRecord(2);
+        auto const c = makeRecord(3);
+        auto const hash = ripple::sha512Half(std::uint32_t{7});
+        {
+            auto s = open(tmp.path);
+            {
+                Storage::Batch batch{*s.storage};
+                BEAST_EXPECT(s->insert(dir, table, a));
+                s->setSyncTxnHash(ChainType::locking, a.txnHash);
+            }
+
+            // Leaving a batch by an exception rolls it back
+            try
+            {
+                Storage::Batch batch{*s.storage};
+                BEAST_EXPECT(s->insert(dir, table, b));
+                s->setSyncTxnHash(ChainType::locking, hash);
+                s->erase(dir, table, 1);
+                s->putSubmission(makeSubmission(ChainType::locking, 1));
+                throw std::runtime_error("abandon batch");
+            }
+            catch (std::runtime_error const&)
+            {
+            }
+            expectSame(s->find(dir, table, a.txnHash), a);
+            BEAST_EXPECT(!s->find(dir, table, b.txnHash));
+            BEAST_EXPECT(
+                s->getSyncState(ChainType::locking)->txnHash == a.txnHash);
+            BEAST_EXPECT(s->getSubmissions().empty());
+
+            // A nested rollback undoes the enclosing batch, whose commit
+            // then throws
+            bool threw = false;
+            try
+            {
+                Storage::Batch outer{*s.storage};
+                BEAST_EXPECT(s->insert(dir, table, b));
+                try
+                {
+                    Storage::Batch inner{*s.storage};
+                    BEAST_EXPECT(s->insert(dir, table, c));
+                    throw std::runtime_error("abandon inner batch");
+                }
+                catch (std::runtime_error const&)
+                {
+                }
+            }
+            catch (std::exception const&)
+            {
+                threw = true;
+            }
+            BEAST_EXPECT(threw);
+            BEAST_EXPECT(!s->find(dir, table, b.txnHash));
+            BEAST_EXPECT(!s->find(dir, table, c.txnHash));
+
+            // Still usable
+            BEAST_EXPECT(s->insert(dir, table, c));
+        }
+        auto s = open(tmp.path);
+        expectSame(s->find(dir, table, a.txnHash), a);
+        BEAST_EXPECT(!s->find(dir, table, b.txnHash));
+        expectSame(s->find(dir, table, c.txnHash), c);
+        BEAST_EXPECT(
+            s->getSyncState(ChainType::locking)->txnHash == a.txnHash);
+    }
+
+    void
+    testBackend(std::string const& backend, Open const& open)
+    {
+        backend_ = backend;
+        testRoundTrip(open);
+        testDuplicate(open);
+        testErase(open);
+        testSyncState(open);
+        testSubmissions(open);
+        testBatch(open);
+    }
+
+public:
+    void
+    run() override
+    {
+        testBackend("sqlite", [this](boost::filesystem::path const& path) {
+            Opened r;
+            r.db = std::make_unique<DatabaseCon>(
+                path,
+                db_init::xChainDBName(),
+                db_init::xChainDBPragma(),
+                db_init::xChainDBInit(),
+                1,
+                j_);
+            r.storage = make_SQLiteStorage(*r.db, j_);
+            return r;
+        });
+        testBackend("lmdb", [this](boost::filesystem::path const& path) {
+            return Opened{nullptr, make_LMDBStorage(path, 64ull << 20, j_)};
+        });
+        testBackend("log", [this](boost::filesystem::path const& path) {
+            return Opened{nullptr, make_LogStorage(path, 1ull << 20, j_)};
+        });
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(Storage, core, xbwd);
+
+}  // namespace tests
+}  // namespace xbwd
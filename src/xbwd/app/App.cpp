@@ -5,31 +5,38 @@
 #include <xbwd/federator/Federator.h>
 #include <xbwd/rpc/ServerHandler.h>
 
-#include <ripple/beast/core/CurrentThreadName.h>
 #include <ripple/protocol/STAmount.h>
 #include <ripple/protocol/STXChainBridge.h>
 #include <ripple/protocol/SecretKey.h>
 #include <ripple/protocol/TER.h>
 
+#include <algorithm>
+#include <memory>
+
 namespace xbwd {
 
-BasicApp::BasicApp(std::size_t numberOfThreads)
+BasicApp::BasicApp(config::ThreadGroupConfig const& io)
+    : ioMonitor_(io_service_)
 {
     work_.emplace(io_service_);
+    auto numberOfThreads = io.size();
     threads_.reserve(numberOfThreads);
 
     while (numberOfThreads--)
     {
-        threads_.emplace_back([this, numberOfThreads]() {
-            beast::setCurrentThreadName(
-                "io svc #" + std::to_string(numberOfThreads));
+        threads_.emplace_back([this, numberOfThreads, cpus = io.cpus]() {
+            threadMap_.enter(
+                "io", "io svc #" + std::to_string(numberOfThreads), cpus);
+            ioMonitor_.addCurrentThread();
             this->io_service_.run();
         });
     }
+    ioMonitor_.start();
 }
 
 BasicApp::~BasicApp()
 {
+    ioMonitor_.stop();
     work_.reset();
 
     for (auto& t : threads_)
@@ -39,7 +46,7 @@ BasicApp::~BasicApp()
 App::App(
     std::unique_ptr<config::Config> config,
     beast::severities::Severity logLevel)
-    : BasicApp(std::thread::hardware_concurrency())
+    : BasicApp(config->threads.io)
     , logs_(logLevel)
     , j_([&, this]() {
         if (!config->logFile.empty())
@@ -57,16 +64,98 @@ App::App(
           db_init::xChainDBName(),
           db_init::xChainDBPragma(),
           db_init::xChainDBInit(),
+          config->dbReadPoolSize,
           j_)
+    , storage_([&]() {
+        if (config->dbBackend == "lmdb")
+            return make_LMDBStorage(
+                config->dataDir / db_init::xChainLMDBDirName(),
+                config->lmdbMapSize,
+                logs_.journal("Storage"));
+        if (config->dbBackend == "log")
+            return make_LogStorage(
+                config->dataDir / db_init::xChainLogDirName(),
+                config->logSegmentSize,
+                logs_.journal("Storage"));
+        return make_SQLiteStorage(xChainTxnDB_, logs_.journal("Storage"));
+    }())
+    , snapshot_(
+          config->dbBackend == "sqlite" ? std::make_unique<DatabaseSnapshot>(
+                                              xChainTxnDB_,
+                                              logs_.journal("Snapshot"))
+                                        : nullptr)
+    , attestationCache_(config->attestationCacheSize)
     , signals_(io_service_)
+    , subscriptions_(logs_.journal("Subscriptions"))
+    , resources_(
+          config->rateLimit,
+          config->adminConfig,
+          logs_.journal("ResourceManager"))
     , config_(std::move(config))
 {
     // TODO initialize the public and secret keys
 
+    {
+        // Pinning only isolates a role if no other role shares its CPUs
+        auto const& t = config_->threads;
+        std::vector<std::pair<char const*, config::ThreadGroupConfig const*>>
+            roles{
+                {"io", &t.io},
+                {"rpc", &t.rpc},
+                {"federator_event", &t.federatorEvent},
+                {"federator_submit", &t.federatorSubmit},
+                {"signing", &t.signing}};
+        if (t.dedicatedChainIO)
+        {
+            roles.emplace_back("locking_io", &t.lockingChainIO);
+            roles.emplace_back("issuing_io", &t.issuingChainIO);
+        }
+        for (std::size_t i = 0; i < roles.size(); ++i)
+        {
+            for (std::size_t k = i + 1; k < roles.size(); ++k)
+            {
+                for (auto const cpu : roles[i].second->cpus)
+                {
+                    auto const& other = roles[k].second->cpus;
+                    if (std::find(other.begin(), other.end(), cpu) ==
+                        other.end())
+                        continue;
+                    JLOGV(
+                        j_.warn(),
+                        "thread roles share a CPU",
+                        ripple::jv("role1", roles[i].first),
+                        ripple::jv("role2", roles[k].first),
+                        ripple::jv("cpu", cpu));
+                    break;
+                }
+            }
+        }
+    }
+
     try
     {
+        if (config_->threads.dedicatedChainIO)
+        {
+            chainIOLoops_[ChainType::locking] = std::make_unique<IOLoop>(
+                "locking_io", config_->threads.lockingChainIO, threadMap_);
+            chainIOLoops_[ChainType::issuing] = std::make_unique<IOLoop>(
+                "issuing_io", config_->threads.issuingChainIO, threadMap_);
+        }
+        auto chainIOService = [this](ChainType ct) -> auto& {
+            return chainIOLoops_[ct] ? chainIOLoops_[ct]->get_io_service()
+                                     : get_io_service();
+        };
+
         federator_ = make_Federator(
-            *this, get_io_service(), *config_, logs_.journal("Federator"));
+            *this,
+            chainIOService(ChainType::locking),
+            chainIOService(ChainType::issuing),
+            *config_,
+            logs_.journal("Federator"));
+
+        if (config_->standby)
+            standby_ = std::make_unique<Standby>(
+                *this, *config_->standby, logs_.journal("Standby"));
 
         serverHandler_ = std::make_unique<rpc::ServerHandler>(
             *this, get_io_service(), logs_.journal("ServerHandler"));
@@ -117,6 +206,8 @@ App::setup()
             p.port = endpoint.port();
             // TODO - encode protocol in config
             p.protocol.insert("http");
+            p.protocol.insert("ws");
+            p.ws_queue_limit = config_->wsSendQueueLimit;
             r.push_back(p);
             return r;
         }();
@@ -139,11 +230,17 @@ App::start()
         federator_->start();
     // TODO: unlockMainLoop should go away
     federator_->unlockMainLoop();
+    // The federator stays inactive until the lease is taken
+    if (standby_)
+        standby_->start();
 };
 
 void
 App::stop()
 {
+    // Releases the lease, so the federator submits nothing more
+    if (standby_)
+        standby_->stop();
     if (federator_)
         federator_->stop();
     if (serverHandler_)
@@ -167,6 +264,56 @@ App::getXChainTxnDB()
     return xChainTxnDB_;
 }
 
+Storage&
+App::storage()
+{
+    return *storage_;
+}
+
+AttestationCache&
+App::attestationCache()
+{
+    return attestationCache_;
+}
+
+DatabaseSnapshot*
+App::snapshot()
+{
+    return snapshot_.get();
+}
+
+Standby*
+App::standby()
+{
+    return standby_.get();
+}
+
+rpc::Subscriptions&
+App::subscriptions()
+{
+    return subscriptions_;
+}
+
+rpc::ResourceManager&
+App::resources()
+{
+    return resources_;
+}
+
+Json::Value
+App::getIOInfo() const
+{
+    Json::Value ret{Json::objectValue};
+    ret["mode"] = config_->threads.dedicatedChainIO ? "dedicated" : "shared";
+    ret["shared"] = ioMonitor_.getInfo();
+    for (auto const ct : {ChainType::locking, ChainType::issuing})
+    {
+        if (chainIOLoops_[ct])
+            ret[to_string(ct)] = chainIOLoops_[ct]->getInfo();
+    }
+    return ret;
+}
+
 void
 App::signalStop()
 {
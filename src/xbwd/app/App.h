@@ -1,8 +1,17 @@
 #pragma once
 
 #include <xbwd/app/Config.h>
+#include <xbwd/app/IOLoop.h>
+#include <xbwd/app/Standby.h>
+#include <xbwd/app/ThreadMap.h>
+#include <xbwd/basics/ChainTypes.h>
+#include <xbwd/core/AttestationCache.h>
 #include <xbwd/core/DatabaseCon.h>
+#include <xbwd/core/DatabaseSnapshot.h>
+#include <xbwd/core/Storage.h>
+#include <xbwd/rpc/ResourceManager.h>
 #include <xbwd/rpc/ServerHandler.h>
+#include <xbwd/rpc/Subscriptions.h>
 
 #include <ripple/beast/utility/Journal.h>
 #include <ripple/protocol/KeyType.h>
@@ -31,12 +40,15 @@ class Federator;
 class BasicApp
 {
 protected:
+    // Declared first, the io threads register in it as they start
+    ThreadMap threadMap_;
     std::optional<boost::asio::io_service::work> work_;
     std::vector<std::thread> threads_;
     boost::asio::io_service io_service_;
+    IOLoopMonitor ioMonitor_;
 
 public:
-    BasicApp(std::size_t numberOfThreads);
+    explicit BasicApp(config::ThreadGroupConfig const& io);
     ~BasicApp();
 
     boost::asio::io_service&
@@ -44,6 +56,18 @@ public:
     {
         return io_service_;
     }
+
+    ThreadMap&
+    threadMap()
+    {
+        return threadMap_;
+    }
+
+    IOLoopMonitor const&
+    ioMonitor() const
+    {
+        return ioMonitor_;
+    }
 };
 
 class App : public BasicApp
@@ -53,10 +77,26 @@ class App : public BasicApp
 
     // Database for cross chain transactions
     DatabaseCon xChainTxnDB_;
+    // Attestations and sync state, in xChainTxnDB_ or in LMDB
+    std::unique_ptr<Storage> storage_;
+    // Online copies of xChainTxnDB_. Only set with the sqlite backend.
+    std::unique_ptr<DatabaseSnapshot> snapshot_;
+    // Recently stored attestations, read by the witness RPCs
+    AttestationCache attestationCache_;
 
     boost::asio::signal_set signals_;
 
+    // Websocket clients subscribed to federator events
+    rpc::Subscriptions subscriptions_;
+    // RPC client rate limits and request queues
+    rpc::ResourceManager resources_;
+    // Chain websocket io_services, if dedicated ones are configured. Must
+    // outlive the federator, whose listeners shut down on them.
+    ChainArray<std::unique_ptr<IOLoop>> chainIOLoops_;
+
     std::shared_ptr<Federator> federator_;
+    // Only set if the witness runs as an active/standby pair
+    std::unique_ptr<Standby> standby_;
     std::unique_ptr<rpc::ServerHandler> serverHandler_;
 
     std::condition_variable stoppingCondition_;
@@ -87,6 +127,30 @@ public:
     DatabaseCon&
     getXChainTxnDB();
 
+    Storage&
+    storage();
+
+    AttestationCache&
+    attestationCache();
+
+    // Null unless the attestations are stored in sqlite
+    DatabaseSnapshot*
+    snapshot();
+
+    // Null unless configured as an active/standby pair
+    Standby*
+    standby();
+
+    rpc::Subscriptions&
+    subscriptions();
+
+    rpc::ResourceManager&
+    resources();
+
+    // Load of the shared io_service and of the dedicated chain ones
+    Json::Value
+    getIOInfo() const;
+
     config::Config&
     config();
 
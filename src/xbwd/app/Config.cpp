@@ -6,6 +6,9 @@
 #include <ripple/protocol/AccountID.h>
 #include <ripple/protocol/KeyType.h>
 
+#include <algorithm>
+#include <thread>
+
 namespace xbwd {
 namespace config {
 
@@ -105,6 +108,115 @@ TxnSubmit::TxnSubmit(Json::Value const& jv)
     }
 }
 
+RateLimitConfig::RateLimitConfig(Json::Value const& jv)
+{
+    if (jv.isMember("Rate"))
+        rate = rpc::fromJson<std::uint32_t>(jv, "Rate");
+    if (jv.isMember("Burst"))
+        burst = rpc::fromJson<std::uint32_t>(jv, "Burst");
+    if (jv.isMember("MaxQueued"))
+        maxQueued = rpc::fromJson<std::uint32_t>(jv, "MaxQueued");
+    if (rate == 0 || burst == 0 || maxQueued == 0)
+        throw std::runtime_error("RPCRateLimit config wrong format");
+}
+
+StandbyConfig::StandbyConfig(Json::Value const& jv)
+    : leaseFile{rpc::fromJson<boost::filesystem::path>(jv, "LeaseFile")}
+    , peerEndpoint{rpc::fromJson<beast::IP::Endpoint>(jv, "PeerRPCEndpoint")}
+{
+    if (jv.isMember("LeaseTTLSeconds"))
+    {
+        leaseTTL = std::chrono::seconds{
+            rpc::fromJson<std::uint32_t>(jv, "LeaseTTLSeconds")};
+        if (leaseTTL.count() == 0)
+            throw std::runtime_error("LeaseTTLSeconds must be positive");
+    }
+    if (jv.isMember("PeerUsername") || jv.isMember("PeerPassword"))
+        peerAuth = AdminConfig::PasswordAuth{
+            rpc::fromJson<std::string>(jv, "PeerUsername"),
+            rpc::fromJson<std::string>(jv, "PeerPassword")};
+}
+
+AggregationConfig::AggregationConfig(Json::Value const& jv)
+{
+    if (!jv["Peers"].isArray() || jv["Peers"].size() == 0)
+        throw std::runtime_error("Aggregation config needs Peers");
+    for (auto const& p : jv["Peers"])
+    {
+        Peer peer{rpc::fromJson<beast::IP::Endpoint>(p, "RPCEndpoint")};
+        if (p.isMember("Username") || p.isMember("Password"))
+            peer.auth = AdminConfig::PasswordAuth{
+                rpc::fromJson<std::string>(p, "Username"),
+                rpc::fromJson<std::string>(p, "Password")};
+        peers.push_back(std::move(peer));
+    }
+    position = rpc::fromJson<std::uint32_t>(jv, "Position");
+    if (position > peers.size())
+        throw std::runtime_error("Aggregation Position past the peers");
+    if (jv.isMember("TurnLedgers"))
+        turnLedgers = rpc::fromJson<std::uint32_t>(jv, "TurnLedgers");
+    if (jv.isMember("FallbackLedgers"))
+        fallbackLedgers = rpc::fromJson<std::uint32_t>(jv, "FallbackLedgers");
+    if (turnLedgers == 0 || fallbackLedgers == 0)
+        throw std::runtime_error("Aggregation ledger counts must be positive");
+}
+
+ThreadGroupConfig::ThreadGroupConfig(
+    Json::Value const& jv,
+    std::uint32_t defaultCount)
+    : count(defaultCount)
+{
+    if (jv.isMember("Count"))
+        count = rpc::fromJson<std::uint32_t>(jv, "Count");
+    if (jv.isMember("CPUs"))
+    {
+        if (!jv["CPUs"].isArray())
+            throw std::runtime_error("Threads config wrong format");
+        for (auto const& cpu : jv["CPUs"])
+            cpus.push_back(cpu.asUInt());
+    }
+}
+
+std::size_t
+ThreadGroupConfig::size() const
+{
+    if (count)
+        return count;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+ThreadsConfig::ThreadsConfig()
+{
+    lockingChainIO.count = 1;
+    issuingChainIO.count = 1;
+}
+
+ThreadsConfig::ThreadsConfig(Json::Value const& jv) : ThreadsConfig()
+{
+    if (jv.isMember("IO"))
+        io = ThreadGroupConfig{jv["IO"]};
+    if (jv.isMember("RPC"))
+        rpc = ThreadGroupConfig{jv["RPC"]};
+    if (jv.isMember("FederatorEvent"))
+        federatorEvent = ThreadGroupConfig{jv["FederatorEvent"]};
+    if (jv.isMember("FederatorSubmit"))
+        federatorSubmit = ThreadGroupConfig{jv["FederatorSubmit"]};
+    if (jv.isMember("Signing"))
+        signing = ThreadGroupConfig{jv["Signing"]};
+    if (jv.isMember("ChainIO"))
+    {
+        auto const mode = jv["ChainIO"].asString();
+        if (mode != "shared" && mode != "dedicated")
+            throw std::runtime_error(
+                "ChainIO must be \"shared\" or \"dedicated\"");
+        dedicatedChainIO = mode == "dedicated";
+    }
+    if (jv.isMember("LockingChainIO"))
+        lockingChainIO = ThreadGroupConfig{jv["LockingChainIO"], 1};
+    if (jv.isMember("IssuingChainIO"))
+        issuingChainIO = ThreadGroupConfig{jv["IssuingChainIO"], 1};
+}
+
 ChainConfig::ChainConfig(Json::Value const& jv)
     : chainIp{rpc::fromJson<beast::IP::Endpoint>(jv, "Endpoint")}
     , rewardAccount{rpc::fromJson<ripple::AccountID>(jv, "RewardAccount")}
@@ -139,6 +251,53 @@ Config::Config(Json::Value const& jv)
           jv.isMember("LogLevel") ? jv["LogLevel"].asString() : std::string())
     , logSilent(jv.isMember("LogSilent") ? jv["LogSilent"].asBool() : false)
 {
+    if (jv.isMember("DBReadPoolSize"))
+        dbReadPoolSize = rpc::fromJson<std::uint32_t>(jv, "DBReadPoolSize");
+    if (jv.isMember("DBBackend"))
+    {
+        dbBackend = jv["DBBackend"].asString();
+        if (dbBackend != "sqlite" && dbBackend != "lmdb" && dbBackend != "log")
+            throw std::runtime_error(
+                "DBBackend must be \"sqlite\", \"lmdb\" or \"log\"");
+    }
+    if (jv.isMember("LMDBMapSizeMB"))
+    {
+        auto const mb = rpc::fromJson<std::uint32_t>(jv, "LMDBMapSizeMB");
+        if (mb == 0)
+            throw std::runtime_error("LMDBMapSizeMB must be positive");
+        lmdbMapSize = std::uint64_t{mb} << 20;
+    }
+    if (jv.isMember("LogSegmentSizeMB"))
+    {
+        auto const mb = rpc::fromJson<std::uint32_t>(jv, "LogSegmentSizeMB");
+        if (mb == 0)
+            throw std::runtime_error("LogSegmentSizeMB must be positive");
+        logSegmentSize = std::uint64_t{mb} << 20;
+    }
+    if (jv.isMember("WSSendQueueLimit"))
+    {
+        wsSendQueueLimit =
+            rpc::fromJson<std::uint16_t>(jv, "WSSendQueueLimit");
+        if (wsSendQueueLimit == 0)
+            throw std::runtime_error("WSSendQueueLimit must be positive");
+    }
+    if (jv.isMember("GapBackfillLedgers"))
+        gapBackfillLedgers =
+            rpc::fromJson<std::uint32_t>(jv, "GapBackfillLedgers");
+    if (jv.isMember("AttestationCacheSize"))
+        attestationCacheSize =
+            rpc::fromJson<std::uint32_t>(jv, "AttestationCacheSize");
+    if (jv.isMember("SpeculativeSigningLedgers"))
+        speculativeSigningLedgers =
+            rpc::fromJson<std::uint32_t>(jv, "SpeculativeSigningLedgers");
+    if (jv.isMember("RPCRateLimit"))
+        rateLimit = RateLimitConfig{jv["RPCRateLimit"]};
+    if (jv.isMember("Threads"))
+        threads = ThreadsConfig{jv["Threads"]};
+    if (jv.isMember("Standby"))
+        standby.emplace(jv["Standby"]);
+    if (jv.isMember("Aggregation"))
+        aggregation.emplace(jv["Aggregation"]);
 }
 
 }  // namespace config
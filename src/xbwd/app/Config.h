@@ -13,7 +13,10 @@
 #include <boost/asio/ip/network_v6.hpp>
 #include <boost/filesystem.hpp>
 
+#include <chrono>
+#include <optional>
 #include <string>
+#include <vector>
 
 namespace xbwd {
 namespace config {
@@ -49,6 +52,104 @@ struct TxnSubmit
     explicit TxnSubmit(Json::Value const& jv);
 };
 
+// Per client RPC rate limits. Clients on the admin address list are exempt.
+struct RateLimitConfig
+{
+    // Cost units refilled per second
+    std::uint32_t rate = 200;
+    // Most cost units a client can accumulate
+    std::uint32_t burst = 2000;
+    // Most requests waiting for an RPC thread before new ones are dropped
+    std::uint32_t maxQueued = 1000;
+
+    RateLimitConfig() = default;
+    explicit RateLimitConfig(Json::Value const& jv);
+};
+
+// Size and CPU affinity of one group of threads
+struct ThreadGroupConfig
+{
+    // Number of threads. 0 means one per hardware thread.
+    std::uint32_t count = 0;
+    // CPUs the threads are pinned to. Empty means not pinned.
+    std::vector<std::uint32_t> cpus;
+
+    ThreadGroupConfig() = default;
+    explicit ThreadGroupConfig(
+        Json::Value const& jv,
+        std::uint32_t defaultCount = 0);
+
+    std::size_t
+    size() const;
+};
+
+// Thread topology. Giving roles disjoint CPU lists isolates them from each
+// other.
+struct ThreadsConfig
+{
+    // Shared io_service threads: the RPC server sockets, and the chain
+    // websockets unless dedicatedChainIO is set
+    ThreadGroupConfig io;
+    // RPC request handlers
+    ThreadGroupConfig rpc;
+    // Federator event loop, which also writes the database. Always 1 thread.
+    ThreadGroupConfig federatorEvent;
+    // Federator transaction submit loop. Always 1 thread.
+    ThreadGroupConfig federatorSubmit;
+    // Sign the attestations of each event batch in parallel for the event
+    // loop, which matters while catching up
+    ThreadGroupConfig signing;
+    // Give each chain's websocket its own io_service and threads, so a busy
+    // chain cannot delay the other chain's ledger stream
+    bool dedicatedChainIO = false;
+    // Threads of the dedicated chain io_services. Count defaults to 1.
+    ThreadGroupConfig lockingChainIO;
+    ThreadGroupConfig issuingChainIO;
+
+    ThreadsConfig();
+    explicit ThreadsConfig(Json::Value const& jv);
+};
+
+// Hot standby. Two witnesses with the same keys on one host share a lease
+// file. The one holding the lease submits; the other follows its state and
+// takes over once the lease expires.
+struct StandbyConfig
+{
+    boost::filesystem::path leaseFile;
+    // The lease expires if not renewed for this long
+    std::chrono::seconds leaseTTL{5};
+    // RPC endpoint of the other witness, followed while standing by
+    beast::IP::Endpoint peerEndpoint;
+    // Admin credentials of the other witness, if it requires them
+    std::optional<AdminConfig::PasswordAuth> peerAuth;
+
+    explicit StandbyConfig(Json::Value const& jv);
+};
+
+// Witnesses of a bridge exchange their signed attestations, and the one
+// whose turn it is submits them together, so each batch goes on chain once
+// rather than once per witness.
+struct AggregationConfig
+{
+    struct Peer
+    {
+        // RPC endpoint of the other witness
+        beast::IP::Endpoint endpoint;
+        std::optional<AdminConfig::PasswordAuth> auth;
+    };
+    std::vector<Peer> peers;
+    // Place of this witness in the rotation, from 0 to the number of peers.
+    // Each witness of the bridge is given a different one.
+    std::uint32_t position = 0;
+    // Ledgers of the destination chain a turn lasts
+    std::uint32_t turnLedgers = 16;
+    // Ledgers attestations are held back for the aggregator before this
+    // witness submits them itself
+    std::uint32_t fallbackLedgers = 8;
+
+    explicit AggregationConfig(Json::Value const& jv);
+};
+
 struct ChainConfig
 {
     beast::IP::Endpoint chainIp;
@@ -66,10 +167,36 @@ public:
     ChainConfig issuingChainConfig;
     beast::IP::Endpoint rpcEndpoint;
     boost::filesystem::path dataDir;
+    // Number of read only DB connections used by RPC handlers
+    std::uint32_t dbReadPoolSize = 2;
+    // Where attestations and sync state are kept: "sqlite", "lmdb" or "log"
+    std::string dbBackend = "sqlite";
+    // Upper bound, in bytes, on the size of the LMDB environment. The file
+    // grows to it as needed. Configured in megabytes.
+    std::uint64_t lmdbMapSize = 16ull << 30;
+    // Size, in bytes, of each segment file of the "log" backend. Configured
+    // in megabytes.
+    std::uint64_t logSegmentSize = 64ull << 20;
+    // Messages queued for a websocket client before it is disconnected as a
+    // slow consumer
+    std::uint16_t wsSendQueueLimit = 100;
+    // Ledgers a claim id or create count gap stays open before the missing
+    // commits are searched for on chain. 0 disables gap detection.
+    std::uint32_t gapBackfillLedgers = 20;
+    // Signed attestations kept in memory for the witness RPCs. 0 disables
+    // the cache.
+    std::uint32_t attestationCacheSize = 4096;
+    // Ledgers a claim signed from a proposed commit waits for the commit to
+    // be validated. 0 disables speculative signing.
+    std::uint32_t speculativeSigningLedgers = 0;
+    RateLimitConfig rateLimit;
+    ThreadsConfig threads;
     ripple::KeyType keyType;
     ripple::SecretKey signingKey;
     ripple::STXChainBridge bridge;
     std::optional<AdminConfig> adminConfig;
+    std::optional<StandbyConfig> standby;
+    std::optional<AggregationConfig> aggregation;
 
     std::string logFile;
     std::string logLevel;
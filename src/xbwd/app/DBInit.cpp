@@ -12,6 +12,20 @@ xChainDBName()
     return r;
 }
 
+std::string const&
+xChainLMDBDirName()
+{
+    static std::string const r{"xchain_txns.lmdb"};
+    return r;
+}
+
+std::string const&
+xChainLogDirName()
+{
+    static std::string const r{"xchain_txns.log"};
+    return r;
+}
+
 std::string const&
 xChainTableName(ChainDir dir)
 {
@@ -42,6 +56,9 @@ xChainDBPragma()
     static std::vector<std::string> const result = [] {
         std::vector<std::string> r;
         r.push_back("PRAGMA journal_size_limit=1582080;");
+        // WAL lets the RPC reader pool query while the federator writes
+        r.push_back("PRAGMA journal_mode=WAL;");
+        r.push_back("PRAGMA busy_timeout=5000;");
         return r;
     }();
 
@@ -96,6 +113,22 @@ xChainDBInit()
             CREATE INDEX IF NOT EXISTS {table_name}CreateCountIdx ON {table_name}(CreateCount);",
         )sql";
 
+        // Pages of query_attestations are read in (id, TransID) order
+        auto constexpr claimPageIdxFmtStr = R"sql(
+            CREATE INDEX IF NOT EXISTS {table_name}ClaimIDTransIDIdx ON {table_name}(ClaimID, TransID);
+        )sql";
+        auto constexpr createAccPageIdxFmtStr = R"sql(
+            CREATE INDEX IF NOT EXISTS {table_name}CreateCountTransIDIdx ON {table_name}(CreateCount, TransID);
+        )sql";
+
+        // Secondary indexes backing the query_attestations filters
+        auto constexpr ledgerSeqIdxFmtStr = R"sql(
+            CREATE INDEX IF NOT EXISTS {table_name}LedgerSeqIdx ON {table_name}(LedgerSeq);
+        )sql";
+        auto constexpr sendingAccountIdxFmtStr = R"sql(
+            CREATE INDEX IF NOT EXISTS {table_name}SendingAccountIdx ON {table_name}(SendingAccount);
+        )sql";
+
         auto constexpr syncTblFmtStr = R"sql(
             CREATE TABLE IF NOT EXISTS {table_name} (
                 ChainType         UNSIGNED PRIMARY KEY,
@@ -103,12 +136,26 @@ xChainDBInit()
                 LedgerSeq         BIGINT UNSIGNED);
         )sql";
 
+        auto constexpr submissionTblFmtStr = R"sql(
+            CREATE TABLE IF NOT EXISTS {table_name} (
+                ChainType         UNSIGNED,
+                AccountSqn        BIGINT UNSIGNED,
+                LastLedgerSeq     BIGINT UNSIGNED,
+                RetriesAllowed    UNSIGNED,
+                Batch             BLOB,
+                SignedTxn         BLOB,
+                PRIMARY KEY (ChainType, AccountSqn));
+        )sql";
+
         for (auto cd : {ChainDir::lockingToIssuing, ChainDir::issuingToLocking})
         {
             r.push_back(fmt::format(
                 tblFmtStr, fmt::arg("table_name", xChainTableName(cd))));
             r.push_back(fmt::format(
                 idxFmtStr, fmt::arg("table_name", xChainTableName(cd))));
+            r.push_back(fmt::format(
+                claimPageIdxFmtStr,
+                fmt::arg("table_name", xChainTableName(cd))));
 
             r.push_back(fmt::format(
                 createAccTblFmtStr,
@@ -116,10 +163,25 @@ xChainDBInit()
             r.push_back(fmt::format(
                 createAccIdxFmtStr,
                 fmt::arg("table_name", xChainCreateAccountTableName(cd))));
+            r.push_back(fmt::format(
+                createAccPageIdxFmtStr,
+                fmt::arg("table_name", xChainCreateAccountTableName(cd))));
+
+            for (auto const& tbl :
+                 {xChainTableName(cd), xChainCreateAccountTableName(cd)})
+            {
+                r.push_back(fmt::format(
+                    ledgerSeqIdxFmtStr, fmt::arg("table_name", tbl)));
+                r.push_back(fmt::format(
+                    sendingAccountIdxFmtStr, fmt::arg("table_name", tbl)));
+            }
         }
 
         r.push_back(fmt::format(
             syncTblFmtStr, fmt::arg("table_name", xChainSyncTable)));
+        r.push_back(fmt::format(
+            submissionTblFmtStr,
+            fmt::arg("table_name", xChainSubmissionTable)));
 
         r.push_back("END TRANSACTION;");
         return r;
@@ -12,10 +12,20 @@ namespace xbwd {
 namespace db_init {
 
 std::string const xChainSyncTable("XChainSync");
+// Submitted attestation transactions whose result is not known yet
+std::string const xChainSubmissionTable("XChainSubmissions");
 
 std::string const&
 xChainDBName();
 
+// Directory of the LMDB environment, when that backend is configured
+std::string const&
+xChainLMDBDirName();
+
+// Directory of the log segments, when that backend is configured
+std::string const&
+xChainLogDirName();
+
 std::string const&
 xChainTableName(ChainDir dir);
 
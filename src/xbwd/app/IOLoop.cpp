@@ -0,0 +1,146 @@
+#include <xbwd/app/IOLoop.h>
+
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#include <pthread.h>
+#include <time.h>
+
+namespace xbwd {
+
+IOLoopMonitor::IOLoopMonitor(boost::asio::io_service& ios)
+    : ios_(ios), timer_(ios)
+{
+}
+
+void
+IOLoopMonitor::addCurrentThread()
+{
+    std::lock_guard l{mutex_};
+    threads_.push_back(pthread_self());
+}
+
+void
+IOLoopMonitor::start()
+{
+    {
+        std::lock_guard l{mutex_};
+        lastSample_ = clock_type::now();
+        lastCpu_ = cpuTime();
+    }
+    // The timer is only touched from the io_service's threads
+    boost::asio::post(ios_, [this]() {
+        timer_.expires_after(interval);
+        timer_.async_wait(
+            [this](boost::system::error_code const& ec) { onTimer(ec); });
+    });
+}
+
+void
+IOLoopMonitor::stop()
+{
+    boost::asio::post(ios_, [this]() {
+        {
+            std::lock_guard l{mutex_};
+            stopped_ = true;
+        }
+        timer_.cancel();
+    });
+}
+
+void
+IOLoopMonitor::onTimer(boost::system::error_code const& ec)
+{
+    if (ec == boost::asio::error::operation_aborted)
+        return;
+
+    auto const now = clock_type::now();
+    {
+        std::lock_guard l{mutex_};
+        if (stopped_)
+            return;
+
+        delay_ = std::chrono::duration_cast<std::chrono::microseconds>(
+            now - timer_.expiry());
+        maxDelay_ = std::max(maxDelay_, delay_);
+
+        auto const cpu = cpuTime();
+        std::chrono::duration<double> const wall = now - lastSample_;
+        std::chrono::duration<double> const busy = cpu - lastCpu_;
+        if (wall.count() > 0 && !threads_.empty())
+            utilization_ = busy / (wall * threads_.size());
+        lastSample_ = now;
+        lastCpu_ = cpu;
+    }
+
+    timer_.expires_after(interval);
+    timer_.async_wait(
+        [this](boost::system::error_code const& ec) { onTimer(ec); });
+}
+
+std::chrono::nanoseconds
+IOLoopMonitor::cpuTime() const
+{
+    std::chrono::nanoseconds total{0};
+#ifdef __linux__
+    for (auto const t : threads_)
+    {
+        clockid_t cid;
+        timespec ts;
+        if (pthread_getcpuclockid(t, &cid) == 0 &&
+            clock_gettime(cid, &ts) == 0)
+        {
+            total += std::chrono::seconds{ts.tv_sec} +
+                std::chrono::nanoseconds{ts.tv_nsec};
+        }
+    }
+#endif
+    return total;
+}
+
+Json::Value
+IOLoopMonitor::getInfo() const
+{
+    Json::Value ret{Json::objectValue};
+    std::lock_guard l{mutex_};
+    ret["threads"] = static_cast<std::uint32_t>(threads_.size());
+    ret["queue_delay_us"] = static_cast<std::uint32_t>(delay_.count());
+    ret["queue_delay_max_us"] = static_cast<std::uint32_t>(maxDelay_.count());
+    // percent of the loop's thread time spent running handlers
+    ret["utilization"] = std::round(utilization_ * 1000) / 10;
+    return ret;
+}
+
+IOLoop::IOLoop(
+    std::string const& name,
+    config::ThreadGroupConfig const& config,
+    ThreadMap& threadMap)
+    : monitor_(ios_)
+{
+    work_.emplace(ios_);
+    auto const numberOfThreads = config.size();
+    threads_.reserve(numberOfThreads);
+
+    for (std::size_t i = 0; i < numberOfThreads; ++i)
+    {
+        threads_.emplace_back([this, &threadMap, name, i, config]() {
+            threadMap.enter(name, name + " #" + std::to_string(i), config.cpus);
+            monitor_.addCurrentThread();
+            ios_.run();
+        });
+    }
+    monitor_.start();
+}
+
+IOLoop::~IOLoop()
+{
+    monitor_.stop();
+    work_.reset();
+
+    for (auto& t : threads_)
+        t.join();
+}
+
+}  // namespace xbwd
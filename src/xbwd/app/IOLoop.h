@@ -0,0 +1,100 @@
+#pragma once
+
+#include <xbwd/app/Config.h>
+#include <xbwd/app/ThreadMap.h>
+#include <xbwd/basics/ThreadSaftyAnalysis.h>
+
+#include <ripple/json/json_value.h>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace xbwd {
+
+/** Load of an io_service.
+
+    Once per interval a timer handler runs on the io_service and records how
+    late it ran, which is how long a handler queued at that moment waited
+    (queue delay), and the share of wall time the loop's threads spent on a
+    CPU since the previous sample (utilization).
+*/
+class IOLoopMonitor
+{
+    using clock_type = std::chrono::steady_clock;
+
+    static constexpr std::chrono::seconds interval{1};
+
+    boost::asio::io_service& ios_;
+    boost::asio::steady_timer timer_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::thread::native_handle_type> GUARDED_BY(mutex_) threads_;
+    bool GUARDED_BY(mutex_) stopped_ = false;
+    clock_type::time_point GUARDED_BY(mutex_) lastSample_;
+    std::chrono::nanoseconds GUARDED_BY(mutex_) lastCpu_{0};
+    std::chrono::microseconds GUARDED_BY(mutex_) delay_{0};
+    std::chrono::microseconds GUARDED_BY(mutex_) maxDelay_{0};
+    double GUARDED_BY(mutex_) utilization_ = 0;
+
+public:
+    explicit IOLoopMonitor(boost::asio::io_service& ios);
+
+    // Called by each thread that runs the io_service, from that thread
+    void
+    addCurrentThread() EXCLUDES(mutex_);
+
+    void
+    start() EXCLUDES(mutex_);
+
+    // Cancel the timer so it no longer keeps the io_service running
+    void
+    stop() EXCLUDES(mutex_);
+
+    Json::Value
+    getInfo() const EXCLUDES(mutex_);
+
+private:
+    void
+    onTimer(boost::system::error_code const& ec) EXCLUDES(mutex_);
+
+    // CPU time used so far by the registered threads
+    std::chrono::nanoseconds
+    cpuTime() const REQUIRES(mutex_);
+};
+
+/** An io_service with its own threads. */
+class IOLoop
+{
+    boost::asio::io_service ios_;
+    std::optional<boost::asio::io_service::work> work_;
+    IOLoopMonitor monitor_;
+    std::vector<std::thread> threads_;
+
+public:
+    IOLoop(
+        std::string const& name,
+        config::ThreadGroupConfig const& config,
+        ThreadMap& threadMap);
+    ~IOLoop();
+
+    boost::asio::io_service&
+    get_io_service()
+    {
+        return ios_;
+    }
+
+    Json::Value
+    getInfo() const
+    {
+        return monitor_.getInfo();
+    }
+};
+
+}  // namespace xbwd
@@ -0,0 +1,544 @@
+#include <xbwd/app/Standby.h>
+
+#include <xbwd/app/App.h>
+#include <xbwd/client/WebsocketClient.h>
+#include <xbwd/core/Storage.h>
+#include <xbwd/federator/Federator.h>
+#include <xbwd/rpc/fromJSON.h>
+
+#include <ripple/basics/Log.h>
+#include <ripple/basics/random.h>
+#include <ripple/basics/strHex.h>
+#include <ripple/protocol/jss.h>
+
+#include <fmt/core.h>
+
+#include <cerrno>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+namespace xbwd {
+
+namespace {
+
+// An open lease file, exclusively locked while this is alive
+class LockedFile
+{
+    int fd_;
+
+public:
+    explicit LockedFile(boost::filesystem::path const& path)
+        : fd_(::open(path.c_str(), O_RDWR | O_CREAT, 0644))
+    {
+        if (fd_ < 0)
+            throw std::runtime_error(
+                "can't open lease file: " + std::string(std::strerror(errno)));
+        if (::flock(fd_, LOCK_EX) != 0)
+        {
+            auto const err = errno;
+            ::close(fd_);
+            throw std::runtime_error(
+                "can't lock lease file: " + std::string(std::strerror(err)));
+        }
+    }
+
+    ~LockedFile()
+    {
+        // Closing releases the lock
+        ::close(fd_);
+    }
+
+    LockedFile(LockedFile const&) = delete;
+    LockedFile&
+    operator=(LockedFile const&) = delete;
+
+    // Owner and expiry, in ms since the epoch. Empty owner if none.
+    std::pair<std::string, std::int64_t>
+    read() const
+    {
+        char buf[256];
+        auto const n = ::pread(fd_, buf, sizeof(buf), 0);
+        if (n < 0)
+            throw std::runtime_error(
+                "can't read lease file: " + std::string(std::strerror(errno)));
+
+        std::istringstream is{std::string(buf, n)};
+        std::string owner;
+        std::int64_t expiry = 0;
+        if (!(is >> owner >> expiry))
+            return {};
+        return {owner, expiry};
+    }
+
+    void
+    write(std::string const& s)
+    {
+        if (::ftruncate(fd_, 0) != 0 ||
+            (!s.empty() &&
+             ::pwrite(fd_, s.data(), s.size(), 0) !=
+                 static_cast<ssize_t>(s.size())))
+            throw std::runtime_error(
+                "can't write lease file: " + std::string(std::strerror(errno)));
+    }
+};
+
+std::int64_t
+nowMs()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch())
+        .count();
+}
+
+SubmissionRecord
+submissionFromJson(Json::Value const& jv)
+{
+    auto const hex = [&](char const* key) {
+        auto const v = jv[key];
+        auto blob = v.isString() ? ripple::strUnHex(v.asString())
+                                 : std::nullopt;
+        if (!blob)
+            throw std::runtime_error(
+                std::string("Expected hex json key: ") + key);
+        return std::move(*blob);
+    };
+
+    SubmissionRecord r;
+    r.chain = rpc::fromJson<ChainType>(jv, "chain_type");
+    r.accountSqn = jv["account_sequence"].asUInt();
+    r.lastLedgerSeq = jv["last_ledger_sequence"].asUInt();
+    r.retriesAllowed = jv["retries_allowed"].asUInt();
+    r.batch = hex("batch");
+    r.signedTxn = hex("tx_blob");
+    return r;
+}
+
+}  // namespace
+
+FileLease::FileLease(
+    boost::filesystem::path path,
+    std::chrono::milliseconds ttl)
+    : path_(std::move(path))
+    , ttl_(ttl)
+    , owner_(fmt::format(
+          "{}-{:X}",
+          ::getpid(),
+          ripple::rand_int<std::uint32_t>()))
+{
+}
+
+bool
+FileLease::acquire()
+{
+    // Taken before the file is read, so the local deadline errs early
+    auto const start = std::chrono::steady_clock::now();
+    LockedFile f{path_};
+    auto const [holder, expiry] = f.read();
+    auto const now = nowMs();
+
+    std::lock_guard l{mutex_};
+    if (!holder.empty() && holder != owner_ && expiry > now)
+    {
+        holder_ = holder;
+        return false;
+    }
+    f.write(owner_ + " " + std::to_string(now + ttl_.count()) + "\n");
+    validUntil_ = start + ttl_;
+    holder_ = owner_;
+    return true;
+}
+
+void
+FileLease::release()
+{
+    std::lock_guard l{mutex_};
+    validUntil_ = {};
+    try
+    {
+        LockedFile f{path_};
+        if (f.read().first == owner_)
+            f.write({});
+    }
+    catch (...)
+    {
+        // Other witnesses take the lease once it expires
+    }
+}
+
+bool
+FileLease::valid() const
+{
+    std::lock_guard l{mutex_};
+    return std::chrono::steady_clock::now() < validUntil_;
+}
+
+std::string
+FileLease::holder() const
+{
+    std::lock_guard l{mutex_};
+    return holder_;
+}
+
+Standby::Standby(
+    App& app,
+    config::StandbyConfig const& config,
+    beast::Journal j)
+    : app_(app)
+    , config_(config)
+    , lease_(
+          config.leaseFile,
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              config.leaseTTL))
+    , j_(j)
+{
+}
+
+Standby::~Standby()
+{
+    stop();
+}
+
+void
+Standby::start()
+{
+    JLOGV(
+        j_.info(),
+        "standby starting",
+        ripple::jv("lease_file", config_.leaseFile.string()),
+        ripple::jv("owner", lease_.owner()));
+    thread_ = std::thread(&Standby::run, this);
+}
+
+void
+Standby::stop()
+{
+    {
+        std::lock_guard l{mutex_};
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+
+    unfollow();
+    // Let the other witness take over without waiting for the expiry
+    if (active_)
+        lease_.release();
+}
+
+void
+Standby::run()
+{
+    app_.threadMap().enter("standby", "Standby", {});
+
+    auto const period =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            config_.leaseTTL) /
+        3;
+
+    std::unique_lock l{mutex_};
+    while (!stopping_)
+    {
+        bool const resync = std::exchange(resync_, false);
+        l.unlock();
+        tick();
+        if (resync && following_)
+            requestPeerState();
+        l.lock();
+        cv_.wait_for(l, period, [this] { return stopping_ || resync_; });
+    }
+}
+
+void
+Standby::tick()
+{
+    bool acquired = false;
+    try
+    {
+        acquired = lease_.acquire();
+    }
+    catch (std::exception const& e)
+    {
+        JLOGV(j_.error(), "lease error", ripple::jv("what", e.what()));
+    }
+
+    if (active_)
+    {
+        if (!acquired)
+        {
+            // The federator is fenced once the last renewal expires. Stop
+            // rather than compete with the new holder.
+            JLOGV(
+                j_.fatal(),
+                "lease lost, stopping",
+                ripple::jv("holder", lease_.holder()));
+            app_.signalStop();
+        }
+        return;
+    }
+
+    if (!acquired)
+    {
+        if (!following_)
+            follow();
+        return;
+    }
+
+    unfollow();
+    active_ = true;
+    JLOGV(
+        j_.info(),
+        "lease acquired, taking over",
+        ripple::jv("owner", lease_.owner()));
+    if (auto federator = app_.federator())
+        federator->activate();
+}
+
+void
+Standby::follow()
+{
+    JLOGV(
+        j_.info(),
+        "standing by",
+        ripple::jv("holder", lease_.holder()),
+        ripple::jv("peer", to_string(config_.peerEndpoint)));
+    following_ = true;
+    if (!peer_)
+    {
+        peer_ = std::make_shared<WebsocketClient>(
+            [this](Json::Value const& msg) { onPeerMessage(msg); },
+            [this]() { onPeerConnect(); },
+            app_.get_io_service(),
+            config_.peerEndpoint,
+            /*headers*/ std::unordered_map<std::string, std::string>{},
+            j_);
+    }
+    peer_->connect();
+}
+
+void
+Standby::unfollow()
+{
+    following_ = false;
+    if (peer_)
+        peer_->shutdown();
+}
+
+void
+Standby::onPeerConnect()
+{
+    // Called with the client's locks held, so the requests are sent from
+    // the standby thread
+    resync();
+}
+
+void
+Standby::resync()
+{
+    {
+        std::lock_guard l{mutex_};
+        resync_ = true;
+    }
+    cv_.notify_all();
+}
+
+void
+Standby::requestPeerState()
+{
+    auto const withAuth = [this](Json::Value params) {
+        if (config_.peerAuth)
+        {
+            params["Username"] = config_.peerAuth->user;
+            params["Password"] = config_.peerAuth->password;
+        }
+        return params;
+    };
+
+    {
+        std::lock_guard l{stateMutex_};
+        stateSeq_.reset();
+        pendingState_.clear();
+    }
+
+    Json::Value params{Json::objectValue};
+    params["streams"] = Json::arrayValue;
+    params["streams"].append("state");
+    peer_->send("subscribe", withAuth(params));
+    // Changes made before the subscription are covered by the journal
+    journalRequestId_ = peer_->send(
+        "submission_journal", withAuth(Json::Value{Json::objectValue}));
+}
+
+void
+Standby::onPeerMessage(Json::Value const& msg)
+{
+    if (active_ || !following_)
+        return;
+
+    try
+    {
+        if (msg["type"] == "state")
+        {
+            onState(msg);
+            return;
+        }
+        if (msg.isMember(ripple::jss::id) &&
+            msg[ripple::jss::id].asUInt() == journalRequestId_)
+        {
+            auto const& result = msg[ripple::jss::result];
+            if (result[ripple::jss::result].isMember("submissions"))
+                applyJournal(result[ripple::jss::result]);
+            else
+                JLOGV(
+                    j_.warn(),
+                    "peer journal request failed",
+                    ripple::jv("msg", msg));
+        }
+    }
+    catch (std::exception const& e)
+    {
+        JLOGV(
+            j_.error(),
+            "bad message from peer",
+            ripple::jv("what", e.what()),
+            ripple::jv("msg", msg));
+    }
+}
+
+void
+Standby::onState(Json::Value const& msg)
+{
+    std::lock_guard l{stateMutex_};
+    if (!stateSeq_)
+    {
+        pendingState_.push_back(msg);
+        return;
+    }
+    applyNext(msg);
+}
+
+void
+Standby::applyNext(Json::Value const& msg)
+{
+    auto const seq = std::stoull(msg["sequence"].asString());
+    // Already in the snapshot
+    if (seq <= *stateSeq_)
+        return;
+    if (seq != *stateSeq_ + 1)
+    {
+        JLOGV(
+            j_.warn(),
+            "missed peer state, resyncing",
+            ripple::jv("expected", std::to_string(*stateSeq_ + 1)),
+            ripple::jv("received", std::to_string(seq)));
+        stateSeq_.reset();
+        pendingState_.clear();
+        resync();
+        return;
+    }
+    applyState(msg);
+    stateSeq_ = seq;
+}
+
+void
+Standby::applyState(Json::Value const& msg)
+{
+    auto& storage = app_.storage();
+    auto const op = msg["op"].asString();
+    if (op == "put_submission")
+    {
+        storage.putSubmission(submissionFromJson(msg));
+    }
+    else if (op == "erase_submission")
+    {
+        storage.eraseSubmission(
+            rpc::fromJson<ChainType>(msg, "chain_type"),
+            msg["account_sequence"].asUInt());
+    }
+    else if (op == "erase_attestation")
+    {
+        auto const ct = rpc::fromJson<ChainType>(msg, "chain_type");
+        auto const dir = ct == ChainType::locking ? ChainDir::issuingToLocking
+                                                  : ChainDir::lockingToIssuing;
+        auto const t = msg["create_account"].asBool()
+            ? AttestationTable::createAccount
+            : AttestationTable::claim;
+        auto const id = std::stoull(msg["id"].asString(), nullptr, 16);
+        storage.erase(dir, t, id);
+        app_.attestationCache().erase(dir, t, id);
+    }
+    else
+    {
+        JLOGV(j_.warn(), "unknown state op", ripple::jv("op", op));
+    }
+}
+
+void
+Standby::applyJournal(Json::Value const& journal)
+{
+    auto const seq = std::stoull(journal["sequence"].asString());
+    std::vector<SubmissionRecord> records;
+    std::set<std::pair<ChainType, std::uint32_t>> keep;
+    for (auto const& jv : journal["submissions"])
+    {
+        records.push_back(submissionFromJson(jv));
+        keep.emplace(records.back().chain, records.back().accountSqn);
+    }
+
+    std::lock_guard l{stateMutex_};
+    if (stateSeq_)
+        return;
+    {
+        // The snapshot is the whole journal as of `seq`, and nothing newer
+        // has been applied yet, so an entry missing from it was erased by
+        // the active
+        auto& storage = app_.storage();
+        Storage::Batch batch{storage};
+        for (auto const& r : storage.getSubmissions())
+        {
+            if (!keep.count({r.chain, r.accountSqn}))
+                storage.eraseSubmission(r.chain, r.accountSqn);
+        }
+        for (auto const& r : records)
+            storage.putSubmission(r);
+    }
+    stateSeq_ = seq;
+
+    JLOGV(
+        j_.info(),
+        "mirrored peer journal",
+        ripple::jv("submissions", records.size()),
+        ripple::jv("sequence", std::to_string(seq)),
+        ripple::jv("held", pendingState_.size()));
+
+    auto const pending = std::move(pendingState_);
+    pendingState_.clear();
+    for (auto const& msg : pending)
+    {
+        // Stops at a gap, which starts over
+        if (!stateSeq_)
+            break;
+        applyNext(msg);
+    }
+}
+
+Json::Value
+Standby::getInfo() const
+{
+    Json::Value r{Json::objectValue};
+    r["role"] = active_ ? "active" : "standby";
+    r["owner"] = lease_.owner();
+    r["lease_holder"] = lease_.holder();
+    r["lease_valid"] = leaseValid();
+    r["following"] = following_.load();
+    r["peer"] = to_string(config_.peerEndpoint);
+    return r;
+}
+
+}  // namespace xbwd
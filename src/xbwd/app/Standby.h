@@ -0,0 +1,188 @@
+#pragma once
+
+#include <xbwd/app/Config.h>
+#include <xbwd/basics/ThreadSaftyAnalysis.h>
+
+#include <ripple/beast/utility/Journal.h>
+#include <ripple/json/json_value.h>
+
+#include <boost/filesystem/path.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace xbwd {
+
+class App;
+class WebsocketClient;
+
+/** A lease shared by processes on one host through a file.
+
+    The file holds the owner and the wall clock time the lease expires. It is
+    read and written under an exclusive flock, which is held only for the
+    update, so a holder that hangs still loses the lease once it expires.
+*/
+class FileLease
+{
+    boost::filesystem::path const path_;
+    std::chrono::milliseconds const ttl_;
+    // Unique to this process
+    std::string const owner_;
+
+    mutable std::mutex mutex_;
+    // Local deadline of the last renewal. Measured from before the file was
+    // written, so it never outlasts the expiry other processes see.
+    std::chrono::steady_clock::time_point GUARDED_BY(mutex_) validUntil_;
+    std::string GUARDED_BY(mutex_) holder_;
+
+public:
+    FileLease(boost::filesystem::path path, std::chrono::milliseconds ttl);
+
+    // Take or renew the lease. False if another owner holds it.
+    bool
+    acquire() EXCLUDES(mutex_);
+
+    // Give the lease up if held
+    void
+    release() EXCLUDES(mutex_);
+
+    // True until the last renewal expires
+    bool
+    valid() const EXCLUDES(mutex_);
+
+    std::string const&
+    owner() const
+    {
+        return owner_;
+    }
+
+    // Owner seen in the file at the last acquire attempt
+    std::string
+    holder() const EXCLUDES(mutex_);
+};
+
+/** Active/standby failover between two witnesses with the same keys.
+
+    The witness holding the lease is active: it submits attestations and
+    publishes its journal changes and attestation erasures on the "state"
+    stream. The other stands by. It follows both chains and stores
+    attestations as usual, but does not submit, and mirrors the active's
+    "state" stream into its own storage over the active's RPC websocket.
+
+    The lease is renewed every third of its TTL. When the active stops
+    renewing it, the standby takes it, stops following and activates its
+    federator, which resumes from the mirrored journal. An active that
+    finds its lease taken stops the process.
+
+    Stream messages and the journal snapshot are numbered by the active.
+    Messages that arrive before the snapshot are held, and only those newer
+    than it are applied. A gap in the numbering starts a new snapshot.
+*/
+class Standby
+{
+    App& app_;
+    config::StandbyConfig const config_;
+    FileLease lease_;
+    beast::Journal j_;
+
+    std::atomic<bool> active_ = false;
+    std::atomic<bool> following_ = false;
+    // Created once by the first follow(), shut down when taking over
+    std::shared_ptr<WebsocketClient> peer_;
+    // Id of the submission_journal request sent on connecting
+    std::atomic<std::uint32_t> journalRequestId_ = 0;
+
+    std::mutex stateMutex_;
+    // Sequence of the last "state" message mirrored, unset until the
+    // journal snapshot is applied
+    std::optional<std::uint64_t> GUARDED_BY(stateMutex_) stateSeq_;
+    // "state" messages received before the snapshot
+    std::vector<Json::Value> GUARDED_BY(stateMutex_) pendingState_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool GUARDED_BY(mutex_) stopping_ = false;
+    // Set when the peer connection is (re)established
+    bool GUARDED_BY(mutex_) resync_ = false;
+    std::thread thread_;
+
+public:
+    Standby(App& app, config::StandbyConfig const& config, beast::Journal j);
+    ~Standby();
+
+    // Start taking or following the lease
+    void
+    start();
+
+    void
+    stop() EXCLUDES(mutex_);
+
+    bool
+    active() const
+    {
+        return active_;
+    }
+
+    // True while the lease is held and has not expired
+    bool
+    leaseValid() const
+    {
+        return active_ && lease_.valid();
+    }
+
+    Json::Value
+    getInfo() const;
+
+private:
+    void
+    run() EXCLUDES(mutex_);
+
+    // Renew or try to take the lease, and act on the outcome
+    void
+    tick();
+
+    void
+    follow();
+
+    void
+    unfollow();
+
+    void
+    onPeerConnect() EXCLUDES(mutex_);
+
+    // Have the standby thread request the peer's state again
+    void
+    resync() EXCLUDES(mutex_);
+
+    // Subscribe to the peer's "state" stream and request its journal
+    void
+    requestPeerState() EXCLUDES(stateMutex_);
+
+    void
+    onPeerMessage(Json::Value const& msg);
+
+    void
+    onState(Json::Value const& msg) EXCLUDES(stateMutex_);
+
+    // Apply a "state" message if it is the next one after stateSeq_
+    void
+    applyNext(Json::Value const& msg) REQUIRES(stateMutex_);
+
+    // Apply one message of the "state" stream
+    void
+    applyState(Json::Value const& msg);
+
+    // Replace the journal with the active's snapshot, then apply the
+    // messages held while waiting for it
+    void
+    applyJournal(Json::Value const& journal) EXCLUDES(stateMutex_);
+};
+
+}  // namespace xbwd
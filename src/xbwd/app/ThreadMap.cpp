@@ -0,0 +1,81 @@
+#include <xbwd/app/ThreadMap.h>
+
+#include <ripple/beast/core/CurrentThreadName.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace xbwd {
+
+namespace {
+
+std::uint64_t
+currentThreadID()
+{
+#ifdef __linux__
+    return static_cast<std::uint64_t>(::syscall(SYS_gettid));
+#else
+    return 0;
+#endif
+}
+
+}  // namespace
+
+bool
+setCurrentThreadAffinity(std::vector<std::uint32_t> const& cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto const cpu : cpus)
+    {
+        if (cpu >= CPU_SETSIZE)
+            return false;
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+void
+ThreadMap::enter(
+    std::string const& role,
+    std::string const& name,
+    std::vector<std::uint32_t> const& cpus)
+{
+    beast::setCurrentThreadName(name);
+    bool const pinned = !cpus.empty() && setCurrentThreadAffinity(cpus);
+
+    std::lock_guard l{mutex_};
+    entries_.push_back({role, name, currentThreadID(), cpus, pinned});
+}
+
+Json::Value
+ThreadMap::getInfo() const
+{
+    Json::Value ret{Json::arrayValue};
+    std::lock_guard l{mutex_};
+    for (auto const& e : entries_)
+    {
+        Json::Value jv{Json::objectValue};
+        jv["role"] = e.role;
+        jv["name"] = e.name;
+        jv["tid"] = std::to_string(e.tid);
+        Json::Value cpus{Json::arrayValue};
+        for (auto const cpu : e.cpus)
+            cpus.append(cpu);
+        jv["cpus"] = cpus;
+        if (!e.cpus.empty())
+            jv["pinned"] = e.pinned;
+        ret.append(jv);
+    }
+    return ret;
+}
+
+}  // namespace xbwd
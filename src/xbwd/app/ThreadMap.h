@@ -0,0 +1,50 @@
+#pragma once
+
+#include <xbwd/basics/ThreadSaftyAnalysis.h>
+
+#include <ripple/json/json_value.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace xbwd {
+
+/** The threads the witness runs, what each is for, and where it runs.
+
+    Every long lived thread registers itself when it starts. Registering names
+    the thread and pins it to the CPUs configured for its role.
+*/
+class ThreadMap
+{
+    struct Entry
+    {
+        std::string role;
+        std::string name;
+        std::uint64_t tid;
+        std::vector<std::uint32_t> cpus;
+        bool pinned;
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<Entry> GUARDED_BY(mutex_) entries_;
+
+public:
+    // Name the calling thread, pin it to `cpus` if not empty, and record it
+    void
+    enter(
+        std::string const& role,
+        std::string const& name,
+        std::vector<std::uint32_t> const& cpus) EXCLUDES(mutex_);
+
+    Json::Value
+    getInfo() const EXCLUDES(mutex_);
+};
+
+// Restrict the calling thread to `cpus`. Return false if that is not supported
+// or fails.
+bool
+setCurrentThreadAffinity(std::vector<std::uint32_t> const& cpus);
+
+}  // namespace xbwd
@@ -48,13 +48,16 @@ printHelp(const boost::program_options::options_description& desc)
                  "     server_info      Server state info.\n";
 }
 
+// Run the suites matching `pattern`, or all but the manual ones if it is
+// empty
 static int
-runUnitTests()
+runUnitTests(std::string const& pattern)
 {
     using namespace beast::unit_test;
     beast::unit_test::dstream dout{std::cout};
     reporter r{dout};
-    bool const anyFailed = r.run_each(global_suites());
+    bool const anyFailed =
+        r.run_each_if(global_suites(), match_auto(pattern));
     if (anyFailed)
         return EXIT_FAILURE;
     return EXIT_SUCCESS;
@@ -73,8 +76,16 @@ main(int argc, char** argv)
     general.add_options()("help,h", "Display this message.")(
         "conf", po::value<std::string>(), "Specify the config file.")(
         "json", po::value<std::string>(), "Handle the provided json request")(
+        "batch",
+        po::value<std::string>(),
+        "Send the json requests in the file, one per line, over one "
+        "connection. Use - for stdin.")(
         "quiet,q", "quiet")("silent", "log to file only")(
-        "verbose,v", "verbose")("unittest,u", "Perform unit tests.")(
+        "verbose,v", "verbose")(
+        "unittest,u",
+        po::value<std::string>()->implicit_value(""),
+        "Perform unit tests. Optionally name the suites to run, including "
+        "manual ones such as benchmarks.")(
         "version", "Display the build version.");
 
     po::options_description cmdline_options;
@@ -97,7 +108,7 @@ main(int argc, char** argv)
     }
 
     if (vm.count("unittest"))
-        return runUnitTests();
+        return runUnitTests(vm["unittest"].as<std::string>());
 
     if (vm.count("version"))
     {
@@ -148,7 +159,6 @@ main(int argc, char** argv)
 
         if (vm.count("json"))
         {
-            // TODO: WIP - this isn't done
             using namespace std::literals;
             beast::setCurrentThreadName(
                 xbwd::build_info::serverName + ": rpc"s);
@@ -176,6 +186,24 @@ main(int argc, char** argv)
             }
             return xbwd::rpc_call::fromCommandLine(*config, jv);
         }
+        if (vm.count("batch"))
+        {
+            using namespace std::literals;
+            beast::setCurrentThreadName(
+                xbwd::build_info::serverName + ": rpc"s);
+
+            auto const file = vm["batch"].as<std::string>();
+            if (file == "-")
+                return xbwd::rpc_call::fromStream(*config, std::cin);
+
+            std::ifstream in(file);
+            if (!in)
+            {
+                std::cerr << "Error: Could not open " << file << std::endl;
+                return EXIT_FAILURE;
+            }
+            return xbwd::rpc_call::fromStream(*config, in);
+        }
         auto const logLevel = [&]() -> beast::severities::Severity {
             using namespace beast::severities;
 
@@ -37,8 +37,18 @@
 #include <ripple/protocol/TxFlags.h>
 #include <ripple/protocol/jss.h>
 
+#include <boost/asio/associated_cancellation_slot.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/experimental/awaitable_operators.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
 #include <charconv>
 #include <type_traits>
+#include <utility>
+#include <variant>
 
 namespace xbwd {
 
@@ -48,6 +58,7 @@ ChainListener::ChainListener(
     ChainType chainType,
     ripple::STXChainBridge const sidechain,
     std::optional<ripple::AccountID> submitAccountOpt,
+    bool speculative,
     std::weak_ptr<Federator>&& federator,
     beast::Journal j)
     : chainType_{chainType}
@@ -55,6 +66,7 @@ ChainListener::ChainListener(
     , witnessAccountStr_(
           submitAccountOpt ? ripple::toBase58(*submitAccountOpt)
                            : std::string{})
+    , speculative_{speculative}
     , federator_{std::move(federator)}
     , j_{j}
 {
@@ -68,6 +80,7 @@ ChainListener::~ChainListener() = default;
 void
 ChainListener::init(boost::asio::io_service& ios, beast::IP::Endpoint const& ip)
 {
+    ios_ = &ios;
     wsClient_ = std::make_shared<WebsocketClient>(
         [self = shared_from_this()](Json::Value const& msg) {
             self->onMessage(msg);
@@ -84,34 +97,245 @@ ChainListener::init(boost::asio::io_service& ios, beast::IP::Endpoint const& ip)
 void
 ChainListener::onConnect()
 {
+    auto const gen = ++connectGen_;
+    spawn([self = shared_from_this(), gen]() {
+        return self->connectSequence(gen);
+    });
+}
+
+boost::asio::awaitable<void>
+ChainListener::connectSequence(std::uint32_t gen)
+{
+    using namespace boost::asio::experimental::awaitable_operators;
+
     auto const doorAccStr = ripple::toBase58(
         ChainType::locking == chainType_ ? bridge_.lockingChainDoor()
                                          : bridge_.issuingChainDoor());
 
+    Json::Value accountInfoParams;
+    accountInfoParams[ripple::jss::account] = doorAccStr;
+    accountInfoParams[ripple::jss::signer_lists] = true;
+
+    // Retry until a reply arrives or a new connection takes over
+    while (gen == connectGen_)
+    {
+        try
+        {
+            // The submitting account's sequence does not depend on the door
+            // account, so both are read at once
+            auto [doorInfo, witnessSqn] = co_await (
+                request("account_info", accountInfoParams) &&
+                witnessSequence());
+            if (gen != connectGen_)
+                co_return;
+
+            processAccountInfo(doorInfo);
+            if (witnessSqn)
+            {
+                std::lock_guard l{m_};
+                witnessSqn_ = witnessSqn;
+            }
+            break;
+        }
+        catch (boost::system::system_error const& e)
+        {
+            if (e.code() == boost::asio::error::operation_aborted)
+                co_return;
+            JLOGV(
+                j_.warn(),
+                "retrying account_info on connect",
+                ripple::jv("what", e.what()),
+                ripple::jv("chain_name", to_string(chainType_)));
+        }
+    }
+    if (gen != connectGen_)
+        co_return;
+
     Json::Value params;
-    params[ripple::jss::account] = doorAccStr;
-    params[ripple::jss::signer_lists] = true;
-
-    send(
-        "account_info",
-        params,
-        [self = shared_from_this(), doorAccStr](Json::Value const& msg) {
-            self->processAccountInfo(msg);
-
-            Json::Value params;
-            params[ripple::jss::account_history_tx_stream] = Json::objectValue;
-            params[ripple::jss::account_history_tx_stream]
-                  [ripple::jss::account] = doorAccStr;
-
-            params[ripple::jss::streams] = Json::arrayValue;
-            params[ripple::jss::streams].append("ledger");
-            if (!self->witnessAccountStr_.empty())
+    params[ripple::jss::account_history_tx_stream] = Json::objectValue;
+    params[ripple::jss::account_history_tx_stream][ripple::jss::account] =
+        doorAccStr;
+
+    params[ripple::jss::streams] = Json::arrayValue;
+    params[ripple::jss::streams].append("ledger");
+    if (!witnessAccountStr_.empty())
+    {
+        params[ripple::jss::accounts] = Json::arrayValue;
+        params[ripple::jss::accounts].append(witnessAccountStr_);
+    }
+    if (speculative_)
+    {
+        params[ripple::jss::accounts_proposed] = Json::arrayValue;
+        params[ripple::jss::accounts_proposed].append(doorAccStr);
+    }
+    // The reply carries the current ledger, handled like a stream message
+    send("subscribe", params);
+}
+
+boost::asio::awaitable<Json::Value>
+ChainListener::request(
+    std::string cmd,
+    Json::Value params,
+    std::chrono::milliseconds timeout)
+{
+    using namespace boost::asio::experimental::awaitable_operators;
+
+    boost::asio::steady_timer timer{
+        co_await boost::asio::this_coro::executor, timeout};
+    auto reply = co_await (
+        asyncReply(cmd, std::move(params)) ||
+        timer.async_wait(boost::asio::use_awaitable));
+    if (reply.index() != 0)
+    {
+        JLOGV(
+            j_.warn(),
+            "ChainListener request timed out",
+            ripple::jv("command", cmd),
+            ripple::jv("chain_name", to_string(chainType_)));
+        throw boost::system::system_error(boost::asio::error::timed_out);
+    }
+    co_return std::get<0>(std::move(reply));
+}
+
+boost::asio::awaitable<Json::Value>
+ChainListener::asyncReply(std::string cmd, Json::Value params)
+{
+    auto initiate = [self = shared_from_this()](
+                        auto handler,
+                        std::string const& cmd,
+                        Json::Value const& params) {
+        using Handler = decltype(handler);
+
+        // Completed once, by the reply or by cancellation, whichever is first
+        struct Op
+        {
+            std::mutex m;
+            std::optional<Handler> handler;
+        };
+        auto op = std::make_shared<Op>();
+        auto slot = boost::asio::get_associated_cancellation_slot(handler);
+        op->handler.emplace(std::move(handler));
+
+        auto complete = [op](boost::system::error_code ec, Json::Value v) {
+            std::optional<Handler> h;
             {
-                params[ripple::jss::accounts] = Json::arrayValue;
-                params[ripple::jss::accounts].append(self->witnessAccountStr_);
+                std::lock_guard l{op->m};
+                h.swap(op->handler);
             }
-            self->send("subscribe", params);
-        });
+            if (!h)
+                return;
+            // Replies arrive on a websocket thread. Resume the coroutine on
+            // its own executor.
+            auto ex = boost::asio::get_associated_executor(*h);
+            boost::asio::post(
+                ex,
+                [h = std::move(*h), ec, v = std::move(v)]() mutable {
+                    boost::asio::get_associated_cancellation_slot(h).clear();
+                    std::move(h)(ec, std::move(v));
+                });
+        };
+
+        auto const id =
+            self->send(cmd, params, [complete](Json::Value const& reply) {
+                complete({}, reply);
+            });
+
+        if (slot.is_connected())
+        {
+            slot.assign([self, id, complete](boost::asio::cancellation_type) {
+                self->forget(id);
+                complete(boost::asio::error::operation_aborted, {});
+            });
+        }
+    };
+
+    co_return co_await boost::asio::async_initiate<
+        decltype(boost::asio::use_awaitable),
+        void(boost::system::error_code, Json::Value)>(
+        std::move(initiate), boost::asio::use_awaitable, cmd, params);
+}
+
+boost::asio::awaitable<std::optional<ChainListener::AccountSequence>>
+ChainListener::accountSequence(std::string account, std::string ledger)
+{
+    Json::Value params;
+    params[ripple::jss::account] = account;
+    params[ripple::jss::ledger_index] = ledger;
+
+    try
+    {
+        auto const reply = co_await request("account_info", params);
+        JLOGV(
+            j_.trace(),
+            "account sequence",
+            ripple::jv("accountInfo", reply),
+            ripple::jv("chain_name", to_string(chainType_)));
+        if (!reply.isMember(ripple::jss::result))
+            co_return std::nullopt;
+        auto const& result = reply[ripple::jss::result];
+        // The open ledger has no ledger_index
+        auto const& ledgerIndex =
+            result.isMember(ripple::jss::ledger_current_index)
+            ? result[ripple::jss::ledger_current_index]
+            : result[ripple::jss::ledger_index];
+        if (!result.isMember(ripple::jss::account_data) ||
+            !ledgerIndex.isIntegral())
+            co_return std::nullopt;
+        auto const& ad = result[ripple::jss::account_data];
+        if (!ad.isMember(ripple::jss::Sequence) ||
+            !ad[ripple::jss::Sequence].isIntegral())
+            co_return std::nullopt;
+        co_return AccountSequence{
+            ad[ripple::jss::Sequence].asUInt(),
+            ledgerIndex.asUInt()};
+    }
+    catch (boost::system::system_error const& e)
+    {
+        if (e.code() == boost::asio::error::operation_aborted)
+            throw;
+        co_return std::nullopt;
+    }
+}
+
+boost::asio::awaitable<std::optional<ChainListener::AccountSequence>>
+ChainListener::witnessSequence()
+{
+    if (witnessAccountStr_.empty())
+        co_return std::nullopt;
+    co_return co_await accountSequence(witnessAccountStr_);
+}
+
+std::optional<ChainListener::AccountSequence>
+ChainListener::takeWitnessSequence()
+{
+    std::lock_guard l{m_};
+    return std::exchange(witnessSqn_, std::nullopt);
+}
+
+void
+ChainListener::forget(std::uint32_t id)
+{
+    std::lock_guard lock(callbacksMtx_);
+    callbacks_.erase(id);
+}
+
+void
+ChainListener::logException(std::exception_ptr e) const
+{
+    if (!e)
+        return;
+    try
+    {
+        std::rethrow_exception(e);
+    }
+    catch (std::exception const& ex)
+    {
+        JLOGV(
+            j_.warn(),
+            "ChainListener coroutine failed",
+            ripple::jv("what", ex.what()),
+            ripple::jv("chain_name", to_string(chainType_)));
+    }
 }
 
 void
@@ -143,7 +367,7 @@ ChainListener::stopHistoricalTxns()
     send("unsubscribe", params);
 }
 
-void
+std::uint32_t
 ChainListener::send(
     std::string const& cmd,
     Json::Value const& params,
@@ -160,6 +384,7 @@ ChainListener::send(
 
     std::lock_guard lock(callbacksMtx_);
     callbacks_.emplace(id, onResponse);
+    return id;
 }
 
 template <class E>
@@ -258,6 +483,11 @@ ChainListener::processMessage(Json::Value const& msg)
     if (!msg.isMember(ripple::jss::validated) ||
         !msg[ripple::jss::validated].asBool())
     {
+        if (speculative_ && msg.isMember(ripple::jss::transaction))
+        {
+            processProposed(msg);
+            return;
+        }
         JLOGV(
             j_.trace(),
             "ignoring listener message",
@@ -317,6 +547,21 @@ ChainListener::processMessage(Json::Value const& msg)
         return msg[ripple::jss::account_history_tx_index].asInt();
     }();
 
+    // The proposed stream sends the door account's transactions again once
+    // validated. Those are handled from the history stream.
+    if (speculative_ && !txnHistoryIndex &&
+        !rpcResultParse::fieldMatchesStr(
+            transaction, ripple::jss::Account, witnessAccountStr_.c_str()))
+    {
+        JLOGV(
+            j_.trace(),
+            "ignoring listener message",
+            ripple::jv("reason", "validated proposed txn"),
+            ripple::jv("msg", msg),
+            ripple::jv("chain_name", chainName));
+        return;
+    }
+
     auto txnTypeOpt = rpcResultParse::parseXChainTxnType(transaction);
     if (!txnTypeOpt)
     {
@@ -430,6 +675,19 @@ ChainListener::processMessage(Json::Value const& msg)
         return {lockingToIssuing, issuingToLocking};
     }();
 
+    // Attestations of other witnesses and claims by their owners complete
+    // claims, which need no more attestations from this one
+    if (txnSuccess &&
+        (*txnTypeOpt == XChainTxnType::xChainAttestation ||
+         *txnTypeOpt == XChainTxnType::xChainClaim))
+    {
+        auto [claimIDs, createCounts] =
+            rpcResultParse::parseCompletedClaims(meta);
+        if (!claimIDs.empty() || !createCounts.empty())
+            pushEvent(event::XChainClaimsCompleted{
+                chainType_, std::move(claimIDs), std::move(createCounts)});
+    }
+
     switch (*txnTypeOpt)
     {
         case XChainTxnType::xChainClaim: {
@@ -671,6 +929,61 @@ processSignerListSetGeneral(
 
 }  // namespace
 
+void
+ChainListener::processProposed(Json::Value const& msg)
+{
+    auto const& transaction = msg[ripple::jss::transaction];
+    if (rpcResultParse::parseXChainTxnType(transaction) !=
+        XChainTxnType::xChainCommit)
+        return;
+
+    // The result is preliminary. A commit that fails it is not signed, and is
+    // attested as usual if it is validated after all.
+    if (!msg.isMember(ripple::jss::engine_result_code) ||
+        !msg[ripple::jss::engine_result_code].isIntegral() ||
+        !ripple::isTesSuccess(ripple::TER::fromInt(
+            msg[ripple::jss::engine_result_code].asInt())))
+        return;
+
+    auto const txnBridge = rpcResultParse::parseBridge(transaction);
+    auto const txnHash = rpcResultParse::parseTxHash(transaction);
+    auto const src = rpcResultParse::parseSrcAccount(transaction);
+    auto const claimID = Json::getOptional<std::uint64_t>(
+        transaction, ripple::sfXChainClaimID);
+    // Proposed transactions have no meta, the amount is the delivered one
+    auto const deliveredAmt =
+        rpcResultParse::parseDeliveredAmt(transaction, Json::Value{});
+    if (!txnBridge || *txnBridge != bridge_ || !txnHash || !src ||
+        !claimID || !deliveredAmt ||
+        !msg.isMember(ripple::jss::ledger_current_index) ||
+        !msg[ripple::jss::ledger_current_index].isIntegral())
+    {
+        JLOGV(
+            j_.trace(),
+            "ignoring proposed txn",
+            ripple::jv("msg", msg),
+            ripple::jv("chain_name", to_string(chainType_)));
+        return;
+    }
+
+    event::XChainCommitDetected e{
+        chainType_ == ChainType::locking ? ChainDir::lockingToIssuing
+                                         : ChainDir::issuingToLocking,
+        *src,
+        *txnBridge,
+        deliveredAmt,
+        *claimID,
+        rpcResultParse::parseDstAccount(
+            transaction, XChainTxnType::xChainCommit),
+        msg[ripple::jss::ledger_current_index].asUInt(),
+        *txnHash,
+        ripple::tesSUCCESS,
+        {},
+        false};
+    if (auto f = federator_.lock())
+        f->speculate(std::move(e));
+}
+
 void
 ChainListener::processAccountInfo(Json::Value const& msg) noexcept
 {
@@ -1155,6 +1468,17 @@ ChainListener::processTx(Json::Value const& v) noexcept
     }
 }
 
+void
+ChainListener::processAccountTx(Json::Value const& entry) noexcept
+{
+    Json::Value v;
+    auto& tx = v[ripple::jss::result];
+    tx = entry[ripple::jss::tx];
+    tx[ripple::jss::meta] = entry[ripple::jss::meta];
+    tx[ripple::jss::validated] = entry[ripple::jss::validated];
+    processTx(v);
+}
+
 Json::Value
 ChainListener::getInfo() const
 {
@@ -26,11 +26,18 @@
 #include <ripple/protocol/AccountID.h>
 #include <ripple/protocol/STXChainBridge.h>
 
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/co_spawn.hpp>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/ip/address.hpp>
+#include <boost/asio/strand.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <exception>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
 
 namespace xbwd {
@@ -45,22 +52,44 @@ private:
 
     ripple::STXChainBridge const bridge_;
     std::string witnessAccountStr_;
+    // Also subscribed to the door account's proposed transactions
+    bool const speculative_;
     std::weak_ptr<Federator> federator_;
     mutable std::mutex m_;
     beast::Journal j_;
 
     std::shared_ptr<WebsocketClient> wsClient_;
+    boost::asio::io_service* ios_ = nullptr;
     mutable std::mutex callbacksMtx_;
 
+    // Incremented on every connect. A connect sequence stops when a newer
+    // connection replaces the one it started on.
+    std::atomic<std::uint32_t> connectGen_{0};
+
     using RpcCallback = std::function<void(Json::Value const&)>;
     std::unordered_map<std::uint32_t, RpcCallback> GUARDED_BY(callbacksMtx_)
         callbacks_;
 
+public:
+    static constexpr std::chrono::seconds requestTimeout{10};
+
+    // Sequence number of an account, and the validated ledger it was read from
+    struct AccountSequence
+    {
+        std::uint32_t sequence;
+        std::uint32_t ledgerIndex;
+    };
+
+private:
+    // Submitting account's sequence, read while connecting
+    std::optional<AccountSequence> GUARDED_BY(m_) witnessSqn_;
+
 public:
     ChainListener(
         ChainType chainType,
         ripple::STXChainBridge const sidechain,
         std::optional<ripple::AccountID> submitAccountOpt,
+        bool speculative,
         std::weak_ptr<Federator>&& federator,
         beast::Journal j);
 
@@ -78,17 +107,56 @@ public:
     Json::Value
     getInfo() const EXCLUDES(m_);
 
+    // Submitting account's sequence as read on the last connect. Returned at
+    // most once.
+    std::optional<AccountSequence>
+    takeWitnessSequence() EXCLUDES(m_);
+
     /**
      * send a RPC and call the callback with the RPC result
      * @param cmd PRC command
      * @param params RPC command parameter
      * @param onResponse callback to process RPC result
+     * @return command id that will be returned in the response
      */
-    void
+    std::uint32_t
     send(
         std::string const& cmd,
         Json::Value const& params,
-        RpcCallback onResponse);
+        RpcCallback onResponse) EXCLUDES(callbacksMtx_);
+
+    /**
+     * send a RPC and suspend the calling coroutine until its result arrives.
+     * Throws boost::system::system_error with `timed_out` if there is no
+     * result within `timeout`, and with `operation_aborted` if cancelled.
+     * @param cmd PRC command
+     * @param params RPC command parameter
+     * @param timeout how long to wait for the result
+     */
+    boost::asio::awaitable<Json::Value>
+    request(
+        std::string cmd,
+        Json::Value params,
+        std::chrono::milliseconds timeout = requestTimeout);
+
+    /**
+     * read an account's sequence number
+     * @param account base58 account id
+     * @param ledger "validated", or "current" to count transactions the
+     *        server has applied but not yet validated
+     * @return nullopt if the account_info RPC failed or timed out
+     */
+    boost::asio::awaitable<std::optional<AccountSequence>>
+    accountSequence(std::string account, std::string ledger = "validated");
+
+    /**
+     * run the coroutine returned by `f` on a strand of the listener's
+     * io_service. Coroutines started here may run concurrently, each
+     * with its own requests in flight. Exceptions are logged.
+     */
+    template <class F>
+    void
+    spawn(F&& f);
 
     // Returns command id that will be returned in the response
     std::uint32_t
@@ -102,6 +170,13 @@ public:
     void
     processTx(Json::Value const& v) noexcept;
 
+    /**
+     * process one entry of an account_tx RPC response, as a tx response
+     * @param entry the entry, with the tx, its meta and validated fields
+     */
+    void
+    processAccountTx(Json::Value const& entry) noexcept;
+
 private:
     void
     onMessage(Json::Value const& msg) EXCLUDES(callbacksMtx_);
@@ -109,9 +184,32 @@ private:
     void
     onConnect();
 
+    // Read the door account's signer lists, then subscribe to its history
+    // and to the ledger stream
+    boost::asio::awaitable<void>
+    connectSequence(std::uint32_t gen);
+
+    // Submitting account's sequence. nullopt if this listener has none.
+    boost::asio::awaitable<std::optional<AccountSequence>>
+    witnessSequence();
+
+    boost::asio::awaitable<Json::Value>
+    asyncReply(std::string cmd, Json::Value params);
+
+    // Drop the callback of a request nobody is waiting for
+    void
+    forget(std::uint32_t id) EXCLUDES(callbacksMtx_);
+
+    void
+    logException(std::exception_ptr e) const;
+
     void
     processMessage(Json::Value const& msg) EXCLUDES(m_);
 
+    // Hand a commit that is not validated yet to the federator to sign
+    void
+    processProposed(Json::Value const& msg) REQUIRES(m_);
+
     void
     processAccountInfo(Json::Value const& msg) noexcept;
 
@@ -129,4 +227,16 @@ private:
     pushEvent(E&& e) REQUIRES(m_);
 };
 
+template <class F>
+void
+ChainListener::spawn(F&& f)
+{
+    boost::asio::co_spawn(
+        boost::asio::make_strand(*ios_),
+        std::forward<F>(f),
+        [self = shared_from_this()](std::exception_ptr e) {
+            self->logException(e);
+        });
+}
+
 }  // namespace xbwd
@@ -18,6 +18,7 @@
 //==============================================================================
 
 #include <xbwd/client/RpcResultParse.h>
+#include <ripple/json/json_get_or_throw.h>
 #include <ripple/protocol/SField.h>
 #include <ripple/protocol/jss.h>
 
@@ -237,5 +238,39 @@ parseDeliveredAmt(Json::Value const& transaction, Json::Value const& meta)
     }
     return deliveredAmt;
 }
+
+std::pair<std::vector<std::uint64_t>, std::vector<std::uint64_t>>
+parseCompletedClaims(Json::Value const& meta)
+{
+    std::pair<std::vector<std::uint64_t>, std::vector<std::uint64_t>> r;
+    try
+    {
+        auto const& af = meta[ripple::sfAffectedNodes.getJsonName()];
+        for (auto const& outerNode : af)
+        {
+            if (!outerNode.isMember(ripple::sfDeletedNode.getJsonName()))
+                continue;
+            auto const& node = outerNode[ripple::sfDeletedNode.getJsonName()];
+            auto const& type = node[ripple::sfLedgerEntryType.getJsonName()];
+            auto const& ff = node[ripple::sfFinalFields.getJsonName()];
+            if (type == "XChainOwnedClaimID")
+            {
+                if (auto const id = Json::getOptional<std::uint64_t>(
+                        ff, ripple::sfXChainClaimID))
+                    r.first.push_back(*id);
+            }
+            else if (type == "XChainOwnedCreateAccountClaimID")
+            {
+                if (auto const count = Json::getOptional<std::uint64_t>(
+                        ff, ripple::sfXChainAccountCreateCount))
+                    r.second.push_back(*count);
+            }
+        }
+    }
+    catch (...)
+    {
+    }
+    return r;
+}
 }  // namespace rpcResultParse
 }  // namespace xbwd
\ No newline at end of file
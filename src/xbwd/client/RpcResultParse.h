@@ -24,6 +24,8 @@
 #include <ripple/protocol/STXChainBridge.h>
 
 #include <optional>
+#include <utility>
+#include <vector>
 
 namespace xbwd {
 enum class XChainTxnType {
@@ -69,5 +71,10 @@ parseLedgerSeq(Json::Value const& msg);
 
 std::optional<ripple::STAmount>
 parseDeliveredAmt(Json::Value const& transaction, Json::Value const& meta);
+
+// Claim ids and create counts of the claims a transaction completed, i.e. of
+// the claim ledger objects it deleted
+std::pair<std::vector<std::uint64_t>, std::vector<std::uint64_t>>
+parseCompletedClaims(Json::Value const& meta);
 }  // namespace rpcResultParse
 }  // namespace xbwd
\ No newline at end of file
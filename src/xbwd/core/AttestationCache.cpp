@@ -0,0 +1,79 @@
+#include <xbwd/core/AttestationCache.h>
+
+namespace xbwd {
+
+AttestationCache::AttestationCache(std::size_t capacity) : capacity_(capacity)
+{
+}
+
+void
+AttestationCache::put(
+    ChainDir dir,
+    AttestationTable t,
+    AttestationRecord const& r)
+{
+    if (capacity_ == 0 || !r.signature)
+        return;
+
+    Key const key{dir, t, r.id};
+    std::lock_guard l{mutex_};
+    if (auto const it = index_.find(key); it != index_.end())
+    {
+        it->second->second = r;
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return;
+    }
+    entries_.emplace_front(key, r);
+    index_.emplace(key, entries_.begin());
+    if (entries_.size() > capacity_)
+    {
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+    }
+}
+
+std::optional<AttestationRecord>
+AttestationCache::get(ChainDir dir, AttestationTable t, std::uint64_t id)
+{
+    if (capacity_ == 0)
+        return std::nullopt;
+
+    std::lock_guard l{mutex_};
+    auto const it = index_.find({dir, t, id});
+    if (it == index_.end())
+    {
+        ++misses_;
+        return std::nullopt;
+    }
+    ++hits_;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->second;
+}
+
+void
+AttestationCache::erase(ChainDir dir, AttestationTable t, std::uint64_t id)
+{
+    if (capacity_ == 0)
+        return;
+
+    std::lock_guard l{mutex_};
+    if (auto const it = index_.find({dir, t, id}); it != index_.end())
+    {
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+}
+
+Json::Value
+AttestationCache::getInfo() const
+{
+    Json::Value r{Json::objectValue};
+    r["capacity"] = static_cast<Json::UInt>(capacity_);
+    std::lock_guard l{mutex_};
+    r["size"] = static_cast<Json::UInt>(entries_.size());
+    r["hits"] = static_cast<Json::UInt>(hits_);
+    r["misses"] = static_cast<Json::UInt>(misses_);
+    return r;
+}
+
+}  // namespace xbwd
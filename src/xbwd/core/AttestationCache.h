@@ -0,0 +1,60 @@
+#pragma once
+
+#include <xbwd/basics/ChainTypes.h>
+#include <xbwd/basics/ThreadSaftyAnalysis.h>
+#include <xbwd/core/Storage.h>
+
+#include <ripple/json/json_value.h>
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <tuple>
+
+namespace xbwd {
+
+/** The most recently stored signed attestations, by direction and id.
+
+    Relayers ask for an attestation right after its commit, while the event
+    thread is busy writing, so the witness RPCs look here before reading the
+    storage. Attestations are put when stored and erased with their id, and
+    the least recently used are evicted past `capacity`.
+*/
+class AttestationCache
+{
+public:
+    // 0 disables the cache
+    explicit AttestationCache(std::size_t capacity);
+
+    // Remember a signed attestation, replacing one with the same id
+    void
+    put(ChainDir dir, AttestationTable t, AttestationRecord const& r)
+        EXCLUDES(mutex_);
+
+    std::optional<AttestationRecord>
+    get(ChainDir dir, AttestationTable t, std::uint64_t id) EXCLUDES(mutex_);
+
+    void
+    erase(ChainDir dir, AttestationTable t, std::uint64_t id)
+        EXCLUDES(mutex_);
+
+    Json::Value
+    getInfo() const EXCLUDES(mutex_);
+
+private:
+    using Key = std::tuple<ChainDir, AttestationTable, std::uint64_t>;
+    using Entries = std::list<std::pair<Key, AttestationRecord>>;
+
+    std::size_t const capacity_;
+
+    mutable std::mutex mutex_;
+    // Most recently used first
+    Entries GUARDED_BY(mutex_) entries_;
+    std::map<Key, Entries::iterator> GUARDED_BY(mutex_) index_;
+    std::uint64_t GUARDED_BY(mutex_) hits_ = 0;
+    std::uint64_t GUARDED_BY(mutex_) misses_ = 0;
+};
+
+}  // namespace xbwd
@@ -32,11 +32,22 @@
 
 namespace xbwd {
 
+namespace {
+std::vector<std::string> const&
+readerPragma()
+{
+    static std::vector<std::string> const r{
+        "PRAGMA query_only=ON;", "PRAGMA busy_timeout=5000;"};
+    return r;
+}
+}  // namespace
+
 DatabaseCon::DatabaseCon(
     boost::filesystem::path const& pPath,
     std::vector<std::string> const* commonPragma,
     std::vector<std::string> const& pragma,
     std::vector<std::string> const& initSQL,
+    std::size_t readPoolSize,
     beast::Journal j)
     : session_(std::make_shared<soci::session>()), j_(j)
 {
@@ -78,5 +89,43 @@ DatabaseCon::DatabaseCon(
         soci::statement st = session_->prepare << sql;
         st.execute(true);
     }
+
+    // Readers are opened after the writer so the tables exist and the
+    // journal mode is already set.
+    readers_.reserve(readPoolSize);
+    for (std::size_t i = 0; i < readPoolSize; ++i)
+    {
+        auto r = std::make_unique<Reader>();
+        r->session_ = std::make_shared<soci::session>();
+        open(*r->session_, "sqlite", pPath.string());
+        for (auto const& p : readerPragma())
+        {
+            soci::statement st = r->session_->prepare << p;
+            st.execute(true);
+        }
+        readers_.push_back(std::move(r));
+    }
+}
+
+LockedSociSession
+DatabaseCon::checkoutReadDb()
+{
+    if (readers_.empty())
+        return checkoutDb();
+
+    // Prefer an idle reader, starting at a different one on each call so the
+    // load spreads over the pool. Only block if all of them are busy.
+    auto const n = readers_.size();
+    auto const start = nextReader_++ % n;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        auto& r = *readers_[(start + i) % n];
+        std::unique_lock<LockedSociSession::mutex> l(r.lock_, std::try_to_lock);
+        if (l.owns_lock())
+            return LockedSociSession(r.session_, std::move(l));
+    }
+
+    auto& r = *readers_[start];
+    return LockedSociSession(r.session_, r.lock_);
 }
 }  // namespace xbwd
@@ -25,6 +25,8 @@
 
 #include <boost/filesystem/path.hpp>
 
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
@@ -51,6 +53,12 @@ public:
         : session_(std::move(it)), lock_(m)
     {
     }
+    LockedSociSession(
+        std::shared_ptr<soci::session> it,
+        std::unique_lock<mutex>&& lock)
+        : session_(std::move(it)), lock_(std::move(lock))
+    {
+    }
     LockedSociSession(LockedSociSession&& rhs) noexcept
         : session_(std::move(rhs.session_)), lock_(std::move(rhs.lock_))
     {
@@ -89,8 +97,15 @@ public:
         std::string const& dbName,
         std::vector<std::string> const& pragma,
         std::vector<std::string> const& initSQL,
+        std::size_t readPoolSize,
         beast::Journal j)
-        : DatabaseCon(dataDir / dbName, nullptr, pragma, initSQL, j)
+        : DatabaseCon(
+              dataDir / dbName,
+              nullptr,
+              pragma,
+              initSQL,
+              readPoolSize,
+              j)
     {
     }
 
@@ -102,18 +117,33 @@ public:
         return *session_;
     }
 
+    // The writer session. It is reserved for the federator; RPC handlers and
+    // diagnostics should use `checkoutReadDb` so they never hold this lock.
     LockedSociSession
     checkoutDb()
     {
         return LockedSociSession(session_, lock_);
     }
 
+    // A read only session from the reader pool. The database is in WAL mode,
+    // so readers see the last committed state and never block the writer.
+    // Falls back to the writer session if the pool is empty.
+    LockedSociSession
+    checkoutReadDb();
+
+    std::size_t
+    readPoolSize() const
+    {
+        return readers_.size();
+    }
+
 private:
     DatabaseCon(
         boost::filesystem::path const& pPath,
         std::vector<std::string> const* commonPragma,
         std::vector<std::string> const& pragma,
         std::vector<std::string> const& initSQL,
+        std::size_t readPoolSize,
         beast::Journal j);
 
     LockedSociSession::mutex lock_;
@@ -126,6 +156,14 @@ private:
     // shared_ptr in this class. session_ will never be null.
     std::shared_ptr<soci::session> const session_;
 
+    struct Reader
+    {
+        std::shared_ptr<soci::session> session_;
+        LockedSociSession::mutex lock_;
+    };
+    std::vector<std::unique_ptr<Reader>> readers_;
+    std::atomic<std::size_t> nextReader_{0};
+
     beast::Journal j_;
 };
 
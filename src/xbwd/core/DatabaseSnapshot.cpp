@@ -0,0 +1,167 @@
+#include <xbwd/core/DatabaseSnapshot.h>
+
+#include <xbwd/core/SociDB.h>
+
+#include <ripple/basics/Log.h>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+
+namespace xbwd {
+
+DatabaseSnapshot::DatabaseSnapshot(DatabaseCon& db, beast::Journal j)
+    : db_(db), j_(j)
+{
+}
+
+DatabaseSnapshot::~DatabaseSnapshot()
+{
+    stopping_ = true;
+    if (thread_.joinable())
+        thread_.join();
+}
+
+std::optional<std::string>
+DatabaseSnapshot::start(Params const& params)
+{
+    std::lock_guard l{mutex_};
+    if (state_ == State::running)
+        return "a snapshot is already running";
+
+    boost::system::error_code ec;
+    if (boost::filesystem::exists(params.path, ec))
+        return "snapshot file already exists";
+    auto const parent = params.path.parent_path();
+    if (!parent.empty())
+    {
+        boost::filesystem::create_directories(parent, ec);
+        if (ec)
+            return "can't create snapshot directory: " + ec.message();
+    }
+
+    // The last snapshot's thread is done by now, it only has to be reaped
+    if (thread_.joinable())
+        thread_.join();
+
+    state_ = State::running;
+    params_ = params;
+    pageCount_ = 0;
+    remaining_ = 0;
+    steps_ = 0;
+    maxStep_ = {};
+    started_ = std::chrono::steady_clock::now();
+    error_.clear();
+    thread_ = std::thread(&DatabaseSnapshot::run, this, params);
+    return std::nullopt;
+}
+
+void
+DatabaseSnapshot::run(Params params)
+{
+    using clock = std::chrono::steady_clock;
+    auto const partial = params.path.string() + ".partial";
+
+    JLOGV(
+        j_.info(),
+        "snapshot started",
+        ripple::jv("path", params.path.string()));
+    try
+    {
+        {
+            std::optional<SociBackup> backup;
+            {
+                auto session = db_.checkoutDb();
+                backup.emplace(*session, partial);
+            }
+            for (;;)
+            {
+                if (stopping_)
+                    throw std::runtime_error("stopped");
+
+                bool done = false;
+                clock::duration held{};
+                {
+                    auto session = db_.checkoutDb();
+                    auto const t = clock::now();
+                    done = backup->step(params.pagesPerStep);
+                    held = clock::now() - t;
+                }
+                {
+                    std::lock_guard l{mutex_};
+                    ++steps_;
+                    maxStep_ = std::max(maxStep_, held);
+                    pageCount_ = backup->pageCount();
+                    remaining_ = backup->remaining();
+                }
+                if (done)
+                    break;
+                std::this_thread::sleep_for(params.pause);
+            }
+        }
+        boost::filesystem::rename(partial, params.path);
+
+        std::lock_guard l{mutex_};
+        state_ = State::done;
+        finished_ = clock::now();
+        JLOGV(
+            j_.info(),
+            "snapshot complete",
+            ripple::jv("path", params.path.string()),
+            ripple::jv("pages", pageCount_),
+            ripple::jv("steps", steps_));
+    }
+    catch (std::exception const& e)
+    {
+        boost::system::error_code ec;
+        boost::filesystem::remove(partial, ec);
+
+        std::lock_guard l{mutex_};
+        state_ = State::failed;
+        finished_ = clock::now();
+        error_ = e.what();
+        JLOGV(
+            j_.error(),
+            "snapshot failed",
+            ripple::jv("path", params.path.string()),
+            ripple::jv("error", error_));
+    }
+}
+
+Json::Value
+DatabaseSnapshot::getInfo() const
+{
+    using namespace std::chrono;
+
+    std::lock_guard l{mutex_};
+    Json::Value r{Json::objectValue};
+    switch (state_)
+    {
+        case State::idle:
+            r["state"] = "idle";
+            return r;
+        case State::running:
+            r["state"] = "running";
+            break;
+        case State::done:
+            r["state"] = "done";
+            break;
+        case State::failed:
+            r["state"] = "failed";
+            r["error"] = error_;
+            break;
+    }
+
+    r["path"] = params_.path.string();
+    r["pages_total"] = pageCount_;
+    r["pages_remaining"] = remaining_;
+    r["steps"] = static_cast<Json::UInt>(steps_);
+    r["max_step_us"] = static_cast<Json::UInt>(
+        duration_cast<microseconds>(maxStep_).count());
+    auto const end = state_ == State::running ? steady_clock::now() : finished_;
+    r["elapsed_ms"] = static_cast<Json::UInt>(
+        duration_cast<milliseconds>(end - started_).count());
+    return r;
+}
+
+}  // namespace xbwd
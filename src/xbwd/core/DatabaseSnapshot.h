@@ -0,0 +1,77 @@
+#pragma once
+
+#include <xbwd/basics/ThreadSaftyAnalysis.h>
+#include <xbwd/core/DatabaseCon.h>
+
+#include <ripple/beast/utility/Journal.h>
+#include <ripple/json/json_value.h>
+
+#include <boost/filesystem/path.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace xbwd {
+
+/** Online snapshots of the sqlite database while the federator keeps writing.
+
+    The copy runs on its own thread, a few pages per step. Each step holds the
+    writer session lock, so a writer waits for at most one step, and the
+    thread pauses between steps to let the writers through. Writes made while
+    the snapshot is in progress are carried into the copy.
+*/
+class DatabaseSnapshot
+{
+public:
+    struct Params
+    {
+        // The snapshot file. It is written under a ".partial" name and renamed
+        // once complete, so an existing file at `path` is always whole.
+        boost::filesystem::path path;
+        // Pages copied per step, holding the writer lock
+        int pagesPerStep = 64;
+        // Pause between steps
+        std::chrono::milliseconds pause{10};
+    };
+
+    DatabaseSnapshot(DatabaseCon& db, beast::Journal j);
+    ~DatabaseSnapshot();
+
+    // Start a snapshot. Returns an error message if it can not be started.
+    std::optional<std::string>
+    start(Params const& params) EXCLUDES(mutex_);
+
+    // State and progress of the running or last snapshot
+    Json::Value
+    getInfo() const EXCLUDES(mutex_);
+
+private:
+    enum class State { idle, running, done, failed };
+
+    void
+    run(Params params);
+
+    DatabaseCon& db_;
+    beast::Journal j_;
+
+    mutable std::mutex mutex_;
+    State GUARDED_BY(mutex_) state_ = State::idle;
+    Params GUARDED_BY(mutex_) params_;
+    int GUARDED_BY(mutex_) pageCount_ = 0;
+    int GUARDED_BY(mutex_) remaining_ = 0;
+    std::uint64_t GUARDED_BY(mutex_) steps_ = 0;
+    // Longest time a step held the writer lock
+    std::chrono::steady_clock::duration GUARDED_BY(mutex_) maxStep_{};
+    std::chrono::steady_clock::time_point GUARDED_BY(mutex_) started_;
+    std::chrono::steady_clock::time_point GUARDED_BY(mutex_) finished_;
+    std::string GUARDED_BY(mutex_) error_;
+
+    std::atomic<bool> stopping_ = false;
+    std::thread thread_;
+};
+
+}  // namespace xbwd
@@ -0,0 +1,561 @@
+#include <xbwd/core/Storage.h>
+
+#include <ripple/basics/Log.h>
+#include <ripple/protocol/Serializer.h>
+
+#include <boost/endian/conversion.hpp>
+#include <boost/filesystem.hpp>
+
+#include <lmdb.h>
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace xbwd {
+
+namespace {
+
+void
+check(int rc, char const* what)
+{
+    if (rc != MDB_SUCCESS)
+        throw std::runtime_error(
+            std::string("lmdb ") + what + ": " + mdb_strerror(rc));
+}
+
+// Attestations are keyed by big endian id followed by the txn hash, so the
+// key order is the (id, txn hash) order of a range scan
+std::size_t constexpr keySize = 8 + ripple::uint256::size();
+using Key = std::array<std::uint8_t, keySize>;
+
+Key
+makeKey(std::uint64_t id, ripple::uint256 const& txnHash)
+{
+    Key k;
+    boost::endian::store_big_u64(k.data(), id);
+    std::memcpy(k.data() + 8, txnHash.data(), txnHash.size());
+    return k;
+}
+
+std::uint64_t
+keyID(MDB_val const& k)
+{
+    assert(k.mv_size == keySize);
+    return boost::endian::load_big_u64(static_cast<std::uint8_t*>(k.mv_data));
+}
+
+MDB_val
+toVal(void const* data, std::size_t size)
+{
+    return MDB_val{size, const_cast<void*>(data)};
+}
+
+AttestationRecord
+deserialize(MDB_val const& k, MDB_val const& v)
+{
+    AttestationRecord r;
+    r.id = keyID(k);
+    std::memcpy(
+        r.txnHash.data(),
+        static_cast<std::uint8_t*>(k.mv_data) + 8,
+        r.txnHash.size());
+    ripple::SerialIter sit(v.mv_data, v.mv_size);
+    r.decodeValue(sit);
+    return r;
+}
+
+// Attestations in an LMDB environment. Each attestation table is a
+// database keyed by (id, txn hash) with a second database mapping the txn
+// hash back to the id. Sync state is a database keyed by chain type, and
+// submissions one keyed by chain type and big endian account sequence.
+class LMDBStorage : public Storage
+{
+    MDB_env* env_ = nullptr;
+
+    struct Table
+    {
+        MDB_dbi data;
+        MDB_dbi byTxn;
+    };
+    // Indexed by ChainDir, then by AttestationTable
+    std::array<std::array<Table, 2>, 2> tables_;
+    MDB_dbi sync_;
+    MDB_dbi submissions_;
+
+    // LMDB allows one write transaction at a time. Writes outside a batch
+    // commit on their own.
+    std::recursive_mutex writeMutex_;
+    MDB_txn* batchTxn_ = nullptr;
+    std::size_t batchDepth_ = 0;
+    // Set when a nested batch is rolled back
+    bool rollbackOnly_ = false;
+    std::atomic<std::thread::id> batchOwner_;
+
+    beast::Journal j_;
+
+public:
+    LMDBStorage(
+        boost::filesystem::path const& dir,
+        std::size_t mapSize,
+        beast::Journal j)
+        : j_(j)
+    {
+        boost::filesystem::create_directories(dir);
+
+        check(mdb_env_create(&env_), "env_create");
+        try
+        {
+            check(mdb_env_set_maxdbs(env_, 16), "set_maxdbs");
+            check(mdb_env_set_mapsize(env_, mapSize), "set_mapsize");
+            // Read transactions are not tied to a thread, so RPC threads can
+            // read while the federator holds the write transaction
+            check(
+                mdb_env_open(env_, dir.string().c_str(), MDB_NOTLS, 0644),
+                "env_open");
+
+            MDB_txn* txn = nullptr;
+            check(mdb_txn_begin(env_, nullptr, 0, &txn), "txn_begin");
+            auto const open = [&](std::string const& name) {
+                MDB_dbi dbi;
+                int const rc =
+                    mdb_dbi_open(txn, name.c_str(), MDB_CREATE, &dbi);
+                if (rc != MDB_SUCCESS)
+                    mdb_txn_abort(txn);
+                check(rc, "dbi_open");
+                return dbi;
+            };
+            for (auto const cd :
+                 {ChainDir::issuingToLocking, ChainDir::lockingToIssuing})
+            {
+                for (auto const t :
+                     {AttestationTable::claim, AttestationTable::createAccount})
+                {
+                    auto const name = to_string(cd) +
+                        (t == AttestationTable::claim ? ".claim" : ".create");
+                    table(cd, t) = Table{open(name), open(name + ".txn")};
+                }
+            }
+            sync_ = open("sync");
+            submissions_ = open("submissions");
+            check(mdb_txn_commit(txn), "txn_commit");
+        }
+        catch (...)
+        {
+            mdb_env_close(env_);
+            throw;
+        }
+
+        JLOGV(
+            j_.info(),
+            "opened lmdb storage",
+            ripple::jv("path", dir.string()),
+            ripple::jv("map_size", std::to_string(mapSize)));
+    }
+
+    ~LMDBStorage() override
+    {
+        assert(!batchTxn_);
+        mdb_env_close(env_);
+    }
+
+    bool
+    insert(ChainDir dir, AttestationTable t, AttestationRecord const& r)
+        override
+    {
+        auto const& tbl = table(dir, t);
+        return write([&](MDB_txn* txn) {
+            auto hashVal = toVal(r.txnHash.data(), r.txnHash.size());
+            MDB_val found;
+            int const rc = mdb_get(txn, tbl.byTxn, &hashVal, &found);
+            if (rc == MDB_SUCCESS)
+                return false;
+            check(rc == MDB_NOTFOUND ? MDB_SUCCESS : rc, "get");
+
+            auto const key = makeKey(r.id, r.txnHash);
+            auto keyVal = toVal(key.data(), key.size());
+            ripple::Serializer s;
+            r.encodeValue(s);
+            auto val = toVal(s.data(), s.size());
+            check(mdb_put(txn, tbl.data, &keyVal, &val, 0), "put");
+
+            std::array<std::uint8_t, 8> id;
+            boost::endian::store_big_u64(id.data(), r.id);
+            auto idVal = toVal(id.data(), id.size());
+            check(mdb_put(txn, tbl.byTxn, &hashVal, &idVal, 0), "put");
+            return true;
+        });
+    }
+
+    std::optional<AttestationRecord>
+    find(ChainDir dir, AttestationTable t, ripple::uint256 const& txnHash)
+        override
+    {
+        auto const& tbl = table(dir, t);
+        return read([&](MDB_txn* txn) -> std::optional<AttestationRecord> {
+            auto hashVal = toVal(txnHash.data(), txnHash.size());
+            MDB_val idVal;
+            int rc = mdb_get(txn, tbl.byTxn, &hashVal, &idVal);
+            if (rc == MDB_NOTFOUND)
+                return std::nullopt;
+            check(rc, "get");
+
+            auto const id = boost::endian::load_big_u64(
+                static_cast<std::uint8_t*>(idVal.mv_data));
+            auto const key = makeKey(id, txnHash);
+            auto keyVal = toVal(key.data(), key.size());
+            MDB_val val;
+            rc = mdb_get(txn, tbl.data, &keyVal, &val);
+            if (rc == MDB_NOTFOUND)
+                return std::nullopt;
+            check(rc, "get");
+            return deserialize(keyVal, val);
+        });
+    }
+
+    void
+    scan(
+        ChainDir dir,
+        AttestationTable t,
+        AttestationQuery const& q,
+        std::function<bool(AttestationRecord const&)> const& f) override
+    {
+        auto const& tbl = table(dir, t);
+        read([&](MDB_txn* txn) {
+            MDB_cursor* cursor = nullptr;
+            check(mdb_cursor_open(txn, tbl.data, &cursor), "cursor_open");
+            std::unique_ptr<MDB_cursor, decltype(&mdb_cursor_close)> guard{
+                cursor, &mdb_cursor_close};
+
+            // Seek to the first key at or past both the id bound and the
+            // resume position
+            auto const start = [&] {
+                if (q.after && q.after->first >= q.minID)
+                    return makeKey(q.after->first, q.after->second);
+                return makeKey(q.minID, ripple::uint256{});
+            }();
+            MDB_val k = toVal(start.data(), start.size());
+            MDB_val v;
+            std::uint32_t passed = 0;
+            for (int rc = mdb_cursor_get(cursor, &k, &v, MDB_SET_RANGE);
+                 rc != MDB_NOTFOUND;
+                 rc = mdb_cursor_get(cursor, &k, &v, MDB_NEXT))
+            {
+                check(rc, "cursor_get");
+                if (keyID(k) > q.maxID || (q.limit && passed == *q.limit))
+                    break;
+                auto const r = deserialize(k, v);
+                if (!q.matches(r))
+                    continue;
+                ++passed;
+                if (!f(r))
+                    break;
+            }
+        });
+    }
+
+    void
+    erase(ChainDir dir, AttestationTable t, std::uint64_t id) override
+    {
+        auto const& tbl = table(dir, t);
+        write([&](MDB_txn* txn) {
+            MDB_cursor* cursor = nullptr;
+            check(mdb_cursor_open(txn, tbl.data, &cursor), "cursor_open");
+            std::unique_ptr<MDB_cursor, decltype(&mdb_cursor_close)> guard{
+                cursor, &mdb_cursor_close};
+
+            auto const start = makeKey(id, ripple::uint256{});
+            MDB_val k = toVal(start.data(), start.size());
+            MDB_val v;
+            for (int rc = mdb_cursor_get(cursor, &k, &v, MDB_SET_RANGE);
+                 rc != MDB_NOTFOUND;
+                 rc = mdb_cursor_get(cursor, &k, &v, MDB_NEXT))
+            {
+                check(rc, "cursor_get");
+                if (keyID(k) != id)
+                    break;
+                MDB_val hashVal = toVal(
+                    static_cast<std::uint8_t*>(k.mv_data) + 8,
+                    ripple::uint256::size());
+                rc = mdb_del(txn, tbl.byTxn, &hashVal, nullptr);
+                check(rc == MDB_NOTFOUND ? MDB_SUCCESS : rc, "del");
+                check(mdb_cursor_del(cursor, 0), "cursor_del");
+            }
+        });
+    }
+
+    std::optional<SyncState>
+    getSyncState(ChainType ct) override
+    {
+        return read([&](MDB_txn* txn) -> std::optional<SyncState> {
+            auto const key = static_cast<std::uint8_t>(ct);
+            auto keyVal = toVal(&key, sizeof(key));
+            MDB_val val;
+            int const rc = mdb_get(txn, sync_, &keyVal, &val);
+            if (rc == MDB_NOTFOUND)
+                return std::nullopt;
+            check(rc, "get");
+            if (val.mv_size != ripple::uint256::size() + 4)
+                throw std::runtime_error("lmdb: corrupt sync state");
+
+            SyncState r;
+            auto const* const p = static_cast<std::uint8_t*>(val.mv_data);
+            std::memcpy(r.txnHash.data(), p, r.txnHash.size());
+            r.ledgerSeq =
+                boost::endian::load_big_u32(p + ripple::uint256::size());
+            return r;
+        });
+    }
+
+    void
+    setSyncState(ChainType ct, SyncState const& s) override
+    {
+        write([&](MDB_txn* txn) { putSyncState(txn, ct, s); });
+    }
+
+    void
+    setSyncTxnHash(ChainType ct, ripple::uint256 const& txnHash) override
+    {
+        write([&](MDB_txn* txn) {
+            auto s = getSyncState(ct).value_or(SyncState{});
+            s.txnHash = txnHash;
+            putSyncState(txn, ct, s);
+        });
+    }
+
+    void
+    setSyncLedgerSeq(ChainType ct, std::uint32_t ledgerSeq) override
+    {
+        write([&](MDB_txn* txn) {
+            auto s = getSyncState(ct).value_or(SyncState{});
+            s.ledgerSeq = ledgerSeq;
+            putSyncState(txn, ct, s);
+        });
+    }
+
+    void
+    putSubmission(SubmissionRecord const& r) override
+    {
+        write([&](MDB_txn* txn) {
+            auto const key = submissionKey(r.chain, r.accountSqn);
+            auto keyVal = toVal(key.data(), key.size());
+            ripple::Serializer s;
+            r.encodeValue(s);
+            auto val = toVal(s.data(), s.size());
+            check(mdb_put(txn, submissions_, &keyVal, &val, 0), "put");
+        });
+    }
+
+    void
+    eraseSubmission(ChainType ct, std::uint32_t accountSqn) override
+    {
+        write([&](MDB_txn* txn) {
+            auto const key = submissionKey(ct, accountSqn);
+            auto keyVal = toVal(key.data(), key.size());
+            int const rc = mdb_del(txn, submissions_, &keyVal, nullptr);
+            check(rc == MDB_NOTFOUND ? MDB_SUCCESS : rc, "del");
+        });
+    }
+
+    std::vector<SubmissionRecord>
+    getSubmissions() override
+    {
+        return read([&](MDB_txn* txn) {
+            MDB_cursor* cursor = nullptr;
+            check(mdb_cursor_open(txn, submissions_, &cursor), "cursor_open");
+            std::unique_ptr<MDB_cursor, decltype(&mdb_cursor_close)> guard{
+                cursor, &mdb_cursor_close};
+
+            std::vector<SubmissionRecord> r;
+            MDB_val k;
+            MDB_val v;
+            for (int rc = mdb_cursor_get(cursor, &k, &v, MDB_FIRST);
+                 rc != MDB_NOTFOUND;
+                 rc = mdb_cursor_get(cursor, &k, &v, MDB_NEXT))
+            {
+                check(rc, "cursor_get");
+                if (k.mv_size != 5)
+                    throw std::runtime_error("lmdb: corrupt submission");
+                auto const* const p = static_cast<std::uint8_t*>(k.mv_data);
+                SubmissionRecord s;
+                s.chain = static_cast<ChainType>(p[0]);
+                s.accountSqn = boost::endian::load_big_u32(p + 1);
+                ripple::SerialIter sit(v.mv_data, v.mv_size);
+                s.decodeValue(sit);
+                r.push_back(std::move(s));
+            }
+            return r;
+        });
+    }
+
+    std::string
+    name() const override
+    {
+        return "lmdb";
+    }
+
+protected:
+    void
+    beginBatch() override
+    {
+        // Blocks while another thread has a batch open
+        writeMutex_.lock();
+        if (batchDepth_++ > 0)
+            return;
+        int const rc = mdb_txn_begin(env_, nullptr, 0, &batchTxn_);
+        if (rc != MDB_SUCCESS)
+        {
+            batchDepth_ = 0;
+            writeMutex_.unlock();
+            check(rc, "txn_begin");
+        }
+        batchOwner_ = std::this_thread::get_id();
+    }
+
+    void
+    commitBatch() override
+    {
+        assert(batchTxn_ && batchDepth_ > 0);
+        std::lock_guard l{writeMutex_, std::adopt_lock};
+        if (--batchDepth_ > 0)
+            return;
+        auto* const txn = std::exchange(batchTxn_, nullptr);
+        batchOwner_ = std::thread::id{};
+        if (std::exchange(rollbackOnly_, false))
+        {
+            mdb_txn_abort(txn);
+            throw std::runtime_error("lmdb batch rolled back");
+        }
+        // The transaction is freed even if the commit fails
+        check(mdb_txn_commit(txn), "txn_commit");
+    }
+
+    void
+    rollbackBatch() override
+    {
+        assert(batchTxn_ && batchDepth_ > 0);
+        std::lock_guard l{writeMutex_, std::adopt_lock};
+        if (--batchDepth_ > 0)
+        {
+            // Undone with the enclosing batch
+            rollbackOnly_ = true;
+            return;
+        }
+        mdb_txn_abort(std::exchange(batchTxn_, nullptr));
+        batchOwner_ = std::thread::id{};
+        rollbackOnly_ = false;
+        JLOG(j_.warn()) << "lmdb batch rolled back";
+    }
+
+private:
+    Table&
+    table(ChainDir dir, AttestationTable t)
+    {
+        return tables_[static_cast<std::size_t>(dir)]
+                      [static_cast<std::size_t>(t)];
+    }
+
+    static std::array<std::uint8_t, 5>
+    submissionKey(ChainType ct, std::uint32_t accountSqn)
+    {
+        std::array<std::uint8_t, 5> k;
+        k[0] = static_cast<std::uint8_t>(ct);
+        boost::endian::store_big_u32(k.data() + 1, accountSqn);
+        return k;
+    }
+
+    void
+    putSyncState(MDB_txn* txn, ChainType ct, SyncState const& s)
+    {
+        auto const key = static_cast<std::uint8_t>(ct);
+        auto keyVal = toVal(&key, sizeof(key));
+        std::array<std::uint8_t, ripple::uint256::size() + 4> buf;
+        std::memcpy(buf.data(), s.txnHash.data(), s.txnHash.size());
+        boost::endian::store_big_u32(
+            buf.data() + ripple::uint256::size(), s.ledgerSeq);
+        auto val = toVal(buf.data(), buf.size());
+        check(mdb_put(txn, sync_, &keyVal, &val, 0), "put");
+    }
+
+    // Run `f` in the open batch, or in a write transaction of its own
+    template <class F>
+    auto
+    write(F&& f)
+    {
+        std::lock_guard l{writeMutex_};
+        if (batchTxn_)
+            return f(batchTxn_);
+
+        MDB_txn* txn = nullptr;
+        check(mdb_txn_begin(env_, nullptr, 0, &txn), "txn_begin");
+        try
+        {
+            batchTxn_ = txn;
+            batchOwner_ = std::this_thread::get_id();
+            if constexpr (std::is_void_v<decltype(f(txn))>)
+            {
+                f(txn);
+                clearOwner();
+                check(mdb_txn_commit(txn), "txn_commit");
+            }
+            else
+            {
+                auto r = f(txn);
+                clearOwner();
+                check(mdb_txn_commit(txn), "txn_commit");
+                return r;
+            }
+        }
+        catch (...)
+        {
+            if (batchTxn_)
+            {
+                clearOwner();
+                mdb_txn_abort(txn);
+            }
+            throw;
+        }
+    }
+
+    void
+    clearOwner()
+    {
+        batchTxn_ = nullptr;
+        batchOwner_ = std::thread::id{};
+    }
+
+    // Run `f` in a read transaction. The owner of the write transaction
+    // reads through it, so it sees its own uncommitted writes.
+    template <class F>
+    auto
+    read(F&& f)
+    {
+        if (batchOwner_.load() == std::this_thread::get_id())
+            return f(batchTxn_);
+
+        MDB_txn* txn = nullptr;
+        check(
+            mdb_txn_begin(env_, nullptr, MDB_RDONLY, &txn), "txn_begin");
+        std::unique_ptr<MDB_txn, decltype(&mdb_txn_abort)> guard{
+            txn, &mdb_txn_abort};
+        return f(txn);
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<Storage>
+make_LMDBStorage(
+    boost::filesystem::path const& dir,
+    std::size_t mapSize,
+    beast::Journal j)
+{
+    return std::make_unique<LMDBStorage>(dir, mapSize, j);
+}
+
+}  // namespace xbwd
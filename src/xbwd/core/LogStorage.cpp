@@ -0,0 +1,1092 @@
+#include <xbwd/core/Storage.h>
+
+#include <ripple/basics/Log.h>
+#include <ripple/basics/hardened_hash.h>
+#include <ripple/protocol/Serializer.h>
+
+#include <boost/crc.hpp>
+#include <boost/endian/conversion.hpp>
+#include <boost/filesystem.hpp>
+
+#include <fmt/core.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace xbwd {
+
+namespace {
+
+/* A record is a header followed by its payload, little endian:
+
+     crc      4  CRC-32 of the rest of the header and the payload
+     length   4  of the payload
+     type     1
+     sub      1  ChainDir and AttestationTable, or ChainType
+
+   Segments are preallocated and zero filled, so a zero type marks the end
+   of the records in a segment.
+
+   The records of a batch are framed by batchBegin and batchCommit records,
+   with a batchBegin at the start of each further segment the batch spans.
+   Records after a batchBegin take effect at its batchCommit; on startup,
+   those of a batch that never committed are dropped with it.
+*/
+std::size_t constexpr headerSize = 10;
+
+enum class RecordType : std::uint8_t {
+    end,
+    attestation,
+    erase,
+    sync,
+    submission,
+    eraseSubmission,
+    batchBegin,
+    batchCommit
+};
+
+std::uint32_t
+crc32(std::uint8_t const* data, std::size_t size)
+{
+    boost::crc_32_type crc;
+    crc.process_bytes(data, size);
+    return crc.checksum();
+}
+
+[[noreturn]] void
+throwErrno(std::string const& what)
+{
+    throw std::system_error(errno, std::system_category(), what);
+}
+
+// Make the creation and removal of files in `dir` durable
+void
+syncDirectory(boost::filesystem::path const& dir)
+{
+    int const fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+        throwErrno("open " + dir.string());
+    if (::fsync(fd) != 0)
+    {
+        int const e = errno;
+        ::close(fd);
+        throw std::system_error(
+            e, std::system_category(), "fsync " + dir.string());
+    }
+    ::close(fd);
+}
+
+// One segment file, mapped for its whole size
+class Segment
+{
+    int fd_ = -1;
+    std::uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+
+public:
+    std::uint32_t const number;
+    boost::filesystem::path const path;
+    // Offset just past the last record
+    std::size_t end = 0;
+    // Attestations in this segment that were not erased
+    std::size_t live = 0;
+
+    // Create the file with `size` bytes if `size` is not zero, else open
+    // the existing one
+    Segment(std::uint32_t n, boost::filesystem::path p, std::size_t size)
+        : number(n), path(std::move(p))
+    {
+        int const flags = size ? O_RDWR | O_CREAT | O_EXCL : O_RDWR;
+        fd_ = ::open(path.c_str(), flags, 0644);
+        if (fd_ < 0)
+            throwErrno("open " + path.string());
+        try
+        {
+            if (size)
+            {
+                if (::ftruncate(fd_, size) != 0)
+                    throwErrno("ftruncate " + path.string());
+                size_ = size;
+            }
+            else
+            {
+                struct stat st;
+                if (::fstat(fd_, &st) != 0)
+                    throwErrno("fstat " + path.string());
+                size_ = st.st_size;
+            }
+            void* const m = ::mmap(
+                nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+            if (m == MAP_FAILED)
+                throwErrno("mmap " + path.string());
+            data_ = static_cast<std::uint8_t*>(m);
+        }
+        catch (...)
+        {
+            ::close(fd_);
+            throw;
+        }
+    }
+
+    ~Segment()
+    {
+        ::munmap(data_, size_);
+        ::close(fd_);
+    }
+
+    Segment(Segment const&) = delete;
+    Segment&
+    operator=(Segment const&) = delete;
+
+    std::uint8_t*
+    data()
+    {
+        return data_;
+    }
+
+    std::size_t
+    size() const
+    {
+        return size_;
+    }
+
+    // Write [from, to) through to the file
+    void
+    sync(std::size_t from, std::size_t to)
+    {
+        if (from >= to)
+            return;
+        static std::size_t const page = ::sysconf(_SC_PAGESIZE);
+        auto const start = from / page * page;
+        if (::msync(data_ + start, to - start, MS_SYNC) != 0)
+            throwErrno("msync " + path.string());
+    }
+};
+
+/** Attestations in an append only log of memory mapped segment files.
+
+    Every change is a CRC protected record appended to the active segment;
+    nothing is updated in place. Attestations are found through in memory
+    indexes rebuilt from the log on startup: a hash index by txn hash, and
+    an ordered index by id that serves range scans. A torn record at the
+    tail, left by a crash, is discarded on startup, as is a segment file
+    the crash left too short to hold a record.
+
+    A batch is written to the log as it goes, but other threads' reads wait
+    for it to commit or roll back, so they never see part of one.
+
+    When a record does not fit, the active segment is sealed and a new one
+    started with a copy of the sync state and the journaled submissions, so
+    neither ever depends on a sealed segment. Once none of the attestations
+    in the oldest segment are live, its file is removed.
+*/
+class LogStorage : public Storage
+{
+    struct Location
+    {
+        Segment* segment;
+        std::size_t offset;
+    };
+
+    struct Table
+    {
+        std::unordered_map<ripple::uint256, Location, ripple::hardened_hash<>>
+            byTxn;
+        // Txn hashes of each id, sorted
+        std::map<std::uint64_t, std::vector<ripple::uint256>> byID;
+    };
+
+    // Where a replay of the log is, across segments
+    struct Replay
+    {
+        // The first batchBegin of the batch being replayed
+        std::optional<Location> begin;
+        // Records of that batch, applied once its batchCommit is reached
+        std::vector<Location> pending;
+    };
+
+    // Records examined per lock acquisition in a scan
+    static std::size_t constexpr scanChunk = 256;
+
+    boost::filesystem::path const dir_;
+    std::size_t const segmentSize_;
+
+    // Guards the indexes, the sync state and the segment list. Readers take
+    // it shared; record bytes do not change once written.
+    mutable std::shared_mutex mutex_;
+    // Indexed by ChainDir, then by AttestationTable
+    std::array<std::array<Table, 2>, 2> tables_;
+    ChainArray<std::optional<SyncState>> sync_;
+    std::map<std::pair<ChainType, std::uint32_t>, SubmissionRecord>
+        submissions_;
+    std::deque<std::unique_ptr<Segment>> segments_;
+
+    // Serializes appends. A batch holds it until it commits.
+    std::recursive_mutex writeMutex_;
+    std::size_t batchDepth_ = 0;
+    // Set when a nested batch is rolled back
+    bool rollbackOnly_ = false;
+    // End of the log when the outermost batch began
+    std::pair<std::uint32_t, std::size_t> batchStart_;
+    // Set once the open batch wrote its batchBegin record
+    bool batchWritten_ = false;
+    // Under the unique lock. Reads from other threads wait while it is set.
+    bool batchOpen_ = false;
+    std::thread::id batchOwner_;
+    mutable std::condition_variable_any batchDone_;
+    // Start of the bytes in the active segment not yet synced
+    std::size_t unsynced_ = 0;
+
+    beast::Journal j_;
+
+public:
+    LogStorage(
+        boost::filesystem::path const& dir,
+        std::size_t segmentSize,
+        beast::Journal j)
+        : dir_(dir), segmentSize_(segmentSize), j_(j)
+    {
+        boost::filesystem::create_directories(dir_);
+
+        std::vector<std::uint32_t> numbers;
+        for (auto const& entry : boost::filesystem::directory_iterator(dir_))
+        {
+            auto const& p = entry.path();
+            if (p.extension() != ".seg")
+                continue;
+            auto const stem = p.stem().string();
+            std::uint32_t n = 0;
+            auto const [ptr, ec] = std::from_chars(
+                stem.data(), stem.data() + stem.size(), n, 16);
+            if (ec == std::errc() && ptr == stem.data() + stem.size())
+                numbers.push_back(n);
+        }
+        std::sort(numbers.begin(), numbers.end());
+
+        // A crash between creating a segment and sizing it leaves a file too
+        // short to map. Only the newest segment can be in that state, and it
+        // holds no records yet.
+        bool dirChanged = false;
+        while (!numbers.empty() &&
+               boost::filesystem::file_size(segmentPath(numbers.back())) <
+                   headerSize)
+        {
+            auto const path = segmentPath(numbers.back());
+            JLOGV(
+                j_.warn(),
+                "removing unsized log segment",
+                ripple::jv("path", path.string()));
+            boost::filesystem::remove(path);
+            numbers.pop_back();
+            dirChanged = true;
+        }
+
+        std::unique_lock l{mutex_};
+        for (auto const n : numbers)
+            segments_.push_back(
+                std::make_unique<Segment>(n, segmentPath(n), 0));
+        replay();
+        if (segments_.empty())
+        {
+            segments_.push_back(
+                std::make_unique<Segment>(0, segmentPath(0), segmentSize_));
+            dirChanged = true;
+        }
+        if (dirChanged)
+            syncDirectory(dir_);
+        reclaim();
+        unsynced_ = segments_.back()->end;
+
+        std::size_t count = 0;
+        for (auto const& byDir : tables_)
+            for (auto const& tbl : byDir)
+                count += tbl.byTxn.size();
+        JLOGV(
+            j_.info(),
+            "opened log storage",
+            ripple::jv("path", dir_.string()),
+            ripple::jv(
+                "segments", static_cast<std::uint32_t>(segments_.size())),
+            ripple::jv("attestations", static_cast<std::uint32_t>(count)));
+    }
+
+    ~LogStorage() override
+    {
+        assert(!batchDepth_);
+        try
+        {
+            flush();
+        }
+        catch (std::exception const& e)
+        {
+            JLOGV(
+                j_.error(), "error syncing log", ripple::jv("what", e.what()));
+        }
+    }
+
+    bool
+    insert(ChainDir dir, AttestationTable t, AttestationRecord const& r)
+        override
+    {
+        std::lock_guard wl{writeMutex_};
+        {
+            std::unique_lock l{mutex_};
+            if (table(dir, t).byTxn.count(r.txnHash))
+                return false;
+
+            ripple::Serializer s;
+            s.add64(r.id);
+            s.addBitString(r.txnHash);
+            r.encodeValue(s);
+            auto const loc =
+                append(RecordType::attestation, tableCode(dir, t), s.slice());
+            addAttestation(dir, t, r.id, r.txnHash, loc);
+        }
+        flushUnlessBatch();
+        return true;
+    }
+
+    std::optional<AttestationRecord>
+    find(ChainDir dir, AttestationTable t, ripple::uint256 const& txnHash)
+        override
+    {
+        auto const l = readLock();
+        auto const& tbl = table(dir, t);
+        auto const it = tbl.byTxn.find(txnHash);
+        if (it == tbl.byTxn.end())
+            return std::nullopt;
+        return read(it->second);
+    }
+
+    void
+    scan(
+        ChainDir dir,
+        AttestationTable t,
+        AttestationQuery const& q,
+        std::function<bool(AttestationRecord const&)> const& f) override
+    {
+        // Records are read a chunk at a time and handed to `f` without the
+        // lock held, so `f` may write to the storage
+        auto pos = q.after;
+        std::vector<AttestationRecord> chunk;
+        std::uint32_t passed = 0;
+        bool done = false;
+        while (!done)
+        {
+            chunk.clear();
+            {
+                auto const l = readLock();
+                auto const& tbl = table(dir, t);
+                auto it = tbl.byID.lower_bound(
+                    pos ? std::max(pos->first, q.minID) : q.minID);
+                std::size_t examined = 0;
+                for (; it != tbl.byID.end() && it->first <= q.maxID &&
+                     examined < scanChunk;
+                     ++it)
+                {
+                    for (auto const& hash : it->second)
+                    {
+                        if (pos && std::make_pair(it->first, hash) <= *pos)
+                            continue;
+                        ++examined;
+                        auto r = read(tbl.byTxn.at(hash));
+                        if (q.matches(r))
+                            chunk.push_back(std::move(r));
+                    }
+                    pos.emplace(it->first, it->second.back());
+                }
+                done = it == tbl.byID.end() || it->first > q.maxID;
+            }
+            for (auto const& r : chunk)
+            {
+                if ((q.limit && passed == *q.limit) || !f(r))
+                    return;
+                ++passed;
+            }
+        }
+    }
+
+    void
+    erase(ChainDir dir, AttestationTable t, std::uint64_t id) override
+    {
+        std::lock_guard wl{writeMutex_};
+        {
+            std::unique_lock l{mutex_};
+            if (!table(dir, t).byID.count(id))
+                return;
+
+            ripple::Serializer s;
+            s.add64(id);
+            append(RecordType::erase, tableCode(dir, t), s.slice());
+            eraseAttestations(dir, t, id);
+            reclaim();
+        }
+        flushUnlessBatch();
+    }
+
+    std::optional<SyncState>
+    getSyncState(ChainType ct) override
+    {
+        auto const l = readLock();
+        return sync_[ct];
+    }
+
+    void
+    setSyncState(ChainType ct, SyncState const& s) override
+    {
+        std::lock_guard wl{writeMutex_};
+        {
+            std::unique_lock l{mutex_};
+            appendSync(ct, s);
+        }
+        flushUnlessBatch();
+    }
+
+    void
+    setSyncTxnHash(ChainType ct, ripple::uint256 const& txnHash) override
+    {
+        std::lock_guard wl{writeMutex_};
+        {
+            std::unique_lock l{mutex_};
+            auto s = sync_[ct].value_or(SyncState{});
+            s.txnHash = txnHash;
+            appendSync(ct, s);
+        }
+        flushUnlessBatch();
+    }
+
+    void
+    setSyncLedgerSeq(ChainType ct, std::uint32_t ledgerSeq) override
+    {
+        std::lock_guard wl{writeMutex_};
+        {
+            std::unique_lock l{mutex_};
+            auto s = sync_[ct].value_or(SyncState{});
+            s.ledgerSeq = ledgerSeq;
+            appendSync(ct, s);
+        }
+        flushUnlessBatch();
+    }
+
+    void
+    putSubmission(SubmissionRecord const& r) override
+    {
+        std::lock_guard wl{writeMutex_};
+        {
+            std::unique_lock l{mutex_};
+            appendSubmission(r);
+        }
+        flushUnlessBatch();
+    }
+
+    void
+    eraseSubmission(ChainType ct, std::uint32_t accountSqn) override
+    {
+        std::lock_guard wl{writeMutex_};
+        {
+            std::unique_lock l{mutex_};
+            if (!submissions_.erase({ct, accountSqn}))
+                return;
+            ripple::Serializer s;
+            s.add32(accountSqn);
+            append(
+                RecordType::eraseSubmission,
+                static_cast<std::uint8_t>(ct),
+                s.slice());
+        }
+        flushUnlessBatch();
+    }
+
+    std::vector<SubmissionRecord>
+    getSubmissions() override
+    {
+        auto const l = readLock();
+        std::vector<SubmissionRecord> r;
+        r.reserve(submissions_.size());
+        for (auto const& [key, sub] : submissions_)
+            r.push_back(sub);
+        return r;
+    }
+
+    std::string
+    name() const override
+    {
+        return "log";
+    }
+
+protected:
+    void
+    beginBatch() override
+    {
+        // Blocks while another thread has a batch open
+        writeMutex_.lock();
+        if (batchDepth_++ == 0)
+        {
+            std::unique_lock l{mutex_};
+            auto const& seg = *segments_.back();
+            batchStart_ = {seg.number, seg.end};
+            batchWritten_ = false;
+            batchOpen_ = true;
+            batchOwner_ = std::this_thread::get_id();
+        }
+    }
+
+    void
+    commitBatch() override
+    {
+        assert(batchDepth_ > 0);
+        std::lock_guard wl{writeMutex_, std::adopt_lock};
+        if (batchDepth_ > 1)
+        {
+            --batchDepth_;
+            return;
+        }
+        // Still open while the batchCommit is written, so a rollover does
+        // not reclaim the segment the batch began in first
+        std::unique_lock l{mutex_};
+        try
+        {
+            if (std::exchange(rollbackOnly_, false))
+            {
+                truncate();
+                throw std::runtime_error("log batch rolled back");
+            }
+            if (batchWritten_)
+            {
+                try
+                {
+                    write(RecordType::batchCommit, 0, {});
+                }
+                catch (...)
+                {
+                    truncate();
+                    throw;
+                }
+            }
+            flush();
+        }
+        catch (std::exception const& e)
+        {
+            JLOGV(
+                j_.error(),
+                "error committing batch",
+                ripple::jv("what", e.what()));
+            closeBatch();
+            throw;
+        }
+        closeBatch();
+        reclaim();
+    }
+
+    void
+    rollbackBatch() override
+    {
+        assert(batchDepth_ > 0);
+        std::lock_guard wl{writeMutex_, std::adopt_lock};
+        if (batchDepth_ > 1)
+        {
+            // Undone with the enclosing batch
+            --batchDepth_;
+            rollbackOnly_ = true;
+            return;
+        }
+        rollbackOnly_ = false;
+        JLOG(j_.warn()) << "log batch rolled back";
+        std::unique_lock l{mutex_};
+        try
+        {
+            truncate();
+        }
+        catch (std::exception const& e)
+        {
+            JLOGV(
+                j_.error(),
+                "error rolling back batch",
+                ripple::jv("what", e.what()));
+        }
+        closeBatch();
+    }
+
+private:
+    // A shared lock once no other thread has a batch open
+    std::shared_lock<std::shared_mutex>
+    readLock() const
+    {
+        std::shared_lock l{mutex_};
+        batchDone_.wait(l, [this] {
+            return !batchOpen_ || batchOwner_ == std::this_thread::get_id();
+        });
+        return l;
+    }
+
+    // Requires the write mutex and the unique lock
+    void
+    closeBatch()
+    {
+        batchDepth_ = 0;
+        batchWritten_ = false;
+        batchOpen_ = false;
+        batchDone_.notify_all();
+    }
+
+    static std::uint8_t
+    tableCode(ChainDir dir, AttestationTable t)
+    {
+        return (static_cast<std::uint8_t>(dir) << 1) |
+            static_cast<std::uint8_t>(t);
+    }
+
+    Table&
+    table(ChainDir dir, AttestationTable t)
+    {
+        return tables_[static_cast<std::size_t>(dir)]
+                      [static_cast<std::size_t>(t)];
+    }
+
+    boost::filesystem::path
+    segmentPath(std::uint32_t n) const
+    {
+        return dir_ / fmt::format("{:08x}.seg", n);
+    }
+
+    // Requires the write mutex and the unique lock
+    Location
+    append(RecordType type, std::uint8_t sub, ripple::Slice payload)
+    {
+        if (batchDepth_ > 0 && !batchWritten_)
+        {
+            write(RecordType::batchBegin, 0, {});
+            batchWritten_ = true;
+        }
+        return write(type, sub, payload);
+    }
+
+    // Append without regard to batches. Requires the write mutex and the
+    // unique lock.
+    Location
+    write(RecordType type, std::uint8_t sub, ripple::Slice payload)
+    {
+        auto const size = headerSize + payload.size();
+        if (size > segmentSize_)
+            throw std::runtime_error("log record larger than a segment");
+
+        auto* seg = segments_.back().get();
+        if (seg->end + size > seg->size())
+        {
+            seg = rollover();
+            if (seg->end + size > seg->size())
+                throw std::runtime_error("log record larger than a segment");
+        }
+
+        auto* const p = seg->data() + seg->end;
+        boost::endian::store_little_u32(p + 4, payload.size());
+        p[8] = static_cast<std::uint8_t>(type);
+        p[9] = sub;
+        if (!payload.empty())
+            std::memcpy(p + headerSize, payload.data(), payload.size());
+        boost::endian::store_little_u32(p, crc32(p + 4, size - 4));
+
+        Location const loc{seg, seg->end};
+        seg->end += size;
+        return loc;
+    }
+
+    void
+    appendSync(ChainType ct, SyncState const& s)
+    {
+        ripple::Serializer payload;
+        payload.addBitString(s.txnHash);
+        payload.add32(s.ledgerSeq);
+        append(
+            RecordType::sync, static_cast<std::uint8_t>(ct), payload.slice());
+        sync_[ct] = s;
+    }
+
+    void
+    appendSubmission(SubmissionRecord const& r)
+    {
+        ripple::Serializer payload;
+        payload.add32(r.accountSqn);
+        r.encodeValue(payload);
+        append(
+            RecordType::submission,
+            static_cast<std::uint8_t>(r.chain),
+            payload.slice());
+        submissions_[{r.chain, r.accountSqn}] = r;
+    }
+
+    // Seal the active segment and start the next one
+    Segment*
+    rollover()
+    {
+        auto& sealed = *segments_.back();
+        sealed.sync(unsynced_, sealed.end);
+        auto const n = sealed.number + 1;
+        segments_.push_back(
+            std::make_unique<Segment>(n, segmentPath(n), segmentSize_));
+        syncDirectory(dir_);
+        unsynced_ = 0;
+        // The batch goes on in this segment, which may outlive the one it
+        // began in
+        if (batchWritten_)
+            write(RecordType::batchBegin, 0, {});
+
+        JLOGV(
+            j_.debug(),
+            "log segment rollover",
+            ripple::jv("sealed", sealed.path.string()),
+            ripple::jv("live", static_cast<std::uint32_t>(sealed.live)));
+
+        for (auto const ct : {ChainType::locking, ChainType::issuing})
+        {
+            if (auto const s = sync_[ct])
+                appendSync(ct, *s);
+        }
+        for (auto const& [key, sub] : submissions_)
+            appendSubmission(sub);
+        reclaim();
+        return segments_.back().get();
+    }
+
+    // Remove leading segments with no live attestations. Erasures in them
+    // only refer to records in the same or older segments, so they are no
+    // longer needed either. Deferred while a batch is open, since a
+    // rollback may bring the attestations back.
+    void
+    reclaim()
+    {
+        if (batchDepth_ > 0)
+            return;
+        bool removed = false;
+        while (segments_.size() > 1 && segments_.front()->live == 0)
+        {
+            auto const path = segments_.front()->path;
+            segments_.pop_front();
+            boost::system::error_code ec;
+            boost::filesystem::remove(path, ec);
+            JLOGV(
+                j_.debug(),
+                "removed log segment",
+                ripple::jv("path", path.string()),
+                ripple::jv("error", ec.message()));
+            removed = true;
+        }
+        if (!removed)
+            return;
+        // A segment that comes back after a crash is only replayed again
+        try
+        {
+            syncDirectory(dir_);
+        }
+        catch (std::exception const& e)
+        {
+            JLOGV(
+                j_.warn(),
+                "error syncing log directory",
+                ripple::jv("what", e.what()));
+        }
+    }
+
+    // Drop everything appended since the batch began and rebuild the indexes
+    // from what is left. Requires the write mutex and the unique lock.
+    void
+    truncate()
+    {
+        auto const [number, offset] = batchStart_;
+        cut(number, offset);
+        replay();
+        unsynced_ = segments_.back()->end;
+    }
+
+    // Remove the records from `offset` in segment `number` on. Requires the
+    // unique lock.
+    void
+    cut(std::uint32_t number, std::size_t offset)
+    {
+        if (segments_.back()->number > number)
+        {
+            while (segments_.back()->number > number)
+            {
+                auto const path = segments_.back()->path;
+                segments_.pop_back();
+                boost::filesystem::remove(path);
+            }
+            syncDirectory(dir_);
+        }
+        auto& seg = *segments_.back();
+        std::memset(seg.data() + offset, 0, seg.end - offset);
+        seg.sync(offset, seg.end);
+        seg.end = offset;
+    }
+
+    // Rebuild the indexes from the log, and remove a batch at its end that
+    // never committed. Requires the unique lock.
+    void
+    replay()
+    {
+        for (auto& byDir : tables_)
+            for (auto& tbl : byDir)
+                tbl = Table{};
+        for (auto const ct : {ChainType::locking, ChainType::issuing})
+            sync_[ct].reset();
+        submissions_.clear();
+
+        Replay r;
+        for (std::size_t i = 0; i < segments_.size(); ++i)
+        {
+            segments_[i]->live = 0;
+            recover(*segments_[i], i + 1 == segments_.size(), r);
+        }
+        if (!r.begin)
+            return;
+        JLOGV(
+            j_.warn(),
+            "discarding uncommitted batch at the end of the log",
+            ripple::jv("path", r.begin->segment->path.string()),
+            ripple::jv("offset", static_cast<std::uint32_t>(r.begin->offset)),
+            ripple::jv(
+                "records", static_cast<std::uint32_t>(r.pending.size())));
+        cut(r.begin->segment->number, r.begin->offset);
+    }
+
+    void
+    flushUnlessBatch()
+    {
+        if (batchDepth_ == 0)
+            flush();
+    }
+
+    // Requires the write mutex
+    void
+    flush()
+    {
+        auto& seg = *segments_.back();
+        seg.sync(unsynced_, seg.end);
+        unsynced_ = seg.end;
+    }
+
+    AttestationRecord
+    read(Location const& loc) const
+    {
+        auto const* const p = loc.segment->data() + loc.offset;
+        ripple::SerialIter sit(
+            p + headerSize, boost::endian::load_little_u32(p + 4));
+        AttestationRecord r;
+        r.id = sit.get64();
+        r.txnHash = sit.get256();
+        r.decodeValue(sit);
+        return r;
+    }
+
+    void
+    addAttestation(
+        ChainDir dir,
+        AttestationTable t,
+        std::uint64_t id,
+        ripple::uint256 const& txnHash,
+        Location const& loc)
+    {
+        auto& tbl = table(dir, t);
+        if (!tbl.byTxn.emplace(txnHash, loc).second)
+            return;
+        auto& hashes = tbl.byID[id];
+        hashes.insert(
+            std::upper_bound(hashes.begin(), hashes.end(), txnHash), txnHash);
+        ++loc.segment->live;
+    }
+
+    void
+    eraseAttestations(ChainDir dir, AttestationTable t, std::uint64_t id)
+    {
+        auto& tbl = table(dir, t);
+        auto const it = tbl.byID.find(id);
+        if (it == tbl.byID.end())
+            return;
+        for (auto const& hash : it->second)
+        {
+            auto const loc = tbl.byTxn.find(hash);
+            --loc->second.segment->live;
+            tbl.byTxn.erase(loc);
+        }
+        tbl.byID.erase(it);
+    }
+
+    // Apply a record read back from the log. False if it is malformed.
+    bool
+    apply(
+        RecordType type,
+        std::uint8_t sub,
+        ripple::SerialIter sit,
+        Location const& loc)
+    {
+        try
+        {
+            switch (type)
+            {
+                case RecordType::attestation:
+                case RecordType::erase: {
+                    if (sub > 3)
+                        return false;
+                    auto const dir = static_cast<ChainDir>(sub >> 1);
+                    auto const t = static_cast<AttestationTable>(sub & 1);
+                    auto const id = sit.get64();
+                    if (type == RecordType::erase)
+                        eraseAttestations(dir, t, id);
+                    else
+                        addAttestation(dir, t, id, sit.get256(), loc);
+                    return true;
+                }
+                case RecordType::sync: {
+                    if (sub > 1)
+                        return false;
+                    SyncState s;
+                    s.txnHash = sit.get256();
+                    s.ledgerSeq = sit.get32();
+                    sync_[static_cast<ChainType>(sub)] = s;
+                    return true;
+                }
+                case RecordType::submission:
+                case RecordType::eraseSubmission: {
+                    if (sub > 1)
+                        return false;
+                    auto const ct = static_cast<ChainType>(sub);
+                    auto const accountSqn = sit.get32();
+                    if (type == RecordType::eraseSubmission)
+                    {
+                        submissions_.erase({ct, accountSqn});
+                        return true;
+                    }
+                    SubmissionRecord r;
+                    r.chain = ct;
+                    r.accountSqn = accountSqn;
+                    r.decodeValue(sit);
+                    submissions_[{ct, accountSqn}] = std::move(r);
+                    return true;
+                }
+                default:
+                    return false;
+            }
+        }
+        catch (std::exception const&)
+        {
+            return false;
+        }
+    }
+
+    // Apply a record of a batch once the batch committed
+    void
+    applyCommitted(Location const& loc)
+    {
+        auto const* const p = loc.segment->data() + loc.offset;
+        auto const length = boost::endian::load_little_u32(p + 4);
+        if (!apply(
+                static_cast<RecordType>(p[8]),
+                p[9],
+                ripple::SerialIter(p + headerSize, length),
+                loc))
+            JLOGV(
+                j_.error(),
+                "malformed record in committed log batch",
+                ripple::jv("path", loc.segment->path.string()),
+                ripple::jv("offset", static_cast<std::uint32_t>(loc.offset)));
+    }
+
+    // Replay the records of a segment, continuing the replay `r` of the
+    // segments before it. A bad record ends the replay; in the last segment,
+    // that and anything after it is a torn write and is cleared so new
+    // records can take its place.
+    void
+    recover(Segment& seg, bool last, Replay& r)
+    {
+        std::size_t pos = 0;
+        while (pos + headerSize <= seg.size())
+        {
+            auto const* const p = seg.data() + pos;
+            auto const type = static_cast<RecordType>(p[8]);
+            if (type == RecordType::end || type > RecordType::batchCommit)
+                break;
+            auto const length = boost::endian::load_little_u32(p + 4);
+            if (length > seg.size() - pos - headerSize ||
+                boost::endian::load_little_u32(p) !=
+                    crc32(p + 4, headerSize - 4 + length))
+                break;
+            Location const loc{&seg, pos};
+            if (type == RecordType::batchBegin)
+            {
+                if (!r.begin)
+                    r.begin = loc;
+            }
+            else if (type == RecordType::batchCommit)
+            {
+                for (auto const& l : r.pending)
+                    applyCommitted(l);
+                r.pending.clear();
+                r.begin.reset();
+            }
+            else if (r.begin)
+                r.pending.push_back(loc);
+            else if (!apply(
+                         type,
+                         p[9],
+                         ripple::SerialIter(p + headerSize, length),
+                         loc))
+                break;
+            pos += headerSize + length;
+        }
+        seg.end = pos;
+
+        auto* const tail = seg.data() + pos;
+        auto const tailSize = seg.size() - pos;
+        if (std::all_of(tail, tail + tailSize, [](auto b) { return b == 0; }))
+            return;
+        if (!last)
+        {
+            JLOGV(
+                j_.error(),
+                "corrupt record in sealed log segment",
+                ripple::jv("path", seg.path.string()),
+                ripple::jv("offset", static_cast<std::uint32_t>(pos)));
+            return;
+        }
+        JLOGV(
+            j_.warn(),
+            "discarding torn records at the end of the log",
+            ripple::jv("path", seg.path.string()),
+            ripple::jv("offset", static_cast<std::uint32_t>(pos)));
+        std::memset(tail, 0, tailSize);
+        seg.sync(pos, seg.size());
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<Storage>
+make_LogStorage(
+    boost::filesystem::path const& dir,
+    std::size_t segmentSize,
+    beast::Journal j)
+{
+    return std::make_unique<LogStorage>(dir, segmentSize, j);
+}
+
+}  // namespace xbwd
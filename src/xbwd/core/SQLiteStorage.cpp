@@ -0,0 +1,586 @@
+#include <xbwd/core/Storage.h>
+
+#include <xbwd/app/DBInit.h>
+#include <xbwd/core/DatabaseCon.h>
+#include <xbwd/core/SociDB.h>
+
+#include <ripple/basics/Log.h>
+#include <ripple/basics/strHex.h>
+#include <ripple/protocol/SField.h>
+
+#include <fmt/core.h>
+
+#include <atomic>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+namespace xbwd {
+
+namespace {
+
+std::string const&
+tableName(ChainDir dir, AttestationTable t)
+{
+    return t == AttestationTable::createAccount
+        ? db_init::xChainCreateAccountTableName(dir)
+        : db_init::xChainTableName(dir);
+}
+
+char const*
+idColumn(AttestationTable t)
+{
+    return t == AttestationTable::createAccount ? "CreateCount" : "ClaimID";
+}
+
+// Buffers for one row of an attestation table. The claim and create account
+// tables share a layout apart from the id column and RewardAmt, so one set of
+// bindings serves both (RewardAmt is selected as NULL for claim tables).
+struct AttestationRow
+{
+    std::string transID;
+    std::uint32_t ledgerSeq = 0;
+    std::uint64_t id = 0;
+    int success = 0;
+    soci::blob amtBlob;
+    soci::blob rewardAmtBlob;
+    soci::indicator rewardAmtInd = soci::i_null;
+    soci::blob bridgeBlob;
+    soci::blob sendingAccountBlob;
+    soci::blob rewardAccountBlob;
+    soci::blob otherChainDstBlob;
+    soci::indicator otherChainDstInd = soci::i_null;
+    soci::blob publicKeyBlob;
+    soci::blob signatureBlob;
+    soci::indicator signatureInd = soci::i_null;
+
+    explicit AttestationRow(soci::session& session)
+        : amtBlob(session)
+        , rewardAmtBlob(session)
+        , bridgeBlob(session)
+        , sendingAccountBlob(session)
+        , rewardAccountBlob(session)
+        , otherChainDstBlob(session)
+        , publicKeyBlob(session)
+        , signatureBlob(session)
+    {
+    }
+
+    static std::string
+    columns(AttestationTable t)
+    {
+        return fmt::format(
+            R"sql(TransID, LedgerSeq, {id_col}, Success, DeliveredAmt,
+                  {reward_amt}, Bridge, SendingAccount, RewardAccount,
+                  OtherChainDst, PublicKey, Signature)sql",
+            fmt::arg("id_col", idColumn(t)),
+            fmt::arg(
+                "reward_amt",
+                t == AttestationTable::createAccount ? "RewardAmt" : "NULL"));
+    }
+
+    soci::statement
+    prepare(soci::session& session, std::string const& sql)
+    {
+        return (
+            session.prepare << sql,
+            soci::into(transID),
+            soci::into(ledgerSeq),
+            soci::into(id),
+            soci::into(success),
+            soci::into(amtBlob),
+            soci::into(rewardAmtBlob, rewardAmtInd),
+            soci::into(bridgeBlob),
+            soci::into(sendingAccountBlob),
+            soci::into(rewardAccountBlob),
+            soci::into(otherChainDstBlob, otherChainDstInd),
+            soci::into(publicKeyBlob),
+            soci::into(signatureBlob, signatureInd));
+    }
+
+    AttestationRecord
+    record()
+    {
+        AttestationRecord r;
+        if (!r.txnHash.parseHex(transID))
+            throw std::runtime_error("cannot parse transaction hash");
+        r.ledgerSeq = ledgerSeq;
+        r.id = id;
+        r.success = success != 0;
+
+        // Empty blobs stand in for missing optional values
+        if (amtBlob.get_len() > 0)
+        {
+            r.deliveredAmt.emplace();
+            convert(amtBlob, *r.deliveredAmt, ripple::sfAmount);
+        }
+        if (rewardAmtInd == soci::i_ok && rewardAmtBlob.get_len() > 0)
+        {
+            r.rewardAmt.emplace();
+            convert(rewardAmtBlob, *r.rewardAmt, ripple::sfAmount);
+        }
+        convert(bridgeBlob, r.bridge, ripple::sfXChainBridge);
+        convert(sendingAccountBlob, r.sendingAccount);
+        convert(rewardAccountBlob, r.rewardAccount);
+        if (otherChainDstInd == soci::i_ok && otherChainDstBlob.get_len() > 0)
+        {
+            r.otherChainDst.emplace();
+            convert(otherChainDstBlob, *r.otherChainDst);
+        }
+        convert(publicKeyBlob, r.publicKey);
+        if (signatureInd == soci::i_ok && signatureBlob.get_len() > 0)
+        {
+            r.signature.emplace();
+            convert(signatureBlob, *r.signature);
+        }
+        return r;
+    }
+};
+
+// Attestations in the tables created by db_init::xChainDBInit
+class SQLiteStorage : public Storage
+{
+    DatabaseCon& db_;
+    // Set while a batch is open. Only the thread that opened it may use the
+    // writer session until it is committed.
+    std::optional<LockedSociSession> batch_;
+    std::size_t batchDepth_ = 0;
+    // Set when a nested batch is rolled back
+    bool rollbackOnly_ = false;
+    std::atomic<std::thread::id> batchOwner_;
+    beast::Journal j_;
+
+public:
+    SQLiteStorage(DatabaseCon& db, beast::Journal j) : db_(db), j_(j)
+    {
+    }
+
+    bool
+    insert(ChainDir dir, AttestationTable t, AttestationRecord const& r)
+        override
+    {
+        auto const& tblName = tableName(dir, t);
+        auto const txnIdHex = ripple::strHex(r.txnHash);
+        auto session = db_.checkoutDb();
+        {
+            auto const sql = fmt::format(
+                R"sql(SELECT count(*) FROM {table_name} WHERE TransID = :tx_hex;
+                )sql",
+                fmt::arg("table_name", tblName));
+            int count = 0;
+            *session << sql, soci::into(count), soci::use(txnIdHex);
+            if (session->got_data() && count > 0)
+                return false;
+        }
+
+        // Soci blob does not play well with optional. Store an empty blob
+        // for missing values.
+        soci::blob amtBlob(*session);
+        if (r.deliveredAmt)
+            convert(*r.deliveredAmt, amtBlob);
+        soci::blob rewardAmtBlob(*session);
+        if (r.rewardAmt)
+            convert(*r.rewardAmt, rewardAmtBlob);
+        soci::blob bridgeBlob(*session);
+        convert(r.bridge, bridgeBlob);
+        soci::blob sendingAccountBlob(*session);
+        convert(r.sendingAccount, sendingAccountBlob);
+        soci::blob rewardAccountBlob(*session);
+        convert(r.rewardAccount, rewardAccountBlob);
+        soci::blob otherChainDstBlob(*session);
+        if (r.otherChainDst)
+            convert(*r.otherChainDst, otherChainDstBlob);
+        soci::blob publicKeyBlob(*session);
+        convert(r.publicKey, publicKeyBlob);
+        soci::blob signatureBlob(*session);
+        if (r.signature)
+            convert(*r.signature, signatureBlob);
+        int const success = r.success ? 1 : 0;  // soci complains about a bool
+
+        if (t == AttestationTable::createAccount)
+        {
+            auto const sql = fmt::format(
+                R"sql(INSERT INTO {table_name}
+                  (TransID, LedgerSeq, CreateCount, Success, DeliveredAmt, RewardAmt, Bridge,
+                   SendingAccount, RewardAccount, OtherChainDst, PublicKey, Signature)
+                  VALUES
+                  (:txnId, :lgrSeq, :createCount, :success, :amt, :rewardAmt, :bridge,
+                   :sendingAccount, :rewardAccount, :otherChainDst, :pk, :sig);
+                )sql",
+                fmt::arg("table_name", tblName));
+            *session << sql, soci::use(txnIdHex), soci::use(r.ledgerSeq),
+                soci::use(r.id), soci::use(success), soci::use(amtBlob),
+                soci::use(rewardAmtBlob), soci::use(bridgeBlob),
+                soci::use(sendingAccountBlob), soci::use(rewardAccountBlob),
+                soci::use(otherChainDstBlob), soci::use(publicKeyBlob),
+                soci::use(signatureBlob);
+        }
+        else
+        {
+            auto const sql = fmt::format(
+                R"sql(INSERT INTO {table_name}
+                  (TransID, LedgerSeq, ClaimID, Success, DeliveredAmt, Bridge,
+                   SendingAccount, RewardAccount, OtherChainDst, PublicKey, Signature)
+                  VALUES
+                  (:txnId, :lgrSeq, :claimID, :success, :amt, :bridge,
+                   :sendingAccount, :rewardAccount, :otherChainDst, :pk, :sig);
+                )sql",
+                fmt::arg("table_name", tblName));
+            *session << sql, soci::use(txnIdHex), soci::use(r.ledgerSeq),
+                soci::use(r.id), soci::use(success), soci::use(amtBlob),
+                soci::use(bridgeBlob), soci::use(sendingAccountBlob),
+                soci::use(rewardAccountBlob), soci::use(otherChainDstBlob),
+                soci::use(publicKeyBlob), soci::use(signatureBlob);
+        }
+        return true;
+    }
+
+    std::optional<AttestationRecord>
+    find(ChainDir dir, AttestationTable t, ripple::uint256 const& txnHash)
+        override
+    {
+        // Every value embedded is hex, never raw input
+        auto const sql = fmt::format(
+            R"sql(SELECT {columns} FROM {table_name} WHERE TransID = '{tx_hex}';
+            )sql",
+            fmt::arg("columns", AttestationRow::columns(t)),
+            fmt::arg("table_name", tableName(dir, t)),
+            fmt::arg("tx_hex", ripple::strHex(txnHash)));
+
+        auto session = checkoutRead();
+        AttestationRow row(*session);
+        soci::statement st = row.prepare(*session, sql);
+        st.execute();
+        if (!st.fetch())
+            return std::nullopt;
+        return row.record();
+    }
+
+    void
+    scan(
+        ChainDir dir,
+        AttestationTable t,
+        AttestationQuery const& q,
+        std::function<bool(AttestationRecord const&)> const& f) override
+    {
+        char const* const idCol = idColumn(t);
+
+        // Every value embedded below is a parsed integer or hex, never raw
+        // input
+        std::vector<std::string> where;
+        if (q.minID > 0)
+            where.push_back(fmt::format("{} >= {}", idCol, q.minID));
+        if (q.maxID < std::numeric_limits<std::uint64_t>::max())
+            where.push_back(fmt::format("{} <= {}", idCol, q.maxID));
+        if (q.minLedger)
+            where.push_back(fmt::format("LedgerSeq >= {}", *q.minLedger));
+        if (q.maxLedger)
+            where.push_back(fmt::format("LedgerSeq <= {}", *q.maxLedger));
+        if (q.success)
+            where.push_back(fmt::format("Success = {}", *q.success ? 1 : 0));
+        if (q.sendingAccount)
+            where.push_back(fmt::format(
+                "SendingAccount = X'{}'", ripple::strHex(*q.sendingAccount)));
+        if (q.after)
+            where.push_back(fmt::format(
+                "({}, TransID) > ({}, '{}')",
+                idCol,
+                q.after->first,
+                ripple::strHex(q.after->second)));
+
+        std::string whereClause;
+        for (auto const& w : where)
+        {
+            whereClause += whereClause.empty() ? "WHERE " : " AND ";
+            whereClause += w;
+        }
+
+        // Without a limit SQLite reads to the end of the matches even when
+        // `f` stops early
+        auto const limitClause =
+            q.limit ? fmt::format("LIMIT {}", *q.limit) : std::string{};
+
+        // With the (id, TransID) index a page can be read in order, rather
+        // than by sorting every match
+        auto const sql = fmt::format(
+            R"sql(SELECT {columns} FROM {table_name} {where}
+                  ORDER BY {id_col}, TransID {limit};
+            )sql",
+            fmt::arg("columns", AttestationRow::columns(t)),
+            fmt::arg("table_name", tableName(dir, t)),
+            fmt::arg("where", whereClause),
+            fmt::arg("id_col", idCol),
+            fmt::arg("limit", limitClause));
+
+        auto session = checkoutRead();
+        AttestationRow row(*session);
+        soci::statement st = row.prepare(*session, sql);
+        st.execute();
+        while (st.fetch())
+        {
+            if (!f(row.record()))
+                break;
+        }
+    }
+
+    void
+    erase(ChainDir dir, AttestationTable t, std::uint64_t id) override
+    {
+        auto const sql = fmt::format(
+            R"sql(DELETE FROM {table_name} WHERE {id_col} = :id;
+            )sql",
+            fmt::arg("table_name", tableName(dir, t)),
+            fmt::arg("id_col", idColumn(t)));
+        auto session = db_.checkoutDb();
+        *session << sql, soci::use(id);
+    }
+
+    std::optional<SyncState>
+    getSyncState(ChainType ct) override
+    {
+        auto const sql = fmt::format(
+            R"sql(SELECT TransID, LedgerSeq FROM {table_name}
+                  WHERE ChainType = :chain_type;
+            )sql",
+            fmt::arg("table_name", db_init::xChainSyncTable));
+
+        std::string transID;
+        std::uint32_t ledgerSeq = 0;
+        auto const chainType = static_cast<std::uint32_t>(ct);
+        auto session = checkoutRead();
+        *session << sql, soci::into(transID), soci::into(ledgerSeq),
+            soci::use(chainType);
+        if (!session->got_data())
+            return std::nullopt;
+
+        SyncState r;
+        if (!r.txnHash.parseHex(transID))
+            throw std::runtime_error(
+                "cannot parse transaction hash " + transID);
+        r.ledgerSeq = ledgerSeq;
+        return r;
+    }
+
+    void
+    setSyncState(ChainType ct, SyncState const& s) override
+    {
+        auto const sql = fmt::format(
+            R"sql(INSERT OR REPLACE INTO {table_name}
+                  (ChainType, TransID, LedgerSeq)
+                  VALUES
+                  (:ct, :txnId, :lgrSeq);
+            )sql",
+            fmt::arg("table_name", db_init::xChainSyncTable));
+        auto const chainType = static_cast<std::uint32_t>(ct);
+        auto const txnIdHex = ripple::strHex(s.txnHash);
+        auto session = db_.checkoutDb();
+        *session << sql, soci::use(chainType), soci::use(txnIdHex),
+            soci::use(s.ledgerSeq);
+    }
+
+    void
+    setSyncTxnHash(ChainType ct, ripple::uint256 const& txnHash) override
+    {
+        auto const sql = fmt::format(
+            R"sql(UPDATE {table_name} SET TransID = :tx_hash WHERE ChainType = :chain_type;
+            )sql",
+            fmt::arg("table_name", db_init::xChainSyncTable));
+        auto const chainType = static_cast<std::uint32_t>(ct);
+        auto const txnIdHex = ripple::strHex(txnHash);
+        auto session = db_.checkoutDb();
+        *session << sql, soci::use(txnIdHex), soci::use(chainType);
+    }
+
+    void
+    setSyncLedgerSeq(ChainType ct, std::uint32_t ledgerSeq) override
+    {
+        auto const sql = fmt::format(
+            R"sql(UPDATE {table_name} SET LedgerSeq = :ledger_sqn WHERE ChainType = :chain_type;
+            )sql",
+            fmt::arg("table_name", db_init::xChainSyncTable));
+        auto const chainType = static_cast<std::uint32_t>(ct);
+        auto session = db_.checkoutDb();
+        *session << sql, soci::use(ledgerSeq), soci::use(chainType);
+    }
+
+    void
+    putSubmission(SubmissionRecord const& r) override
+    {
+        auto const sql = fmt::format(
+            R"sql(INSERT OR REPLACE INTO {table_name}
+                  (ChainType, AccountSqn, LastLedgerSeq, RetriesAllowed,
+                   Batch, SignedTxn)
+                  VALUES
+                  (:ct, :sqn, :lgrSeq, :retries, :batch, :txn);
+            )sql",
+            fmt::arg("table_name", db_init::xChainSubmissionTable));
+        auto const chainType = static_cast<std::uint32_t>(r.chain);
+        int const retries = r.retriesAllowed;
+        auto session = db_.checkoutDb();
+        soci::blob batchBlob(*session);
+        convert(r.batch, batchBlob);
+        soci::blob txnBlob(*session);
+        convert(r.signedTxn, txnBlob);
+        *session << sql, soci::use(chainType), soci::use(r.accountSqn),
+            soci::use(r.lastLedgerSeq), soci::use(retries),
+            soci::use(batchBlob), soci::use(txnBlob);
+    }
+
+    void
+    eraseSubmission(ChainType ct, std::uint32_t accountSqn) override
+    {
+        auto const sql = fmt::format(
+            R"sql(DELETE FROM {table_name}
+                  WHERE ChainType = :ct AND AccountSqn = :sqn;
+            )sql",
+            fmt::arg("table_name", db_init::xChainSubmissionTable));
+        auto const chainType = static_cast<std::uint32_t>(ct);
+        auto session = db_.checkoutDb();
+        *session << sql, soci::use(chainType), soci::use(accountSqn);
+    }
+
+    std::vector<SubmissionRecord>
+    getSubmissions() override
+    {
+        auto const sql = fmt::format(
+            R"sql(SELECT ChainType, AccountSqn, LastLedgerSeq, RetriesAllowed,
+                         Batch, SignedTxn
+                  FROM {table_name} ORDER BY ChainType, AccountSqn;
+            )sql",
+            fmt::arg("table_name", db_init::xChainSubmissionTable));
+
+        std::vector<SubmissionRecord> r;
+        auto session = checkoutRead();
+        std::uint32_t chainType = 0;
+        std::uint32_t accountSqn = 0;
+        std::uint32_t lastLedgerSeq = 0;
+        int retries = 0;
+        soci::blob batchBlob(*session);
+        soci::blob txnBlob(*session);
+        soci::statement st =
+            (session->prepare << sql,
+             soci::into(chainType),
+             soci::into(accountSqn),
+             soci::into(lastLedgerSeq),
+             soci::into(retries),
+             soci::into(batchBlob),
+             soci::into(txnBlob));
+        st.execute();
+        while (st.fetch())
+        {
+            SubmissionRecord s;
+            s.chain = static_cast<ChainType>(chainType);
+            s.accountSqn = accountSqn;
+            s.lastLedgerSeq = lastLedgerSeq;
+            s.retriesAllowed = static_cast<std::uint8_t>(retries);
+            convert(batchBlob, s.batch);
+            convert(txnBlob, s.signedTxn);
+            r.push_back(std::move(s));
+        }
+        return r;
+    }
+
+    std::string
+    name() const override
+    {
+        return "sqlite";
+    }
+
+protected:
+    void
+    beginBatch() override
+    {
+        // Blocks while another thread has a batch open
+        auto session = db_.checkoutDb();
+        if (batchDepth_++ > 0)
+            return;
+        *session << "BEGIN TRANSACTION;";
+        batchOwner_ = std::this_thread::get_id();
+        batch_.emplace(std::move(session));
+    }
+
+    void
+    commitBatch() override
+    {
+        assert(batch_ && batchDepth_ > 0);
+        if (--batchDepth_ > 0)
+            return;
+        if (std::exchange(rollbackOnly_, false))
+        {
+            endBatch("ROLLBACK;");
+            throw std::runtime_error("sqlite batch rolled back");
+        }
+        try
+        {
+            **batch_ << "COMMIT;";
+        }
+        catch (std::exception const& e)
+        {
+            JLOGV(
+                j_.error(),
+                "error committing batch",
+                ripple::jv("what", e.what()));
+            endBatch("ROLLBACK;");
+            throw;
+        }
+        endBatch(nullptr);
+    }
+
+    void
+    rollbackBatch() override
+    {
+        assert(batch_ && batchDepth_ > 0);
+        if (--batchDepth_ > 0)
+        {
+            // Undone with the enclosing batch
+            rollbackOnly_ = true;
+            return;
+        }
+        rollbackOnly_ = false;
+        JLOG(j_.warn()) << "sqlite batch rolled back";
+        endBatch("ROLLBACK;");
+    }
+
+private:
+    // Run `sql`, if any, and release the writer session
+    void
+    endBatch(char const* sql) noexcept
+    {
+        if (sql)
+        {
+            try
+            {
+                **batch_ << sql;
+            }
+            catch (std::exception const& e)
+            {
+                JLOGV(
+                    j_.error(),
+                    "error ending batch",
+                    ripple::jv("sql", sql),
+                    ripple::jv("what", e.what()));
+            }
+        }
+        batchOwner_ = std::thread::id{};
+        batch_.reset();
+    }
+
+    // Readers do not see an open batch, so its owner reads from the writer
+    LockedSociSession
+    checkoutRead()
+    {
+        if (batchOwner_.load() == std::this_thread::get_id())
+            return db_.checkoutDb();
+        return db_.checkoutReadDb();
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<Storage>
+make_SQLiteStorage(DatabaseCon& db, beast::Journal j)
+{
+    return std::make_unique<SQLiteStorage>(db, j);
+}
+
+}  // namespace xbwd
@@ -117,6 +117,55 @@ getKBUsedDB(soci::session& s)
     return 0;  // Silence compiler warning.
 }
 
+SociBackup::SociBackup(soci::session& source, std::string const& destPath)
+{
+    using namespace sqlite_api;
+    if (sqlite3_open(destPath.c_str(), &dest_) != SQLITE_OK)
+    {
+        std::string const msg = dest_ ? sqlite3_errmsg(dest_) : "out of memory";
+        sqlite3_close(dest_);
+        throw std::runtime_error("can't open backup file: " + msg);
+    }
+    backup_ = sqlite3_backup_init(dest_, "main", getConnection(source), "main");
+    if (!backup_)
+    {
+        std::string const msg = sqlite3_errmsg(dest_);
+        sqlite3_close(dest_);
+        throw std::runtime_error("can't start backup: " + msg);
+    }
+}
+
+SociBackup::~SociBackup()
+{
+    sqlite_api::sqlite3_backup_finish(backup_);
+    sqlite_api::sqlite3_close(dest_);
+}
+
+bool
+SociBackup::step(int pages)
+{
+    auto const rc = sqlite_api::sqlite3_backup_step(backup_, pages);
+    if (rc == SQLITE_DONE)
+        return true;
+    // Busy and locked are transient, the step is retried on the next call
+    if (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED)
+        return false;
+    throw std::runtime_error(
+        std::string("backup failed: ") + sqlite_api::sqlite3_errstr(rc));
+}
+
+int
+SociBackup::remaining() const
+{
+    return sqlite_api::sqlite3_backup_remaining(backup_);
+}
+
+int
+SociBackup::pageCount() const
+{
+    return sqlite_api::sqlite3_backup_pagecount(backup_);
+}
+
 void
 convert(soci::blob& from, std::vector<std::uint8_t>& to)
 {
@@ -48,6 +48,7 @@
 
 namespace sqlite_api {
 struct sqlite3;
+struct sqlite3_backup;
 }
 
 namespace xbwd {
@@ -72,6 +73,37 @@ getKBUsedAll(soci::session& s);
 std::uint32_t
 getKBUsedDB(soci::session& s);
 
+/** Online copy of a sqlite database into a new file, a few pages at a time.
+
+    Writes made through the source session while the copy is in progress are
+    carried into the copy, so once complete it is a consistent image of the
+    database. The caller must hold the source session's lock for each step.
+*/
+class SociBackup
+{
+    sqlite_api::sqlite3* dest_ = nullptr;
+    sqlite_api::sqlite3_backup* backup_ = nullptr;
+
+public:
+    SociBackup(soci::session& source, std::string const& destPath);
+    ~SociBackup();
+
+    SociBackup(SociBackup const&) = delete;
+    SociBackup&
+    operator=(SociBackup const&) = delete;
+
+    // Copy up to `pages` more pages. Returns true once the copy is complete.
+    // Throws if the copy failed.
+    bool
+    step(int pages);
+
+    // Pages left to copy and the size of the source, as of the last step
+    int
+    remaining() const;
+    int
+    pageCount() const;
+};
+
 void
 convert(soci::blob& from, std::vector<std::uint8_t>& to);
 
@@ -0,0 +1,162 @@
+#include <xbwd/core/Storage.h>
+
+#include <ripple/basics/Slice.h>
+#include <ripple/basics/strHex.h>
+#include <ripple/protocol/SField.h>
+#include <ripple/protocol/jss.h>
+
+#include <fmt/core.h>
+
+namespace xbwd {
+
+namespace {
+
+// Flags for the optional members of an encoded record
+std::uint8_t constexpr hasDeliveredAmt = 0x01;
+std::uint8_t constexpr hasRewardAmt = 0x02;
+std::uint8_t constexpr hasOtherChainDst = 0x04;
+std::uint8_t constexpr hasSignature = 0x08;
+
+}  // namespace
+
+Json::Value
+AttestationRecord::toJson(AttestationTable t) const
+{
+    bool const isCreate = t == AttestationTable::createAccount;
+
+    Json::Value r{Json::objectValue};
+    r["tx_hash"] = to_string(txnHash);
+    r["ledger_index"] = ledgerSeq;
+    // 64 bit values are rendered as hex strings, as rippled does
+    r[isCreate ? "create_count" : "claim_id"] = fmt::format("{:X}", id);
+    r["success"] = success;
+    if (deliveredAmt)
+        r["delivered_amount"] =
+            deliveredAmt->getJson(ripple::JsonOptions::none);
+    if (rewardAmt)
+        r["reward_amount"] = rewardAmt->getJson(ripple::JsonOptions::none);
+    r["bridge"] = bridge.getJson(ripple::JsonOptions::none);
+    r["sending_account"] = ripple::toBase58(sendingAccount);
+    r["reward_account"] = ripple::toBase58(rewardAccount);
+    if (otherChainDst)
+        r["destination"] = ripple::toBase58(*otherChainDst);
+    r["public_key"] = ripple::strHex(publicKey);
+    if (signature)
+        r["signature"] = ripple::strHex(*signature);
+    return r;
+}
+
+void
+AttestationRecord::encodeValue(ripple::Serializer& s) const
+{
+    std::uint8_t flags = 0;
+    if (deliveredAmt)
+        flags |= hasDeliveredAmt;
+    if (rewardAmt)
+        flags |= hasRewardAmt;
+    if (otherChainDst)
+        flags |= hasOtherChainDst;
+    if (signature)
+        flags |= hasSignature;
+
+    s.add32(ledgerSeq);
+    s.add8(success ? 1 : 0);
+    s.add8(flags);
+    if (deliveredAmt)
+        deliveredAmt->add(s);
+    if (rewardAmt)
+        rewardAmt->add(s);
+    bridge.add(s);
+    s.addBitString(sendingAccount);
+    s.addBitString(rewardAccount);
+    if (otherChainDst)
+        s.addBitString(*otherChainDst);
+    s.addVL(publicKey.slice());
+    if (signature)
+        s.addVL(signature->data(), signature->size());
+}
+
+void
+AttestationRecord::decodeValue(ripple::SerialIter& sit)
+{
+    ledgerSeq = sit.get32();
+    success = sit.get8() != 0;
+    auto const flags = sit.get8();
+    deliveredAmt.reset();
+    if (flags & hasDeliveredAmt)
+        deliveredAmt.emplace(sit, ripple::sfAmount);
+    rewardAmt.reset();
+    if (flags & hasRewardAmt)
+        rewardAmt.emplace(sit, ripple::sfAmount);
+    bridge = ripple::STXChainBridge{sit, ripple::sfXChainBridge};
+    auto const getAccount = [&sit] {
+        auto const bits = sit.get160();
+        return ripple::AccountID::fromVoid(bits.data());
+    };
+    sendingAccount = getAccount();
+    rewardAccount = getAccount();
+    otherChainDst.reset();
+    if (flags & hasOtherChainDst)
+        otherChainDst = getAccount();
+    {
+        auto const pk = sit.getVL();
+        publicKey = ripple::PublicKey{ripple::makeSlice(pk)};
+    }
+    signature.reset();
+    if (flags & hasSignature)
+    {
+        auto const sig = sit.getVL();
+        signature.emplace(sig.data(), sig.size());
+    }
+}
+
+Json::Value
+SubmissionRecord::toJson() const
+{
+    Json::Value r{Json::objectValue};
+    r["chain_type"] = to_string(chain);
+    r["account_sequence"] = accountSqn;
+    r["last_ledger_sequence"] = lastLedgerSeq;
+    r["retries_allowed"] = retriesAllowed;
+    r["batch"] = ripple::strHex(batch);
+    r["tx_blob"] = ripple::strHex(signedTxn);
+    return r;
+}
+
+void
+SubmissionRecord::encodeValue(ripple::Serializer& s) const
+{
+    s.add32(lastLedgerSeq);
+    s.add8(retriesAllowed);
+    s.addVL(batch.data(), batch.size());
+    s.addVL(signedTxn.data(), signedTxn.size());
+}
+
+void
+SubmissionRecord::decodeValue(ripple::SerialIter& sit)
+{
+    lastLedgerSeq = sit.get32();
+    retriesAllowed = sit.get8();
+    batch = sit.getVL();
+    signedTxn = sit.getVL();
+}
+
+bool
+AttestationQuery::matches(AttestationRecord const& r) const
+{
+    if (r.id < minID || r.id > maxID)
+        return false;
+    if (minLedger && r.ledgerSeq < *minLedger)
+        return false;
+    if (maxLedger && r.ledgerSeq > *maxLedger)
+        return false;
+    if (success && r.success != *success)
+        return false;
+    if (sendingAccount && r.sendingAccount != *sendingAccount)
+        return false;
+    if (after && std::make_pair(r.id, r.txnHash) <= *after)
+        return false;
+    return true;
+}
+
+}  // namespace xbwd
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <xbwd/basics/ChainTypes.h>
+
+#include <ripple/basics/Blob.h>
+#include <ripple/basics/Buffer.h>
+#include <ripple/basics/base_uint.h>
+#include <ripple/beast/utility/Journal.h>
+#include <ripple/json/json_value.h>
+#include <ripple/protocol/AccountID.h>
+#include <ripple/protocol/PublicKey.h>
+#include <ripple/protocol/STAmount.h>
+#include <ripple/protocol/STXChainBridge.h>
+#include <ripple/protocol/Serializer.h>
+
+#include <boost/filesystem/path.hpp>
+
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace xbwd {
+
+class DatabaseCon;
+
+// The two kinds of attestations. Each has its own table per direction.
+enum class AttestationTable { claim, createAccount };
+
+/** A stored attestation: the commit transaction seen on the source chain and
+    the witness's signature over it.
+
+    Failed commits are stored too, without an amount or signature, so the
+    history scan does not pick them up again.
+*/
+struct AttestationRecord
+{
+    ripple::uint256 txnHash;
+    std::uint32_t ledgerSeq = 0;
+    // Claim id, or create count for create account attestations
+    std::uint64_t id = 0;
+    bool success = false;
+    std::optional<ripple::STAmount> deliveredAmt;
+    // Create account attestations only
+    std::optional<ripple::STAmount> rewardAmt;
+    ripple::STXChainBridge bridge;
+    ripple::AccountID sendingAccount;
+    ripple::AccountID rewardAccount;
+    std::optional<ripple::AccountID> otherChainDst;
+    ripple::PublicKey publicKey;
+    std::optional<ripple::Buffer> signature;
+
+    Json::Value
+    toJson(AttestationTable t) const;
+
+    // Binary form of everything but the txn hash and id, which backends keep
+    // in their keys
+    void
+    encodeValue(ripple::Serializer& s) const;
+
+    void
+    decodeValue(ripple::SerialIter& sit);
+};
+
+// Per chain progress of the history scan
+struct SyncState
+{
+    // Last commit transaction stored
+    ripple::uint256 txnHash;
+    // Last ledger a submitted attestation could be validated in
+    std::uint32_t ledgerSeq = 0;
+};
+
+/** An attestation batch transaction submitted to a chain whose result is not
+    known yet. Journaled so a restart can keep tracking it instead of
+    attesting its claims again.
+*/
+struct SubmissionRecord
+{
+    ChainType chain = ChainType::locking;
+    std::uint32_t accountSqn = 0;
+    std::uint32_t lastLedgerSeq = 0;
+    std::uint8_t retriesAllowed = 0;
+    // Serialized STXChainAttestationBatch
+    ripple::Blob batch;
+    // The signed transaction, as submitted
+    ripple::Blob signedTxn;
+
+    Json::Value
+    toJson() const;
+
+    // Binary form of everything but the chain and account sequence, which
+    // backends keep in their keys
+    void
+    encodeValue(ripple::Serializer& s) const;
+
+    void
+    decodeValue(ripple::SerialIter& sit);
+};
+
+// Filters of a range scan. Unset members match everything.
+struct AttestationQuery
+{
+    std::uint64_t minID = 0;
+    std::uint64_t maxID = std::numeric_limits<std::uint64_t>::max();
+    std::optional<std::uint32_t> minLedger;
+    std::optional<std::uint32_t> maxLedger;
+    std::optional<bool> success;
+    std::optional<ripple::AccountID> sendingAccount;
+    // Resume after this (id, txn hash) position
+    std::optional<std::pair<std::uint64_t, ripple::uint256>> after;
+    // Pass at most this many to the scan's callback
+    std::optional<std::uint32_t> limit;
+
+    bool
+    matches(AttestationRecord const& r) const;
+};
+
+/** Persistent store of attestations, sync state and in flight submissions.
+
+    Attestations are keyed by transaction hash and ordered by
+    (id, transaction hash). One writer at a time is assumed for each key, but
+    reads may run on any thread concurrently with writes.
+*/
+class Storage
+{
+public:
+    virtual ~Storage() = default;
+
+    // Store `r` unless an attestation for its transaction is already stored.
+    // Return false if one was.
+    virtual bool
+    insert(ChainDir dir, AttestationTable t, AttestationRecord const& r) = 0;
+
+    virtual std::optional<AttestationRecord>
+    find(ChainDir dir, AttestationTable t, ripple::uint256 const& txnHash) = 0;
+
+    // Call `f` for each matching attestation in (id, txn hash) order until it
+    // returns false
+    virtual void
+    scan(
+        ChainDir dir,
+        AttestationTable t,
+        AttestationQuery const& q,
+        std::function<bool(AttestationRecord const&)> const& f) = 0;
+
+    // Remove every attestation with this id
+    virtual void
+    erase(ChainDir dir, AttestationTable t, std::uint64_t id) = 0;
+
+    // nullopt if the sync state was never written
+    virtual std::optional<SyncState>
+    getSyncState(ChainType ct) = 0;
+
+    virtual void
+    setSyncState(ChainType ct, SyncState const& s) = 0;
+
+    virtual void
+    setSyncTxnHash(ChainType ct, ripple::uint256 const& txnHash) = 0;
+
+    virtual void
+    setSyncLedgerSeq(ChainType ct, std::uint32_t ledgerSeq) = 0;
+
+    // Journal a submission, replacing one with the same chain and account
+    // sequence
+    virtual void
+    putSubmission(SubmissionRecord const& r) = 0;
+
+    virtual void
+    eraseSubmission(ChainType ct, std::uint32_t accountSqn) = 0;
+
+    // Every journaled submission, by chain then account sequence
+    virtual std::vector<SubmissionRecord>
+    getSubmissions() = 0;
+
+    /** Writes made by this thread while a Batch is alive are committed
+        together when it is destroyed. Writes from other threads wait.
+
+        A failed commit throws from the destructor. If the scope is left by
+        an exception the writes are rolled back instead, along with those
+        of any enclosing batch.
+    */
+    class Batch
+    {
+        Storage& storage_;
+        int const uncaught_ = std::uncaught_exceptions();
+
+    public:
+        explicit Batch(Storage& storage) : storage_(storage)
+        {
+            storage_.beginBatch();
+        }
+        ~Batch() noexcept(false)
+        {
+            if (std::uncaught_exceptions() > uncaught_)
+                storage_.rollbackBatch();
+            else
+                storage_.commitBatch();
+        }
+        Batch(Batch const&) = delete;
+        Batch&
+        operator=(Batch const&) = delete;
+    };
+
+    virtual std::string
+    name() const = 0;
+
+protected:
+    virtual void
+    beginBatch() = 0;
+
+    // Throws if the writes could not be committed, or if a nested batch
+    // was rolled back. The batch is closed either way.
+    virtual void
+    commitBatch() = 0;
+
+    // Must not throw: it runs while an exception unwinds
+    virtual void
+    rollbackBatch() = 0;
+};
+
+// Attestations in the SQLite tables of `db`
+std::unique_ptr<Storage>
+make_SQLiteStorage(DatabaseCon& db, beast::Journal j);
+
+// Attestations in an LMDB environment in `dir`, which may grow to `mapSize`
+// bytes
+std::unique_ptr<Storage>
+make_LMDBStorage(
+    boost::filesystem::path const& dir,
+    std::size_t mapSize,
+    beast::Journal j);
+
+// Attestations in an append only log of memory mapped segment files of
+// `segmentSize` bytes in `dir`
+std::unique_ptr<Storage>
+make_LogStorage(
+    boost::filesystem::path const& dir,
+    std::size_t segmentSize,
+    beast::Journal j);
+
+}  // namespace xbwd
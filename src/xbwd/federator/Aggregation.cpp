@@ -0,0 +1,425 @@
+#include <xbwd/federator/Aggregation.h>
+
+#include <xbwd/client/WebsocketClient.h>
+#include <xbwd/rpc/fromJSON.h>
+
+#include <ripple/basics/Log.h>
+#include <ripple/basics/strHex.h>
+#include <ripple/protocol/SField.h>
+#include <ripple/protocol/TER.h>
+
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <optional>
+
+namespace xbwd {
+
+namespace {
+
+// Bounds on what peers can make a witness keep
+std::size_t constexpr maxReceived = 16 * 1024;
+std::size_t constexpr maxPending = 1024;
+
+// A batch as published by a peer, serialized like the submission journal
+std::optional<ripple::STXChainAttestationBatch>
+batchFromHex(Json::Value const& jv)
+{
+    if (!jv.isString())
+        return std::nullopt;
+    auto const blob = ripple::strUnHex(jv.asString());
+    if (!blob)
+        return std::nullopt;
+    ripple::SerialIter sit(ripple::makeSlice(*blob));
+    return ripple::STXChainAttestationBatch{
+        sit, ripple::sfXChainAttestationBatch};
+}
+
+// Erase the attestations signed with `pk` that `id` matches
+template <class T, class F>
+void
+eraseIds(std::vector<T>& atts, ripple::PublicKey const& pk, F const& id)
+{
+    atts.erase(
+        std::remove_if(
+            atts.begin(),
+            atts.end(),
+            [&](T const& att) { return att.publicKey == pk && id(att); }),
+        atts.end());
+}
+
+}  // namespace
+
+Aggregation::Aggregation(
+    config::AggregationConfig const& config,
+    ripple::STXChainBridge const& bridge,
+    ripple::PublicKey const& signingPK,
+    boost::asio::io_service& ios,
+    beast::Journal j)
+    : config_(config)
+    , bridge_(bridge)
+    , signingPK_(signingPK)
+    , ios_(ios)
+    , j_(j)
+{
+}
+
+void
+Aggregation::start()
+{
+    JLOGV(
+        j_.info(),
+        "aggregation starting",
+        ripple::jv("position", config_.position),
+        ripple::jv("peers", config_.peers.size()));
+    for (std::size_t i = 0; i < config_.peers.size(); ++i)
+    {
+        auto peer = std::make_shared<WebsocketClient>(
+            [this, i](Json::Value const& msg) { onPeerMessage(i, msg); },
+            [this, i]() { onPeerConnect(i); },
+            ios_,
+            config_.peers[i].endpoint,
+            /*headers*/ std::unordered_map<std::string, std::string>{},
+            j_);
+        peers_.push_back(peer);
+        peer->connect();
+    }
+}
+
+void
+Aggregation::stop()
+{
+    for (auto const& peer : peers_)
+        peer->shutdown();
+}
+
+std::uint32_t
+Aggregation::turnOf(std::uint32_t ledgerSeq) const
+{
+    return ledgerSeq / config_.turnLedgers;
+}
+
+bool
+Aggregation::mine(std::uint32_t turn) const
+{
+    auto const witnesses = config_.peers.size() + 1;
+    return turn % witnesses == config_.position;
+}
+
+bool
+Aggregation::aggregating(ChainType, std::uint32_t ledgerSeq) const
+{
+    return mine(turnOf(ledgerSeq));
+}
+
+void
+Aggregation::hold(ChainType ct, Attestations atts, std::uint32_t ledgerSeq)
+{
+    std::lock_guard l{mutex_};
+    heldCount_ += atts.claims.size() + atts.creates.size();
+    auto const deadline = ledgerSeq + config_.fallbackLedgers;
+    held_[ct].push_back({std::move(atts), deadline});
+}
+
+Aggregation::Due
+Aggregation::onLedger(ChainType ct, std::uint32_t ledgerSeq)
+{
+    Due due;
+    std::lock_guard l{mutex_};
+    due.landedClaims = std::move(landed_[ct].claims);
+    due.landedCreates = std::move(landed_[ct].creates);
+    landed_[ct] = {};
+
+    // Held in ledger order, so the expired ones are in front
+    auto& held = held_[ct];
+    while (!held.empty() && held.front().deadline <= ledgerSeq)
+    {
+        auto& atts = held.front().atts;
+        expiredCount_ += atts.claims.size() + atts.creates.size();
+        std::move(
+            atts.claims.begin(),
+            atts.claims.end(),
+            std::back_inserter(due.expired.claims));
+        std::move(
+            atts.creates.begin(),
+            atts.creates.end(),
+            std::back_inserter(due.expired.creates));
+        held.pop_front();
+    }
+
+    // Those sent in this witness's turns are submitted from the start of the
+    // turn to the first ledger after it, so late ones are not lost. Those of
+    // the other aggregators are dropped once their turn is over.
+    ledgerSeqs_[ct] = ledgerSeq;
+    auto const current = turnOf(ledgerSeq);
+    auto& received = received_[ct];
+    for (auto it = received.begin();
+         it != received.end() && it->first <= current;)
+    {
+        if (mine(it->first))
+        {
+            auto& atts = it->second;
+            aggregatedCount_ += atts.size();
+            std::move(
+                atts.claims.begin(),
+                atts.claims.end(),
+                std::back_inserter(due.received.claims));
+            std::move(
+                atts.creates.begin(),
+                atts.creates.end(),
+                std::back_inserter(due.received.creates));
+        }
+        else if (it->first == current)
+        {
+            ++it;
+            continue;
+        }
+        it = received.erase(it);
+    }
+    return due;
+}
+
+void
+Aggregation::setSigners(
+    ChainType ct,
+    std::unordered_set<ripple::AccountID> signers)
+{
+    std::lock_guard l{mutex_};
+    signers_[ct] = std::move(signers);
+}
+
+void
+Aggregation::onPeerConnect(std::size_t peer)
+{
+    // Called with the client's locks held, so the subscription is sent from
+    // another handler
+    boost::asio::post(ios_, [weak = weak_from_this(), peer] {
+        if (auto self = weak.lock())
+            self->subscribe(peer);
+    });
+}
+
+void
+Aggregation::subscribe(std::size_t peer)
+{
+    Json::Value params{Json::objectValue};
+    params["streams"] = Json::arrayValue;
+    for (auto const s : {"attestations", "submissions", "results"})
+        params["streams"].append(s);
+    if (auto const& auth = config_.peers[peer].auth)
+    {
+        params["Username"] = auth->user;
+        params["Password"] = auth->password;
+    }
+    peers_[peer]->send("subscribe", params);
+}
+
+void
+Aggregation::onPeerMessage(std::size_t peer, Json::Value const& msg)
+{
+    try
+    {
+        // Replies to the subscription have no type
+        auto const type = msg["type"].asString();
+        if (type != "attestation" && type != "submission" && type != "result")
+            return;
+        auto const ct = rpc::fromJson<ChainType>(msg, "chain_type");
+
+        if (type == "result")
+        {
+            if (!msg["engine_result_code"].isIntegral())
+                throw std::runtime_error("missing engine_result_code");
+            auto const ter =
+                ripple::TER::fromInt(msg["engine_result_code"].asInt());
+            std::lock_guard l{mutex_};
+            onResult(
+                peer,
+                ct,
+                rpc::fromJson<std::uint32_t>(msg, "account_sequence"),
+                ripple::isTesSuccess(ter));
+            return;
+        }
+
+        auto const batch = batchFromHex(msg["batch"]);
+        if (!batch)
+            throw std::runtime_error("missing batch");
+        std::lock_guard l{mutex_};
+        if (type == "attestation")
+        {
+            // The turn on the destination chain the peer sent it in. Older
+            // peers do not say, so it is taken to be the current one.
+            auto const ledgerSeq = msg.isMember("destination_ledger_index")
+                ? rpc::fromJson<std::uint32_t>(msg, "destination_ledger_index")
+                : ledgerSeqs_[ct];
+            onAttestation(ct, turnOf(ledgerSeq), *batch);
+        }
+        else
+            onSubmission(
+                peer,
+                ct,
+                rpc::fromJson<std::uint32_t>(msg, "account_sequence"),
+                *batch);
+    }
+    catch (std::exception const& e)
+    {
+        JLOGV(
+            j_.warn(),
+            "bad message from aggregation peer",
+            ripple::jv("peer", to_string(config_.peers[peer].endpoint)),
+            ripple::jv("what", e.what()));
+    }
+}
+
+void
+Aggregation::onAttestation(
+    ChainType ct,
+    std::uint32_t turn,
+    ripple::STXChainAttestationBatch const& batch)
+{
+    // Our own come back from peers that subscribed to us too
+    auto const ours = [&](auto const& att) {
+        return att.publicKey == signingPK_;
+    };
+    std::size_t size = 0;
+    for (auto const& r : received_[ct])
+        size += r.second.size();
+    auto& received = received_[ct][turn];
+    auto const full = [&] { return size >= maxReceived; };
+    // Rejected until the signer list of the destination door is known
+    auto const& signers = signers_[ct];
+    auto const valid = [&](auto const& att) {
+        return signers &&
+            signers->contains(ripple::calcAccountID(att.publicKey)) &&
+            att.verify(bridge_);
+    };
+    for (auto const& att : batch.claims())
+    {
+        if (ours(att))
+            continue;
+        if (full() || !valid(att))
+        {
+            ++rejectedCount_;
+            continue;
+        }
+        ++receivedCount_;
+        ++size;
+        received.claims.push_back(att);
+    }
+    for (auto const& att : batch.creates())
+    {
+        if (ours(att))
+            continue;
+        if (full() || !valid(att))
+        {
+            ++rejectedCount_;
+            continue;
+        }
+        ++receivedCount_;
+        ++size;
+        received.creates.push_back(att);
+    }
+}
+
+void
+Aggregation::onSubmission(
+    std::size_t peer,
+    ChainType ct,
+    std::uint32_t accountSqn,
+    ripple::STXChainAttestationBatch const& batch)
+{
+    Ids ids;
+    for (auto const& att : batch.claims())
+        if (att.publicKey == signingPK_)
+            ids.claims.push_back(att.claimID);
+    for (auto const& att : batch.creates())
+        if (att.publicKey == signingPK_)
+            ids.creates.push_back(att.createCount);
+    if (ids.claims.empty() && ids.creates.empty())
+        return;
+
+    auto& pending = pending_[ct];
+    // Submissions that never get a result, such as malformed ones
+    if (pending.size() >= maxPending)
+        pending.erase(pending.begin());
+    pending[{peer, accountSqn}] = std::move(ids);
+}
+
+void
+Aggregation::onResult(
+    std::size_t peer,
+    ChainType ct,
+    std::uint32_t accountSqn,
+    bool success)
+{
+    auto& pending = pending_[ct];
+    auto const it = pending.find({peer, accountSqn});
+    if (it == pending.end())
+        return;
+    auto const ids = std::move(it->second);
+    pending.erase(it);
+    if (!success)
+        return;
+
+    auto const in = [](std::vector<std::uint64_t> const& v, std::uint64_t id) {
+        return std::find(v.begin(), v.end(), id) != v.end();
+    };
+    auto& held = held_[ct];
+    for (auto& h : held)
+    {
+        eraseIds(h.atts.claims, signingPK_, [&](auto const& att) {
+            return in(ids.claims, att.claimID);
+        });
+        eraseIds(h.atts.creates, signingPK_, [&](auto const& att) {
+            return in(ids.creates, att.createCount);
+        });
+    }
+    held.erase(
+        std::remove_if(
+            held.begin(),
+            held.end(),
+            [](Held const& h) { return h.atts.empty(); }),
+        held.end());
+
+    auto& landed = landed_[ct];
+    landed.claims.insert(
+        landed.claims.end(), ids.claims.begin(), ids.claims.end());
+    landed.creates.insert(
+        landed.creates.end(), ids.creates.begin(), ids.creates.end());
+    landedCount_ += ids.claims.size() + ids.creates.size();
+}
+
+Json::Value
+Aggregation::getInfo() const
+{
+    Json::Value r{Json::objectValue};
+    r["position"] = config_.position;
+    r["witnesses"] = static_cast<Json::UInt>(config_.peers.size() + 1);
+    r["turn_ledgers"] = config_.turnLedgers;
+
+    std::lock_guard l{mutex_};
+    for (auto const ct : {ChainType::locking, ChainType::issuing})
+    {
+        std::size_t held = 0;
+        for (auto const& h : held_[ct])
+            held += h.atts.claims.size() + h.atts.creates.size();
+        Json::Value side{Json::objectValue};
+        side["held"] = static_cast<Json::UInt>(held);
+        std::size_t received = 0;
+        for (auto const& r : received_[ct])
+            received += r.second.size();
+        side["received"] = static_cast<Json::UInt>(received);
+        side["pending_submissions"] =
+            static_cast<Json::UInt>(pending_[ct].size());
+        r[to_string(ct)] = std::move(side);
+    }
+    r["received"] = static_cast<Json::UInt>(receivedCount_);
+    r["rejected"] = static_cast<Json::UInt>(rejectedCount_);
+    r["aggregated"] = static_cast<Json::UInt>(aggregatedCount_);
+    r["held_back"] = static_cast<Json::UInt>(heldCount_);
+    r["landed_by_peers"] = static_cast<Json::UInt>(landedCount_);
+    r["submitted_after_fallback"] = static_cast<Json::UInt>(expiredCount_);
+    return r;
+}
+
+}  // namespace xbwd
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <xbwd/app/Config.h>
+#include <xbwd/basics/ChainTypes.h>
+#include <xbwd/basics/ThreadSaftyAnalysis.h>
+
+#include <ripple/beast/utility/Journal.h>
+#include <ripple/json/json_value.h>
+#include <ripple/protocol/AccountID.h>
+#include <ripple/protocol/PublicKey.h>
+#include <ripple/protocol/STXChainAttestationBatch.h>
+#include <ripple/protocol/STXChainBridge.h>
+
+#include <boost/asio/io_service.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace xbwd {
+
+class WebsocketClient;
+
+/** Submission of several witnesses' attestations in one transaction.
+
+    Each witness subscribes to the attestations, submissions and results
+    streams of its peers. Turns rotate every `turnLedgers` ledgers of the
+    destination chain, in the order of the configured positions. The witness
+    whose turn it is adds the attestations it receives to its own batches.
+    The others hold theirs back until they are seen in a successful
+    submission of a peer, or for `fallbackLedgers` ledgers, after which they
+    submit them themselves. An aggregator that is down delays attestations,
+    but does not lose them.
+
+    Attestations received are checked against their signature and the
+    signer list of the destination door account, so a peer can not get
+    anything submitted that a witness of the bridge did not sign. They are
+    kept by the turn they were sent in, and an aggregator submits them even
+    if they arrive after its turn ended.
+*/
+class Aggregation : public std::enable_shared_from_this<Aggregation>
+{
+public:
+    struct Attestations
+    {
+        std::vector<ripple::AttestationBatch::AttestationClaim> claims;
+        std::vector<ripple::AttestationBatch::AttestationCreateAccount>
+            creates;
+
+        bool
+        empty() const
+        {
+            return claims.empty() && creates.empty();
+        }
+
+        std::size_t
+        size() const
+        {
+            return claims.size() + creates.size();
+        }
+    };
+
+    // Work for the federator as of a new ledger
+    struct Due
+    {
+        // Received from peers, for this witness to submit as the aggregator
+        Attestations received;
+        // Held back past the fallback, for this witness to submit
+        Attestations expired;
+        // Ids of this witness's attestations that a peer landed
+        std::vector<std::uint64_t> landedClaims;
+        std::vector<std::uint64_t> landedCreates;
+    };
+
+    Aggregation(
+        config::AggregationConfig const& config,
+        ripple::STXChainBridge const& bridge,
+        ripple::PublicKey const& signingPK,
+        boost::asio::io_service& ios,
+        beast::Journal j);
+
+    void
+    start();
+
+    void
+    stop();
+
+    // True if this witness submits the attestations for `ct` as of
+    // `ledgerSeq`
+    bool
+    aggregating(ChainType ct, std::uint32_t ledgerSeq) const;
+
+    // Hold this witness's attestations for `ct` back for the aggregator
+    void
+    hold(ChainType ct, Attestations atts, std::uint32_t ledgerSeq)
+        EXCLUDES(mutex_);
+
+    Due
+    onLedger(ChainType ct, std::uint32_t ledgerSeq) EXCLUDES(mutex_);
+
+    // Accounts in the signer list of the door account on `ct`
+    void
+    setSigners(ChainType ct, std::unordered_set<ripple::AccountID> signers)
+        EXCLUDES(mutex_);
+
+    Json::Value
+    getInfo() const EXCLUDES(mutex_);
+
+private:
+    struct Held
+    {
+        Attestations atts;
+        // Submitted by this witness once this ledger is reached
+        std::uint32_t deadline;
+    };
+
+    // Ids of this witness's attestations in a peer's submission
+    struct Ids
+    {
+        std::vector<std::uint64_t> claims;
+        std::vector<std::uint64_t> creates;
+    };
+
+    void
+    onPeerConnect(std::size_t peer);
+
+    void
+    onPeerMessage(std::size_t peer, Json::Value const& msg) EXCLUDES(mutex_);
+
+    void
+    subscribe(std::size_t peer);
+
+    std::uint32_t
+    turnOf(std::uint32_t ledgerSeq) const;
+
+    bool
+    mine(std::uint32_t turn) const;
+
+    void
+    onAttestation(
+        ChainType ct,
+        std::uint32_t turn,
+        ripple::STXChainAttestationBatch const& batch) REQUIRES(mutex_);
+
+    void
+    onSubmission(
+        std::size_t peer,
+        ChainType ct,
+        std::uint32_t accountSqn,
+        ripple::STXChainAttestationBatch const& batch) REQUIRES(mutex_);
+
+    void
+    onResult(
+        std::size_t peer,
+        ChainType ct,
+        std::uint32_t accountSqn,
+        bool success) REQUIRES(mutex_);
+
+    config::AggregationConfig const config_;
+    ripple::STXChainBridge const bridge_;
+    ripple::PublicKey const signingPK_;
+    boost::asio::io_service& ios_;
+    beast::Journal j_;
+
+    std::vector<std::shared_ptr<WebsocketClient>> peers_;
+
+    mutable std::mutex mutex_;
+    // Keyed by the turn they were sent in
+    ChainArray<std::map<std::uint32_t, Attestations>> GUARDED_BY(mutex_)
+        received_;
+    // Last ledger seen, for attestations that do not say their turn
+    ChainArray<std::uint32_t> GUARDED_BY(mutex_) ledgerSeqs_{0u, 0u};
+    ChainArray<std::optional<std::unordered_set<ripple::AccountID>>>
+        GUARDED_BY(mutex_) signers_;
+    ChainArray<std::deque<Held>> GUARDED_BY(mutex_) held_;
+    // Keyed by peer and account sequence, until the result is seen
+    ChainArray<std::map<std::pair<std::size_t, std::uint32_t>, Ids>>
+        GUARDED_BY(mutex_) pending_;
+    ChainArray<Ids> GUARDED_BY(mutex_) landed_;
+
+    // Counted in attestations
+    std::uint64_t GUARDED_BY(mutex_) receivedCount_ = 0;
+    std::uint64_t GUARDED_BY(mutex_) rejectedCount_ = 0;
+    std::uint64_t GUARDED_BY(mutex_) aggregatedCount_ = 0;
+    std::uint64_t GUARDED_BY(mutex_) heldCount_ = 0;
+    std::uint64_t GUARDED_BY(mutex_) landedCount_ = 0;
+    std::uint64_t GUARDED_BY(mutex_) expiredCount_ = 0;
+};
+
+}  // namespace xbwd
@@ -0,0 +1,462 @@
+#include <xbwd/federator/BulkAttest.h>
+
+#include <xbwd/client/ChainListener.h>
+#include <xbwd/client/RpcResultParse.h>
+#include <xbwd/core/Storage.h>
+
+#include <ripple/basics/Log.h>
+#include <ripple/protocol/AccountID.h>
+#include <ripple/protocol/jss.h>
+
+#include <algorithm>
+#include <string_view>
+
+namespace xbwd {
+
+BulkAttest::BulkAttest(
+    std::uint32_t id,
+    Params params,
+    std::shared_ptr<ChainListener> listener,
+    ripple::STXChainBridge const& bridge,
+    Storage& storage,
+    beast::Journal j)
+    : id_(id)
+    , params_(std::move(params))
+    , listener_(std::move(listener))
+    , bridge_(bridge)
+    , storage_(storage)
+    , j_(j)
+    , ledgers_(params_.ledgers)
+{
+}
+
+void
+BulkAttest::start()
+{
+    {
+        std::lock_guard l{mutex_};
+        started_ = std::chrono::steady_clock::now();
+        finished_ = started_;
+    }
+    if (params_.ledgers && (params_.fromTx || params_.onStart))
+    {
+        {
+            // The preparation counts as a worker until it launches the others
+            std::lock_guard l{mutex_};
+            workers_ = 1;
+        }
+        listener_->spawn(
+            [self = shared_from_this()] { return self->prepare(); });
+        return;
+    }
+    launch();
+}
+
+void
+BulkAttest::launch()
+{
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> parts;
+    std::uint32_t workers = 0;
+    {
+        std::lock_guard l{mutex_};
+        if (ledgers_)
+        {
+            // Contiguous parts, paged through in parallel
+            auto const [first, last] = *ledgers_;
+            std::uint64_t const count = std::uint64_t{last} - first + 1;
+            workers = static_cast<std::uint32_t>(
+                std::min<std::uint64_t>(params_.concurrency, count));
+            for (std::uint32_t w = 0; w < workers; ++w)
+                parts.emplace_back(
+                    first + count * w / workers,
+                    first + count * (w + 1) / workers - 1);
+        }
+        else
+        {
+            workers = static_cast<std::uint32_t>(std::min<std::size_t>(
+                params_.concurrency, params_.hashes.size()));
+        }
+        workers_ = workers;
+    }
+    JLOGV(
+        j_.info(),
+        "bulk attest started",
+        ripple::jv("job", id_),
+        ripple::jv("chain", to_string(params_.chain)),
+        ripple::jv("hashes", params_.hashes.size()),
+        ripple::jv("workers", workers));
+
+    for (std::uint32_t w = 0; w < workers; ++w)
+    {
+        if (params_.ledgers)
+            listener_->spawn([self = shared_from_this(), part = parts[w]] {
+                return self->rangeWorker(part.first, part.second);
+            });
+        else
+            listener_->spawn(
+                [self = shared_from_this()] { return self->hashWorker(); });
+    }
+}
+
+boost::asio::awaitable<void>
+BulkAttest::prepare()
+{
+    try
+    {
+        auto [first, last] = *params_.ledgers;
+        if (params_.fromTx)
+        {
+            Json::Value request;
+            request[ripple::jss::transaction] = to_string(*params_.fromTx);
+            auto const reply = co_await listener_->request("tx", request);
+            auto const& result = reply[ripple::jss::result];
+            if (result.isMember(ripple::jss::error))
+                throw std::runtime_error(
+                    result[ripple::jss::error].asString());
+            if (!result[ripple::jss::validated].asBool())
+                throw std::runtime_error("transaction not validated");
+            first = result[ripple::jss::ledger_index].asUInt();
+            if (first > last)
+                throw std::runtime_error("transaction past the range");
+            std::lock_guard l{mutex_};
+            ledgers_->first = first;
+        }
+
+        if (params_.onStart)
+            params_.onStart(co_await lastCommitBefore(first));
+        if (!cancelled_)
+        {
+            launch();
+            co_return;
+        }
+    }
+    catch (std::exception const& e)
+    {
+        JLOGV(
+            j_.warn(),
+            "bulk attest start failed",
+            ripple::jv("job", id_),
+            ripple::jv("what", e.what()));
+        record(
+            params_.fromTx.value_or(ripple::uint256{}),
+            "failed",
+            std::string("start: ") + e.what());
+    }
+    workerDone();
+}
+
+boost::asio::awaitable<ripple::uint256>
+BulkAttest::lastCommitBefore(std::uint32_t ledger)
+{
+    // Pages searched back, so an old start does not read the whole history
+    static constexpr int maxPages = 10;
+
+    if (ledger <= 1)
+        co_return ripple::uint256{};
+
+    Json::Value params;
+    params[ripple::jss::account] = ripple::toBase58(
+        params_.chain == ChainType::locking ? bridge_.lockingChainDoor()
+                                            : bridge_.issuingChainDoor());
+    params[ripple::jss::ledger_index_min] = -1;
+    params[ripple::jss::ledger_index_max] = ledger - 1;
+    params[ripple::jss::forward] = false;
+    params[ripple::jss::limit] = 200;
+
+    for (int page = 0; page < maxPages && !cancelled_; ++page)
+    {
+        auto const reply = co_await listener_->request("account_tx", params);
+        auto const& result = reply[ripple::jss::result];
+        if (!result[ripple::jss::transactions].isArray())
+            throw std::runtime_error("bad account_tx reply");
+
+        for (auto const& entry : result[ripple::jss::transactions])
+        {
+            auto const& tx = entry[ripple::jss::tx];
+            if (!isCommit(tx))
+                continue;
+            if (auto const hash = rpcResultParse::parseTxHash(tx))
+                co_return *hash;
+        }
+
+        if (!result.isMember(ripple::jss::marker))
+            break;
+        params[ripple::jss::marker] = result[ripple::jss::marker];
+    }
+    co_return ripple::uint256{};
+}
+
+void
+BulkAttest::cancel()
+{
+    cancelled_ = true;
+}
+
+bool
+BulkAttest::running() const
+{
+    std::lock_guard l{mutex_};
+    return workers_ != 0;
+}
+
+bool
+BulkAttest::attested(ripple::uint256 const& hash, bool isCreateAccount)
+{
+    auto const dir = params_.chain == ChainType::locking
+        ? ChainDir::lockingToIssuing
+        : ChainDir::issuingToLocking;
+    return storage_
+        .find(
+            dir,
+            isCreateAccount ? AttestationTable::createAccount
+                            : AttestationTable::claim,
+            hash)
+        .has_value();
+}
+
+bool
+BulkAttest::isCommit(Json::Value const& tx) const
+{
+    auto const type = rpcResultParse::parseXChainTxnType(tx);
+    return (type == XChainTxnType::xChainCommit ||
+            type == XChainTxnType::xChainCreateAccount) &&
+        rpcResultParse::parseBridge(tx) == bridge_;
+}
+
+char const*
+BulkAttest::classify(
+    Json::Value const& tx,
+    Json::Value const& meta,
+    bool validated)
+{
+    if (!isCommit(tx))
+        return nullptr;
+
+    if (!validated)
+        return "not_validated";
+    // Failed commits are not attested out of order, as with attest_tx
+    if (!meta.isMember("TransactionResult") ||
+        meta["TransactionResult"].asString() != "tesSUCCESS")
+        return "not_successful";
+    auto const hash = rpcResultParse::parseTxHash(tx);
+    if (!hash)
+        return "malformed";
+    auto const type = rpcResultParse::parseXChainTxnType(tx);
+    if (attested(*hash, type == XChainTxnType::xChainCreateAccount))
+        return "already_attested";
+    return "attesting";
+}
+
+boost::asio::awaitable<void>
+BulkAttest::hashWorker()
+{
+    for (;;)
+    {
+        std::size_t i = 0;
+        {
+            std::lock_guard l{mutex_};
+            if (cancelled_ || next_ == params_.hashes.size())
+                break;
+            i = next_++;
+        }
+        auto const& hash = params_.hashes[i];
+
+        // Either table, to save the round trip
+        if (attested(hash, false) || attested(hash, true))
+        {
+            record(hash, "already_attested");
+            continue;
+        }
+
+        try
+        {
+            Json::Value request;
+            request[ripple::jss::transaction] = to_string(hash);
+            auto const reply = co_await listener_->request("tx", request);
+            auto const& result = reply[ripple::jss::result];
+            if (result.isMember(ripple::jss::error))
+            {
+                auto const error = result[ripple::jss::error].asString();
+                if (error == "txnNotFound")
+                    record(hash, "not_found");
+                else
+                    record(hash, "failed", error);
+                continue;
+            }
+
+            auto const status = classify(
+                result,
+                result[ripple::jss::meta],
+                result[ripple::jss::validated].asBool());
+            if (!status)
+            {
+                record(hash, "not_a_commit");
+                continue;
+            }
+            if (status == std::string_view{"attesting"})
+                listener_->processTx(reply);
+            record(hash, status);
+        }
+        catch (std::exception const& e)
+        {
+            record(hash, "failed", e.what());
+        }
+    }
+    workerDone();
+}
+
+boost::asio::awaitable<void>
+BulkAttest::rangeWorker(std::uint32_t first, std::uint32_t last)
+{
+    Json::Value params;
+    params[ripple::jss::account] = ripple::toBase58(
+        params_.chain == ChainType::locking ? bridge_.lockingChainDoor()
+                                            : bridge_.issuingChainDoor());
+    params[ripple::jss::ledger_index_min] = first;
+    params[ripple::jss::ledger_index_max] = last;
+    params[ripple::jss::forward] = true;
+    params[ripple::jss::limit] = 200;
+
+    try
+    {
+        while (!cancelled_)
+        {
+            auto const reply =
+                co_await listener_->request("account_tx", params);
+            auto const& result = reply[ripple::jss::result];
+            if (!result[ripple::jss::transactions].isArray())
+                throw std::runtime_error("bad account_tx reply");
+
+            for (auto const& entry : result[ripple::jss::transactions])
+            {
+                auto const& tx = entry[ripple::jss::tx];
+                auto const status = classify(
+                    tx,
+                    entry[ripple::jss::meta],
+                    entry[ripple::jss::validated].asBool());
+                {
+                    std::lock_guard l{mutex_};
+                    ++scanned_;
+                }
+                if (!status)
+                    continue;
+                if (status == std::string_view{"attesting"})
+                    listener_->processAccountTx(entry);
+                record(
+                    rpcResultParse::parseTxHash(tx).value_or(ripple::uint256{}),
+                    status);
+            }
+
+            if (!result.isMember(ripple::jss::marker))
+                break;
+            params[ripple::jss::marker] = result[ripple::jss::marker];
+        }
+    }
+    catch (std::exception const& e)
+    {
+        JLOGV(
+            j_.warn(),
+            "bulk attest range failed",
+            ripple::jv("job", id_),
+            ripple::jv("first", first),
+            ripple::jv("last", last),
+            ripple::jv("what", e.what()));
+        std::lock_guard l{mutex_};
+        ++errors_;
+        results_.push_back(
+            {ripple::uint256{},
+             "failed",
+             "ledgers " + std::to_string(first) + "-" + std::to_string(last) +
+                 ": " + e.what()});
+    }
+    workerDone();
+}
+
+void
+BulkAttest::record(
+    ripple::uint256 const& hash,
+    std::string status,
+    std::optional<std::string> error)
+{
+    std::lock_guard l{mutex_};
+    if (status == "attesting")
+        ++attesting_;
+    else if (status == "already_attested")
+        ++alreadyAttested_;
+    else if (status == "failed")
+        ++errors_;
+    results_.push_back({hash, std::move(status), std::move(error)});
+}
+
+void
+BulkAttest::workerDone()
+{
+    {
+        std::lock_guard l{mutex_};
+        if (--workers_ != 0)
+            return;
+        finished_ = std::chrono::steady_clock::now();
+        JLOGV(
+            j_.info(),
+            "bulk attest done",
+            ripple::jv("job", id_),
+            ripple::jv("attesting", attesting_),
+            ripple::jv("already_attested", alreadyAttested_),
+            ripple::jv("errors", errors_),
+            ripple::jv("cancelled", cancelled_.load()));
+    }
+    if (params_.onDone)
+        params_.onDone();
+}
+
+Json::Value
+BulkAttest::getInfo(std::size_t from, std::size_t limit) const
+{
+    using namespace std::chrono;
+
+    std::lock_guard l{mutex_};
+    Json::Value r{Json::objectValue};
+    r["job_id"] = id_;
+    r["chain_type"] = to_string(params_.chain);
+    if (workers_ != 0)
+        r["state"] = cancelled_ ? "cancelling" : "running";
+    else
+        r["state"] = cancelled_ ? "cancelled" : "done";
+    if (ledgers_)
+    {
+        r["ledger_index_min"] = ledgers_->first;
+        r["ledger_index_max"] = ledgers_->second;
+        r["scanned"] = static_cast<Json::UInt>(scanned_);
+    }
+    else
+    {
+        r["total"] = static_cast<Json::UInt>(params_.hashes.size());
+    }
+    r["done"] = static_cast<Json::UInt>(results_.size());
+    r["attesting"] = static_cast<Json::UInt>(attesting_);
+    r["already_attested"] = static_cast<Json::UInt>(alreadyAttested_);
+    r["errors"] = static_cast<Json::UInt>(errors_);
+    auto const end = workers_ != 0 ? steady_clock::now() : finished_;
+    r["elapsed_ms"] = static_cast<Json::UInt>(
+        duration_cast<milliseconds>(end - started_).count());
+
+    Json::Value results{Json::arrayValue};
+    auto const last = std::min(results_.size(), from + limit);
+    for (auto i = std::min(from, last); i < last; ++i)
+    {
+        auto const& res = results_[i];
+        Json::Value jv{Json::objectValue};
+        if (res.hash.isNonZero())
+            jv["tx_hash"] = to_string(res.hash);
+        jv["status"] = res.status;
+        if (res.error)
+            jv["error"] = *res.error;
+        results.append(std::move(jv));
+    }
+    r["results"] = std::move(results);
+    // Where the next call picks up
+    r["results_next"] = static_cast<Json::UInt>(std::max(from, last));
+    return r;
+}
+
+}  // namespace xbwd
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <xbwd/basics/ChainTypes.h>
+#include <xbwd/basics/ThreadSaftyAnalysis.h>
+
+#include <ripple/basics/base_uint.h>
+#include <ripple/beast/utility/Journal.h>
+#include <ripple/json/json_value.h>
+#include <ripple/protocol/STXChainBridge.h>
+
+#include <boost/asio/awaitable.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace xbwd {
+
+class ChainListener;
+class Storage;
+
+/** Attest many commits of one chain at once, for recovery.
+
+    The commits are given as transaction hashes, fetched with `tx`, or as a
+    ledger range of the door account, read with `account_tx`. Up to
+    `concurrency` requests are in flight: the hashes are shared among that
+    many workers, and the range is split into that many parts. Commits that
+    are already attested are skipped, the others are pushed to the federator
+    like `attest_tx` does. A result is recorded for each hash and each
+    commit found, and can be read while the job runs.
+
+    A range may instead start at the ledger of a given transaction. When
+    `onStart` is set, the job first looks for the last commit before the
+    range and passes its hash on, before any commit of the range is pushed.
+*/
+class BulkAttest : public std::enable_shared_from_this<BulkAttest>
+{
+public:
+    struct Params
+    {
+        // The chain the commits are on
+        ChainType chain = ChainType::locking;
+        std::vector<ripple::uint256> hashes;
+        // Inclusive ledger range, if not attesting `hashes`
+        std::optional<std::pair<std::uint32_t, std::uint32_t>> ledgers;
+        std::uint32_t concurrency = 8;
+        // Start the range at this transaction's ledger instead
+        std::optional<ripple::uint256> fromTx;
+        // Called with the last commit before the range, zero if not found
+        std::function<void(ripple::uint256 const&)> onStart;
+        // Called once the job is done, even if it failed to start
+        std::function<void()> onDone;
+    };
+
+    BulkAttest(
+        std::uint32_t id,
+        Params params,
+        std::shared_ptr<ChainListener> listener,
+        ripple::STXChainBridge const& bridge,
+        Storage& storage,
+        beast::Journal j);
+
+    void
+    start();
+
+    // Stop once the requests in flight complete
+    void
+    cancel();
+
+    std::uint32_t
+    id() const
+    {
+        return id_;
+    }
+
+    bool
+    running() const EXCLUDES(mutex_);
+
+    // Progress, and the results from index `from` on, at most `limit`
+    Json::Value
+    getInfo(std::size_t from, std::size_t limit) const EXCLUDES(mutex_);
+
+private:
+    // Spawn the workers. Ranges use ledgers_.
+    void
+    launch() EXCLUDES(mutex_);
+
+    // Resolve the range and call onStart, then launch
+    boost::asio::awaitable<void>
+    prepare();
+
+    // Hash of the last commit before `ledger`, zero if none is found in a
+    // few pages
+    boost::asio::awaitable<ripple::uint256>
+    lastCommitBefore(std::uint32_t ledger);
+
+    boost::asio::awaitable<void>
+    hashWorker();
+
+    boost::asio::awaitable<void>
+    rangeWorker(std::uint32_t first, std::uint32_t last);
+
+    // True if an attestation of the transaction is stored
+    bool
+    attested(ripple::uint256 const& hash, bool isCreateAccount);
+
+    // True if the transaction is a commit on the bridge
+    bool
+    isCommit(Json::Value const& tx) const;
+
+    // Status of a transaction: "attesting" if it is a commit to attest, or
+    // why it is not. Null if it is not a commit on the bridge.
+    char const*
+    classify(Json::Value const& tx, Json::Value const& meta, bool validated);
+
+    void
+    record(
+        ripple::uint256 const& hash,
+        std::string status,
+        std::optional<std::string> error = std::nullopt) EXCLUDES(mutex_);
+
+    void
+    workerDone() EXCLUDES(mutex_);
+
+    std::uint32_t const id_;
+    Params const params_;
+    std::shared_ptr<ChainListener> const listener_;
+    ripple::STXChainBridge const bridge_;
+    Storage& storage_;
+    beast::Journal j_;
+
+    std::atomic<bool> cancelled_ = false;
+
+    struct Result
+    {
+        ripple::uint256 hash;
+        std::string status;
+        std::optional<std::string> error;
+    };
+
+    mutable std::mutex mutex_;
+    // params_.ledgers, with the start resolved from params_.fromTx
+    std::optional<std::pair<std::uint32_t, std::uint32_t>> GUARDED_BY(mutex_)
+        ledgers_;
+    // Next of params_.hashes to take
+    std::size_t GUARDED_BY(mutex_) next_ = 0;
+    std::uint32_t GUARDED_BY(mutex_) workers_ = 0;
+    std::uint64_t GUARDED_BY(mutex_) scanned_ = 0;
+    std::uint64_t GUARDED_BY(mutex_) attesting_ = 0;
+    std::uint64_t GUARDED_BY(mutex_) alreadyAttested_ = 0;
+    std::uint64_t GUARDED_BY(mutex_) errors_ = 0;
+    std::vector<Result> GUARDED_BY(mutex_) results_;
+    std::chrono::steady_clock::time_point GUARDED_BY(mutex_) started_;
+    std::chrono::steady_clock::time_point GUARDED_BY(mutex_) finished_;
+};
+
+}  // namespace xbwd
@@ -20,22 +20,25 @@
 #include <xbwd/federator/Federator.h>
 
 #include <xbwd/app/App.h>
-#include <xbwd/app/DBInit.h>
+#include <xbwd/app/Standby.h>
 #include <xbwd/basics/ChainTypes.h>
 #include <xbwd/client/RpcResultParse.h>
+#include <xbwd/core/Storage.h>
 #include <xbwd/federator/TxnSupport.h>
 
 #include <ripple/basics/strHex.h>
-#include <ripple/beast/core/CurrentThreadName.h>
 #include <ripple/json/Output.h>
+#include <ripple/json/json_get_or_throw.h>
 #include <ripple/json/json_reader.h>
 #include <ripple/json/json_writer.h>
 #include <ripple/protocol/AccountID.h>
+#include <ripple/protocol/HashPrefix.h>
 #include <ripple/protocol/SField.h>
 #include <ripple/protocol/STParsedJSON.h>
 #include <ripple/protocol/STTx.h>
 #include <ripple/protocol/STXChainAttestationBatch.h>
 #include <ripple/protocol/Seed.h>
+#include <ripple/protocol/digest.h>
 #include <ripple/protocol/jss.h>
 
 #include <fmt/core.h>
@@ -45,15 +48,53 @@
 #include <cmath>
 #include <exception>
 #include <future>
+#include <iterator>
 #include <sstream>
 #include <stdexcept>
+#include <unordered_set>
 
 namespace xbwd {
 
+std::pair<std::string, std::string>
+forAttestIDs(
+    ripple::STXChainAttestationBatch const& batch,
+    std::function<void(std::uint64_t id)> commitFunc = [](std::uint64_t) {},
+    std::function<void(std::uint64_t id)> createFunc = [](std::uint64_t) {})
+{
+    std::stringstream commitAttests;
+    std::stringstream createAttests;
+    auto temp = ripple::STXChainAttestationBatch::for_each_claim_batch<int>(
+        batch.claims().begin(),
+        batch.claims().end(),
+        [&](auto batchStart, auto batchEnd) -> int {
+            for (auto i = batchStart; i != batchEnd; ++i)
+            {
+                commitAttests << ":" << i->claimID;
+                commitFunc(i->claimID);
+            }
+            return 0;
+        });
+
+    temp = ripple::STXChainAttestationBatch::for_each_create_batch<int>(
+        batch.creates().begin(),
+        batch.creates().end(),
+        [&](auto batchStart, auto batchEnd) -> int {
+            for (auto i = batchStart; i != batchEnd; ++i)
+            {
+                createAttests << ":" << i->createCount;
+                createFunc(i->createCount);
+            }
+            return 0;
+        });
+
+    return {commitAttests.str(), createAttests.str()};
+}
+
 std::shared_ptr<Federator>
 make_Federator(
     App& app,
-    boost::asio::io_service& ios,
+    boost::asio::io_service& lockingIos,
+    boost::asio::io_service& issuingIos,
     config::Config const& config,
     beast::Journal j)
 {
@@ -77,6 +118,7 @@ make_Federator(
             ChainType::locking,
             config.bridge,
             getSubmitAccount(ChainType::locking),
+            config.speculativeSigningLedgers != 0,
             r,
             j);
     std::shared_ptr<ChainListener> sidechainListener =
@@ -84,12 +126,14 @@ make_Federator(
             ChainType::issuing,
             config.bridge,
             getSubmitAccount(ChainType::issuing),
+            config.speculativeSigningLedgers != 0,
             r,
             j);
     r->init(
-        ios,
+        lockingIos,
         config.lockingChainConfig.chainIp,
         std::move(mainchainListener),
+        issuingIos,
         config.issuingChainConfig.chainIp,
         std::move(sidechainListener));
 
@@ -118,6 +162,23 @@ Federator::Federator(
     , keyType_{config.keyType}
     , signingPK_{derivePublicKey(config.keyType, config.signingKey)}
     , signingSK_{config.signingKey}
+    , signingLoop_{std::make_unique<IOLoop>(
+          "signing",
+          config.threads.signing,
+          app.threadMap())}
+    , signingThreads_{config.threads.signing.size()}
+    , active_{!config.standby}
+    , claimGaps_{config.gapBackfillLedgers, config.gapBackfillLedgers}
+    , createGaps_{config.gapBackfillLedgers, config.gapBackfillLedgers}
+    , aggregation_{
+          config.aggregation ? std::make_shared<Aggregation>(
+                                   *config.aggregation,
+                                   config.bridge,
+                                   signingPK_,
+                                   app.get_io_service(),
+                                   j)
+                             : nullptr}
+    , speculative_{config.speculativeSigningLedgers, j}
     , j_(j)
 {
     signerListsInfo_[ChainType::locking].ignoreSignerList_ =
@@ -131,63 +192,31 @@ Federator::Federator(
 
 void
 Federator::init(
-    boost::asio::io_service& ios,
+    boost::asio::io_service& mainchainIos,
     beast::IP::Endpoint const& mainchainIp,
     std::shared_ptr<ChainListener>&& mainchainListener,
+    boost::asio::io_service& sidechainIos,
     beast::IP::Endpoint const& sidechainIp,
     std::shared_ptr<ChainListener>&& sidechainListener)
 {
     auto fillLastTxHash = [&]() -> bool {
         try
         {
-            auto session = app_.getXChainTxnDB().checkoutDb();
-            auto const sql = fmt::format(
-                R"sql(SELECT ChainType, TransID, LedgerSeq FROM {table_name};
-            )sql",
-                fmt::arg("table_name", db_init::xChainSyncTable));
-
-            std::uint32_t chainType = 0;
-            std::string transID;
-            std::uint32_t ledgerSeq = 0;
-            int rows = 0;
-            soci::statement st =
-                ((*session).prepare << sql,
-                 soci::into(chainType),
-                 soci::into(transID),
-                 soci::into(ledgerSeq));
-            st.execute();
-            while (st.fetch())
+            for (auto const ct : {ChainType::locking, ChainType::issuing})
             {
-                if (chainType !=
-                        static_cast<std::uint32_t>(ChainType::issuing) &&
-                    chainType != static_cast<std::uint32_t>(ChainType::locking))
-                {
-                    JLOG(j_.error())
-                        << "error reading database: unknown chain type "
-                        << chainType << ". Recreating init sync table.";
+                auto const state = app_.storage().getSyncState(ct);
+                if (!state)
                     return false;
-                }
-                auto const ct = static_cast<ChainType>(chainType);
-
-                if (!initSync_[ct].dbTxnHash_.parseHex(transID))
-                {
-                    JLOG(j_.error())
-                        << "error reading database: cannot parse transation "
-                           "hash "
-                        << transID << ". Recreating init sync table.";
-                    return false;
-                }
-
-                initSync_[ct].dbLedgerSqn_ = ledgerSeq;
-                ++rows;
+                initSync_[ct].dbTxnHash_ = state->txnHash;
+                initSync_[ct].dbLedgerSqn_ = state->ledgerSeq;
             }
-            return rows == 2;  // both chainTypes
+            return true;
         }
         catch (std::exception& e)
         {
             JLOGV(
                 j_.error(),
-                "error reading init sync table.",
+                "error reading init sync table. Recreating it.",
                 ripple::jv("what", e.what()));
             return false;
         }
@@ -196,34 +225,15 @@ Federator::init(
     auto initializeInitSyncTable = [&]() {
         try
         {
-            {
-                auto session = app_.getXChainTxnDB().checkoutDb();
-                auto const sql = fmt::format(
-                    R"sql(DELETE FROM {table_name};
-            )sql",
-                    fmt::arg("table_name", db_init::xChainSyncTable));
-                *session << sql;
-            }
+            Storage::Batch batch{app_.storage()};
             for (auto const ct : {ChainType::locking, ChainType::issuing})
             {
                 initSync_[ct].dbLedgerSqn_ = 0u;
                 initSync_[ct].dbTxnHash_ = {};
-                auto const txnIdHex = ripple::strHex(
-                    initSync_[ct].dbTxnHash_.begin(),
-                    initSync_[ct].dbTxnHash_.end());
-                auto session = app_.getXChainTxnDB().checkoutDb();
-                auto const sql = fmt::format(
-                    R"sql(INSERT INTO {table_name}
-                      (ChainType, TransID, LedgerSeq)
-                      VALUES
-                      (:ct, :txnId, :lgrSeq);
-                )sql",
-                    fmt::arg("table_name", db_init::xChainSyncTable));
-                *session << sql, soci::use(static_cast<std::uint32_t>(ct)),
-                    soci::use(txnIdHex), soci::use(initSync_[ct].dbLedgerSqn_);
+                app_.storage().setSyncState(ct, SyncState{});
             }
-            JLOG(j_.info()) << "created DB table for initial sync, "
-                            << db_init::xChainSyncTable;
+            JLOG(j_.info()) << "initialized sync state in "
+                            << app_.storage().name() << " storage";
         }
         catch (std::exception& e)
         {
@@ -237,6 +247,9 @@ Federator::init(
 
     if (!fillLastTxHash())
         initializeInitSyncTable();
+    // A standby restores the journal it mirrored when it takes over
+    if (active_)
+        restoreSubmissions();
 
     for (auto const ct : {ChainType::locking, ChainType::issuing})
     {
@@ -251,9 +264,9 @@ Federator::init(
     }
 
     chains_[ChainType::locking].listener_ = std::move(mainchainListener);
-    chains_[ChainType::locking].listener_->init(ios, mainchainIp);
+    chains_[ChainType::locking].listener_->init(mainchainIos, mainchainIp);
     chains_[ChainType::issuing].listener_ = std::move(sidechainListener);
-    chains_[ChainType::issuing].listener_->init(ios, sidechainIp);
+    chains_[ChainType::issuing].listener_->init(sidechainIos, sidechainIp);
 }
 
 void
@@ -264,90 +277,49 @@ Federator::sendDBAttests(ChainType ct)
     int commits = 0;
     int creates = 0;
 
-    try
+    // Attestations in submissions restored from the journal are still in
+    // flight; only the rest need to be sent
+    std::unordered_set<std::uint64_t> inFlightCommits;
+    std::unordered_set<std::uint64_t> inFlightCreates;
     {
-        auto const& tblName = db_init::xChainTableName(chainDir);
-        auto session = app_.getXChainTxnDB().checkoutDb();
-        soci::blob amtBlob(*session);
-        soci::blob bridgeBlob(*session);
-        soci::blob sendingAccountBlob(*session);
-        soci::blob rewardAccountBlob(*session);
-        soci::blob otherChainDstBlob(*session);
-        soci::blob publicKeyBlob(*session);
-        soci::blob signatureBlob(*session);
-
-        std::string transID;
-        int ledgerSeq;
-        int claimID;
-        int success;
-
-        auto const sql = fmt::format(
-            R"sql(SELECT TransID, LedgerSeq, ClaimID, Success, DeliveredAmt,
-                     Bridge, SendingAccount, RewardAccount, OtherChainDst,
-                     PublicKey, Signature FROM {table_name} ORDER BY ClaimID;
-        )sql",
-            fmt::arg("table_name", tblName));
-
-        soci::indicator otherChainDstInd;
-        soci::statement st =
-            ((*session).prepare << sql,
-             soci::into(transID),
-             soci::into(ledgerSeq),
-             soci::into(claimID),
-             soci::into(success),
-             soci::into(amtBlob),
-             soci::into(bridgeBlob),
-             soci::into(sendingAccountBlob),
-             soci::into(rewardAccountBlob),
-             soci::into(otherChainDstBlob, otherChainDstInd),
-             soci::into(publicKeyBlob),
-             soci::into(signatureBlob));
-        st.execute();
-
-        std::vector<ripple::AttestationBatch::AttestationClaim> claims;
-        ripple::STXChainBridge bridge;
-        std::optional<ripple::STXChainBridge> firstBridge;
-        while (st.fetch())
-        {
-            ripple::PublicKey signingPK;
-            convert(publicKeyBlob, signingPK);
-
-            ripple::Buffer sigBuf;
-            convert(signatureBlob, sigBuf);
-
-            ripple::STAmount sendingAmount;
-            convert(amtBlob, sendingAmount, ripple::sfAmount);
-
-            ripple::AccountID sendingAccount;
-            convert(sendingAccountBlob, sendingAccount);
-
-            ripple::AccountID rewardAccount;
-            convert(rewardAccountBlob, rewardAccount);
-
-            std::optional<ripple::AccountID> optDst;
-            if (otherChainDstInd == soci::i_ok)
-            {
-                optDst.emplace();
-                convert(otherChainDstBlob, *optDst);
-            }
+        std::lock_guard l{txnsMutex_};
+        for (auto const& sub : submitted_[ct])
+            forAttestIDs(
+                sub.batch_,
+                [&](std::uint64_t id) { inFlightCommits.insert(id); },
+                [&](std::uint64_t id) { inFlightCreates.insert(id); });
+    }
 
-            convert(bridgeBlob, bridge, ripple::sfXChainBridge);
+    // Failed commits are stored without a signature, and are not resent
+    AttestationQuery q;
+    q.success = true;
 
-            pushAtt(
-                bridge,
-                ripple::AttestationBatch::AttestationClaim{
-                    signingPK,
-                    sigBuf,
-                    sendingAccount,
-                    sendingAmount,
-                    rewardAccount,
-                    chainDir == ChainDir::lockingToIssuing,
-                    static_cast<std::uint64_t>(claimID),
-                    optDst},
-                ct,
-                true);
-            ++commits;
-        }
+    try
+    {
+        app_.storage().scan(
+            chainDir,
+            AttestationTable::claim,
+            q,
+            [&](AttestationRecord const& r) {
+                if (!r.deliveredAmt || !r.signature ||
+                    inFlightCommits.count(r.id))
+                    return true;
+                pushAtt(
+                    r.bridge,
+                    ripple::AttestationBatch::AttestationClaim{
+                        r.publicKey,
+                        *r.signature,
+                        r.sendingAccount,
+                        *r.deliveredAmt,
+                        r.rewardAccount,
+                        chainDir == ChainDir::lockingToIssuing,
+                        r.id,
+                        r.otherChainDst},
+                    ct,
+                    true);
+                ++commits;
+                return true;
+            });
     }
     catch (std::exception& e)
     {
@@ -360,90 +332,31 @@ Federator::sendDBAttests(ChainType ct)
 
     try
     {
-        auto const& tblName = db_init::xChainCreateAccountTableName(chainDir);
-        auto session = app_.getXChainTxnDB().checkoutDb();
-        soci::blob amtBlob(*session);
-        soci::blob rewardAmtBlob(*session);
-        soci::blob bridgeBlob(*session);
-        soci::blob sendingAccountBlob(*session);
-        soci::blob rewardAccountBlob(*session);
-        soci::blob otherChainDstBlob(*session);
-        soci::blob publicKeyBlob(*session);
-        soci::blob signatureBlob(*session);
-
-        std::string transID;
-        int ledgerSeq;
-        int createCount;
-        int success;
-
-        auto const sql = fmt::format(
-            R"sql(SELECT TransID, LedgerSeq, CreateCount, Success, DeliveredAmt, RewardAmt,
-                     Bridge, SendingAccount, RewardAccount, OtherChainDst,
-                     PublicKey, Signature FROM {table_name} ORDER BY CreateCount;
-        )sql",
-            fmt::arg("table_name", tblName));
-
-        soci::indicator otherChainDstInd;
-        soci::statement st =
-            ((*session).prepare << sql,
-             soci::into(transID),
-             soci::into(ledgerSeq),
-             soci::into(createCount),
-             soci::into(success),
-             soci::into(amtBlob),
-             soci::into(rewardAmtBlob),
-             soci::into(bridgeBlob),
-             soci::into(sendingAccountBlob),
-             soci::into(rewardAccountBlob),
-             soci::into(otherChainDstBlob, otherChainDstInd),
-             soci::into(publicKeyBlob),
-             soci::into(signatureBlob));
-        st.execute();
-
-        std::vector<ripple::AttestationBatch::AttestationClaim> claims;
-        ripple::STXChainBridge bridge;
-        std::optional<ripple::STXChainBridge> firstBridge;
-        while (st.fetch())
-        {
-            ripple::PublicKey signingPK;
-            convert(publicKeyBlob, signingPK);
-
-            ripple::Buffer sigBuf;
-            convert(signatureBlob, sigBuf);
-
-            ripple::STAmount sendingAmount;
-            convert(amtBlob, sendingAmount, ripple::sfAmount);
-
-            ripple::STAmount rewardAmount;
-            convert(rewardAmtBlob, rewardAmount, ripple::sfAmount);
-
-            ripple::AccountID sendingAccount;
-            convert(sendingAccountBlob, sendingAccount);
-
-            ripple::AccountID rewardAccount;
-            convert(rewardAccountBlob, rewardAccount);
-
-            ripple::AccountID dstAccount;
-            convert(otherChainDstBlob, dstAccount);
-
-            convert(bridgeBlob, bridge, ripple::sfXChainBridge);
-
-            pushAtt(
-                bridge,
-                ripple::AttestationBatch::AttestationCreateAccount{
-                    signingPK,
-                    sigBuf,
-                    sendingAccount,
-                    sendingAmount,
-                    rewardAmount,
-                    rewardAccount,
-                    chainDir == ChainDir::lockingToIssuing,
-                    static_cast<std::uint64_t>(createCount),
-                    dstAccount},
-                ct,
-                true);
-            ++creates;
-        }
+        app_.storage().scan(
+            chainDir,
+            AttestationTable::createAccount,
+            q,
+            [&](AttestationRecord const& r) {
+                if (!r.deliveredAmt || !r.rewardAmt || !r.otherChainDst ||
+                    !r.signature || inFlightCreates.count(r.id))
+                    return true;
+                pushAtt(
+                    r.bridge,
+                    ripple::AttestationBatch::AttestationCreateAccount{
+                        r.publicKey,
+                        *r.signature,
+                        r.sendingAccount,
+                        *r.deliveredAmt,
+                        *r.rewardAmt,
+                        r.rewardAccount,
+                        chainDir == ChainDir::lockingToIssuing,
+                        r.id,
+                        *r.otherChainDst},
+                    ct,
+                    true);
+                ++creates;
+                return true;
+            });
     }
     catch (std::exception& e)
     {
@@ -455,7 +368,114 @@ Federator::sendDBAttests(ChainType ct)
     }
 
     JLOG(j_.trace()) << "sendDBAttests " << to_string(ct) << " commit "
-                     << commits << " create account " << creates;
+                     << commits << " create account " << creates
+                     << " in flight "
+                     << inFlightCommits.size() + inFlightCreates.size();
+}
+
+void
+Federator::restoreSubmissions()
+{
+    std::vector<SubmissionRecord> records;
+    try
+    {
+        records = app_.storage().getSubmissions();
+    }
+    catch (std::exception& e)
+    {
+        JLOGV(
+            j_.fatal(),
+            "error reading submission journal.",
+            ripple::jv("what", e.what()));
+        throw;
+    }
+
+    std::lock_guard l{txnsMutex_};
+    // The previous process, or the active witness this one takes over from,
+    // may have had transactions applied that are not validated yet, journaled
+    // or not. The submit loop reads the next sequence from the current ledger
+    // for every chain.
+    for (auto const ct : {ChainType::locking, ChainType::issuing})
+        restoredSqns_[ct] = std::max(restoredSqns_[ct], 1u);
+    for (auto& r : records)
+    {
+        if (!autoSubmit_[r.chain])
+        {
+            unjournalSubmission(r.chain, r.accountSqn);
+            continue;
+        }
+        try
+        {
+            ripple::SerialIter sit(ripple::makeSlice(r.batch));
+            Submission sub{
+                r.lastLedgerSeq,
+                r.accountSqn,
+                ripple::STXChainAttestationBatch{
+                    sit, ripple::sfXChainAttestationBatch}};
+            sub.retriesAllowed_ = r.retriesAllowed;
+            // Looked up rather than resubmitted if it expires unseen
+            if (!r.signedTxn.empty())
+                sub.txnHash_ = ripple::sha512Half(
+                    ripple::HashPrefix::transactionID,
+                    ripple::makeSlice(r.signedTxn));
+            submitted_[r.chain].push_back(std::move(sub));
+        }
+        catch (std::exception& e)
+        {
+            // Its attestations are sent again with the rest after init sync
+            JLOGV(
+                j_.warn(),
+                "dropping unreadable journaled submission",
+                ripple::jv("chain", to_string(r.chain)),
+                ripple::jv("accountSqn", r.accountSqn),
+                ripple::jv("what", e.what()));
+            unjournalSubmission(r.chain, r.accountSqn);
+            continue;
+        }
+        // The chain may be ahead of the journal, e.g. if the process died
+        // between submitting and journaling, so the submit loop takes the
+        // greater of this and the chain's.
+        restoredSqns_[r.chain] =
+            std::max(restoredSqns_[r.chain], r.accountSqn + 1);
+        restored_[r.chain].emplace_back(
+            r.lastLedgerSeq, std::move(r.signedTxn));
+    }
+
+    for (auto const ct : {ChainType::locking, ChainType::issuing})
+    {
+        if (!submitted_[ct].empty())
+            JLOGV(
+                j_.info(),
+                "restored journaled submissions",
+                ripple::jv("chain", to_string(ct)),
+                ripple::jv(
+                    "count",
+                    static_cast<std::uint32_t>(submitted_[ct].size())),
+                ripple::jv("nextAccountSqn", restoredSqns_[ct]));
+    }
+}
+
+void
+Federator::resendRestored(ChainType ct)
+{
+    auto const ledgerIndex = ledgerIndexes_[ct].load();
+    if (ledgerIndex == 0)
+        return;
+    std::vector<std::pair<std::uint32_t, ripple::Blob>> restored;
+    {
+        std::lock_guard l{txnsMutex_};
+        restored.swap(restored_[ct]);
+    }
+
+    for (auto const& [lastLedgerSeq, blob] : restored)
+    {
+        if (lastLedgerSeq <= ledgerIndex)
+            continue;
+        // Results arrive as XChainAttestsResult events like any other
+        Json::Value request;
+        request[ripple::jss::tx_blob] = ripple::strHex(blob);
+        chains_[ct].listener_->send("submit", request);
+    }
 }
 
 Federator::~Federator()
@@ -471,15 +491,22 @@ Federator::start()
     requestStop_ = false;
     running_ = true;
 
-    threads_[lt_event] = std::thread([this]() {
-        beast::setCurrentThreadName("FederatorEvents");
-        this->mainLoop();
-    });
+    auto const& threads = app_.config().threads;
 
-    threads_[lt_txnSubmit] = std::thread([this]() {
-        beast::setCurrentThreadName("FederatorTxns");
-        this->txnSubmitLoop();
-    });
+    threads_[lt_event] =
+        std::thread([this, cpus = threads.federatorEvent.cpus]() {
+            app_.threadMap().enter("federator_event", "FederatorEvents", cpus);
+            this->mainLoop();
+        });
+
+    threads_[lt_txnSubmit] =
+        std::thread([this, cpus = threads.federatorSubmit.cpus]() {
+            app_.threadMap().enter("federator_submit", "FederatorTxns", cpus);
+            this->txnSubmitLoop();
+        });
+
+    if (aggregation_)
+        aggregation_->start();
 }
 
 void
@@ -498,6 +525,13 @@ Federator::stop()
             threads_[i].join();
         running_ = false;
     }
+    if (aggregation_)
+        aggregation_->stop();
+    {
+        std::lock_guard l{bulkMutex_};
+        for (auto const& job : bulkJobs_)
+            job->cancel();
+    }
     chains_[ChainType::locking].listener_->shutdown();
     chains_[ChainType::issuing].listener_->shutdown();
 }
@@ -585,7 +619,7 @@ Federator::tryFinishInitSync(ChainType const ct)
                      << replays_[ct].size() << " events to replay";
     initSync_[ct].syncing_ = false;
     chains_[otherChain(ct)].listener_->stopHistoricalTxns();
-    if (autoSubmit_[ct])
+    if (submitting(ct))
         sendDBAttests(ct);
     for (auto const& event : replays_[ct])
     {
@@ -594,9 +628,181 @@ Federator::tryFinishInitSync(ChainType const ct)
     replays_[ct].clear();
 }
 
+std::vector<Federator::Presigned>
+Federator::presign(std::vector<FederatorEvent> const& events)
+{
+    // Fewer than this are signed inline
+    static constexpr std::size_t minPresign = 2;
+
+    // Events the handlers will sign, by the same checks. Chains only leave
+    // init sync, so none is signed for nothing on that account.
+    std::vector<std::size_t> toSign;
+    for (std::size_t i = 0; i < events.size(); ++i)
+    {
+        std::visit(
+            [&](auto const& e) {
+                using T = std::decay_t<decltype(e)>;
+                if constexpr (
+                    std::is_same_v<T, event::XChainCommitDetected> ||
+                    std::is_same_v<T, event::XChainAccountCreateCommitDetected>)
+                {
+                    auto const dstChain = e.dir_ == ChainDir::lockingToIssuing
+                        ? ChainType::issuing
+                        : ChainType::locking;
+                    if (ripple::isTesSuccess(e.status_) && e.deliveredAmt_ &&
+                        !initSync_[dstChain].syncing_)
+                        toSign.push_back(i);
+                }
+            },
+            events[i]);
+    }
+    if (toSign.size() < minPresign)
+        return {};
+
+    // Claims already signed from the proposed commits are not signed again
+    std::vector<Presigned> r(events.size());
+    std::size_t n = 0;
+    for (auto const i : toSign)
+    {
+        auto const e = std::get_if<event::XChainCommitDetected>(&events[i]);
+        if (auto claim = e ? speculative_.take(*e) : std::nullopt)
+            r[i] = std::move(*claim);
+        else
+            toSign[n++] = i;
+    }
+    toSign.resize(n);
+
+    auto const sign = [&](std::size_t i) {
+        using namespace event;
+        if (auto const e = std::get_if<XChainCommitDetected>(&events[i]))
+            r[i] = signClaim(*e);
+        else
+            r[i] = signCreate(
+                std::get<XChainAccountCreateCommitDetected>(events[i]));
+    };
+    if (toSign.size() < minPresign)
+    {
+        for (auto const i : toSign)
+            sign(i);
+        return r;
+    }
+
+    // Contiguous ranges, one per worker
+    auto const workers = std::min(signingThreads_, toSign.size());
+    std::vector<std::future<void>> done;
+    done.reserve(workers);
+    for (std::size_t w = 0; w < workers; ++w)
+    {
+        auto const begin = toSign.size() * w / workers;
+        auto const end = toSign.size() * (w + 1) / workers;
+        auto task =
+            std::make_shared<std::packaged_task<void()>>([&, begin, end] {
+                for (auto k = begin; k < end; ++k)
+                    sign(toSign[k]);
+            });
+        done.push_back(task->get_future());
+        boost::asio::post(
+            signingLoop_->get_io_service(), [task] { (*task)(); });
+    }
+
+    // Every task refers to `r`, so all are waited on before any rethrows
+    for (auto& f : done)
+        f.wait();
+    for (auto& f : done)
+        f.get();
+    return r;
+}
+
+template <class T>
+std::optional<T>
+Federator::takePresigned()
+{
+    auto const p = std::exchange(presigned_, nullptr);
+    if (!p)
+        return std::nullopt;
+    if (auto const att = std::get_if<T>(p))
+        return std::move(*att);
+    return std::nullopt;
+}
+
+ripple::AttestationBatch::AttestationClaim
+Federator::signClaim(event::XChainCommitDetected const& e) const
+{
+    ChainType const dstChain = e.dir_ == ChainDir::lockingToIssuing
+        ? ChainType::issuing
+        : ChainType::locking;
+
+    ripple::AttestationBatch::AttestationClaim claim{
+        e.bridge_,
+        signingPK_,
+        signingSK_,
+        e.src_,
+        *e.deliveredAmt_,
+        chains_[dstChain].rewardAccount_,
+        e.dir_ == ChainDir::lockingToIssuing,
+        e.claimID_,
+        e.otherChainDst_};
+    assert(claim.verify(e.bridge_));
+    return claim;
+}
+
+void
+Federator::speculate(event::XChainCommitDetected&& e)
+{
+    if (!speculative_.enabled())
+        return;
+    ChainType const dstChain = e.dir_ == ChainDir::lockingToIssuing
+        ? ChainType::issuing
+        : ChainType::locking;
+    // Commits seen while syncing are not signed by the event handler either
+    if (initSync_[dstChain].syncing_)
+        return;
+    // Marked before it is signed, so a validated commit handled first takes
+    // the mark and the claim is not kept
+    if (!speculative_.mark(e))
+        return;
+    boost::asio::post(
+        signingLoop_->get_io_service(),
+        [weak = weak_from_this(), e = std::move(e)] {
+            if (auto self = weak.lock())
+                self->addSpeculative(e);
+        });
+}
+
+void
+Federator::addSpeculative(event::XChainCommitDetected const& e)
+{
+    speculative_.fill(e, signClaim(e));
+}
+
+ripple::AttestationBatch::AttestationCreateAccount
+Federator::signCreate(event::XChainAccountCreateCommitDetected const& e) const
+{
+    ChainType const dstChain = e.dir_ == ChainDir::lockingToIssuing
+        ? ChainType::issuing
+        : ChainType::locking;
+
+    ripple::AttestationBatch::AttestationCreateAccount create{
+        e.bridge_,
+        signingPK_,
+        signingSK_,
+        e.src_,
+        *e.deliveredAmt_,
+        e.rewardAmt_,
+        chains_[dstChain].rewardAccount_,
+        e.dir_ == ChainDir::lockingToIssuing,
+        e.createCount_,
+        e.otherChainDst_};
+    assert(create.verify(e.bridge_));
+    return create;
+}
+
 void
 Federator::onEvent(event::XChainCommitDetected const& e)
 {
+    // Taken first, so events replayed from here can't pick it up
+    auto presigned =
+        takePresigned<ripple::AttestationBatch::AttestationClaim>();
     ChainType const dstChain = e.dir_ == ChainDir::lockingToIssuing
         ? ChainType::issuing
         : ChainType::locking;
@@ -620,32 +826,9 @@ Federator::onEvent(event::XChainCommitDetected const& e)
         return;
     }
 
-    auto const& tblName = db_init::xChainTableName(e.dir_);
-    auto const txnIdHex = ripple::strHex(e.txnHash_.begin(), e.txnHash_.end());
-    {
-        auto session = app_.getXChainTxnDB().checkoutDb();
-        auto const sql = fmt::format(
-            R"sql(SELECT count(*) FROM {table_name} WHERE TransID = "{tx_hex}";)sql",
-            fmt::arg("table_name", tblName),
-            fmt::arg("tx_hex", txnIdHex));
+    claimGaps_[dstChain].observe(e.claimID_, e.ledgerSeq_);
 
-        int count = 0;
-        *session << sql, soci::into(count);
-        if (session->got_data() && count > 0)
-        {
-            // Already have this transaction
-            // TODO: Sanity check the claim id and deliveredAmt match
-            // TODO: Stop historical transaction collection
-            JLOGV(
-                j_.fatal(),
-                "onEvent XChainTransferDetected already present",
-                ripple::jv("event", e.toJson()));
-            return;  // Don't store it again
-        }
-    }
-
-    int const success =
-        ripple::isTesSuccess(e.status_) ? 1 : 0;  // soci complains about a bool
+    bool const success = ripple::isTesSuccess(e.status_);
     auto const& rewardAccount = chains_[dstChain].rewardAccount_;
     auto const& optDst = e.otherChainDst_;
 
@@ -662,101 +845,63 @@ Federator::onEvent(event::XChainCommitDetected const& e)
                 ripple::jv("event", e.toJson()));
             return std::nullopt;
         }
-
-        return ripple::AttestationBatch::AttestationClaim{
-            e.bridge_,
-            signingPK_,
-            signingSK_,
-            e.src_,
-            *e.deliveredAmt_,
-            rewardAccount,
-            e.dir_ == ChainDir::lockingToIssuing,
-            e.claimID_,
-            optDst};
-    }();
-
-    assert(!claimOpt || claimOpt->verify(e.bridge_));
-
-    auto const encodedAmtOpt =
-        [&]() -> std::optional<std::vector<std::uint8_t>> {
-        if (!e.deliveredAmt_)
-            return std::nullopt;
-        ripple::Serializer s;
-        e.deliveredAmt_->add(s);
-        return std::move(s.modData());
-    }();
-
-    std::vector<std::uint8_t> const encodedBridge = [&] {
-        ripple::Serializer s;
-        bridge_.add(s);
-        return std::move(s.modData());
-    }();
-
-    {
-        auto session = app_.getXChainTxnDB().checkoutDb();
-
-        // Soci blob does not play well with optional. Store an empty blob
-        // when missing delivered amount
-        soci::blob amtBlob{*session};
-        if (encodedAmtOpt)
+        if (presigned)
         {
-            convert(*encodedAmtOpt, amtBlob);
+            // Proposed after the batch was presigned
+            speculative_.drop(e.txnHash_);
+            return std::move(presigned);
         }
+        if (auto speculative = speculative_.take(e))
+            return speculative;
+        return signClaim(e);
+    }();
 
-        soci::blob bridgeBlob(*session);
-        convert(encodedBridge, bridgeBlob);
-
-        soci::blob sendingAccountBlob(*session);
-        // Convert to an AccountID first, because if the type changes we
-        // want to catch it.
-        ripple::AccountID const& sendingAccount{e.src_};
-        convert(sendingAccount, sendingAccountBlob);
-
-        soci::blob rewardAccountBlob(*session);
-        convert(rewardAccount, rewardAccountBlob);
-
-        soci::blob publicKeyBlob(*session);
-        convert(signingPK_, publicKeyBlob);
-
-        soci::blob signatureBlob(*session);
-        if (claimOpt)
-        {
-            convert(claimOpt->signature, signatureBlob);
-        }
+    AttestationRecord rec;
+    rec.txnHash = e.txnHash_;
+    rec.ledgerSeq = e.ledgerSeq_;
+    rec.id = e.claimID_;
+    rec.success = success;
+    rec.deliveredAmt = e.deliveredAmt_;
+    rec.bridge = bridge_;
+    // Convert to an AccountID first, because if the type changes we want to
+    // catch it.
+    rec.sendingAccount = ripple::AccountID{e.src_};
+    rec.rewardAccount = rewardAccount;
+    rec.otherChainDst = optDst;
+    rec.publicKey = signingPK_;
+    if (claimOpt)
+        rec.signature = claimOpt->signature;
 
-        soci::blob otherChainDstBlob(*session);
-        if (optDst)
+    {
+        Storage::Batch batch{app_.storage()};
+        if (!app_.storage().insert(e.dir_, AttestationTable::claim, rec))
         {
-            convert(*optDst, otherChainDstBlob);
+            // Already have this transaction
+            // TODO: Sanity check the claim id and deliveredAmt match
+            // TODO: Stop historical transaction collection
+            JLOGV(
+                j_.fatal(),
+                "onEvent XChainTransferDetected already present",
+                ripple::jv("event", e.toJson()));
+            return;  // Don't store it again
         }
-
-        auto const sql = fmt::format(
-            R"sql(INSERT INTO {table_name}
-                  (TransID, LedgerSeq, ClaimID, Success, DeliveredAmt, Bridge,
-                   SendingAccount, RewardAccount, OtherChainDst, PublicKey, Signature)
-                  VALUES
-                  (:txnId, :lgrSeq, :claimID, :success, :amt, :bridge,
-                   :sendingAccount, :rewardAccount, :otherChainDst, :pk, :sig);
-            )sql",
-            fmt::arg("table_name", tblName));
-
-        *session << sql, soci::use(txnIdHex), soci::use(e.ledgerSeq_),
-            soci::use(e.claimID_), soci::use(success), soci::use(amtBlob),
-            soci::use(bridgeBlob), soci::use(sendingAccountBlob),
-            soci::use(rewardAccountBlob), soci::use(otherChainDstBlob),
-            soci::use(publicKeyBlob), soci::use(signatureBlob);
+        setSyncTxnHash(dstChain, e.txnHash_, e.rpcOrder_.has_value());
     }
+    app_.attestationCache().put(e.dir_, AttestationTable::claim, rec);
+
+    if (claimOpt &&
+        app_.subscriptions().hasSubscribers(
+            rpc::Subscriptions::Stream::attestations))
     {
-        auto session = app_.getXChainTxnDB().checkoutDb();
-        auto const sql = fmt::format(
-            R"sql(UPDATE {table_name} SET TransID = :tx_hash WHERE ChainType = :chain_type;
-            )sql",
-            fmt::arg("table_name", db_init::xChainSyncTable));
-        auto const chainType = static_cast<std::uint32_t>(dstChain);
-        *session << sql, soci::use(txnIdHex), soci::use(chainType);
+        publishAttestation(
+            dstChain,
+            ripple::strHex(e.txnHash_),
+            e.ledgerSeq_,
+            ripple::STXChainAttestationBatch{
+                e.bridge_, &*claimOpt, &*claimOpt + 1});
     }
 
-    if (autoSubmit_[dstChain] && claimOpt)
+    if (submitting(dstChain) && claimOpt)
     {
         bool processNow = e.ledgerBoundary_ || !e.rpcOrder_;
         pushAtt(e.bridge_, std::move(*claimOpt), dstChain, processNow);
@@ -766,6 +911,8 @@ Federator::onEvent(event::XChainCommitDetected const& e)
 void
 Federator::onEvent(event::XChainAccountCreateCommitDetected const& e)
 {
+    auto presigned =
+        takePresigned<ripple::AttestationBatch::AttestationCreateAccount>();
     ChainType const dstChain = e.dir_ == ChainDir::lockingToIssuing
         ? ChainType::issuing
         : ChainType::locking;
@@ -790,28 +937,9 @@ Federator::onEvent(event::XChainAccountCreateCommitDetected const& e)
         return;
     }
 
-    auto const& tblName = db_init::xChainCreateAccountTableName(e.dir_);
-    auto const txnIdHex = ripple::strHex(e.txnHash_.begin(), e.txnHash_.end());
-    {
-        auto session = app_.getXChainTxnDB().checkoutDb();
-        auto const sql = fmt::format(
-            R"sql(SELECT count(*) FROM {table_name} WHERE TransID = "{tx_hex}";)sql",
-            fmt::arg("table_name", tblName),
-            fmt::arg("tx_hex", txnIdHex));
-
-        int count = 0;
-        *session << sql, soci::into(count);
-        if (session->got_data() && count > 0)
-        {
-            // Already have this transaction
-            // TODO: Sanity check the claim id and deliveredAmt match
-            // TODO: Stop historical transaction collection
-            return;  // Don't store it again
-        }
-    }
+    createGaps_[dstChain].observe(e.createCount_, e.ledgerSeq_);
 
-    int const success =
-        ripple::isTesSuccess(e.status_) ? 1 : 0;  // soci complains about a bool
+    bool const success = ripple::isTesSuccess(e.status_);
     auto const& rewardAccount = chains_[dstChain].rewardAccount_;
     auto const& dst = e.otherChainDst_;
 
@@ -829,111 +957,75 @@ Federator::onEvent(event::XChainAccountCreateCommitDetected const& e)
             return std::nullopt;
         }
 
-        return ripple::AttestationBatch::AttestationCreateAccount{
-            e.bridge_,
-            signingPK_,
-            signingSK_,
-            e.src_,
-            *e.deliveredAmt_,
-            e.rewardAmt_,
-            rewardAccount,
-            e.dir_ == ChainDir::lockingToIssuing,
-            e.createCount_,
-            dst};
+        if (presigned)
+            return std::move(presigned);
+        return signCreate(e);
     }();
 
-    assert(!createOpt || createOpt->verify(e.bridge_));
-
-    {
-        auto session = app_.getXChainTxnDB().checkoutDb();
+    AttestationRecord rec;
+    rec.txnHash = e.txnHash_;
+    rec.ledgerSeq = e.ledgerSeq_;
+    rec.id = e.createCount_;
+    rec.success = success;
+    rec.deliveredAmt = e.deliveredAmt_;
+    rec.rewardAmt = e.rewardAmt_;
+    rec.bridge = bridge_;
+    // Convert to an AccountID first, because if the type changes we want to
+    // catch it.
+    rec.sendingAccount = ripple::AccountID{e.src_};
+    rec.rewardAccount = rewardAccount;
+    rec.otherChainDst = dst;
+    rec.publicKey = signingPK_;
+    if (createOpt)
+        rec.signature = createOpt->signature;
 
-        // Soci blob does not play well with optional. Store an empty blob when
-        // missing delivered amount
-        soci::blob amtBlob{*session};
-        if (e.deliveredAmt_)
-        {
-            convert(*e.deliveredAmt_, amtBlob);
-        }
-
-        soci::blob rewardAmtBlob{*session};
-        convert(e.rewardAmt_, rewardAmtBlob);
-
-        soci::blob bridgeBlob(*session);
-        convert(bridge_, bridgeBlob);
-
-        soci::blob sendingAccountBlob(*session);
-        // Convert to an AccountID first, because if the type changes we want to
-        // catch it.
-        ripple::AccountID const& sendingAccount{e.src_};
-        convert(sendingAccount, sendingAccountBlob);
-
-        soci::blob rewardAccountBlob(*session);
-        convert(rewardAccount, rewardAccountBlob);
-
-        soci::blob publicKeyBlob(*session);
-        convert(signingPK_, publicKeyBlob);
+    JLOGV(
+        j_.trace(),
+        "Insert into create table",
+        ripple::jv("chain_dir", to_string(e.dir_)),
+        ripple::jv("success", success),
+        ripple::jv("create_count", e.createCount_),
+        ripple::jv(
+            "amt",
+            e.deliveredAmt_ ? e.deliveredAmt_->getFullText()
+                            : std::string("no delivered amt")),
+        ripple::jv("reward_amt", e.rewardAmt_),
+        ripple::jv("sending_account", rec.sendingAccount),
+        ripple::jv("reward_account", rewardAccount),
+        ripple::jv("other_chain_dst", dst));
 
-        soci::blob signatureBlob(*session);
-        if (createOpt)
+    {
+        Storage::Batch batch{app_.storage()};
+        if (!app_.storage().insert(
+                e.dir_, AttestationTable::createAccount, rec))
         {
-            convert(createOpt->signature, signatureBlob);
+            // Already have this transaction
+            // TODO: Sanity check the claim id and deliveredAmt match
+            // TODO: Stop historical transaction collection
+            return;  // Don't store it again
         }
+        setSyncTxnHash(dstChain, e.txnHash_, e.rpcOrder_.has_value());
+    }
+    app_.attestationCache().put(e.dir_, AttestationTable::createAccount, rec);
 
-        soci::blob otherChainDstBlob(*session);
-        convert(dst, otherChainDstBlob);
+    if (createOpt &&
+        app_.subscriptions().hasSubscribers(
+            rpc::Subscriptions::Stream::attestations))
+    {
+        ripple::AttestationBatch::AttestationClaim* nullClaim = nullptr;
+        publishAttestation(
+            dstChain,
+            ripple::strHex(e.txnHash_),
+            e.ledgerSeq_,
+            ripple::STXChainAttestationBatch{
+                e.bridge_,
+                nullClaim,
+                nullClaim,
+                &*createOpt,
+                &*createOpt + 1});
+    }
 
-        if (e.deliveredAmt_)
-            JLOGV(
-                j_.trace(),
-                "Insert into create table",
-                ripple::jv("table_name", tblName),
-                ripple::jv("success", success),
-                ripple::jv("create_count", e.createCount_),
-                ripple::jv("amt", *e.deliveredAmt_),
-                ripple::jv("reward_amt", e.rewardAmt_),
-                ripple::jv("sending_account", sendingAccount),
-                ripple::jv("reward_account", rewardAccount),
-                ripple::jv("other_chain_dst", dst));
-        else
-            JLOGV(
-                j_.trace(),
-                "Insert into create table",
-                ripple::jv("table_name", tblName),
-                ripple::jv("success", success),
-                ripple::jv("create_count", e.createCount_),
-                ripple::jv("amt", "no delivered amt"),
-                ripple::jv("reward_amt", e.rewardAmt_),
-                ripple::jv("sending_account", sendingAccount),
-                ripple::jv("reward_account", rewardAccount),
-                ripple::jv("other_chain_dst", dst));
-
-        auto const sql = fmt::format(
-            R"sql(INSERT INTO {table_name}
-                  (TransID, LedgerSeq, CreateCount, Success, DeliveredAmt, RewardAmt, Bridge,
-                   SendingAccount, RewardAccount, otherChainDst, PublicKey, Signature)
-                  VALUES
-                  (:txnId, :lgrSeq, :createCount, :success, :amt, :rewardAmt, :bridge,
-                   :sendingAccount, :rewardAccount, :otherChainDst, :pk, :sig);
-            )sql",
-            fmt::arg("table_name", tblName));
-
-        *session << sql, soci::use(txnIdHex), soci::use(e.ledgerSeq_),
-            soci::use(e.createCount_), soci::use(success), soci::use(amtBlob),
-            soci::use(rewardAmtBlob), soci::use(bridgeBlob),
-            soci::use(sendingAccountBlob), soci::use(rewardAccountBlob),
-            soci::use(otherChainDstBlob), soci::use(publicKeyBlob),
-            soci::use(signatureBlob);
-    }
-    {
-        auto session = app_.getXChainTxnDB().checkoutDb();
-        auto const sql = fmt::format(
-            R"sql(UPDATE {table_name} SET TransID = :tx_hash WHERE ChainType = :chain_type;
-            )sql",
-            fmt::arg("table_name", db_init::xChainSyncTable));
-        auto const chainType = static_cast<std::uint32_t>(dstChain);
-        *session << sql, soci::use(txnIdHex), soci::use(chainType);
-    }
-    if (autoSubmit_[dstChain] && createOpt)
+    if (submitting(dstChain) && createOpt)
     {
         bool processNow = e.ledgerBoundary_ || !e.rpcOrder_;
         pushAtt(e.bridge_, std::move(*createOpt), dstChain, processNow);
@@ -965,39 +1057,57 @@ Federator::onEvent(event::EndOfHistory const& e)
     }
 }
 
-std::pair<std::string, std::string>
-forAttestIDs(
-    ripple::STXChainAttestationBatch const& batch,
-    std::function<void(std::uint64_t id)> commitFunc = [](std::uint64_t) {},
-    std::function<void(std::uint64_t id)> createFunc = [](std::uint64_t) {})
+void
+Federator::onEvent(event::Resync const& e)
 {
-    std::stringstream commitAttests;
-    std::stringstream createAttests;
-    auto temp = ripple::STXChainAttestationBatch::for_each_claim_batch<int>(
-        batch.claims().begin(),
-        batch.claims().end(),
-        [&](auto batchStart, auto batchEnd) -> int {
-            for (auto i = batchStart; i != batchEnd; ++i)
-            {
-                commitAttests << ":" << i->claimID;
-                commitFunc(i->claimID);
-            }
-            return 0;
-        });
+    auto const dstChain = otherChain(e.chainType_);
+    auto& hold = resyncHolds_[dstChain];
+    if (e.start_)
+    {
+        hold.held_ = true;
+        hold.latest_.reset();
+        if (e.txnHash_.isNonZero())
+            app_.storage().setSyncTxnHash(dstChain, e.txnHash_);
+        else
+            JLOGV(
+                j_.warn(),
+                "resync start commit not found, sync point not rewound",
+                ripple::jv("chain", to_string(e.chainType_)));
+        JLOGV(
+            j_.info(),
+            "resync started",
+            ripple::jv("chain", to_string(e.chainType_)),
+            ripple::jv("sync_txn_hash", to_string(e.txnHash_)));
+        return;
+    }
 
-    temp = ripple::STXChainAttestationBatch::for_each_create_batch<int>(
-        batch.creates().begin(),
-        batch.creates().end(),
-        [&](auto batchStart, auto batchEnd) -> int {
-            for (auto i = batchStart; i != batchEnd; ++i)
-            {
-                createAttests << ":" << i->createCount;
-                createFunc(i->createCount);
-            }
-            return 0;
-        });
+    // The end of a resync that failed to start is still pushed
+    if (!hold.held_)
+        return;
+    hold.held_ = false;
+    if (hold.latest_)
+        app_.storage().setSyncTxnHash(dstChain, *hold.latest_);
+    JLOGV(
+        j_.info(),
+        "resync done",
+        ripple::jv("chain", to_string(e.chainType_)));
+}
 
-    return {commitAttests.str(), createAttests.str()};
+void
+Federator::setSyncTxnHash(
+    ChainType dstChain,
+    ripple::uint256 const& txnHash,
+    bool live)
+{
+    auto& hold = resyncHolds_[dstChain];
+    if (!hold.held_)
+    {
+        app_.storage().setSyncTxnHash(dstChain, txnHash);
+        return;
+    }
+    // Commits resynced or attested on request are behind the stream
+    if (live)
+        hold.latest_ = txnHash;
 }
 
 static std::unordered_set<ripple::TERUnderlyingType> SkippableTxnResult(
@@ -1022,7 +1132,19 @@ Federator::onEvent(event::XChainAttestsResult const& e)
         ripple::jv("accountSqn", e.accountSqn_),
         ripple::jv("result", transHuman(e.ter_)));
 
-    if (!autoSubmit_[e.chainType_])
+    if (auto& subs = app_.subscriptions();
+        subs.hasSubscribers(rpc::Subscriptions::Stream::results))
+    {
+        Json::Value jv{Json::objectValue};
+        jv["type"] = "result";
+        jv["chain_type"] = to_string(e.chainType_);
+        jv["account_sequence"] = e.accountSqn_;
+        jv["engine_result"] = ripple::transToken(e.ter_);
+        jv["engine_result_code"] = TERtoInt(e.ter_);
+        subs.publish(rpc::Subscriptions::Stream::results, jv);
+    }
+
+    if (!submitting(e.chainType_))
         return;
 
     if (SkippableTxnResult.find(TERtoInt(e.ter_)) != SkippableTxnResult.end())
@@ -1052,6 +1174,7 @@ Federator::onEvent(event::XChainAttestsResult const& e)
                 ripple::jv("commitAttests", attestedIDs.first),
                 ripple::jv("createAttests", attestedIDs.second));
 
+            unjournalSubmission(e.chainType_, e.accountSqn_);
             subs.erase(i);
         }
     }
@@ -1059,6 +1182,38 @@ Federator::onEvent(event::XChainAttestsResult const& e)
     // may also get here during init sync.
 }
 
+void
+Federator::onEvent(event::XChainClaimsCompleted const& e)
+{
+    // Ids only grow, so the lowest are forgotten past this
+    static constexpr std::size_t maxCompleted = 64 * 1024;
+
+    JLOGV(
+        j_.trace(),
+        "XChainClaimsCompleted",
+        ripple::jv("event", e.toJson()));
+    {
+        std::lock_guard l{completedMutex_};
+        auto& completed = completed_[e.chainType_];
+        completed.claimIDs_.insert(e.claimIDs_.begin(), e.claimIDs_.end());
+        completed.createCounts_.insert(
+            e.createCounts_.begin(), e.createCounts_.end());
+        for (auto* ids : {&completed.claimIDs_, &completed.createCounts_})
+        {
+            while (ids->size() > maxCompleted)
+                ids->erase(ids->begin());
+        }
+    }
+
+    if (!submitting(e.chainType_))
+        return;
+    // Nothing is left to submit for these
+    for (auto const id : e.claimIDs_)
+        deleteFromDB(e.chainType_, id, false);
+    for (auto const count : e.createCounts_)
+        deleteFromDB(e.chainType_, count, true);
+}
+
 void
 Federator::onEvent(event::NewLedger const& e)
 {
@@ -1071,6 +1226,10 @@ Federator::onEvent(event::NewLedger const& e)
     ledgerIndexes_[e.chainType_].store(e.ledgerIndex_);
     ledgerFees_[e.chainType_].store(e.fee_);
 
+    // Commits on this chain are attested on the other
+    checkGaps(otherChain(e.chainType_), e.ledgerIndex_);
+    speculative_.expire(e.chainType_, e.ledgerIndex_);
+
     if (initSync_[e.chainType_].syncing_)
     {
         initSync_[e.chainType_].oldTxExpired_ =
@@ -1079,9 +1238,12 @@ Federator::onEvent(event::NewLedger const& e)
         return;
     }
 
-    if (!autoSubmit_[e.chainType_])
+    if (!submitting(e.chainType_))
         return;
 
+    if (aggregation_)
+        aggregate(e.chainType_, e.ledgerIndex_);
+
     bool notify = false;
     {
         std::lock_guard l{txnsMutex_};
@@ -1095,43 +1257,305 @@ Federator::onEvent(event::NewLedger const& e)
         {
             assert(!initSync_[e.chainType_].syncing_);
             auto& front = subs.front();
-            if (front.retriesAllowed_ > 0)
+            // Its result may only have been missed, so it is looked up
+            // before it is resubmitted
+            if (front.txnHash_.isNonZero())
+                reconciling_[e.chainType_].emplace_back(std::move(front));
+            else
+                retrySubmission(e.chainType_, std::move(front));
+            submitted_[e.chainType_].pop_front();
+        }
+        if (!reconciling_[e.chainType_].empty())
+            startReconcile(e.chainType_);
+        notify = !errored_[e.chainType_].empty();
+    }
+    if (notify)
+    {
+        std::lock_guard l(cvMutexes_[lt_txnSubmit]);
+        cvs_[lt_txnSubmit].notify_one();
+    }
+    else
+    {
+        std::lock_guard bl{batchMutex_};
+        if (curClaimAtts_[e.chainType_].size() +
+                curCreateAtts_[e.chainType_].size() >
+            0)
+            pushAttOnSubmitTxn(bridge_, e.chainType_);
+    }
+}
+
+void
+Federator::retrySubmission(ChainType ct, Submission s)
+{
+    // Resubmitted under a new sequence, or given up on
+    unjournalSubmission(ct, s.accountSqn_);
+    if (s.retriesAllowed_ > 0)
+    {
+        s.retriesAllowed_--;
+        s.accountSqn_ = 0;
+        s.lastLedgerSeq_ = 0;
+        s.txnHash_.zero();
+        errored_[ct].emplace_back(std::move(s));
+    }
+    else
+    {
+        auto const attestedIDs = forAttestIDs(s.batch_);
+        JLOGV(
+            j_.warn(),
+            "Giving up after repeated retries",
+            ripple::jv("chain", to_string(ct)),
+            ripple::jv("commitAttests", attestedIDs.first),
+            ripple::jv("createAttests", attestedIDs.second),
+            ripple::jv("batch", s.batch_.getJson(ripple::JsonOptions::none)));
+    }
+}
+
+void
+Federator::startReconcile(ChainType ct)
+{
+    if (reconcileInFlight_[ct])
+        return;
+    reconcileInFlight_[ct] = true;
+
+    std::vector<reconciliation::Expired> expired;
+    std::vector<std::uint32_t> lastLedgerSeqs;
+    for (auto const& s : reconciling_[ct])
+    {
+        expired.emplace_back(s.accountSqn_, s.txnHash_);
+        lastLedgerSeqs.push_back(s.lastLedgerSeq_);
+    }
+    auto const ledgers = reconciliation::window(lastLedgerSeqs, TxnTTLLedgers);
+    chains_[ct].listener_->spawn(
+        [self = shared_from_this(),
+         ct,
+         expired = std::move(expired),
+         ledgers]() mutable {
+            return self->reconcile(
+                ct, std::move(expired), ledgers.first, ledgers.second);
+        });
+}
+
+boost::asio::awaitable<void>
+Federator::reconcile(
+    ChainType ct,
+    std::vector<reconciliation::Expired> expired,
+    std::uint32_t fromLedger,
+    std::uint32_t toLedger)
+{
+    auto const listener = chains_[ct].listener_;
+    event::SubmissionsReconciled e{ct};
+    for (auto const& [sqn, hash] : expired)
+        e.checked_.push_back(sqn);
+
+    // What is not found is resubmitted, as when the lookup fails
+    try
+    {
+        Json::Value params;
+        params[ripple::jss::account] =
+            ripple::toBase58(chains_[ct].txnSubmit_->submittingAccount);
+        params[ripple::jss::ledger_index_min] = fromLedger;
+        params[ripple::jss::ledger_index_max] = toLedger;
+        params[ripple::jss::forward] = true;
+        params[ripple::jss::limit] = 200;
+
+        while (e.landed_.size() < expired.size())
+        {
+            auto const reply = co_await listener->request("account_tx", params);
+            auto const& result = reply[ripple::jss::result];
+            if (!result[ripple::jss::transactions].isArray())
+                throw std::runtime_error("bad account_tx reply");
+
+            reconciliation::match(
+                expired, result[ripple::jss::transactions], e.landed_);
+
+            if (!result.isMember(ripple::jss::marker))
+                break;
+            params[ripple::jss::marker] = result[ripple::jss::marker];
+        }
+    }
+    catch (std::exception const& ex)
+    {
+        JLOGV(
+            j_.warn(),
+            "looking up expired submissions failed",
+            ripple::jv("chain", to_string(ct)),
+            ripple::jv("what", ex.what()));
+    }
+    push(std::move(e));
+}
+
+void
+Federator::onEvent(event::SubmissionsReconciled const& e)
+{
+    JLOGV(
+        j_.debug(),
+        "SubmissionsReconciled",
+        ripple::jv("event", e.toJson()));
+
+    auto const ct = e.chainType_;
+    reconcileInFlight_[ct] = false;
+    bool notify = false;
+    {
+        std::lock_guard l{txnsMutex_};
+        auto& pending = reconciling_[ct];
+        for (auto i = pending.begin(); i != pending.end();)
+        {
+            auto const sqn = i->accountSqn_;
+            auto const outcome =
+                reconciliation::outcome(e, sqn, SkippableTxnResult);
+            if (outcome == reconciliation::Outcome::unchecked)
             {
-                front.retriesAllowed_--;
-                front.accountSqn_ = 0;
-                front.lastLedgerSeq_ = 0;
-                errored_[e.chainType_].emplace_back(front);
+                ++i;
+                continue;
             }
+
+            if (outcome == reconciliation::Outcome::missing)
+                ++reconciledMissing_;
             else
+                ++reconciledLanded_;
+            if (outcome == reconciliation::Outcome::landed)
             {
-                auto const attestedIDs = forAttestIDs(front.batch_);
-                JLOGV(
-                    j_.warn(),
-                    "Giving up after repeated retries",
-                    ripple::jv("chain", to_string(e.chainType_)),
-                    ripple::jv("commitAttests", attestedIDs.first),
-                    ripple::jv("createAttests", attestedIDs.second),
-                    ripple::jv(
-                        "batch",
-                        front.batch_.getJson(ripple::JsonOptions::none)));
+                // As if its result had been seen
+                forAttestIDs(
+                    i->batch_,
+                    [&](std::uint64_t id) { deleteFromDB(ct, id, false); },
+                    [&](std::uint64_t id) { deleteFromDB(ct, id, true); });
+                unjournalSubmission(ct, sqn);
+            }
+            else
+                retrySubmission(ct, std::move(*i));
+            i = pending.erase(i);
+        }
+        if (!pending.empty())
+            startReconcile(ct);
+        // The chain's queued submissions wait for the lookups to end
+        notify = !errored_[ct].empty() || pending.empty();
+    }
+    if (notify)
+    {
+        std::lock_guard l(cvMutexes_[lt_txnSubmit]);
+        cvs_[lt_txnSubmit].notify_one();
+    }
+}
+
+void
+Federator::checkGaps(ChainType dstChain, std::uint32_t ledgerSeq)
+{
+    // Init sync replays the history, and the ids with it
+    if (initSync_[dstChain].syncing_)
+        return;
+
+    auto const& listener = chains_[otherChain(dstChain)].listener_;
+    for (bool const isCreateAccount : {false, true})
+    {
+        auto& gaps =
+            isCreateAccount ? createGaps_[dstChain] : claimGaps_[dstChain];
+        for (auto& b : gaps.due(ledgerSeq))
+        {
+            JLOGV(
+                j_.info(),
+                "backfilling gap",
+                ripple::jv("chain", to_string(dstChain)),
+                ripple::jv("create_account", isCreateAccount),
+                ripple::jv("ids", b.ids.size()),
+                ripple::jv("first", b.ids.front()),
+                ripple::jv("last", b.ids.back()),
+                ripple::jv("from_ledger", b.fromLedger),
+                ripple::jv("to_ledger", b.toLedger));
+            listener->spawn(
+                [self = shared_from_this(),
+                 dstChain,
+                 isCreateAccount,
+                 b = std::move(b)]() mutable {
+                    return self->backfill(
+                        dstChain, isCreateAccount, std::move(b));
+                });
+        }
+    }
+}
+
+boost::asio::awaitable<void>
+Federator::backfill(
+    ChainType dstChain,
+    bool isCreateAccount,
+    GapDetector::Backfill b)
+{
+    auto const srcChain = otherChain(dstChain);
+    auto const listener = chains_[srcChain].listener_;
+    auto& gaps = isCreateAccount ? createGaps_[dstChain] : claimGaps_[dstChain];
+
+    // The missing id of a commit on the door account, if it is one
+    auto const missingID = [&](Json::Value const& tx, Json::Value const& meta)
+        -> std::optional<std::uint64_t> {
+        auto const type = rpcResultParse::parseXChainTxnType(tx);
+        std::optional<std::uint64_t> id;
+        if (isCreateAccount && type == XChainTxnType::xChainCreateAccount)
+            id = rpcResultParse::parseCreateCount(meta);
+        else if (!isCreateAccount && type == XChainTxnType::xChainCommit)
+            id = Json::getOptional<std::uint64_t>(tx, ripple::sfXChainClaimID);
+        if (!id || rpcResultParse::parseBridge(tx) != bridge_ ||
+            !std::binary_search(b.ids.begin(), b.ids.end(), *id))
+            return std::nullopt;
+        return id;
+    };
+
+    std::vector<std::uint64_t> found;
+    try
+    {
+        Json::Value params;
+        params[ripple::jss::account] = ripple::toBase58(
+            srcChain == ChainType::locking ? bridge_.lockingChainDoor()
+                                           : bridge_.issuingChainDoor());
+        params[ripple::jss::ledger_index_min] = b.fromLedger;
+        params[ripple::jss::ledger_index_max] = b.toLedger;
+        params[ripple::jss::forward] = true;
+        params[ripple::jss::limit] = 200;
+
+        while (found.size() < b.ids.size())
+        {
+            auto const reply = co_await listener->request("account_tx", params);
+            auto const& result = reply[ripple::jss::result];
+            if (!result[ripple::jss::transactions].isArray())
+                throw std::runtime_error("bad account_tx reply");
+
+            for (auto const& entry : result[ripple::jss::transactions])
+            {
+                auto const& meta = entry[ripple::jss::meta];
+                auto const id = missingID(entry[ripple::jss::tx], meta);
+                if (!id)
+                    continue;
+
+                listener->processAccountTx(entry);
+                found.push_back(*id);
             }
-            submitted_[e.chainType_].pop_front();
+
+            if (!result.isMember(ripple::jss::marker))
+                break;
+            params[ripple::jss::marker] = result[ripple::jss::marker];
         }
-        notify = !errored_[e.chainType_].empty();
-    }
-    if (notify)
-    {
-        std::lock_guard l(cvMutexes_[lt_txnSubmit]);
-        cvs_[lt_txnSubmit].notify_one();
     }
-    else
+    catch (std::exception const& e)
     {
-        std::lock_guard bl{batchMutex_};
-        if (curClaimAtts_[e.chainType_].size() +
-                curCreateAtts_[e.chainType_].size() >
-            0)
-            pushAttOnSubmitTxn(bridge_, e.chainType_);
+        JLOGV(
+            j_.warn(),
+            "gap backfill failed",
+            ripple::jv("chain", to_string(dstChain)),
+            ripple::jv("create_account", isCreateAccount),
+            ripple::jv("what", e.what()));
+        gaps.failed(b);
+        co_return;
     }
+
+    auto const givenUp = gaps.backfilled(b, found);
+    // Claim ids may be allocated and never committed, but every create
+    // count is
+    JLOGV(
+        (isCreateAccount && !givenUp.empty()) ? j_.warn() : j_.info(),
+        "gap backfilled",
+        ripple::jv("chain", to_string(dstChain)),
+        ripple::jv("create_account", isCreateAccount),
+        ripple::jv("found", found.size()),
+        ripple::jv("given_up", givenUp.size()));
 }
 
 void
@@ -1174,6 +1598,8 @@ Federator::onEvent(event::XChainSignerListSet const& e)
     signerListInfo.presentInSignerList_ =
         e.signerList_.find(signingAcc) != e.signerList_.end();
     updateSignerListStatus(e.chainType_);
+    if (aggregation_)
+        aggregation_->setSigners(e.chainType_, e.signerList_);
 
     JLOGV(
         j_.info(),
@@ -1223,10 +1649,16 @@ Federator::onEvent(event::XChainAccountSet const& e)
 void
 Federator::pushAttOnSubmitTxn(
     ripple::STXChainBridge const& bridge,
-    ChainType chainType)
+    ChainType chainType,
+    bool mayHold)
 {
     // batch mutex must already be held
     bool notify = false;
+    // Claims completed since these were signed need no attestation
+    dropCompleted(
+        chainType, curClaimAtts_[chainType], curCreateAtts_[chainType]);
+    if (curClaimAtts_[chainType].empty() && curCreateAtts_[chainType].empty())
+        return;
     auto const& signerListInfo(signerListsInfo_[chainType]);
     if (signerListInfo.ignoreSignerList_ ||
         (signerListInfo.status_ != SignerListInfo::absent))
@@ -1236,6 +1668,20 @@ Federator::pushAttOnSubmitTxn(
             "in signer list, atestations proceed",
             ripple::jv("ChainType", to_string(chainType)));
 
+        if (auto const ledgerSeq = ledgerIndexes_[chainType].load();
+            mayHold && aggregation_ &&
+            !aggregation_->aggregating(chainType, ledgerSeq))
+        {
+            aggregation_->hold(
+                chainType,
+                {std::move(curClaimAtts_[chainType]),
+                 std::move(curCreateAtts_[chainType])},
+                ledgerSeq);
+            curClaimAtts_[chainType].clear();
+            curCreateAtts_[chainType].clear();
+            return;
+        }
+
         std::lock_guard tl{txnsMutex_};
         notify = txns_[ChainType::locking].empty() &&
             txns_[ChainType::issuing].empty();
@@ -1305,6 +1751,107 @@ Federator::pushAtt(
         pushAttOnSubmitTxn(bridge, chainType);
 }
 
+void
+Federator::aggregate(ChainType ct, std::uint32_t ledgerSeq)
+{
+    auto due = aggregation_->onLedger(ct, ledgerSeq);
+    for (auto const id : due.landedClaims)
+        deleteFromDB(ct, id, false);
+    for (auto const id : due.landedCreates)
+        deleteFromDB(ct, id, true);
+
+    if (due.received.empty() && due.expired.empty())
+        return;
+    JLOGV(
+        j_.debug(),
+        "aggregate",
+        ripple::jv("chain", to_string(ct)),
+        ripple::jv(
+            "received",
+            due.received.claims.size() + due.received.creates.size()),
+        ripple::jv(
+            "expired", due.expired.claims.size() + due.expired.creates.size()));
+
+    // Neither is held back again: received ones are submitted by the
+    // aggregator, and expired ones by their signer
+    std::lock_guard bl{batchMutex_};
+    auto& claims = curClaimAtts_[ct];
+    auto& creates = curCreateAtts_[ct];
+    for (auto* atts : {&due.received, &due.expired})
+    {
+        for (auto& att : atts->claims)
+        {
+            claims.emplace_back(std::move(att));
+            if (claims.size() + creates.size() >=
+                ripple::AttestationBatch::maxAttestations)
+                pushAttOnSubmitTxn(bridge_, ct, false);
+        }
+        for (auto& att : atts->creates)
+        {
+            creates.emplace_back(std::move(att));
+            if (claims.size() + creates.size() >=
+                ripple::AttestationBatch::maxAttestations)
+                pushAttOnSubmitTxn(bridge_, ct, false);
+        }
+    }
+    if (claims.size() + creates.size() > 0)
+        pushAttOnSubmitTxn(bridge_, ct, false);
+}
+
+std::size_t
+Federator::dropCompleted(
+    ChainType ct,
+    std::vector<ripple::AttestationBatch::AttestationClaim>& claims,
+    std::vector<ripple::AttestationBatch::AttestationCreateAccount>& creates)
+{
+    std::lock_guard l{completedMutex_};
+    auto const& completed = completed_[ct];
+    auto dropped = std::erase_if(claims, [&](auto const& att) {
+        return completed.claimIDs_.count(att.claimID) != 0;
+    });
+    dropped += std::erase_if(creates, [&](auto const& att) {
+        return completed.createCounts_.count(att.createCount) != 0;
+    });
+    suppressedAttests_ += dropped;
+    return dropped;
+}
+
+void
+Federator::pruneCompleted(ChainType ct, std::vector<Submission>& txns)
+{
+    std::vector<Submission> kept;
+    kept.reserve(txns.size());
+    for (auto& txn : txns)
+    {
+        auto const& batch = txn.batch_;
+        std::vector<ripple::AttestationBatch::AttestationClaim> claims(
+            batch.claims().begin(), batch.claims().end());
+        std::vector<ripple::AttestationBatch::AttestationCreateAccount>
+            creates(batch.creates().begin(), batch.creates().end());
+        if (dropCompleted(ct, claims, creates) == 0)
+        {
+            kept.push_back(std::move(txn));
+            continue;
+        }
+        if (claims.empty() && creates.empty())
+        {
+            ++suppressedTxns_;
+            continue;
+        }
+        kept.emplace_back(
+            txn.lastLedgerSeq_,
+            txn.accountSqn_,
+            ripple::STXChainAttestationBatch{
+                bridge_,
+                claims.begin(),
+                claims.end(),
+                creates.begin(),
+                creates.end()});
+        kept.back().retriesAllowed_ = txn.retriesAllowed_;
+    }
+    txns.swap(kept);
+}
+
 void
 Federator::submitTxn(Submission const& submission, ChainType dstChain)
 {
@@ -1333,6 +1880,47 @@ Federator::submitTxn(Submission const& submission, ChainType dstChain)
         txnSubmit.keypair,
         j_);
 
+    {
+        // Tracked from when the submission was queued, so the hash is set
+        // there
+        std::lock_guard l{txnsMutex_};
+        auto& subs = submitted_[dstChain];
+        if (auto const i = std::find_if(
+                subs.begin(),
+                subs.end(),
+                [&](auto const& i) {
+                    return i.accountSqn_ == submission.accountSqn_;
+                });
+            i != subs.end())
+            i->txnHash_ = toSubmit.getTransactionID();
+    }
+
+    {
+        SubmissionRecord r;
+        r.chain = dstChain;
+        r.accountSqn = submission.accountSqn_;
+        r.lastLedgerSeq = submission.lastLedgerSeq_;
+        r.retriesAllowed = submission.retriesAllowed_;
+        ripple::Serializer s;
+        submission.batch_.add(s);
+        r.batch = s.peekData();
+        r.signedTxn = toSubmit.getSerializer().peekData();
+        try
+        {
+            journalSubmission(r);
+        }
+        catch (std::exception const& e)
+        {
+            // Still submitted; a restart would attest these claims again
+            JLOGV(
+                j_.error(),
+                "error journaling submission",
+                ripple::jv("chain", to_string(dstChain)),
+                ripple::jv("accountSqn", submission.accountSqn_),
+                ripple::jv("what", e.what()));
+        }
+    }
+
     Json::Value const request = [&] {
         Json::Value r;
         r[ripple::jss::tx_blob] =
@@ -1340,7 +1928,8 @@ Federator::submitTxn(Submission const& submission, ChainType dstChain)
         return r;
     }();
 
-    auto callback = [&](Json::Value const& v) {
+    // Runs after this returns, so it captures nothing by reference
+    auto callback = [this, dstChain, attestedIDs](Json::Value const& v) {
         // drop tem submissions. Other errors will be processed after txn TTL.
         if (v.isMember(ripple::jss::result))
         {
@@ -1361,18 +1950,17 @@ Federator::submitTxn(Submission const& submission, ChainType dstChain)
                             std::uint32_t sqn =
                                 txJson[ripple::jss::Sequence].asUInt();
 
-                            std::lock_guard l{txnsMutex_};
-                            auto& subs = submitted_[dstChain];
-                            if (auto i = std::find_if(
+                            {
+                                std::lock_guard l{txnsMutex_};
+                                auto& subs = submitted_[dstChain];
+                                auto const i = std::find_if(
                                     subs.begin(),
                                     subs.end(),
                                     [&](auto const& i) {
                                         return i.accountSqn_ == sqn;
                                     });
-                                i != subs.end())
-                            {
-                                auto const attestedIDs =
-                                    forAttestIDs(submission.batch_);
+                                if (i == subs.end())
+                                    return;
                                 JLOGV(
                                     j_.warn(),
                                     "Tem txn submit result, removing "
@@ -1385,6 +1973,9 @@ Federator::submitTxn(Submission const& submission, ChainType dstChain)
                                         "createAttests", attestedIDs.second));
                                 subs.erase(i);
                             }
+                            // Not under txnsMutex_: the event thread holds the
+                            // storage batch while it takes that mutex
+                            unjournalSubmission(dstChain, sqn);
                         }
                     }
                 }
@@ -1394,6 +1985,55 @@ Federator::submitTxn(Submission const& submission, ChainType dstChain)
 
     chains_[dstChain].listener_->send("submit", request, callback);
     JLOG(j_.trace()) << "txn submitted";  // the listener logs as well
+
+    if (auto& subs = app_.subscriptions();
+        subs.hasSubscribers(rpc::Subscriptions::Stream::submissions))
+    {
+        Json::Value jv{Json::objectValue};
+        jv["type"] = "submission";
+        jv["chain_type"] = to_string(dstChain);
+        jv["tx_hash"] = to_string(toSubmit.getTransactionID());
+        jv["account_sequence"] = submission.accountSqn_;
+        jv["last_ledger_sequence"] = submission.lastLedgerSeq_;
+        Json::Value claimIDs{Json::arrayValue};
+        Json::Value createCounts{Json::arrayValue};
+        forAttestIDs(
+            submission.batch_,
+            [&](std::uint64_t id) { claimIDs.append(fmt::format("{:X}", id)); },
+            [&](std::uint64_t id) {
+                createCounts.append(fmt::format("{:X}", id));
+            });
+        jv["claim_ids"] = std::move(claimIDs);
+        jv["create_counts"] = std::move(createCounts);
+        // For aggregation peers to find their attestations in
+        ripple::Serializer batch;
+        submission.batch_.add(batch);
+        jv["batch"] = ripple::strHex(batch.peekData());
+        subs.publish(rpc::Subscriptions::Stream::submissions, jv);
+    }
+}
+
+void
+Federator::publishAttestation(
+    ChainType dstChain,
+    std::string const& txnIdHex,
+    std::uint32_t ledgerSeq,
+    ripple::STXChainAttestationBatch const& batch)
+{
+    Json::Value jv{Json::objectValue};
+    jv["type"] = "attestation";
+    jv["chain_type"] = to_string(dstChain);
+    jv["tx_hash"] = txnIdHex;
+    jv["ledger_index"] = ledgerSeq;
+    // For aggregation peers to tell the turn it was sent in
+    jv["destination_ledger_index"] = ledgerIndexes_[dstChain].load();
+    jv["XChainAttestationBatch"] = batch.getJson(ripple::JsonOptions::none);
+    // Exact bytes, for aggregation peers to check the signature of
+    ripple::Serializer s;
+    batch.add(s);
+    jv["batch"] = ripple::strHex(s.peekData());
+    app_.subscriptions().publish(
+        rpc::Subscriptions::Stream::attestations, jv);
 }
 
 void
@@ -1407,9 +2047,29 @@ Federator::unlockMainLoop()
     }
 }
 
+// Events that steer how commits are handled, rather than commits. They are
+// handled ahead of the commits queued before them. Resync and EndOfHistory
+// mark a place in the commits, so they are not.
+static bool
+isControlEvent(FederatorEvent const& e)
+{
+    using namespace event;
+    return std::holds_alternative<NewLedger>(e) ||
+        std::holds_alternative<XChainAttestsResult>(e) ||
+        std::holds_alternative<XChainClaimsCompleted>(e) ||
+        std::holds_alternative<SubmissionsReconciled>(e) ||
+        std::holds_alternative<XChainSignerListSet>(e) ||
+        std::holds_alternative<XChainSetRegularKey>(e) ||
+        std::holds_alternative<XChainAccountSet>(e) ||
+        std::holds_alternative<HeartbeatTimer>(e);
+}
+
 void
 Federator::mainLoop()
 {
+    // Commits handled between two looks for control events
+    static constexpr std::size_t bulkChunk = 256;
+
     auto const lt = lt_event;
     {
         std::unique_lock l{loopMutexes_[lt]};
@@ -1418,14 +2078,46 @@ Federator::mainLoop()
 
     std::vector<FederatorEvent> localEvents;
     localEvents.reserve(16);
+    std::vector<FederatorEvent> control;
+    std::deque<FederatorEvent> bulk;
+    std::vector<FederatorEvent> chunk;
     while (!requestStop_)
     {
+        if (activatePending_.exchange(false))
+            onActivate();
+
         {
             std::lock_guard l{eventsMutex_};
             assert(localEvents.empty());
             localEvents.swap(events_);
         }
-        if (localEvents.empty())
+        for (auto& e : localEvents)
+        {
+            if (!isControlEvent(e))
+            {
+                bulk.push_back(std::move(e));
+                continue;
+            }
+            // A ledger supersedes the earlier ones of its chain. It keeps its
+            // own place, after the results that came before it.
+            if (auto const nl = std::get_if<event::NewLedger>(&e))
+            {
+                auto const it = std::find_if(
+                    control.begin(), control.end(), [&](auto const& c) {
+                        auto const p = std::get_if<event::NewLedger>(&c);
+                        return p && p->chainType_ == nl->chainType_;
+                    });
+                if (it != control.end())
+                {
+                    control.erase(it);
+                    ++coalescedLedgers_;
+                }
+            }
+            control.push_back(std::move(e));
+        }
+        localEvents.clear();
+
+        if (control.empty() && bulk.empty())
         {
             using namespace std::chrono_literals;
             // In rare cases, an event may be pushed and the condition
@@ -1438,9 +2130,26 @@ Federator::mainLoop()
             continue;
         }
 
-        for (auto const& event : localEvents)
-            std::visit([this](auto&& e) { this->onEvent(e); }, event);
-        localEvents.clear();
+        auto const n = std::min(bulk.size(), bulkChunk);
+        chunk.assign(
+            std::make_move_iterator(bulk.begin()),
+            std::make_move_iterator(bulk.begin() + n));
+        bulk.erase(bulk.begin(), bulk.begin() + n);
+        bulkBacklog_ = bulk.size();
+
+        {
+            auto presigned = presign(chunk);
+            for (auto const& c : control)
+                std::visit([this](auto&& e) { this->onEvent(e); }, c);
+            for (std::size_t i = 0; i < chunk.size(); ++i)
+            {
+                presigned_ = presigned.empty() ? nullptr : &presigned[i];
+                std::visit([this](auto&& e) { this->onEvent(e); }, chunk[i]);
+            }
+            presigned_ = nullptr;
+        }
+        control.clear();
+        chunk.clear();
     }
 }
 
@@ -1470,9 +2179,16 @@ Federator::txnSubmitLoop()
         loopCvs_[lt].wait(l, [this, lt] { return !loopLocked_[lt]; });
     }
 
-    ChainArray<bool> waitingAccountInfo{false, false};
-    ChainArray<std::uint32_t> accountInfoSqns{0u, 0u};
-    std::mutex accountInfoMutex;
+    // Shared with the account_info coroutines, which may outlive this loop
+    struct AccountInfoState
+    {
+        std::mutex m;
+        ChainArray<bool> waiting{false, false};
+        ChainArray<std::uint32_t> sqns{0u, 0u};
+    };
+    auto const accountInfo = std::make_shared<AccountInfoState>();
+    // Least next sequence after restoring the journal, 0 if not restoring
+    ChainArray<std::uint32_t> minSqns{0u, 0u};
     // return if ready to submit txn
     auto getReady = [&](ChainType chain) -> bool {
         if (ledgerIndexes_[chain] == 0 || ledgerFees_[chain] == 0)
@@ -1488,61 +2204,90 @@ Federator::txnSubmitLoop()
         if (accountSqns_[chain] != 0)
             return true;
 
+        auto& listener = chains_[chain].listener_;
+
+        // Read while connecting. Good only if nothing was validated since,
+        // and not right after restoring the journal.
+        if (auto const sqn = listener->takeWitnessSequence();
+            sqn && sqn->ledgerIndex == ledgerIndexes_[chain].load() &&
+            minSqns[chain] == 0)
+        {
+            accountSqns_[chain] = sqn->sequence;
+            return true;
+        }
+
         {
-            std::lock_guard aiLock{accountInfoMutex};
-            if (waitingAccountInfo[chain])
+            std::lock_guard aiLock{accountInfo->m};
+            if (accountInfo->waiting[chain])
                 return false;
 
-            if (accountInfoSqns[chain] != 0)
+            if (accountInfo->sqns[chain] != 0)
             {
-                accountSqns_[chain] = accountInfoSqns[chain];
-                accountInfoSqns[chain] = 0;
+                accountSqns_[chain] =
+                    std::max(accountInfo->sqns[chain], minSqns[chain]);
+                accountInfo->sqns[chain] = 0;
+                minSqns[chain] = 0;
                 return true;
             }
-            waitingAccountInfo[chain] = true;
+            accountInfo->waiting[chain] = true;
         }
 
-        auto callback = [&, ct = chain](Json::Value const& accountInfo) {
-            JLOGV(
-                j_.trace(),
-                "txn submit account info",
-                ripple::jv("accountInfo", accountInfo));
-            if (accountInfo.isMember(ripple::jss::result) &&
-                accountInfo[ripple::jss::result].isMember("account_data"))
+        // Submissions from before the restore may be applied but not yet
+        // validated
+        std::string ledger = minSqns[chain] ? "current" : "validated";
+        listener->spawn([listener,
+                         accountInfo,
+                         ct = chain,
+                         account = accountStrs[chain],
+                         ledger = std::move(ledger),
+                         j = j_]() -> boost::asio::awaitable<void> {
+            // On failure the next getReady asks again
+            auto const sqn =
+                co_await listener->accountSequence(account, ledger);
+            std::lock_guard aiLock{accountInfo->m};
+            accountInfo->waiting[ct] = false;
+            if (sqn)
             {
-                auto const ad =
-                    accountInfo[ripple::jss::result]["account_data"];
-                if (ad.isMember(ripple::jss::Sequence) &&
-                    ad[ripple::jss::Sequence].isIntegral())
-                {
-                    std::lock_guard aiLock{accountInfoMutex};
-                    assert(waitingAccountInfo[ct] && accountInfoSqns[ct] == 0);
-                    accountInfoSqns[ct] = ad[ripple::jss::Sequence].asUInt();
-                    waitingAccountInfo[ct] = false;
-                    JLOG(j_.trace())
-                        << "got account sqn " << accountInfoSqns[ct];
-                }
+                accountInfo->sqns[ct] = sqn->sequence;
+                JLOG(j.trace()) << "got account sqn " << sqn->sequence;
             }
-        };
-        Json::Value request;
-        request[ripple::jss::account] = accountStrs[chain];
-        request[ripple::jss::ledger_index] = "validated";
-        chains_[chain].listener_->send("account_info", request, callback);
+        });
         JLOG(j_.trace()) << "Not ready, waiting account sqn";
         return false;
     };
 
     std::vector<Submission> localTxns;
     ChainType submitChain = ChainType::locking;
+    auto const* const standby = app_.standby();
     while (!requestStop_)
     {
+        // Nothing is submitted without a lease that is still valid, so a
+        // witness that stalled past its lease can not race the one that
+        // took over
+        bool const fenced = !active_ || (standby && !standby->leaseValid());
+        if (!fenced)
+        {
+            for (auto const ct : {ChainType::locking, ChainType::issuing})
+                resendRestored(ct);
+        }
+
         {
             std::lock_guard l{txnsMutex_};
             assert(localTxns.empty());
-            for (auto i = 0; i < 2; ++i)
+            for (auto const ct : {ChainType::locking, ChainType::issuing})
+            {
+                if (restoredSqns_[ct] != 0)
+                {
+                    minSqns[ct] = restoredSqns_[ct];
+                    restoredSqns_[ct] = 0;
+                    accountSqns_[ct] = 0;
+                }
+            }
+            for (auto i = 0; i < 2 && !fenced; ++i)
             {
                 submitChain = otherChain(submitChain);
-                if (accountStrs[submitChain].empty())
+                if (accountStrs[submitChain].empty() ||
+                    !reconciling_[submitChain].empty())
                     continue;
                 if (errored_[submitChain].empty())
                 {
@@ -1568,6 +2313,7 @@ Federator::txnSubmitLoop()
             }
         }
 
+        pruneCompleted(submitChain, localTxns);
         if (localTxns.empty())
         {
             using namespace std::chrono_literals;
@@ -1592,14 +2338,8 @@ Federator::txnSubmitLoop()
             }
             {
                 // TODO move out of submit loop
-                auto session = app_.getXChainTxnDB().checkoutDb();
-                auto const sql = fmt::format(
-                    R"sql(UPDATE {table_name} SET LedgerSeq = :ledger_sqn WHERE ChainType = :chain_type;
-            )sql",
-                    fmt::arg("table_name", db_init::xChainSyncTable));
-                auto const chainType = static_cast<std::uint32_t>(submitChain);
-                *session << sql, soci::use(txn.lastLedgerSeq_),
-                    soci::use(chainType);
+                app_.storage().setSyncLedgerSeq(
+                    submitChain, txn.lastLedgerSeq_);
                 JLOGV(
                     j_.trace(),
                     "syncDB update ledgerSqn txnSubmitLoop",
@@ -1619,11 +2359,36 @@ Federator::getInfo() const
     // Track transactons per secons
     // Track when last transaction or event was submitted
     Json::Value ret{Json::objectValue};
+    ret["active"] = active_.load();
+    ret["signing"] = signingLoop_->getInfo();
+    ret["signing"]["threads"] = static_cast<Json::UInt>(signingThreads_);
+    if (aggregation_)
+        ret["aggregation"] = aggregation_->getInfo();
+    {
+        // Not submitted because their claims were completed
+        std::lock_guard l{completedMutex_};
+        ret["suppressed_attestations"] =
+            static_cast<Json::UInt>(suppressedAttests_);
+    }
+    ret["suppressed_submissions"] =
+        static_cast<Json::UInt>(suppressedTxns_.load());
+    // Expired submissions found validated
+    ret["reconciled_landed"] =
+        static_cast<Json::UInt>(reconciledLanded_.load());
+    // Expired submissions not found, so resubmitted
+    ret["reconciled_missing"] =
+        static_cast<Json::UInt>(reconciledMissing_.load());
+    if (speculative_.enabled())
+        ret["speculative"] = speculative_.getInfo();
     {
         // Pending events
         // In most cases, events have been moved by event loop thread
         std::lock_guard l{eventsMutex_};
         ret["pending_events_size"] = (int)events_.size();
+        // Taken by the event thread, behind the control events
+        ret["bulk_backlog"] = static_cast<Json::UInt>(bulkBacklog_.load());
+        ret["coalesced_ledgers"] =
+            static_cast<Json::UInt>(coalescedLedgers_.load());
         if (events_.size() > 0)
         {
             Json::Value pendingEvents{Json::arrayValue};
@@ -1643,6 +2408,8 @@ Federator::getInfo() const
         side["initiating"] = initSync_[ct].syncing_ ? "True" : "False";
         side["ledger_index"] = ledgerIndexes_[ct].load();
         side["fee"] = ledgerFees_[ct].load();
+        side["claim_gaps"] = claimGaps_[ct].getInfo();
+        side["create_gaps"] = createGaps_[ct].getInfo();
 
         int commitCount = 0;
         int createCount = 0;
@@ -1695,6 +2462,8 @@ Federator::getInfo() const
             if (createCount > 0)
                 errored["create_account_attests"] = createAttests;
             side["errored"] = errored;
+            side["reconciling"] =
+                static_cast<Json::UInt>(reconciling_[ct].size());
 
             getAttests(txns_[ct]);
         }
@@ -1726,35 +2495,161 @@ Federator::getInfo() const
     return ret;
 }
 
-void
-Federator::deleteFromDB(ChainType ct, std::uint64_t id, bool isCreateAccount)
+std::unordered_map<std::uint64_t, Json::Value>
+Federator::getSubmissionStatus(
+    ChainType ct,
+    bool isCreateAccount,
+    std::vector<std::uint64_t> const& ids) const
 {
-    auto session = app_.getXChainTxnDB().checkoutDb();
-    auto const& tblName = [&]() {
-        if (isCreateAccount)
-            return db_init::xChainCreateAccountTableName(
-                ct == ChainType::locking ? ChainDir::issuingToLocking
-                                         : ChainDir::lockingToIssuing);
-        else
-            return db_init::xChainTableName(
-                ct == ChainType::locking ? ChainDir::issuingToLocking
-                                         : ChainDir::lockingToIssuing);
-    }();
+    std::unordered_map<std::uint64_t, Json::Value> ret;
+    if (ids.empty())
+        return ret;
+
+    std::unordered_set<std::uint64_t> const wanted(ids.begin(), ids.end());
+    auto const addStatus = [&](std::uint64_t id,
+                               char const* status,
+                               Submission const* submission) {
+        if (!wanted.count(id) || ret.count(id))
+            return;
+        Json::Value r{Json::objectValue};
+        r["status"] = status;
+        if (submission)
+        {
+            r["account_sequence"] = submission->accountSqn_;
+            r["last_ledger_sequence"] = submission->lastLedgerSeq_;
+            r["retries_left"] = submission->retriesAllowed_;
+        }
+        ret.emplace(id, std::move(r));
+    };
+
+    auto const scan = [&](auto const& submissions, char const* status) {
+        for (auto const& s : submissions)
+        {
+            auto const onID = [&](std::uint64_t id) {
+                addStatus(id, status, &s);
+            };
+            if (isCreateAccount)
+                forAttestIDs(s.batch_, [](std::uint64_t) {}, onID);
+            else
+                forAttestIDs(s.batch_, onID);
+        }
+    };
 
-    auto const sql = [&]() {
+    {
+        // A resubmitted batch can be in more than one collection. Report the
+        // most recent state first.
+        std::lock_guard l{txnsMutex_};
+        scan(submitted_[ct], "submitted");
+        scan(txns_[ct], "queued");
+        scan(errored_[ct], "errored");
+    }
+    {
+        std::lock_guard l{batchMutex_};
         if (isCreateAccount)
-            return fmt::format(
-                R"sql(DELETE FROM {table_name} WHERE CreateCount = :cid;
-                )sql",
-                fmt::arg("table_name", tblName));
+        {
+            for (auto const& a : curCreateAtts_[ct])
+                addStatus(a.createCount, "pending", nullptr);
+        }
         else
-            return fmt::format(
-                R"sql(DELETE FROM {table_name} WHERE ClaimID = :cid;
-                )sql",
-                fmt::arg("table_name", tblName));
-    }();
-    *session << sql, soci::use(id);
-};
+        {
+            for (auto const& a : curClaimAtts_[ct])
+                addStatus(a.claimID, "pending", nullptr);
+        }
+    }
+
+    return ret;
+}
+
+void
+Federator::deleteFromDB(ChainType ct, std::uint64_t id, bool isCreateAccount)
+{
+    auto const dir = ct == ChainType::locking ? ChainDir::issuingToLocking
+                                              : ChainDir::lockingToIssuing;
+    auto const t = isCreateAccount ? AttestationTable::createAccount
+                                   : AttestationTable::claim;
+    std::lock_guard l{stateMutex_};
+    app_.storage().erase(dir, t, id);
+    app_.attestationCache().erase(dir, t, id);
+
+    Json::Value jv{Json::objectValue};
+    jv["chain_type"] = to_string(ct);
+    jv["create_account"] = isCreateAccount;
+    jv["id"] = fmt::format("{:X}", id);
+    publishState("erase_attestation", std::move(jv));
+}
+
+void
+Federator::journalSubmission(SubmissionRecord const& r)
+{
+    std::lock_guard l{stateMutex_};
+    app_.storage().putSubmission(r);
+    publishState("put_submission", r.toJson());
+}
+
+void
+Federator::unjournalSubmission(ChainType ct, std::uint32_t accountSqn)
+{
+    std::lock_guard l{stateMutex_};
+    app_.storage().eraseSubmission(ct, accountSqn);
+
+    Json::Value jv{Json::objectValue};
+    jv["chain_type"] = to_string(ct);
+    jv["account_sequence"] = accountSqn;
+    publishState("erase_submission", std::move(jv));
+}
+
+void
+Federator::publishState(char const* op, Json::Value jv)
+{
+    // Numbered even with no subscribers, so a snapshot taken now tells a
+    // standby that subscribes later which messages it already covers
+    auto const seq = ++stateSeq_;
+    auto& subs = app_.subscriptions();
+    if (!subs.hasSubscribers(rpc::Subscriptions::Stream::state))
+        return;
+    jv["type"] = "state";
+    jv["op"] = op;
+    jv["sequence"] = std::to_string(seq);
+    subs.publish(rpc::Subscriptions::Stream::state, jv);
+}
+
+Json::Value
+Federator::journalSnapshot() const
+{
+    // Journal writes are not batched, so storage has every change numbered
+    // so far
+    std::lock_guard l{stateMutex_};
+    Json::Value submissions{Json::arrayValue};
+    for (auto const& r : app_.storage().getSubmissions())
+        submissions.append(r.toJson());
+
+    Json::Value r{Json::objectValue};
+    r["submissions"] = std::move(submissions);
+    r["sequence"] = std::to_string(stateSeq_);
+    return r;
+}
+
+void
+Federator::activate()
+{
+    activatePending_ = true;
+    std::lock_guard l(cvMutexes_[lt_event]);
+    cvs_[lt_event].notify_one();
+}
+
+void
+Federator::onActivate()
+{
+    restoreSubmissions();
+    active_ = true;
+    JLOG(j_.info()) << "federator active";
+    // Chains still in init sync send their stored attestations when it ends
+    for (auto const ct : {ChainType::locking, ChainType::issuing})
+    {
+        if (submitting(ct) && !initSync_[ct].syncing_)
+            sendDBAttests(ct);
+    }
+}
 
 void
 Federator::pullAndAttestTx(
@@ -1770,13 +2665,125 @@ Federator::pullAndAttestTx(
         return;
     }
 
-    auto callback = [this, srcChain = ct](Json::Value const& v) {
-        chains_[srcChain].listener_->processTx(v);
-    };
-
     Json::Value request;
     request[ripple::jss::transaction] = to_string(txHash);
-    chains_[ct].listener_->send("tx", request, callback);
+    auto& listener = chains_[ct].listener_;
+    listener->spawn([listener, request]() -> boost::asio::awaitable<void> {
+        listener->processTx(co_await listener->request("tx", request));
+    });
+}
+
+void
+Federator::startBulkAttest(
+    ripple::STXChainBridge const& bridge,
+    BulkAttest::Params params,
+    Json::Value& result)
+{
+    // Jobs are kept for their results, up to this many
+    static constexpr std::size_t maxBulkJobs = 8;
+
+    if (bridge != bridge_)
+    {
+        result["error"] = "unknown bridge";
+        return;
+    }
+    if (initSync_[otherChain(params.chain)].syncing_)
+    {
+        result["error"] = "syncing";
+        return;
+    }
+
+    std::shared_ptr<BulkAttest> job;
+    {
+        std::lock_guard l{bulkMutex_};
+        if (std::any_of(bulkJobs_.begin(), bulkJobs_.end(), [](auto const& j) {
+                return j->running();
+            }))
+        {
+            result["error"] = "a bulk attest job is already running";
+            return;
+        }
+
+        auto const ct = params.chain;
+        job = std::make_shared<BulkAttest>(
+            nextBulkID_++,
+            std::move(params),
+            chains_[ct].listener_,
+            bridge_,
+            app_.storage(),
+            j_);
+        bulkJobs_.push_back(job);
+        if (bulkJobs_.size() > maxBulkJobs)
+            bulkJobs_.pop_front();
+    }
+    job->start();
+    result["result"] = job->getInfo(0, 0);
+}
+
+void
+Federator::startResync(
+    ripple::STXChainBridge const& bridge,
+    ChainType ct,
+    std::optional<std::uint32_t> ledger,
+    std::optional<ripple::uint256> txHash,
+    std::uint32_t concurrency,
+    Json::Value& result)
+{
+    auto const current = ledgerIndexes_[ct].load();
+    if (current == 0)
+    {
+        result["error"] = "no validated ledger yet";
+        return;
+    }
+    if (ledger && *ledger > current)
+    {
+        result["error"] = "ledger_index is past the validated ledger";
+        return;
+    }
+
+    BulkAttest::Params params;
+    params.chain = ct;
+    params.concurrency = concurrency;
+    // The start is resolved by the job when given as a transaction
+    params.ledgers.emplace(ledger.value_or(0), current);
+    params.fromTx = txHash;
+    // Pushed as events, so the hold is in place before any commit of the
+    // range is handled, and ends after the last one
+    std::weak_ptr<Federator> weak = weak_from_this();
+    params.onStart = [weak, ct](ripple::uint256 const& prev) {
+        if (auto self = weak.lock())
+            self->push(event::Resync{ct, true, prev});
+    };
+    params.onDone = [weak, ct] {
+        if (auto self = weak.lock())
+            self->push(event::Resync{ct, false, {}});
+    };
+    startBulkAttest(bridge, std::move(params), result);
+}
+
+void
+Federator::getBulkAttest(
+    std::uint32_t id,
+    std::size_t from,
+    std::size_t limit,
+    Json::Value& result) const
+{
+    std::shared_ptr<BulkAttest> job;
+    {
+        std::lock_guard l{bulkMutex_};
+        auto const it = std::find_if(
+            bulkJobs_.begin(), bulkJobs_.end(), [&](auto const& j) {
+                return j->id() == id;
+            });
+        if (it != bulkJobs_.end())
+            job = *it;
+    }
+    if (!job)
+    {
+        result["error"] = "unknown job";
+        return;
+    }
+    result["result"] = job->getInfo(from, limit);
 }
 
 Submission::Submission(
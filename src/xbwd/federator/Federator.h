@@ -19,11 +19,18 @@
 //==============================================================================
 
 #include <xbwd/app/Config.h>
+#include <xbwd/app/IOLoop.h>
 #include <xbwd/basics/ChainTypes.h>
 #include <xbwd/basics/ThreadSaftyAnalysis.h>
 #include <xbwd/client/ChainListener.h>
+#include <xbwd/federator/Aggregation.h>
+#include <xbwd/federator/BulkAttest.h>
 #include <xbwd/federator/FederatorEvents.h>
+#include <xbwd/federator/GapDetector.h>
+#include <xbwd/federator/Reconciliation.h>
+#include <xbwd/federator/SpeculativeClaims.h>
 
+#include <ripple/basics/Blob.h>
 #include <ripple/beast/net/IPEndpoint.h>
 #include <ripple/beast/utility/Journal.h>
 #include <ripple/json/json_value.h>
@@ -38,15 +45,20 @@
 #include <condition_variable>
 #include <deque>
 #include <list>
+#include <map>
 #include <memory>
 #include <optional>
+#include <set>
 #include <thread>
 #include <unordered_map>
+#include <utility>
+#include <variant>
 #include <vector>
 
 namespace xbwd {
 
 class App;
+struct SubmissionRecord;
 
 // resubmit at most 5 times.
 static constexpr std::uint8_t MaxResubmits = 5;
@@ -65,6 +77,9 @@ struct Submission
     uint32_t lastLedgerSeq_;
     uint32_t accountSqn_;
     ripple::STXChainAttestationBatch batch_;
+    // Hash of the transaction last submitted, zero until then. Looked up
+    // once the submission expires.
+    ripple::uint256 txnHash_;
 
     Submission(
         uint32_t lastLedgerSeq,
@@ -110,11 +125,23 @@ class Federator : public std::enable_shared_from_this<Federator>
 
     mutable std::mutex eventsMutex_;
     std::vector<FederatorEvent> GUARDED_BY(eventsMutex_) events_;
+    // Commits taken from events_ and not handled yet
+    std::atomic<std::size_t> bulkBacklog_ = 0;
+    // NewLedger events dropped for a later one of the same chain
+    std::atomic<std::uint64_t> coalescedLedgers_ = 0;
 
     mutable std::mutex txnsMutex_;
     ChainArray<std::vector<Submission>> GUARDED_BY(txnsMutex_) txns_;
     ChainArray<std::list<Submission>> GUARDED_BY(txnsMutex_) submitted_;
     ChainArray<std::vector<Submission>> GUARDED_BY(txnsMutex_) errored_;
+    // Expired submissions whose outcome is looked up before they are
+    // resubmitted. Nothing else is submitted to the chain meanwhile.
+    ChainArray<std::vector<Submission>> GUARDED_BY(txnsMutex_) reconciling_;
+    ChainArray<bool> reconcileInFlight_{false, false};  // event thread only
+    // Expired submissions found validated
+    std::atomic<std::uint64_t> reconciledLanded_ = 0;
+    // Expired submissions not found, so resubmitted
+    std::atomic<std::uint64_t> reconciledMissing_ = 0;
 
     ripple::KeyType const keyType_;
     ripple::PublicKey const signingPK_;
@@ -122,6 +149,16 @@ class Federator : public std::enable_shared_from_this<Federator>
 
     ChainArray<SignerListInfo> signerListsInfo_;
 
+    // An attestation signed by the signing pool ahead of its event
+    using Presigned = std::variant<
+        std::monostate,
+        ripple::AttestationBatch::AttestationClaim,
+        ripple::AttestationBatch::AttestationCreateAccount>;
+    std::unique_ptr<IOLoop> signingLoop_;
+    std::size_t const signingThreads_;
+    // Presigned attestation of the event being handled. Event thread only.
+    Presigned* presigned_ = nullptr;
+
     // Use a condition variable to prevent busy waiting when the queue is
     // empty
     mutable std::array<std::mutex, lt_last> cvMutexes_;
@@ -149,6 +186,25 @@ class Federator : public std::enable_shared_from_this<Federator>
     ChainArray<std::atomic<std::uint32_t>> ledgerIndexes_{0u, 0u};
     ChainArray<std::atomic<std::uint32_t>> ledgerFees_{0u, 0u};
     ChainArray<std::uint32_t> accountSqns_{0u, 0u};  // tx submit thread only
+    // Signed blobs of the journaled submissions restored from storage, with
+    // their last ledger. Sent again once the chain's ledger is known.
+    ChainArray<std::vector<std::pair<std::uint32_t, ripple::Blob>>>
+        GUARDED_BY(txnsMutex_) restored_;
+    // Least next account sequence after restoring the journal: one past the
+    // restored submissions, else 1. Taken by the submit thread, which then
+    // reads the sequence from the current ledger. 0 once taken.
+    ChainArray<std::uint32_t> GUARDED_BY(txnsMutex_) restoredSqns_{0u, 0u};
+
+    // False while standing by for another witness: attestations are signed
+    // and stored, but not submitted
+    std::atomic<bool> active_;
+    // Set by `activate`, handled by the event thread
+    std::atomic<bool> activatePending_ = false;
+
+    // Orders the "state" stream against journal snapshots. Each change is
+    // stored and numbered under the lock.
+    mutable std::mutex stateMutex_;
+    std::uint64_t GUARDED_BY(stateMutex_) stateSeq_ = 0;
 
     struct InitSync
     {
@@ -162,6 +218,43 @@ class Federator : public std::enable_shared_from_this<Federator>
 
     ChainArray<InitSync> initSync_;
     ChainArray<std::deque<FederatorEvent>> replays_;
+    // Claim ids and create counts missing from the commits seen, by
+    // destination chain
+    ChainArray<GapDetector> claimGaps_;
+    ChainArray<GapDetector> createGaps_;
+
+    // Sync point held by a resync, by destination chain. Event thread only.
+    struct ResyncHold
+    {
+        bool held_ = false;
+        // Latest commit of the stream since, stored once the hold ends
+        std::optional<ripple::uint256> latest_;
+    };
+    ChainArray<ResyncHold> resyncHolds_;
+
+    // Claims completed on each chain, the most recent ones only. Their
+    // attestations are not submitted.
+    struct Completed
+    {
+        std::set<std::uint64_t> claimIDs_;
+        std::set<std::uint64_t> createCounts_;
+    };
+    mutable std::mutex completedMutex_;
+    ChainArray<Completed> GUARDED_BY(completedMutex_) completed_;
+    // Attestations not submitted, and submissions left with none
+    std::uint64_t GUARDED_BY(completedMutex_) suppressedAttests_ = 0;
+    std::atomic<std::uint64_t> suppressedTxns_ = 0;
+
+    // Set if attestations are exchanged with the other witnesses
+    std::shared_ptr<Aggregation> const aggregation_;
+
+    // Claims signed from commits seen before they were validated
+    SpeculativeClaims speculative_;
+
+    mutable std::mutex bulkMutex_;
+    std::uint32_t GUARDED_BY(bulkMutex_) nextBulkID_ = 1;
+    // The latest bulk attest jobs, oldest first
+    std::deque<std::shared_ptr<BulkAttest>> GUARDED_BY(bulkMutex_) bulkJobs_;
     beast::Journal j_;
 
 public:
@@ -189,6 +282,11 @@ public:
     void
     push(FederatorEvent&& e) EXCLUDES(m_, eventsMutex_);
 
+    // Sign the claim of a commit that is not validated yet on the signing
+    // pool, for the validated commit with the same hash to use
+    void
+    speculate(event::XChainCommitDetected&& e);
+
     // Don't process any events until the bootstrap has a chance to run
     void
     unlockMainLoop() EXCLUDES(m_);
@@ -196,6 +294,40 @@ public:
     Json::Value
     getInfo() const;
 
+    // Start submitting after standing by. The journal mirrored from the
+    // previous active witness is restored first, so its submissions are
+    // tracked and its account sequences are not reused.
+    void
+    activate();
+
+    bool
+    active() const
+    {
+        return active_;
+    }
+
+    // The journaled submissions, with the sequence of the last "state"
+    // message they include
+    Json::Value
+    journalSnapshot() const EXCLUDES(stateMutex_);
+
+    /**
+     * Report where attestations are in the submission pipeline: "pending"
+     * (collected in the current batch), "queued", "submitted" or "errored".
+     * Ids that are in none of them are absent from the result.
+     *
+     * @param ct the chain the attestations are submitted to
+     * @param isCreateAccount true if the ids are create counts
+     * @param ids the claim ids or create counts to look up
+     * @return the status object of each id found
+     */
+    std::unordered_map<std::uint64_t, Json::Value>
+    getSubmissionStatus(
+        ChainType ct,
+        bool isCreateAccount,
+        std::vector<std::uint64_t> const& ids) const
+        EXCLUDES(txnsMutex_, batchMutex_);
+
     /**
      * Answering a RPC request for attesting an out of order transaction.
      * The local witness node sends a tx RPC request to the connected
@@ -214,14 +346,66 @@ public:
         ripple::uint256 const& txHash,
         Json::Value& result);
 
+    /**
+     * Start attesting many commits at once, for recovery. One job runs at a
+     * time.
+     *
+     * @param bridge the bridge spec
+     * @param params the commits to attest
+     * @param result the response to the RPC request, with the job's status
+     */
+    void
+    startBulkAttest(
+        ripple::STXChainBridge const& bridge,
+        BulkAttest::Params params,
+        Json::Value& result) EXCLUDES(bulkMutex_);
+
+    /**
+     * Progress of a bulk attest job, and its results from index `from` on.
+     *
+     * @param id the job id
+     * @param from the index of the first result returned
+     * @param limit the most results returned
+     * @param result the response to the RPC request
+     */
+    void
+    getBulkAttest(
+        std::uint32_t id,
+        std::size_t from,
+        std::size_t limit,
+        Json::Value& result) const EXCLUDES(bulkMutex_);
+
+    /**
+     * Attest again the commits on a chain from a ledger, or from the ledger
+     * of a transaction, to the current one. Runs as a bulk attest job. Until
+     * it is done, the sync point stored for the other chain is held before
+     * the range, so a restart replays the range instead of losing it.
+     *
+     * @param bridge the bridge spec
+     * @param ct the chain the commits are on
+     * @param ledger the first ledger, if not from `txHash`
+     * @param txHash the transaction whose ledger is the first one
+     * @param concurrency the most requests in flight
+     * @param result the response to the RPC request, with the job's status
+     */
+    void
+    startResync(
+        ripple::STXChainBridge const& bridge,
+        ChainType ct,
+        std::optional<std::uint32_t> ledger,
+        std::optional<ripple::uint256> txHash,
+        std::uint32_t concurrency,
+        Json::Value& result) EXCLUDES(bulkMutex_);
+
 private:
     // Two phase init needed for shared_from this.
     // Only called from `make_Federator`
     void
     init(
-        boost::asio::io_service& ios,
+        boost::asio::io_service& mainchainIos,
         beast::IP::Endpoint const& mainchainIp,
         std::shared_ptr<ChainListener>&& mainchainListener,
+        boost::asio::io_service& sidechainIos,
         beast::IP::Endpoint const& sidechainIp,
         std::shared_ptr<ChainListener>&& sidechainListener);
 
@@ -231,6 +415,30 @@ private:
     void
     txnSubmitLoop() EXCLUDES(txnSubmitLoopMutex_);
 
+    // Sign the attestations of an event batch on the signing pool, taking
+    // the speculative claims of its commits instead where there are some.
+    // Returns them by event index, or nothing if the batch is not worth
+    // handing off.
+    std::vector<Presigned>
+    presign(std::vector<FederatorEvent> const& events);
+
+    // Take the presigned attestation of the event being handled, if any
+    template <class T>
+    std::optional<T>
+    takePresigned();
+
+    // Sign the attestation of a successful commit with a delivered amount
+    ripple::AttestationBatch::AttestationClaim
+    signClaim(event::XChainCommitDetected const& e) const;
+
+    // Sign the claim of a commit that speculate() marked, unless the mark
+    // was taken or dropped in the meantime
+    void
+    addSpeculative(event::XChainCommitDetected const& e);
+
+    ripple::AttestationBatch::AttestationCreateAccount
+    signCreate(event::XChainAccountCreateCommitDetected const& e) const;
+
     void
     onEvent(event::XChainCommitDetected const& e);
 
@@ -249,6 +457,29 @@ private:
     void
     onEvent(event::XChainAttestsResult const& e);
 
+    void
+    onEvent(event::XChainClaimsCompleted const& e) EXCLUDES(completedMutex_);
+
+    void
+    onEvent(event::SubmissionsReconciled const& e) EXCLUDES(txnsMutex_);
+
+    // Queue an expired submission for resubmission, unless out of retries
+    void
+    retrySubmission(ChainType ct, Submission s) REQUIRES(txnsMutex_);
+
+    // Look the expired submissions to `ct` up, unless a lookup is running
+    void
+    startReconcile(ChainType ct) REQUIRES(txnsMutex_);
+
+    // Search the submitting account's transactions for the expired ones,
+    // and push what was found as an event
+    boost::asio::awaitable<void>
+    reconcile(
+        ChainType ct,
+        std::vector<reconciliation::Expired> expired,
+        std::uint32_t fromLedger,
+        std::uint32_t toLedger);
+
     void
     onEvent(event::XChainSignerListSet const& e);
 
@@ -261,9 +492,31 @@ private:
     void
     updateSignerListStatus(ChainType const chainType);
 
+    // Start backfills of the gaps to `dstChain` that are due
+    void
+    checkGaps(ChainType dstChain, std::uint32_t ledgerSeq);
+
+    // Search the source chain's door account for the missing commits and
+    // push those found as events
+    boost::asio::awaitable<void>
+    backfill(
+        ChainType dstChain,
+        bool isCreateAccount,
+        GapDetector::Backfill b);
+
     void
     onEvent(event::EndOfHistory const& e);
 
+    void
+    onEvent(event::Resync const& e);
+
+    // Store the sync point of a chain, unless a resync holds it
+    void
+    setSyncTxnHash(
+        ChainType dstChain,
+        ripple::uint256 const& txnHash,
+        bool live);
+
     void
     initSync(
         ChainType const ct,
@@ -288,29 +541,92 @@ private:
         ChainType chainType,
         bool ledgerBoundary);
 
-    // Code to run from `pushAtt` when submitting a transaction
+    // Code to run from `pushAtt` when submitting a transaction. With
+    // aggregation, the batch is held back for the aggregator if `mayHold`
+    // and it is not this witness's turn.
     void
     pushAttOnSubmitTxn(
         ripple::STXChainBridge const& bridge,
-        ChainType chainType) REQUIRES(batchMutex_)
+        ChainType chainType,
+        bool mayHold = true) REQUIRES(batchMutex_)
         EXCLUDES(txnsMutex_, cvMutexes_);
 
+    // Submit the attestations received from peers and those held back too
+    // long, and erase those of ours that peers landed
+    void
+    aggregate(ChainType ct, std::uint32_t ledgerSeq) EXCLUDES(batchMutex_);
+
+    // Erase the attestations of claims completed on `ct`. Returns how many
+    // were erased.
+    std::size_t
+    dropCompleted(
+        ChainType ct,
+        std::vector<ripple::AttestationBatch::AttestationClaim>& claims,
+        std::vector<ripple::AttestationBatch::AttestationCreateAccount>&
+            creates) EXCLUDES(completedMutex_);
+
+    // Rebuild the submissions to `ct` without the attestations of completed
+    // claims, and drop those left empty
+    void
+    pruneCompleted(ChainType ct, std::vector<Submission>& txns)
+        EXCLUDES(completedMutex_);
+
     void
     submitTxn(Submission const& submission, ChainType dstChain);
 
+    // Send a newly signed attestation to websocket subscribers
+    void
+    publishAttestation(
+        ChainType dstChain,
+        std::string const& txnIdHex,
+        std::uint32_t ledgerSeq,
+        ripple::STXChainAttestationBatch const& batch);
+
     void
     deleteFromDB(
         ChainType ct,
         std::uint64_t claimID,
-        bool isCreateAccount);  // TODO add bridge
+        bool isCreateAccount) EXCLUDES(stateMutex_);  // TODO add bridge
+
+    void
+    sendDBAttests(ChainType ct) EXCLUDES(txnsMutex_);
+
+    // Event thread side of `activate`
+    void
+    onActivate();
+
+    // True if attestations for `ct` are batched and submitted
+    bool
+    submitting(ChainType ct) const
+    {
+        return autoSubmit_[ct] && active_;
+    }
+
+    // Journal changes, also published for a standby to mirror
+    void
+    journalSubmission(SubmissionRecord const& r) EXCLUDES(stateMutex_);
+
+    void
+    unjournalSubmission(ChainType ct, std::uint32_t accountSqn)
+        EXCLUDES(stateMutex_);
+
+    void
+    publishState(char const* op, Json::Value jv) REQUIRES(stateMutex_);
+
+    // Track the submissions journaled before a restart as submitted
+    void
+    restoreSubmissions() EXCLUDES(txnsMutex_);
 
+    // Send the restored submissions that may still be validated again, in
+    // case they never reached the network
     void
-    sendDBAttests(ChainType ct);
+    resendRestored(ChainType ct) EXCLUDES(txnsMutex_);
 
     friend std::shared_ptr<Federator>
     make_Federator(
         App& app,
-        boost::asio::io_service& ios,
+        boost::asio::io_service& lockingIos,
+        boost::asio::io_service& issuingIos,
         config::Config const& config,
         beast::Journal j);
 };
@@ -318,7 +634,8 @@ private:
 std::shared_ptr<Federator>
 make_Federator(
     App& app,
-    boost::asio::io_service& ios,
+    boost::asio::io_service& lockingIos,
+    boost::asio::io_service& issuingIos,
     config::Config const& config,
     beast::Journal j);
 
@@ -110,6 +110,41 @@ XChainAttestsResult::toJson() const
     return result;
 }
 
+Json::Value
+XChainClaimsCompleted::toJson() const
+{
+    Json::Value result{Json::objectValue};
+    result["eventType"] = "XChainClaimsCompleted";
+    result["chainType"] = to_string(chainType_);
+    result["claimIDs"] = Json::arrayValue;
+    for (auto const id : claimIDs_)
+        result["claimIDs"].append(to_hex(id));
+    result["createCounts"] = Json::arrayValue;
+    for (auto const count : createCounts_)
+        result["createCounts"].append(to_hex(count));
+    return result;
+}
+
+Json::Value
+SubmissionsReconciled::toJson() const
+{
+    Json::Value result{Json::objectValue};
+    result["eventType"] = "SubmissionsReconciled";
+    result["chainType"] = to_string(chainType_);
+    result["checked"] = Json::arrayValue;
+    for (auto const sqn : checked_)
+        result["checked"].append(sqn);
+    result["landed"] = Json::arrayValue;
+    for (auto const& [sqn, ter] : landed_)
+    {
+        Json::Value l{Json::objectValue};
+        l["accountSequence"] = sqn;
+        l["ter"] = transHuman(ter);
+        result["landed"].append(std::move(l));
+    }
+    return result;
+}
+
 Json::Value
 NewLedger::toJson() const
 {
@@ -145,6 +180,18 @@ XChainSignerListSet::toJson() const
     return result;
 }
 
+Json::Value
+Resync::toJson() const
+{
+    Json::Value result{Json::objectValue};
+    result["eventType"] = "Resync";
+    result["chainType"] = to_string(chainType_);
+    result["start"] = start_;
+    if (txnHash_.isNonZero())
+        result["txnHash"] = to_string(txnHash_);
+    return result;
+}
+
 Json::Value
 XChainSetRegularKey::toJson() const
 {
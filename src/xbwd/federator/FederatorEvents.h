@@ -28,7 +28,9 @@
 #include <ripple/protocol/TER.h>
 
 #include <optional>
+#include <utility>
 #include <variant>
+#include <vector>
 
 namespace xbwd {
 namespace event {
@@ -112,6 +114,30 @@ struct XChainAttestsResult
     toJson() const;
 };
 
+// Claims completed on a chain, by any witness or by their owner
+struct XChainClaimsCompleted
+{
+    ChainType chainType_ = ChainType::locking;
+    std::vector<std::uint64_t> claimIDs_;
+    std::vector<std::uint64_t> createCounts_;
+
+    Json::Value
+    toJson() const;
+};
+
+// Outcome of expired submissions, looked up on their chain
+struct SubmissionsReconciled
+{
+    ChainType chainType_ = ChainType::locking;
+    // Account sequences of the submissions looked up
+    std::vector<std::uint32_t> checked_;
+    // Those found validated, with their result
+    std::vector<std::pair<std::uint32_t, ripple::TER>> landed_;
+
+    Json::Value
+    toJson() const;
+};
+
 struct NewLedger
 {
     ChainType chainType_;
@@ -130,6 +156,19 @@ struct EndOfHistory
     toJson() const;
 };
 
+// A resync of the commits on a chain starts or ends. While it runs, the sync
+// point stored for the other chain stays before the resynced range.
+struct Resync
+{
+    ChainType chainType_ = ChainType::locking;
+    bool start_ = true;
+    // Last commit before the range, zero if not found. Start only.
+    ripple::uint256 txnHash_;
+
+    Json::Value
+    toJson() const;
+};
+
 // Signer list changed on chain account
 struct XChainSignerListSet
 {
@@ -169,11 +208,14 @@ using FederatorEvent = std::variant<
     event::HeartbeatTimer,
     event::XChainTransferResult,
     event::XChainAttestsResult,
+    event::XChainClaimsCompleted,
+    event::SubmissionsReconciled,
     event::NewLedger,
     event::XChainSignerListSet,
     event::XChainSetRegularKey,
     event::XChainAccountSet,
-    event::EndOfHistory>;
+    event::EndOfHistory,
+    event::Resync>;
 
 Json::Value
 toJson(FederatorEvent const& event);
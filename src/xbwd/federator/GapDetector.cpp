@@ -0,0 +1,201 @@
+#include <xbwd/federator/GapDetector.h>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+
+namespace xbwd {
+
+namespace {
+
+// Ids looked for by one backfill. Larger gaps take several.
+std::size_t constexpr maxBackfillIds = 256;
+
+// Bound on the bitmap. Ids further above the lowest missing one restart the
+// detector, giving up on the gaps below.
+std::uint64_t constexpr maxWindow = 1u << 20;
+
+}  // namespace
+
+GapDetector::GapDetector(std::uint32_t ledgers) : ledgers_(ledgers)
+{
+}
+
+bool
+GapDetector::seen(std::uint64_t id) const
+{
+    return id < *base_ || (id - *base_ < seen_.size() && seen_[id - *base_]);
+}
+
+void
+GapDetector::observe(std::uint64_t id, std::uint32_t ledgerSeq)
+{
+    if (!enabled())
+        return;
+
+    std::lock_guard l{mutex_};
+    if (!base_ || id >= *base_ + maxWindow)
+    {
+        base_ = id;
+        seen_.clear();
+        windowLedger_.reset();
+        gaps_.clear();
+    }
+    if (seen(id))
+        return;
+
+    auto const top = *base_ + seen_.size();
+    if (id > top)
+    {
+        // Commits of the gap may predate the ids around it by a little
+        auto const from =
+            std::min(windowLedger_.value_or(ledgerSeq), ledgerSeq);
+        gaps_.push_back(
+            {top, id - 1, ledgerSeq, from > ledgers_ ? from - ledgers_ : 1});
+        detected_ += id - top;
+    }
+    if (id >= top)
+        seen_.resize(id - *base_ + 1);
+    else
+        ++filled_;
+
+    windowLedger_ = std::min(windowLedger_.value_or(ledgerSeq), ledgerSeq);
+    setSeen(id);
+}
+
+void
+GapDetector::setSeen(std::uint64_t id)
+{
+    seen_.set(id - *base_);
+    auto const it = std::find_if(gaps_.begin(), gaps_.end(), [&](auto& g) {
+        return id >= g.first && id <= g.last;
+    });
+    if (it != gaps_.end())
+    {
+        while (it->first <= it->last && seen(it->first))
+            ++it->first;
+        while (it->last >= it->first && seen(it->last))
+            --it->last;
+        if (it->first > it->last)
+            gaps_.erase(it);
+    }
+    compact();
+}
+
+void
+GapDetector::compact()
+{
+    std::size_t n = 0;
+    while (n < seen_.size() && seen_[n])
+        ++n;
+    if (n == 0)
+        return;
+    seen_ >>= n;
+    seen_.resize(seen_.size() - n);
+    *base_ += n;
+    if (seen_.empty())
+        windowLedger_.reset();
+}
+
+std::vector<GapDetector::Backfill>
+GapDetector::due(std::uint32_t ledgerSeq)
+{
+    std::vector<Backfill> r;
+    if (!enabled())
+        return r;
+
+    std::lock_guard l{mutex_};
+    for (auto& g : gaps_)
+    {
+        if (g.inFlight || ledgerSeq < g.sinceLedger + ledgers_)
+            continue;
+
+        Backfill b;
+        for (auto id = g.first; id <= g.last && b.ids.size() < maxBackfillIds;
+             ++id)
+        {
+            if (!seen(id))
+                b.ids.push_back(id);
+        }
+        b.fromLedger = g.fromLedger;
+        b.toLedger = ledgerSeq;
+        g.inFlight = true;
+        ++backfills_;
+        r.push_back(std::move(b));
+    }
+    return r;
+}
+
+void
+GapDetector::land(Backfill const& b)
+{
+    for (auto& g : gaps_)
+    {
+        if (g.last < b.ids.front() || g.first > b.ids.back())
+            continue;
+        g.inFlight = false;
+        g.sinceLedger = b.toLedger;
+    }
+}
+
+std::vector<std::uint64_t>
+GapDetector::backfilled(
+    Backfill const& b,
+    std::vector<std::uint64_t> const& found)
+{
+    std::vector<std::uint64_t> givenUp;
+    std::lock_guard l{mutex_};
+    if (!base_ || b.ids.empty())
+        return givenUp;
+
+    land(b);
+    for (auto const id : b.ids)
+    {
+        if (seen(id) ||
+            std::find(found.begin(), found.end(), id) != found.end())
+            continue;
+        givenUp.push_back(id);
+        setSeen(id);
+    }
+    givenUp_ += givenUp.size();
+    return givenUp;
+}
+
+void
+GapDetector::failed(Backfill const& b)
+{
+    std::lock_guard l{mutex_};
+    if (!base_ || b.ids.empty())
+        return;
+    land(b);
+    ++failures_;
+}
+
+Json::Value
+GapDetector::getInfo() const
+{
+    Json::Value r{Json::objectValue};
+    if (!enabled())
+    {
+        r["enabled"] = false;
+        return r;
+    }
+
+    std::lock_guard l{mutex_};
+    r["enabled"] = true;
+    if (base_)
+        r["lowest_missing"] = fmt::format("{:X}", *base_);
+    r["open_gaps"] = static_cast<Json::UInt>(gaps_.size());
+    std::uint64_t missing = 0;
+    for (auto const& g : gaps_)
+        missing += g.last - g.first + 1;
+    r["missing_upto"] = static_cast<Json::UInt>(missing);
+    r["detected"] = static_cast<Json::UInt>(detected_);
+    r["filled"] = static_cast<Json::UInt>(filled_);
+    r["given_up"] = static_cast<Json::UInt>(givenUp_);
+    r["backfills"] = static_cast<Json::UInt>(backfills_);
+    r["backfill_failures"] = static_cast<Json::UInt>(failures_);
+    return r;
+}
+
+}  // namespace xbwd
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <xbwd/basics/ThreadSaftyAnalysis.h>
+
+#include <ripple/json/json_value.h>
+
+#include <boost/dynamic_bitset.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace xbwd {
+
+/** Finds claim ids or create counts that were never seen in one direction.
+
+    Ids are allocated in increasing order, so an id missing below the
+    highest one seen is a gap: its commit was dropped by the stream, or, for
+    claim ids, it has not been committed yet. Seen ids are kept as a bitmap
+    starting at the lowest id not seen, so the memory used is bounded by the
+    spread of the open gaps rather than by the ids.
+
+    A gap still open `ledgers` ledgers after it was found is due for a
+    backfill: the source chain is searched from a little before the gap
+    opened. Ids the backfill does not find are given up on, so a claim id
+    that was never committed is searched for only once.
+
+    Ledgers are those of the chain the commits are made on.
+*/
+class GapDetector
+{
+public:
+    // Missing ids to look for, and the ledgers to look in
+    struct Backfill
+    {
+        std::vector<std::uint64_t> ids;
+        std::uint32_t fromLedger = 0;
+        std::uint32_t toLedger = 0;
+    };
+
+    // 0 disables the detector
+    explicit GapDetector(std::uint32_t ledgers);
+
+    bool
+    enabled() const
+    {
+        return ledgers_ != 0;
+    }
+
+    // An id was seen in a commit of ledger `ledgerSeq`
+    void
+    observe(std::uint64_t id, std::uint32_t ledgerSeq) EXCLUDES(mutex_);
+
+    // Gaps due for a backfill as of `ledgerSeq`. They are marked in flight
+    // until `backfilled` or `failed` is called.
+    std::vector<Backfill>
+    due(std::uint32_t ledgerSeq) EXCLUDES(mutex_);
+
+    // A backfill is done. `found` ids were pushed as events and are seen once
+    // handled. Returns the ids given up on.
+    std::vector<std::uint64_t>
+    backfilled(Backfill const& b, std::vector<std::uint64_t> const& found)
+        EXCLUDES(mutex_);
+
+    // A backfill could not be done. It is retried once due again.
+    void
+    failed(Backfill const& b) EXCLUDES(mutex_);
+
+    Json::Value
+    getInfo() const EXCLUDES(mutex_);
+
+private:
+    struct Gap
+    {
+        std::uint64_t first;
+        std::uint64_t last;
+        // Ledger the gap was found or last backfilled in
+        std::uint32_t sinceLedger;
+        // Earliest ledger its commits may be in
+        std::uint32_t fromLedger;
+        bool inFlight = false;
+    };
+
+    bool
+    seen(std::uint64_t id) const REQUIRES(mutex_);
+
+    // Mark an id seen, shrinking or closing the gap it is in
+    void
+    setSeen(std::uint64_t id) REQUIRES(mutex_);
+
+    // Drop the leading run of seen ids from the bitmap
+    void
+    compact() REQUIRES(mutex_);
+
+    // Mark the gaps a backfill covered as no longer in flight
+    void
+    land(Backfill const& b) REQUIRES(mutex_);
+
+    std::uint32_t const ledgers_;
+
+    mutable std::mutex mutex_;
+    // Lowest id not seen. Unset until the first id.
+    std::optional<std::uint64_t> GUARDED_BY(mutex_) base_;
+    // Bit i is set if id base_ + i was seen
+    boost::dynamic_bitset<std::uint64_t> GUARDED_BY(mutex_) seen_;
+    // Earliest ledger of the ids in the bitmap
+    std::optional<std::uint32_t> GUARDED_BY(mutex_) windowLedger_;
+    std::vector<Gap> GUARDED_BY(mutex_) gaps_;
+
+    // Counted in ids
+    std::uint64_t GUARDED_BY(mutex_) detected_ = 0;
+    std::uint64_t GUARDED_BY(mutex_) filled_ = 0;
+    std::uint64_t GUARDED_BY(mutex_) givenUp_ = 0;
+    // Counted in backfills
+    std::uint64_t GUARDED_BY(mutex_) backfills_ = 0;
+    std::uint64_t GUARDED_BY(mutex_) failures_ = 0;
+};
+
+}  // namespace xbwd
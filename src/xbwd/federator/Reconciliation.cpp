@@ -0,0 +1,82 @@
+#include <xbwd/federator/Reconciliation.h>
+
+#include <xbwd/client/RpcResultParse.h>
+
+#include <ripple/protocol/jss.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace xbwd {
+namespace reconciliation {
+
+std::pair<std::uint32_t, std::uint32_t>
+window(
+    std::vector<std::uint32_t> const& lastLedgerSeqs,
+    std::uint32_t ttlLedgers)
+{
+    auto fromLedger = std::numeric_limits<std::uint32_t>::max();
+    std::uint32_t toLedger = 0;
+    for (auto const lastLedgerSeq : lastLedgerSeqs)
+    {
+        fromLedger = std::min(
+            fromLedger,
+            lastLedgerSeq > ttlLedgers ? lastLedgerSeq - ttlLedgers : 0);
+        toLedger = std::max(toLedger, lastLedgerSeq);
+    }
+    return {fromLedger, toLedger};
+}
+
+void
+match(
+    std::vector<Expired> const& expired,
+    Json::Value const& transactions,
+    Landed& landed)
+{
+    for (auto const& entry : transactions)
+    {
+        if (!entry[ripple::jss::validated].asBool())
+            continue;
+        auto const& tx = entry[ripple::jss::tx];
+        auto const hash = rpcResultParse::parseTxHash(tx);
+        auto const sqn = rpcResultParse::parseTxSeq(tx);
+        if (!hash || !sqn)
+            continue;
+        auto const it =
+            std::find(expired.begin(), expired.end(), Expired{*sqn, *hash});
+        if (it == expired.end())
+            continue;
+        if (std::find_if(landed.begin(), landed.end(), [&](auto const& x) {
+                return x.first == *sqn;
+            }) != landed.end())
+            continue;
+        auto const ter = ripple::transCode(
+            entry[ripple::jss::meta]["TransactionResult"].asString());
+        if (ter)
+            landed.emplace_back(*sqn, *ter);
+    }
+}
+
+Outcome
+outcome(
+    event::SubmissionsReconciled const& e,
+    std::uint32_t sqn,
+    std::unordered_set<ripple::TERUnderlyingType> const& skippable)
+{
+    if (std::find(e.checked_.begin(), e.checked_.end(), sqn) ==
+        e.checked_.end())
+        return Outcome::unchecked;
+
+    auto const landed =
+        std::find_if(e.landed_.begin(), e.landed_.end(), [&](auto const& x) {
+            return x.first == sqn;
+        });
+    if (landed == e.landed_.end())
+        return Outcome::missing;
+    if (skippable.find(TERtoInt(landed->second)) != skippable.end())
+        return Outcome::landed;
+    return Outcome::failed;
+}
+
+}  // namespace reconciliation
+}  // namespace xbwd
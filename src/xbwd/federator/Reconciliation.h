@@ -0,0 +1,68 @@
+#pragma once
+
+#include <xbwd/federator/FederatorEvents.h>
+
+#include <ripple/basics/base_uint.h>
+#include <ripple/json/json_value.h>
+#include <ripple/protocol/TER.h>
+
+#include <cstdint>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace xbwd {
+
+/** Looking up the outcome of expired submissions.
+
+    A submission expires once its last ledger passes without its result
+    having been seen. The result may only have been missed, so the
+    submitting account's validated transactions are searched for it before
+    it is resubmitted. A transaction is the submission's if both its account
+    sequence and its hash are those last submitted.
+*/
+namespace reconciliation {
+
+// Account sequence of an expired submission, and the hash last submitted
+using Expired = std::pair<std::uint32_t, ripple::uint256>;
+
+// Account sequences of the submissions found validated, with their result
+using Landed = std::vector<std::pair<std::uint32_t, ripple::TER>>;
+
+// Ledgers to search, given the last ledgers of the expired submissions. Each
+// was submitted at most `ttlLedgers` ledgers before its last ledger.
+std::pair<std::uint32_t, std::uint32_t>
+window(
+    std::vector<std::uint32_t> const& lastLedgerSeqs,
+    std::uint32_t ttlLedgers);
+
+// Add the expired submissions found in a page of account_tx `transactions`
+// to `landed`. Transactions not validated, and submissions already landed,
+// are skipped.
+void
+match(
+    std::vector<Expired> const& expired,
+    Json::Value const& transactions,
+    Landed& landed);
+
+enum class Outcome {
+    // Expired while the others were looked up
+    unchecked,
+    // Found validated with a result that is not retried
+    landed,
+    // Found validated with a result that is retried
+    failed,
+    // Not found
+    missing
+};
+
+// What became of the submission with account sequence `sqn`, given the
+// results that are not retried
+Outcome
+outcome(
+    event::SubmissionsReconciled const& e,
+    std::uint32_t sqn,
+    std::unordered_set<ripple::TERUnderlyingType> const& skippable);
+
+}  // namespace reconciliation
+}  // namespace xbwd
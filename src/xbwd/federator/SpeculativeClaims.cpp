@@ -0,0 +1,139 @@
+#include <xbwd/federator/SpeculativeClaims.h>
+
+#include <ripple/basics/Log.h>
+
+namespace xbwd {
+
+namespace {
+
+// Bound on the claims waiting for their commit
+std::size_t constexpr maxMarks = 4096;
+
+}  // namespace
+
+SpeculativeClaims::SpeculativeClaims(std::uint32_t ledgers, beast::Journal j)
+    : ledgers_(ledgers), j_(j)
+{
+}
+
+bool
+SpeculativeClaims::sameCommit(
+    event::XChainCommitDetected const& p,
+    event::XChainCommitDetected const& e)
+{
+    return p.dir_ == e.dir_ && p.src_ == e.src_ && p.bridge_ == e.bridge_ &&
+        p.deliveredAmt_ == e.deliveredAmt_ && p.claimID_ == e.claimID_ &&
+        p.otherChainDst_ == e.otherChainDst_;
+}
+
+bool
+SpeculativeClaims::mark(event::XChainCommitDetected const& e)
+{
+    if (!enabled())
+        return false;
+
+    std::lock_guard l{mutex_};
+    if (marks_.size() >= maxMarks || marks_.count(e.txnHash_))
+        return false;
+    marks_.emplace(
+        e.txnHash_, Speculative{e, std::nullopt, e.ledgerSeq_ + ledgers_});
+    return true;
+}
+
+void
+SpeculativeClaims::fill(event::XChainCommitDetected const& e, Claim claim)
+{
+    std::lock_guard l{mutex_};
+    auto const it = marks_.find(e.txnHash_);
+    // A mark made for the same commit proposed again since is not filled
+    // with this one's claim
+    if (it == marks_.end() || it->second.claim_ ||
+        !sameCommit(it->second.event_, e))
+        return;
+    it->second.claim_ = std::move(claim);
+}
+
+std::optional<SpeculativeClaims::Claim>
+SpeculativeClaims::take(event::XChainCommitDetected const& e)
+{
+    if (!enabled())
+        return std::nullopt;
+
+    std::lock_guard l{mutex_};
+    auto const it = marks_.find(e.txnHash_);
+    if (it == marks_.end())
+    {
+        ++misses_;
+        return std::nullopt;
+    }
+    auto s = std::move(it->second);
+    marks_.erase(it);
+
+    // Still being signed: signed inline rather than waited for
+    if (!s.claim_)
+    {
+        ++misses_;
+        return std::nullopt;
+    }
+
+    // The validated commit is what is attested, whatever was proposed
+    if (!sameCommit(s.event_, e))
+    {
+        JLOGV(
+            j_.warn(),
+            "speculative claim does not match the validated commit",
+            ripple::jv("proposed", s.event_.toJson()),
+            ripple::jv("validated", e.toJson()));
+        ++misses_;
+        return std::nullopt;
+    }
+    ++hits_;
+    return std::move(s.claim_);
+}
+
+void
+SpeculativeClaims::drop(ripple::uint256 const& txnHash)
+{
+    if (!enabled())
+        return;
+
+    std::lock_guard l{mutex_};
+    marks_.erase(txnHash);
+}
+
+void
+SpeculativeClaims::expire(ChainType ct, std::uint32_t ledgerIndex)
+{
+    if (!enabled())
+        return;
+
+    // Commits on `ct` are attested on the other chain
+    auto const dir = ct == ChainType::locking ? ChainDir::lockingToIssuing
+                                              : ChainDir::issuingToLocking;
+    std::lock_guard l{mutex_};
+    for (auto it = marks_.begin(); it != marks_.end();)
+    {
+        if (it->second.event_.dir_ == dir && it->second.expires_ < ledgerIndex)
+        {
+            it = marks_.erase(it);
+            ++dropped_;
+        }
+        else
+            ++it;
+    }
+}
+
+Json::Value
+SpeculativeClaims::getInfo() const
+{
+    Json::Value ret{Json::objectValue};
+    ret["ledgers"] = ledgers_;
+    std::lock_guard l{mutex_};
+    ret["pending"] = static_cast<Json::UInt>(marks_.size());
+    ret["hits"] = static_cast<Json::UInt>(hits_);
+    ret["misses"] = static_cast<Json::UInt>(misses_);
+    ret["dropped"] = static_cast<Json::UInt>(dropped_);
+    return ret;
+}
+
+}  // namespace xbwd
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <xbwd/basics/ChainTypes.h>
+#include <xbwd/basics/ThreadSaftyAnalysis.h>
+#include <xbwd/federator/FederatorEvents.h>
+
+#include <ripple/basics/base_uint.h>
+#include <ripple/beast/utility/Journal.h>
+#include <ripple/json/json_value.h>
+#include <ripple/protocol/STXChainAttestationBatch.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+
+namespace xbwd {
+
+/** Claims signed from commits seen before they were validated.
+
+    A proposed commit is marked before its claim is signed, and the claim
+    fills the mark once signed. The validated commit with the same hash
+    takes the mark: the claim is used only if it was signed from the same
+    fields, since the validated commit is what is attested whatever was
+    proposed. A mark still being signed is taken as well, so the claim that
+    fills it later is not kept.
+
+    Marks of commits not validated within `ledgers` ledgers of their
+    proposed ledger are dropped.
+*/
+class SpeculativeClaims
+{
+public:
+    using Claim = ripple::AttestationBatch::AttestationClaim;
+
+    // 0 disables the store
+    SpeculativeClaims(std::uint32_t ledgers, beast::Journal j);
+
+    bool
+    enabled() const
+    {
+        return ledgers_ != 0;
+    }
+
+    // True if a claim signed from the commit `p` attests the commit `e`
+    static bool
+    sameCommit(
+        event::XChainCommitDetected const& p,
+        event::XChainCommitDetected const& e);
+
+    // Mark a proposed commit. Returns false if its claim is not to be
+    // signed: the store is disabled or full, or the hash is marked already.
+    bool
+    mark(event::XChainCommitDetected const& e) EXCLUDES(mutex_);
+
+    // Fill the mark of the proposed commit `e` with its claim, unless the
+    // mark was taken, or was made for another commit with the same hash
+    void
+    fill(event::XChainCommitDetected const& e, Claim claim) EXCLUDES(mutex_);
+
+    // Take the claim of a validated commit, if it was signed with the same
+    // fields. The mark is removed either way.
+    std::optional<Claim>
+    take(event::XChainCommitDetected const& e) EXCLUDES(mutex_);
+
+    // Remove the mark of a commit attested without its claim
+    void
+    drop(ripple::uint256 const& txnHash) EXCLUDES(mutex_);
+
+    // Drop the marks of commits on `ct` that were not validated by
+    // `ledgerIndex`
+    void
+    expire(ChainType ct, std::uint32_t ledgerIndex) EXCLUDES(mutex_);
+
+    Json::Value
+    getInfo() const EXCLUDES(mutex_);
+
+private:
+    struct Speculative
+    {
+        event::XChainCommitDetected event_;
+        // Unset while it is being signed
+        std::optional<Claim> claim_;
+        // Dropped once the commit's chain is past this ledger
+        std::uint32_t expires_;
+    };
+
+    std::uint32_t const ledgers_;
+
+    mutable std::mutex mutex_;
+    std::map<ripple::uint256, Speculative> GUARDED_BY(mutex_) marks_;
+    std::uint64_t GUARDED_BY(mutex_) hits_ = 0;
+    std::uint64_t GUARDED_BY(mutex_) misses_ = 0;
+    std::uint64_t GUARDED_BY(mutex_) dropped_ = 0;
+
+    beast::Journal j_;
+};
+
+}  // namespace xbwd
@@ -0,0 +1,379 @@
+#include <xbwd/rpc/RPCCall.h>
+
+#include <xbwd/app/BuildInfo.h>
+#include <xbwd/app/Config.h>
+
+#include <ripple/json/json_reader.h>
+#include <ripple/json/to_string.h>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace xbwd {
+namespace rpc_call {
+
+namespace {
+
+namespace http = boost::beast::http;
+using tcp = boost::asio::ip::tcp;
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+// Requests sent ahead of their replies
+std::size_t constexpr pipelineDepth = 32;
+// Time allowed for each reply
+std::chrono::seconds constexpr replyTimeout{60};
+
+// Give the request the {"method", "params": [{...}]} form the server expects,
+// with the admin credentials from the config
+Json::Value
+prepare(config::Config const& config, Json::Value request)
+{
+    if (!request.isMember("params"))
+        request["params"] = Json::arrayValue;
+    auto& params = request["params"];
+    if (params.isArray() && params.size() == 0)
+        params.append(Json::objectValue);
+
+    if (config.adminConfig && config.adminConfig->pass && params.isArray() &&
+        params[0u].isObject() && !params[0u].isMember("Username"))
+    {
+        params[0u]["Username"] = config.adminConfig->pass->user;
+        params[0u]["Password"] = config.adminConfig->pass->password;
+    }
+    return request;
+}
+
+bool
+isError(Json::Value const& reply)
+{
+    return reply.isMember("error") ||
+        (reply.isMember("result") && reply["result"].isObject() &&
+         reply["result"].isMember("error"));
+}
+
+Json::Value
+makeError(std::string const& message)
+{
+    Json::Value r{Json::objectValue};
+    r["error"] = message;
+    return r;
+}
+
+// A keep-alive connection that pipelines requests. Runs on one thread, so the
+// state below needs no locking.
+class Client
+{
+    config::Config const& config_;
+    boost::asio::io_context& ioc_;
+    tcp::socket socket_;
+    std::string const host_;
+
+    // Wake the writer and the reader when the state below changes
+    boost::asio::steady_timer writeSignal_;
+    boost::asio::steady_timer readSignal_;
+
+    // Input lines not yet sent
+    std::deque<std::string> input_;
+    bool inputDone_ = false;
+    // One entry per sent request, oldest first. Empty if the reply comes from
+    // the server, otherwise the error to print in its place.
+    std::deque<std::optional<Json::Value>> outstanding_;
+    bool writerDone_ = false;
+    // The connection failed
+    bool failed_ = false;
+    // A request failed
+    bool error_ = false;
+
+    std::function<void(Json::Value const&)> print_;
+
+public:
+    Client(
+        config::Config const& config,
+        boost::asio::io_context& ioc,
+        std::function<void(Json::Value const&)> print)
+        : config_(config)
+        , ioc_(ioc)
+        , socket_(ioc)
+        , host_(config.rpcEndpoint.to_string())
+        , writeSignal_(ioc)
+        , readSignal_(ioc)
+        , print_(std::move(print))
+    {
+    }
+
+    // Called from any thread. An empty optional marks the end of the input.
+    void
+    push(std::optional<std::string> line)
+    {
+        boost::asio::post(ioc_, [this, line = std::move(line)]() {
+            if (line)
+                input_.push_back(*line);
+            else
+                inputDone_ = true;
+            notify();
+        });
+    }
+
+    awaitable<void>
+    run()
+    {
+        try
+        {
+            auto const& ep = config_.rpcEndpoint;
+            co_await socket_.async_connect(
+                tcp::endpoint{ep.address(), ep.port()}, use_awaitable);
+        }
+        catch (std::exception const& e)
+        {
+            std::cerr << "Error: could not connect to " << host_ << ": "
+                      << e.what() << std::endl;
+            failed_ = true;
+            co_return;
+        }
+
+        boost::asio::co_spawn(ioc_, write(), boost::asio::detached);
+        co_await read();
+    }
+
+    bool
+    failed() const
+    {
+        return failed_ || error_;
+    }
+
+    bool
+    inputDone() const
+    {
+        return inputDone_;
+    }
+
+private:
+    void
+    notify()
+    {
+        writeSignal_.cancel();
+        readSignal_.cancel();
+    }
+
+    static awaitable<void>
+    wait(boost::asio::steady_timer& signal)
+    {
+        boost::system::error_code ec;
+        signal.expires_at(boost::asio::steady_timer::time_point::max());
+        co_await signal.async_wait(
+            boost::asio::redirect_error(use_awaitable, ec));
+    }
+
+    awaitable<void>
+    write()
+    {
+        try
+        {
+            for (;;)
+            {
+                while (!failed_ && input_.empty() && !inputDone_)
+                    co_await wait(writeSignal_);
+                while (!failed_ && outstanding_.size() >= pipelineDepth)
+                    co_await wait(writeSignal_);
+                if (failed_ || (input_.empty() && inputDone_))
+                    break;
+
+                auto const line = std::move(input_.front());
+                input_.pop_front();
+
+                Json::Value jv;
+                if (!Json::Reader().parse(line, jv) || !jv.isObject())
+                {
+                    outstanding_.emplace_back(
+                        makeError("Could not parse json request: " + line));
+                    notify();
+                    continue;
+                }
+
+                http::request<http::string_body> req{
+                    http::verb::post, "/", 11};
+                req.set(http::field::host, host_);
+                req.set(http::field::user_agent, build_info::serverName);
+                req.set(http::field::content_type, "application/json");
+                req.keep_alive(true);
+                req.body() = to_string(prepare(config_, std::move(jv)));
+                req.prepare_payload();
+
+                outstanding_.emplace_back();
+                notify();
+                co_await http::async_write(socket_, req, use_awaitable);
+            }
+        }
+        catch (std::exception const& e)
+        {
+            if (!failed_)
+                std::cerr << "Error: " << e.what() << std::endl;
+            failed_ = true;
+        }
+        writerDone_ = true;
+        notify();
+    }
+
+    awaitable<void>
+    read()
+    {
+        boost::beast::flat_buffer buffer;
+        try
+        {
+            for (;;)
+            {
+                while (outstanding_.empty() && !writerDone_)
+                    co_await wait(readSignal_);
+                if (outstanding_.empty() || failed_)
+                    break;
+
+                if (auto const& local = outstanding_.front())
+                {
+                    print_(*local);
+                    error_ = true;
+                    outstanding_.pop_front();
+                    notify();
+                    continue;
+                }
+
+                // The server may not answer at all. Give up on the
+                // connection, and every request still on it, if it takes
+                // too long.
+                boost::asio::steady_timer deadline{ioc_};
+                deadline.expires_after(replyTimeout);
+                deadline.async_wait([this](boost::system::error_code ec) {
+                    if (!ec)
+                        socket_.close();
+                });
+
+                http::response<http::string_body> res;
+                co_await http::async_read(socket_, buffer, res, use_awaitable);
+                deadline.cancel();
+                outstanding_.pop_front();
+                notify();
+
+                Json::Value reply;
+                if (!Json::Reader().parse(res.body(), reply))
+                    reply = makeError(
+                        "HTTP " + std::to_string(res.result_int()) + ": " +
+                        res.body());
+                if (isError(reply))
+                    error_ = true;
+                print_(reply);
+            }
+        }
+        catch (std::exception const& e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            failed_ = true;
+            notify();
+        }
+        boost::system::error_code ec;
+        socket_.close(ec);
+    }
+};
+
+// `nextLine` may block on input that never comes, e.g. from a terminal, only
+// if `detachable`
+int
+call(
+    config::Config const& config,
+    std::function<std::optional<std::string>()> nextLine,
+    std::function<void(Json::Value const&)> print,
+    bool detachable)
+{
+    auto ioc = std::make_shared<boost::asio::io_context>();
+    auto client = std::make_shared<Client>(config, *ioc, std::move(print));
+    auto stop = std::make_shared<std::atomic<bool>>(false);
+
+    // Read input on its own thread, so a caller waiting for a reply before
+    // writing its next request does not stall the connection
+    std::thread reader([ioc, client, stop, nextLine = std::move(nextLine)]() {
+        while (!*stop)
+        {
+            auto line = nextLine();
+            bool const done = !line;
+            client->push(std::move(line));
+            if (done)
+                break;
+        }
+    });
+
+    boost::asio::co_spawn(*ioc, client->run(), boost::asio::detached);
+    ioc->run();
+    // After a connection failure the reader may still be reading. It is
+    // stopped and waited for, since `nextLine` may refer to the caller's
+    // stream. One blocked on a terminal owns what it uses, so it is left
+    // to end with the process.
+    *stop = true;
+    if (client->inputDone() || !detachable)
+        reader.join();
+    else
+        reader.detach();
+
+    return client->failed() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+}  // namespace
+
+int
+fromCommandLine(config::Config const& config, Json::Value const& request)
+{
+    return call(
+        config,
+        [line = to_string(request),
+         sent = false]() mutable -> std::optional<std::string> {
+            if (std::exchange(sent, true))
+                return std::nullopt;
+            return line;
+        },
+        [](Json::Value const& reply) {
+            std::cout << reply.toStyledString() << std::endl;
+        },
+        false);
+}
+
+int
+fromStream(config::Config const& config, std::istream& in)
+{
+    return call(
+        config,
+        [&in]() -> std::optional<std::string> {
+            std::string line;
+            while (std::getline(in, line))
+            {
+                // skip blank lines and comments
+                auto const start = line.find_first_not_of(" \t\r");
+                if (start != std::string::npos && line[start] != '#')
+                    return line;
+            }
+            return std::nullopt;
+        },
+        [](Json::Value const& reply) {
+            std::cout << to_string(reply) << std::endl;
+        },
+        &in == &std::cin);
+}
+
+}  // namespace rpc_call
+}  // namespace xbwd
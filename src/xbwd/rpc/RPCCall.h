@@ -2,6 +2,8 @@
 
 #include <ripple/json/json_value.h>
 
+#include <istream>
+
 namespace xbwd {
 
 namespace config {
@@ -10,12 +12,24 @@ class Config;
 
 namespace rpc_call {
 
-inline int
-fromCommandLine(config::Config const& config, Json::Value const& request)
-{
-    // TODO
-    return 0;
-}
+/** Send one request to the server's RPC port and print the reply.
+
+    @return EXIT_SUCCESS if the server answered without an error
+*/
+int
+fromCommandLine(config::Config const& config, Json::Value const& request);
+
+/** Send requests read from `in`, one json object per line, and print each
+    reply on its own line in the order of the requests.
+
+    The requests share one keep-alive connection and are pipelined: up to a
+    fixed number are sent ahead of their replies. Lines are read as they
+    arrive, so a script can write a request and wait for its reply.
+
+    @return EXIT_SUCCESS if every request got a reply without an error
+*/
+int
+fromStream(config::Config const& config, std::istream& in);
 
 }  // namespace rpc_call
 }  // namespace xbwd
@@ -1,10 +1,13 @@
 #include <xbwd/rpc/RPCHandler.h>
 
 #include <xbwd/app/App.h>
-#include <xbwd/app/DBInit.h>
+#include <xbwd/app/Standby.h>
+#include <xbwd/core/DatabaseSnapshot.h>
+#include <xbwd/core/Storage.h>
 #include <xbwd/federator/Federator.h>
 #include <xbwd/rpc/fromJSON.h>
 
+#include <ripple/basics/strHex.h>
 #include <ripple/json/json_value.h>
 #include <ripple/protocol/AccountID.h>
 #include <ripple/protocol/SField.h>
@@ -15,9 +18,13 @@
 #include <ripple/protocol/jss.h>
 
 #include <fmt/core.h>
-#include <soci/soci-backend.h>
 
+#include <algorithm>
+#include <charconv>
+#include <chrono>
 #include <functional>
+#include <optional>
+#include <string_view>
 #include <unordered_map>
 
 namespace xbwd {
@@ -49,127 +56,314 @@ doServerInfo(App& app, Json::Value const& in, Json::Value& result)
 
     Json::Value inner;
     inner["info"] = f->getInfo();
+    inner["info"]["rpc"] = app.resources().getInfo();
+    inner["info"]["threads"] = app.threadMap().getInfo();
+    inner["info"]["io"] = app.getIOInfo();
+    inner["info"]["attestation_cache"] = app.attestationCache().getInfo();
+    inner["info"]["storage"] = app.storage().name();
+    if (auto const standby = app.standby())
+        inner["info"]["standby"] = standby->getInfo();
     result["result"] = inner;
 }
 
-void
-doSelectAll(
-    App& app,
-    Json::Value const& in,
-    Json::Value& result,
-    ChainDir const chainDir)
+// Page size bounds for query_attestations. Each page is read and serialized
+// on its own, so the cost of a call does not grow with the table.
+std::uint32_t constexpr queryDefaultLimit = 200;
+std::uint32_t constexpr queryMaxLimit = 1000;
+
+// The marker is an opaque "<id>:<txn hash>" pair in hex. Attestations are
+// returned in (id, txn hash) order, and every backend seeks to the marker in
+// that order. The ledger and sending account filters are checked on the rows
+// read from there, so a page of sparse matches may read many rows.
+std::string
+toMarker(std::uint64_t id, ripple::uint256 const& txnHash)
+{
+    return fmt::format("{:x}:{}", id, to_string(txnHash));
+}
 
+std::optional<std::pair<std::uint64_t, ripple::uint256>>
+fromMarker(Json::Value const& jv)
 {
-    // TODO: Remove me
-    //
+    if (!jv.isString())
+        return std::nullopt;
+    auto const s = jv.asString();
+    auto const sep = s.find(':');
+    if (sep == std::string::npos)
+        return std::nullopt;
+
+    std::uint64_t id = 0;
+    auto r = std::from_chars(s.data(), s.data() + sep, id, 16);
+    if (r.ec != std::errc() || r.ptr != s.data() + sep)
+        return std::nullopt;
+    ripple::uint256 txnHash;
+    if (!txnHash.parseHex(std::string_view{s}.substr(sep + 1)))
+        return std::nullopt;
+    return std::make_pair(id, txnHash);
+}
 
+void
+doQueryAttestations(App& app, Json::Value const& in, Json::Value& result)
+{
     result["request"] = in;
 
-    auto const& tblName = db_init::xChainTableName(chainDir);
-
-    {
-        auto session = app.getXChainTxnDB().checkoutDb();
-        soci::blob amtBlob(*session);
-        soci::blob bridgeBlob(*session);
-        soci::blob sendingAccountBlob(*session);
-        soci::blob rewardAccountBlob(*session);
-        soci::blob otherChainDstBlob(*session);
-        soci::blob publicKeyBlob(*session);
-        soci::blob signatureBlob(*session);
-
-        std::string transID;
-        int ledgerSeq;
-        int claimID;
-        int success;
-
-        auto sql = fmt::format(
-            R"sql(SELECT TransID, LedgerSeq, ClaimID, Success, DeliveredAmt,
-                         Bridge, SendingAccount, RewardAccount, OtherChainDst,
-                         PublicKey, Signature FROM {table_name};
-            )sql",
-            fmt::arg("table_name", tblName));
-
-        soci::indicator otherChainDstInd;
-        soci::statement st =
-            ((*session).prepare << sql,
-             soci::into(transID),
-             soci::into(ledgerSeq),
-             soci::into(claimID),
-             soci::into(success),
-             soci::into(amtBlob),
-             soci::into(bridgeBlob),
-             soci::into(sendingAccountBlob),
-             soci::into(rewardAccountBlob),
-             soci::into(otherChainDstBlob, otherChainDstInd),
-             soci::into(publicKeyBlob),
-             soci::into(signatureBlob));
-        st.execute();
-
-        std::vector<ripple::AttestationBatch::AttestationClaim> claims;
-        ripple::STXChainBridge bridge;
-        std::optional<ripple::STXChainBridge> firstBridge;
-        while (st.fetch())
+    // Fields that are present must parse; absent fields are not filters
+    auto const invalid = [&](char const* key, auto const& opt) {
+        return in.isMember(key) && !opt;
+    };
+
+    // chain_type is the chain the commit transactions were made on
+    auto optChainType = optFromJson<ChainType>(in, "chain_type");
+    auto optType = optFromJson<std::string>(in, "type");
+    auto optMinID = optFromJson<std::uint64_t>(in, "min_id");
+    auto optMaxID = optFromJson<std::uint64_t>(in, "max_id");
+    auto optMinLedger = optFromJson<std::uint32_t>(in, "ledger_index_min");
+    auto optMaxLedger = optFromJson<std::uint32_t>(in, "ledger_index_max");
+    auto optSendingAccount =
+        optFromJson<ripple::AccountID>(in, "sending_account");
+    auto optLimit = optFromJson<std::uint32_t>(in, "limit");
+    auto const optSuccess = [&]() -> std::optional<bool> {
+        if (!in.isMember("success") || !in["success"].isBool())
+            return std::nullopt;
+        return in["success"].asBool();
+    }();
+    auto const optMarker = [&]() {
+        if (!in.isMember("marker"))
+            return std::optional<
+                std::pair<std::uint64_t, ripple::uint256>>{};
+        return fromMarker(in["marker"]);
+    }();
+    {
+        auto const missingOrInvalidField = [&]() -> std::string {
+            if (!optChainType)
+                return "chain_type";
+            if (invalid("type", optType) ||
+                (optType && *optType != "claim" &&
+                 *optType != "create_account"))
+                return "type";
+            if (invalid("min_id", optMinID))
+                return "min_id";
+            if (invalid("max_id", optMaxID))
+                return "max_id";
+            if (invalid("ledger_index_min", optMinLedger))
+                return "ledger_index_min";
+            if (invalid("ledger_index_max", optMaxLedger))
+                return "ledger_index_max";
+            if (invalid("success", optSuccess))
+                return "success";
+            if (invalid("sending_account", optSendingAccount))
+                return "sending_account";
+            if (invalid("limit", optLimit) || (optLimit && *optLimit == 0))
+                return "limit";
+            if (invalid("marker", optMarker))
+                return "marker";
+            return {};
+        }();
+        if (!missingOrInvalidField.empty())
         {
-            ripple::PublicKey signingPK;
-            convert(publicKeyBlob, signingPK);
+            result["error"] = fmt::format(
+                "Missing or invalid field: {}", missingOrInvalidField);
+            return;
+        }
+    }
 
-            ripple::Buffer sigBuf;
-            convert(signatureBlob, sigBuf);
+    bool const isCreate = optType && *optType == "create_account";
+    ChainDir const chainDir = *optChainType == ChainType::locking
+        ? ChainDir::lockingToIssuing
+        : ChainDir::issuingToLocking;
+    AttestationTable const table = isCreate ? AttestationTable::createAccount
+                                            : AttestationTable::claim;
+    std::uint32_t const limit =
+        std::min(optLimit.value_or(queryDefaultLimit), queryMaxLimit);
+
+    AttestationQuery q;
+    if (optMinID)
+        q.minID = *optMinID;
+    if (optMaxID)
+        q.maxID = *optMaxID;
+    q.minLedger = optMinLedger;
+    q.maxLedger = optMaxLedger;
+    q.success = optSuccess;
+    q.sendingAccount = optSendingAccount;
+    q.after = optMarker;
+    q.limit = limit + 1;
+
+    Json::Value rows{Json::arrayValue};
+    std::optional<std::string> marker;
+    std::pair<std::uint64_t, ripple::uint256> last;
+    // Read one past the page to learn whether another page follows
+    app.storage().scan(
+        chainDir, table, q, [&](AttestationRecord const& r) {
+            if (rows.size() == limit)
+            {
+                marker = toMarker(last.first, last.second);
+                return false;
+            }
+            rows.append(r.toJson(table));
+            last = {r.id, r.txnHash};
+            return true;
+        });
+
+    result["result"]["chain_type"] = to_string(*optChainType);
+    result["result"]["type"] = isCreate ? "create_account" : "claim";
+    result["result"]["limit"] = limit;
+    result["result"]["attestations"] = std::move(rows);
+    if (marker)
+        result["result"]["marker"] = *marker;
+}
 
-            ripple::STAmount sendingAmount;
-            convert(amtBlob, sendingAmount, ripple::sfAmount);
+// Upper bound on the number of lookups in one lookup_attestations call
+std::size_t constexpr lookupMaxBatch = 256;
 
-            ripple::AccountID sendingAccount;
-            convert(sendingAccountBlob, sendingAccount);
+void
+doLookupAttestations(App& app, Json::Value const& in, Json::Value& result)
+{
+    result["request"] = in;
+    auto const f = app.federator();
+    if (!f)
+    {
+        result["error"] = "internal error";
+        return;
+    }
 
-            ripple::AccountID rewardAccount;
-            convert(rewardAccountBlob, rewardAccount);
+    // chain_type is the chain the commit transactions were made on
+    auto optChainType = optFromJson<ChainType>(in, "chain_type");
+    auto const& lookups = in["lookups"];
+    {
+        auto const missingOrInvalidField = [&]() -> std::string {
+            if (!optChainType)
+                return "chain_type";
+            if (!lookups.isArray() || lookups.size() == 0 ||
+                lookups.size() > lookupMaxBatch)
+                return "lookups";
+            return {};
+        }();
+        if (!missingOrInvalidField.empty())
+        {
+            result["error"] = fmt::format(
+                "Missing or invalid field: {}", missingOrInvalidField);
+            return;
+        }
+    }
 
-            std::optional<ripple::AccountID> optDst;
-            if (otherChainDstInd == soci::i_ok)
-            {
-                optDst.emplace();
-                convert(otherChainDstBlob, *optDst);
-            }
+    // Each lookup names exactly one of claim_id, create_count or tx_hash
+    struct Lookup
+    {
+        char const* key;
+        std::uint64_t id = 0;
+        std::optional<ripple::uint256> txHash;
+    };
+    std::vector<Lookup> parsed;
+    parsed.reserve(lookups.size());
+    for (Json::UInt i = 0; i < lookups.size(); ++i)
+    {
+        auto const& l = lookups[i];
+        std::optional<Lookup> lookup;
+        if (l.isObject() && l.size() == 1)
+        {
+            if (auto id = optFromJson<std::uint64_t>(l, "claim_id"))
+                lookup = Lookup{"claim_id", *id, {}};
+            else if (auto id = optFromJson<std::uint64_t>(l, "create_count"))
+                lookup = Lookup{"create_count", *id, {}};
+            else if (auto h = optFromJson<ripple::uint256>(l, "tx_hash"))
+                lookup = Lookup{"tx_hash", 0, *h};
+        }
+        if (!lookup)
+        {
+            result["error"] = fmt::format("Invalid lookup at index {}", i);
+            return;
+        }
+        parsed.push_back(std::move(*lookup));
+    }
 
-            convert(bridgeBlob, bridge, ripple::sfXChainBridge);
-            if (!firstBridge)
-            {
-                firstBridge = bridge;
-            }
-            else
-            {
-                assert(bridge == *firstBridge);
-            }
+    ChainDir const chainDir = *optChainType == ChainType::locking
+        ? ChainDir::lockingToIssuing
+        : ChainDir::issuingToLocking;
 
-            claims.emplace_back(
-                signingPK,
-                sigBuf,
-                sendingAccount,
-                sendingAmount,
-                rewardAccount,
-                chainDir == ChainDir::lockingToIssuing,
-                claimID,
-                optDst);
+    // Ids of the attestations found, in output order, for the submission
+    // status
+    struct Found
+    {
+        bool isCreate;
+        std::uint64_t id;
+    };
+    std::vector<Found> found;
+    std::vector<std::uint64_t> claimIDs;
+    std::vector<std::uint64_t> createCounts;
+
+    Json::Value entries{Json::arrayValue};
+    auto& storage = app.storage();
+    for (Json::UInt i = 0; i < lookups.size(); ++i)
+    {
+        auto const& lookup = parsed[i];
+        Json::Value rows{Json::arrayValue};
+        auto const add = [&](AttestationRecord const& r, bool isCreate) {
+            rows.append(r.toJson(
+                isCreate ? AttestationTable::createAccount
+                         : AttestationTable::claim));
+            found.push_back({isCreate, r.id});
+            (isCreate ? createCounts : claimIDs).push_back(r.id);
+        };
+
+        if (!lookup.txHash)
+        {
+            bool const isCreate =
+                std::string_view{lookup.key} == "create_count";
+            AttestationQuery q;
+            q.minID = q.maxID = lookup.id;
+            storage.scan(
+                chainDir,
+                isCreate ? AttestationTable::createAccount
+                         : AttestationTable::claim,
+                q,
+                [&](AttestationRecord const& r) {
+                    add(r, isCreate);
+                    return true;
+                });
+        }
+        else if (
+            auto r = storage.find(
+                chainDir, AttestationTable::claim, *lookup.txHash))
+        {
+            add(*r, false);
+        }
+        else if (
+            auto r = storage.find(
+                chainDir, AttestationTable::createAccount, *lookup.txHash))
+        {
+            add(*r, true);
         }
 
-        ripple::STXChainAttestationBatch batch{
-            bridge, claims.begin(), claims.end()};
-        result["result"]["XChainAttestationBatch"] =
-            batch.getJson(ripple::JsonOptions::none);
+        Json::Value entry{Json::objectValue};
+        entry[lookup.key] = lookups[i][lookup.key];
+        entry["attestations"] = std::move(rows);
+        entries.append(std::move(entry));
     }
-}
 
-void
-doSelectAllLocking(App& app, Json::Value const& in, Json::Value& result)
-{
-    return doSelectAll(app, in, result, ChainDir::lockingToIssuing);
-}
+    // Attestations are submitted to the other chain
+    auto const dstChain = otherChain(*optChainType);
+    auto const claimStatus = f->getSubmissionStatus(dstChain, false, claimIDs);
+    auto const createStatus =
+        f->getSubmissionStatus(dstChain, true, createCounts);
 
-void
-doSelectAllIssuing(App& app, Json::Value const& in, Json::Value& result)
-{
-    return doSelectAll(app, in, result, ChainDir::issuingToLocking);
+    Json::Value const none = [] {
+        Json::Value r{Json::objectValue};
+        r["status"] = "none";
+        return r;
+    }();
+    std::size_t next = 0;
+    for (auto& entry : entries)
+    {
+        for (auto& r : entry["attestations"])
+        {
+            auto const& fnd = found[next++];
+            auto const& status = fnd.isCreate ? createStatus : claimStatus;
+            auto const it = status.find(fnd.id);
+            r["submission"] = it == status.end() ? none : it->second;
+        }
+    }
+
+    result["result"]["chain_type"] = to_string(*optChainType);
+    result["result"]["lookups"] = std::move(entries);
 }
 
 void
@@ -226,98 +420,53 @@ doWitness(App& app, Json::Value const& in, Json::Value& result)
         return;
     }
 
-    auto const& tblName = db_init::xChainTableName(chainDir);
-
+    auto const matches = [&](AttestationRecord const& r) {
+        return r.deliveredAmt == sendingAmount && r.bridge == bridge &&
+            r.sendingAccount == sendingAccount &&
+            (!optDst || r.otherChainDst == optDst);
+    };
+
+    // TODO: Check for multiple values
+    auto match =
+        app.attestationCache().get(chainDir, AttestationTable::claim, claimID);
+    if (match && !matches(*match))
+        match.reset();
+    if (!match)
     {
-        auto session = app.getXChainTxnDB().checkoutDb();
-        soci::blob amtBlob(*session);
-        soci::blob bridgeBlob(*session);
-        soci::blob sendingAccountBlob(*session);
-        soci::blob rewardAccountBlob(*session);
-        soci::blob otherChainDstBlob(*session);
-        soci::blob publicKeyBlob(*session);
-        soci::blob signatureBlob(*session);
-
-        convert(sendingAmount, amtBlob);
-        convert(bridge, bridgeBlob);
-        convert(sendingAccount, sendingAccountBlob);
-        soci::indicator sigInd;
-        if (optDst)
-        {
-            convert(*optDst, otherChainDstBlob);
-
-            auto sql = fmt::format(
-                R"sql(SELECT Signature, PublicKey, RewardAccount FROM {table_name}
-                  WHERE ClaimID = :claimID and
-                        Success = 1 and
-                        DeliveredAmt = :amt and
-                        Bridge = :bridge and
-                        SendingAccount = :sendingAccount and
-                        OtherChainDst = :otherChainDst;
-            )sql",
-                fmt::arg("table_name", tblName));
-
-            *session << sql, soci::into(signatureBlob, sigInd),
-                soci::into(publicKeyBlob), soci::into(rewardAccountBlob),
-                soci::use(*optClaimID), soci::use(amtBlob),
-                soci::use(bridgeBlob), soci::use(sendingAccountBlob),
-                soci::use(otherChainDstBlob);
-        }
-        else
-        {
-            auto sql = fmt::format(
-                R"sql(SELECT Signature, PublicKey, RewardAccount, OtherChainDst FROM {table_name}
-                  WHERE ClaimID = :claimID and
-                        Success = 1 and
-                        DeliveredAmt = :amt and
-                        Bridge = :bridge and
-                        SendingAccount = :sendingAccount;
-            )sql",
-                fmt::arg("table_name", tblName));
-
-            soci::indicator otherChainDstInd;
-            *session << sql, soci::into(signatureBlob, sigInd),
-                soci::into(publicKeyBlob), soci::into(rewardAccountBlob),
-                soci::into(otherChainDstBlob, otherChainDstInd),
-                soci::use(*optClaimID), soci::use(amtBlob),
-                soci::use(bridgeBlob), soci::use(sendingAccountBlob);
-
-            if (otherChainDstInd == soci::i_ok)
-            {
-                optDst.emplace();
-                convert(otherChainDstBlob, *optDst);
-            }
-        }
+        AttestationQuery q;
+        q.minID = q.maxID = claimID;
+        q.success = true;
+        app.storage().scan(
+            chainDir,
+            AttestationTable::claim,
+            q,
+            [&](AttestationRecord const& r) {
+                if (!matches(r))
+                    return true;
+                match = r;
+                return false;
+            });
+    }
 
-        // TODO: Check for multiple values
-        if (sigInd == soci::i_ok && publicKeyBlob.get_len() > 0 &&
-            rewardAccountBlob.get_len() > 0)
-        {
-            ripple::AccountID rewardAccount;
-            convert(rewardAccountBlob, rewardAccount);
-            ripple::PublicKey signingPK;
-            convert(publicKeyBlob, signingPK);
-            ripple::Buffer sigBuf;
-            convert(signatureBlob, sigBuf);
-
-            ripple::AttestationBatch::AttestationClaim claim{
-                signingPK,
-                sigBuf,
-                sendingAccount,
-                sendingAmount,
-                rewardAccount,
-                chainDir == ChainDir::lockingToIssuing,
-                claimID,
-                optDst};
-
-            ripple::STXChainAttestationBatch batch{bridge, &claim, &claim + 1};
-            result["result"]["XChainAttestationBatch"] =
-                batch.getJson(ripple::JsonOptions::none);
-        }
-        else
-        {
-            result["error"] = "No such transaction";
-        }
+    if (match && match->signature)
+    {
+        ripple::AttestationBatch::AttestationClaim claim{
+            match->publicKey,
+            *match->signature,
+            sendingAccount,
+            sendingAmount,
+            match->rewardAccount,
+            chainDir == ChainDir::lockingToIssuing,
+            claimID,
+            match->otherChainDst};
+
+        ripple::STXChainAttestationBatch batch{bridge, &claim, &claim + 1};
+        result["result"]["XChainAttestationBatch"] =
+            batch.getJson(ripple::JsonOptions::none);
+    }
+    else
+    {
+        result["error"] = "No such transaction";
     }
 }
 
@@ -386,100 +535,225 @@ doWitnessAccountCreate(App& app, Json::Value const& in, Json::Value& result)
         return;
     }
 
-    auto const& tblName = db_init::xChainCreateAccountTableName(chainDir);
+    auto const matches = [&](AttestationRecord const& r) {
+        return r.deliveredAmt == sendingAmount &&
+            r.rewardAmt == rewardAmount && r.bridge == bridge &&
+            r.sendingAccount == sendingAccount && r.otherChainDst == dst;
+    };
+
+    // TODO: Check for multiple values
+    auto match = app.attestationCache().get(
+        chainDir, AttestationTable::createAccount, createCount);
+    if (match && !matches(*match))
+        match.reset();
+    if (!match)
+    {
+        AttestationQuery q;
+        q.minID = q.maxID = createCount;
+        q.success = true;
+        app.storage().scan(
+            chainDir,
+            AttestationTable::createAccount,
+            q,
+            [&](AttestationRecord const& r) {
+                if (!matches(r))
+                    return true;
+                match = r;
+                return false;
+            });
+    }
 
-    std::vector<std::uint8_t> const encodedBridge = [&] {
-        ripple::Serializer s;
-        bridge.add(s);
-        return std::move(s.modData());
-    }();
+    if (match && match->signature)
+    {
+        ripple::AttestationBatch::AttestationCreateAccount claim{
+            match->publicKey,
+            *match->signature,
+            sendingAccount,
+            sendingAmount,
+            rewardAmount,
+            match->rewardAccount,
+            chainDir == ChainDir::lockingToIssuing,
+            createCount,
+            dst};
+
+        ripple::AttestationBatch::AttestationClaim* nullClaim = nullptr;
+        ripple::STXChainAttestationBatch batch{
+            bridge, nullClaim, nullClaim, &claim, &claim + 1};
+        result["result"]["XChainAttestationBatch"] =
+            batch.getJson(ripple::JsonOptions::none);
+    }
+    else
+    {
+        result["error"] = "No such transaction";
+    }
+}
 
-    auto const encodedAmt = [&]() -> std::vector<std::uint8_t> {
-        ripple::Serializer s;
-        sendingAmount.add(s);
-        return std::move(s.modData());
-    }();
-    auto const encodedRewardAmt = [&]() -> std::vector<std::uint8_t> {
-        ripple::Serializer s;
-        rewardAmount.add(s);
-        return std::move(s.modData());
-    }();
+void
+doAttestTx(App& app, Json::Value const& in, Json::Value& result)
+{
+    result["request"] = in;
+    auto const f = app.federator();
+    if (!f)
     {
-        auto session = app.getXChainTxnDB().checkoutDb();
+        result["error"] = "internal error";
+        return;
+    }
 
-        soci::blob amtBlob(*session);
-        convert(encodedAmt, amtBlob);
+    auto optBridge = optFromJson<ripple::STXChainBridge>(in, "bridge");
+    auto optChainType = optFromJson<ChainType>(in, "chain_type");
+    auto optTxHash = optFromJson<ripple::uint256>(in, "tx_hash");
+    {
+        auto const missingOrInvalidField = [&]() -> std::string {
+            if (!optBridge)
+                return "bridge";
+            if (!optChainType)
+                return "chain_type";
+            if (!optTxHash)
+                return "tx_hash";
+            return {};
+        }();
+        if (!missingOrInvalidField.empty())
+        {
+            result["error"] = fmt::format(
+                "Missing or invalid field: {}", missingOrInvalidField);
+            return;
+        }
+    }
 
-        soci::blob rewardAmtBlob(*session);
-        convert(encodedRewardAmt, rewardAmtBlob);
+    f->pullAndAttestTx(*optBridge, *optChainType, *optTxHash, result);
+}
 
-        soci::blob bridgeBlob(*session);
-        convert(encodedBridge, bridgeBlob);
+// Bounds on a bulk attest job
+std::uint32_t constexpr bulkMaxHashes = 10000;
+std::uint32_t constexpr bulkDefaultConcurrency = 8;
+std::uint32_t constexpr bulkMaxConcurrency = 32;
 
-        soci::blob sendingAccountBlob(*session);
-        convert(sendingAccount, sendingAccountBlob);
+void
+doAttestTxs(App& app, Json::Value const& in, Json::Value& result)
+{
+    result["request"] = in;
+    auto const f = app.federator();
+    if (!f)
+    {
+        result["error"] = "internal error";
+        return;
+    }
 
-        soci::blob otherChainDstBlob(*session);
-        convert(dst, otherChainDstBlob);
+    // chain_type is the chain the commit transactions were made on. The
+    // commits are either listed in tx_hashes, or are those of the door
+    // account in the ledger_index_min to ledger_index_max range.
+    auto optBridge = optFromJson<ripple::STXChainBridge>(in, "bridge");
+    auto optChainType = optFromJson<ChainType>(in, "chain_type");
+    auto const& hashes = in["tx_hashes"];
+    auto optMin = optFromJson<std::uint32_t>(in, "ledger_index_min");
+    auto optMax = optFromJson<std::uint32_t>(in, "ledger_index_max");
+    auto optConcurrency = optFromJson<std::uint32_t>(in, "concurrency");
+    {
+        auto const missingOrInvalidField = [&]() -> std::string {
+            if (!optBridge)
+                return "bridge";
+            if (!optChainType)
+                return "chain_type";
+            bool const byRange = in.isMember("ledger_index_min") ||
+                in.isMember("ledger_index_max");
+            if (in.isMember("tx_hashes") == byRange)
+                return "tx_hashes";
+            if (!byRange &&
+                (!hashes.isArray() || hashes.size() == 0 ||
+                 hashes.size() > bulkMaxHashes))
+                return "tx_hashes";
+            if (byRange && !optMin)
+                return "ledger_index_min";
+            if (byRange && (!optMax || *optMax < *optMin))
+                return "ledger_index_max";
+            if (in.isMember("concurrency") &&
+                (!optConcurrency || !*optConcurrency ||
+                 *optConcurrency > bulkMaxConcurrency))
+                return "concurrency";
+            return {};
+        }();
+        if (!missingOrInvalidField.empty())
+        {
+            result["error"] = fmt::format(
+                "Missing or invalid field: {}", missingOrInvalidField);
+            return;
+        }
+    }
 
-        soci::blob rewardAccountBlob(*session);
-        soci::blob publicKeyBlob(*session);
-        soci::blob signatureBlob(*session);
+    BulkAttest::Params params;
+    params.chain = *optChainType;
+    params.concurrency = optConcurrency.value_or(bulkDefaultConcurrency);
+    if (optMin)
+    {
+        params.ledgers.emplace(*optMin, *optMax);
+    }
+    else
+    {
+        params.hashes.reserve(hashes.size());
+        for (Json::UInt i = 0; i < hashes.size(); ++i)
+        {
+            ripple::uint256 h;
+            if (!hashes[i].isString() || !h.parseHex(hashes[i].asString()))
+            {
+                result["error"] = fmt::format("Invalid tx_hash at index {}", i);
+                return;
+            }
+            params.hashes.push_back(h);
+        }
+        // Duplicates are attested once
+        std::sort(params.hashes.begin(), params.hashes.end());
+        params.hashes.erase(
+            std::unique(params.hashes.begin(), params.hashes.end()),
+            params.hashes.end());
+    }
 
-        auto sql = fmt::format(
-            R"sql(SELECT Signature, PublicKey, RewardAccount FROM {table_name}
-                  WHERE CreateCount = :createCount and
-                        Success = 1 and
-                        DeliveredAmt = :amt and
-                        RewardAmt = :rewardAmt and
-                        Bridge = :bridge and
-                        SendingAccount = :sendingAccount and
-                        OtherChainDst = :otherChainDst;
-            )sql",
-            fmt::arg("table_name", tblName));
+    f->startBulkAttest(*optBridge, std::move(params), result);
+}
 
-        *session << sql, soci::into(signatureBlob), soci::into(publicKeyBlob),
-            soci::into(rewardAccountBlob), soci::use(createCount),
-            soci::use(amtBlob), soci::use(rewardAmtBlob), soci::use(bridgeBlob),
-            soci::use(sendingAccountBlob), soci::use(otherChainDstBlob);
+void
+doAttestTxsStatus(App& app, Json::Value const& in, Json::Value& result)
+{
+    result["request"] = in;
+    auto const f = app.federator();
+    if (!f)
+    {
+        result["error"] = "internal error";
+        return;
+    }
 
-        // TODO: Check for multiple values
-        if (signatureBlob.get_len() > 0 && publicKeyBlob.get_len() > 0 &&
-            rewardAccountBlob.get_len() > 0)
-        {
-            ripple::AccountID rewardAccount;
-            convert(rewardAccountBlob, rewardAccount);
-            ripple::PublicKey signingPK;
-            convert(publicKeyBlob, signingPK);
-            ripple::Buffer sigBuf;
-            convert(signatureBlob, sigBuf);
-
-            ripple::AttestationBatch::AttestationCreateAccount claim{
-                signingPK,
-                sigBuf,
-                sendingAccount,
-                sendingAmount,
-                rewardAmount,
-                rewardAccount,
-                chainDir == ChainDir::lockingToIssuing,
-                createCount,
-                dst};
-
-            ripple::AttestationBatch::AttestationClaim* nullClaim = nullptr;
-            ripple::STXChainAttestationBatch batch{
-                bridge, nullClaim, nullClaim, &claim, &claim + 1};
-            result["result"]["XChainAttestationBatch"] =
-                batch.getJson(ripple::JsonOptions::none);
-        }
-        else
+    // Results are paged like query_attestations: pass the returned
+    // results_next as results_from to get the ones recorded since
+    auto optID = optFromJson<std::uint32_t>(in, "job_id");
+    auto optFrom = optFromJson<std::uint32_t>(in, "results_from");
+    auto optLimit = optFromJson<std::uint32_t>(in, "limit");
+    {
+        auto const missingOrInvalidField = [&]() -> std::string {
+            if (!optID)
+                return "job_id";
+            if (in.isMember("results_from") && !optFrom)
+                return "results_from";
+            if (in.isMember("limit") &&
+                (!optLimit || !*optLimit || *optLimit > queryMaxLimit))
+                return "limit";
+            return {};
+        }();
+        if (!missingOrInvalidField.empty())
         {
-            result["error"] = "No such transaction";
+            result["error"] = fmt::format(
+                "Missing or invalid field: {}", missingOrInvalidField);
+            return;
         }
     }
+
+    f->getBulkAttest(
+        *optID,
+        optFrom.value_or(0),
+        optLimit.value_or(queryDefaultLimit),
+        result);
 }
 
 void
-doAttestTx(App& app, Json::Value const& in, Json::Value& result)
+doResync(App& app, Json::Value const& in, Json::Value& result)
 {
     result["request"] = in;
     auto const f = app.federator();
@@ -489,17 +763,30 @@ doAttestTx(App& app, Json::Value const& in, Json::Value& result)
         return;
     }
 
+    // chain_type is the chain the commits were made on. They are attested
+    // again from ledger_index, or from the ledger of tx_hash, on. The job is
+    // followed with attest_txs_status.
     auto optBridge = optFromJson<ripple::STXChainBridge>(in, "bridge");
     auto optChainType = optFromJson<ChainType>(in, "chain_type");
+    auto optLedger = optFromJson<std::uint32_t>(in, "ledger_index");
     auto optTxHash = optFromJson<ripple::uint256>(in, "tx_hash");
+    auto optConcurrency = optFromJson<std::uint32_t>(in, "concurrency");
     {
         auto const missingOrInvalidField = [&]() -> std::string {
             if (!optBridge)
                 return "bridge";
             if (!optChainType)
                 return "chain_type";
-            if (!optTxHash)
+            if (in.isMember("ledger_index") == in.isMember("tx_hash"))
+                return "ledger_index";
+            if (in.isMember("ledger_index") && (!optLedger || !*optLedger))
+                return "ledger_index";
+            if (in.isMember("tx_hash") && !optTxHash)
                 return "tx_hash";
+            if (in.isMember("concurrency") &&
+                (!optConcurrency || !*optConcurrency ||
+                 *optConcurrency > bulkMaxConcurrency))
+                return "concurrency";
             return {};
         }();
         if (!missingOrInvalidField.empty())
@@ -510,7 +797,121 @@ doAttestTx(App& app, Json::Value const& in, Json::Value& result)
         }
     }
 
-    f->pullAndAttestTx(*optBridge, *optChainType, *optTxHash, result);
+    f->startResync(
+        *optBridge,
+        *optChainType,
+        optLedger,
+        optTxHash,
+        optConcurrency.value_or(bulkDefaultConcurrency),
+        result);
+}
+
+// Bounds on the snapshot step size. A step holds the writer lock, so this
+// bounds how long the federator can wait on a snapshot.
+std::uint32_t constexpr snapshotMaxPagesPerStep = 4096;
+std::uint32_t constexpr snapshotMaxPauseMs = 10000;
+
+void
+doSnapshot(App& app, Json::Value const& in, Json::Value& result)
+{
+    result["request"] = in;
+    auto const snapshot = app.snapshot();
+    if (!snapshot)
+    {
+        result["error"] = "snapshot requires the sqlite storage backend";
+        return;
+    }
+
+    auto optPath = optFromJson<std::string>(in, "path");
+    auto optPages = optFromJson<std::uint32_t>(in, "pages_per_step");
+    auto optPause = optFromJson<std::uint32_t>(in, "pause_ms");
+    {
+        auto const missingOrInvalidField = [&]() -> std::string {
+            if (in.isMember("path") && (!optPath || optPath->empty()))
+                return "path";
+            if (in.isMember("pages_per_step") &&
+                (!optPages || !*optPages ||
+                 *optPages > snapshotMaxPagesPerStep))
+                return "pages_per_step";
+            if (in.isMember("pause_ms") &&
+                (!optPause || *optPause > snapshotMaxPauseMs))
+                return "pause_ms";
+            return {};
+        }();
+        if (!missingOrInvalidField.empty())
+        {
+            result["error"] = fmt::format(
+                "Missing or invalid field: {}", missingOrInvalidField);
+            return;
+        }
+    }
+
+    DatabaseSnapshot::Params params;
+    if (optPath)
+    {
+        params.path = *optPath;
+    }
+    else
+    {
+        using namespace std::chrono;
+        auto const now = system_clock::now().time_since_epoch();
+        params.path = fmt::format(
+            "snapshots/xchain_txns-{}.db",
+            duration_cast<seconds>(now).count());
+    }
+    // Relative paths are in the data directory
+    if (params.path.is_relative())
+        params.path = app.config().dataDir / params.path;
+    if (optPages)
+        params.pagesPerStep = *optPages;
+    if (optPause)
+        params.pause = std::chrono::milliseconds{*optPause};
+
+    if (auto const err = snapshot->start(params))
+    {
+        result["error"] = *err;
+        return;
+    }
+    result["result"] = snapshot->getInfo();
+}
+
+void
+doSnapshotStatus(App& app, Json::Value const& in, Json::Value& result)
+{
+    result["request"] = in;
+    auto const snapshot = app.snapshot();
+    if (!snapshot)
+    {
+        result["error"] = "snapshot requires the sqlite storage backend";
+        return;
+    }
+    result["result"] = snapshot->getInfo();
+}
+
+// The in-flight submissions, and the sequence of the last "state" message
+// they include. A standby witness mirrors them from the active.
+void
+doSubmissionJournal(App& app, Json::Value const& in, Json::Value& result)
+{
+    result["request"] = in;
+    auto const f = app.federator();
+    if (!f)
+    {
+        result["error"] = "internal error";
+        return;
+    }
+    result["result"] = f->journalSnapshot();
+}
+
+// subscribe and unsubscribe are served by the websocket session handler. This
+// only answers when they arrive over http.
+void
+doWebsocketOnly(App& app, Json::Value const& in, Json::Value& result)
+{
+    result["request"] = in;
+    result["error"] = fmt::format(
+        "{} is only available over websocket",
+        in[ripple::jss::command].asString());
 }
 
 enum class Role { USER, ADMIN };
@@ -529,9 +930,20 @@ std::unordered_map<std::string, CmdFun> const handlers = [] {
     r.emplace("witness"s, CmdFun{doWitness, Role::USER});
     r.emplace(
         "witness_account_create"s, CmdFun{doWitnessAccountCreate, Role::USER});
-    r.emplace("select_all_locking"s, CmdFun{doSelectAllLocking, Role::USER});
-    r.emplace("select_all_issuing"s, CmdFun{doSelectAllIssuing, Role::USER});
+    r.emplace("query_attestations"s, CmdFun{doQueryAttestations, Role::USER});
+    r.emplace(
+        "lookup_attestations"s, CmdFun{doLookupAttestations, Role::USER});
     r.emplace("attest_tx"s, CmdFun{doAttestTx, Role::ADMIN});
+    r.emplace("attest_txs"s, CmdFun{doAttestTxs, Role::ADMIN});
+    r.emplace(
+        "attest_txs_status"s, CmdFun{doAttestTxsStatus, Role::ADMIN});
+    r.emplace("resync"s, CmdFun{doResync, Role::ADMIN});
+    r.emplace("snapshot"s, CmdFun{doSnapshot, Role::ADMIN});
+    r.emplace("snapshot_status"s, CmdFun{doSnapshotStatus, Role::ADMIN});
+    r.emplace(
+        "submission_journal"s, CmdFun{doSubmissionJournal, Role::ADMIN});
+    r.emplace("subscribe"s, CmdFun{doWebsocketOnly, Role::USER});
+    r.emplace("unsubscribe"s, CmdFun{doWebsocketOnly, Role::USER});
     return r;
 }();
 }  // namespace
@@ -572,6 +984,14 @@ isAdmin(
     if (ac.addresses.empty() && ac.netsV4.empty() && ac.netsV6.empty())
         return true;
 
+    return isAdminAddress(ac, remoteIp);
+}
+
+bool
+isAdminAddress(
+    config::AdminConfig const& ac,
+    boost::asio::ip::address const& remoteIp)
+{
     if (ac.addresses.count(remoteIp) != 0)
         return true;
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <xbwd/app/Config.h>
+
 #include <ripple/beast/net/IPEndpoint.h>
 #include <ripple/json/json_value.h>
 #include <ripple/server/Port.h>
@@ -8,6 +10,19 @@ namespace xbwd {
 class App;
 namespace rpc {
 
+// True if the request may run admin commands
+bool
+isAdmin(
+    std::optional<config::AdminConfig> const& adminConf,
+    Json::Value const& params,
+    boost::asio::ip::address const& remoteIp);
+
+// True if the address is listed in, or inside a subnet of, the admin config
+bool
+isAdminAddress(
+    config::AdminConfig const& ac,
+    boost::asio::ip::address const& remoteIp);
+
 void
 doCommand(
     App& app,
@@ -0,0 +1,182 @@
+#include <xbwd/rpc/ResourceManager.h>
+
+#include <xbwd/rpc/RPCHandler.h>
+
+#include <ripple/basics/Log.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace xbwd {
+namespace rpc {
+
+namespace {
+
+// Cost of commands not listed in commandCosts
+double constexpr defaultCost = 2;
+
+// Relative cost of each command, roughly the work it does per call
+std::unordered_map<std::string, double> const commandCosts{
+    {"server_info", 1},
+    {"witness", 1},
+    {"witness_account_create", 1},
+    {"lookup_attestations", 5},
+    {"query_attestations", 10},
+    {"subscribe", 2},
+    {"unsubscribe", 1},
+};
+
+// Forget idle clients once this many are tracked
+std::size_t constexpr maxBuckets = 10000;
+
+}  // namespace
+
+ResourceManager::ResourceManager(
+    config::RateLimitConfig const& limits,
+    std::optional<config::AdminConfig> const& adminConfig,
+    beast::Journal j)
+    : limits_(limits), adminConfig_(adminConfig), j_(j)
+{
+}
+
+bool
+ResourceManager::exempt(boost::asio::ip::address const& remote) const
+{
+    return remote.is_loopback() ||
+        (adminConfig_ && isAdminAddress(*adminConfig_, remote));
+}
+
+ResourceManager::Priority
+ResourceManager::priority(boost::asio::ip::address const& remote) const
+{
+    return exempt(remote) ? Priority::high : Priority::normal;
+}
+
+ResourceManager::Bucket&
+ResourceManager::bucket(
+    boost::asio::ip::address const& remote,
+    clock_type::time_point now)
+{
+    auto const refill = [&](Bucket& b) {
+        std::chrono::duration<double> const elapsed = now - b.updated;
+        b.tokens = std::min<double>(
+            limits_.burst, b.tokens + elapsed.count() * limits_.rate);
+        b.updated = now;
+    };
+
+    if (auto it = buckets_.find(remote); it != buckets_.end())
+    {
+        refill(it->second);
+        return it->second;
+    }
+
+    if (buckets_.size() >= maxBuckets)
+    {
+        // A full bucket carries no state worth keeping
+        for (auto it = buckets_.begin(); it != buckets_.end();)
+        {
+            refill(it->second);
+            if (it->second.tokens >= limits_.burst)
+                it = buckets_.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    return buckets_
+        .emplace(remote, Bucket{static_cast<double>(limits_.burst), now})
+        .first->second;
+}
+
+bool
+ResourceManager::admit(boost::asio::ip::address const& remote)
+{
+    if (exempt(remote))
+        return true;
+
+    {
+        std::lock_guard l{mutex_};
+        if (bucket(remote, clock_type::now()).tokens > 0)
+            return true;
+    }
+
+    ++limited_;
+    JLOGV(
+        j_.debug(),
+        "rate limited",
+        ripple::jv("remote", remote.to_string()));
+    return false;
+}
+
+void
+ResourceManager::charge(
+    boost::asio::ip::address const& remote,
+    std::string const& command)
+{
+    if (exempt(remote))
+        return;
+
+    auto const it = commandCosts.find(command);
+    double const cost = it == commandCosts.end() ? defaultCost : it->second;
+
+    std::lock_guard l{mutex_};
+    bucket(remote, clock_type::now()).tokens -= cost;
+}
+
+bool
+ResourceManager::enqueue(Priority p, std::function<void()>&& job)
+{
+    {
+        std::lock_guard l{mutex_};
+        auto& q = queues_[static_cast<std::size_t>(p)];
+        if (p == Priority::high || q.size() < limits_.maxQueued)
+        {
+            q.push_back(std::move(job));
+            return true;
+        }
+    }
+
+    ++dropped_;
+    JLOG(j_.warn()) << "RPC queue full, dropping request";
+    return false;
+}
+
+std::function<void()>
+ResourceManager::next()
+{
+    std::lock_guard l{mutex_};
+    for (auto& q : queues_)
+    {
+        if (!q.empty())
+        {
+            auto job = std::move(q.front());
+            q.pop_front();
+            ++served_;
+            return job;
+        }
+    }
+    return {};
+}
+
+Json::Value
+ResourceManager::getInfo() const
+{
+    Json::Value ret{Json::objectValue};
+    {
+        std::lock_guard l{mutex_};
+        ret["clients"] = static_cast<std::uint32_t>(buckets_.size());
+        ret["queued_high"] = static_cast<std::uint32_t>(
+            queues_[static_cast<std::size_t>(Priority::high)].size());
+        ret["queued_normal"] = static_cast<std::uint32_t>(
+            queues_[static_cast<std::size_t>(Priority::normal)].size());
+    }
+    ret["served"] = std::to_string(served_.load());
+    ret["limited"] = std::to_string(limited_.load());
+    ret["dropped"] = std::to_string(dropped_.load());
+    ret["rate"] = limits_.rate;
+    ret["burst"] = limits_.burst;
+    return ret;
+}
+
+}  // namespace rpc
+}  // namespace xbwd
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <xbwd/app/Config.h>
+#include <xbwd/basics/ThreadSaftyAnalysis.h>
+
+#include <ripple/beast/utility/Journal.h>
+#include <ripple/json/json_value.h>
+
+#include <boost/asio/ip/address.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace xbwd {
+namespace rpc {
+
+/** Admission control and scheduling for RPC clients.
+
+    Each client address has a token bucket refilled at the configured rate.
+    Every command a client runs is charged its cost, and a client whose bucket
+    is empty is turned away before its request is parsed. Admitted requests
+    wait for an RPC thread in one of two queues. Clients on the admin address
+    list, and loopback clients, use the high priority queue and are never
+    charged. Everybody else uses the normal queue, which is bounded.
+*/
+class ResourceManager
+{
+public:
+    enum class Priority : std::size_t { high, normal, last };
+
+private:
+    using clock_type = std::chrono::steady_clock;
+
+    struct Bucket
+    {
+        double tokens;
+        clock_type::time_point updated;
+    };
+
+    config::RateLimitConfig const limits_;
+    std::optional<config::AdminConfig> const adminConfig_;
+
+    mutable std::mutex mutex_;
+    std::map<boost::asio::ip::address, Bucket> GUARDED_BY(mutex_) buckets_;
+    std::array<
+        std::deque<std::function<void()>>,
+        static_cast<std::size_t>(Priority::last)>
+        GUARDED_BY(mutex_) queues_;
+
+    std::atomic<std::uint64_t> served_{0};
+    // requests turned away because the client was over its limit
+    std::atomic<std::uint64_t> limited_{0};
+    // requests turned away because the normal queue was full
+    std::atomic<std::uint64_t> dropped_{0};
+    beast::Journal j_;
+
+public:
+    ResourceManager(
+        config::RateLimitConfig const& limits,
+        std::optional<config::AdminConfig> const& adminConfig,
+        beast::Journal j);
+
+    Priority
+    priority(boost::asio::ip::address const& remote) const;
+
+    // Return false, and count the request as limited, if the client has no
+    // tokens left
+    bool
+    admit(boost::asio::ip::address const& remote) EXCLUDES(mutex_);
+
+    // Charge the client for running `command`
+    void
+    charge(boost::asio::ip::address const& remote, std::string const& command)
+        EXCLUDES(mutex_);
+
+    // Queue a job. Return false, and count it as dropped, if the queue for
+    // normal priority jobs is full.
+    bool
+    enqueue(Priority p, std::function<void()>&& job) EXCLUDES(mutex_);
+
+    // Remove the highest priority queued job. Empty if there is none.
+    std::function<void()>
+    next() EXCLUDES(mutex_);
+
+    Json::Value
+    getInfo() const EXCLUDES(mutex_);
+
+private:
+    bool
+    exempt(boost::asio::ip::address const& remote) const;
+
+    Bucket&
+    bucket(boost::asio::ip::address const& remote, clock_type::time_point now)
+        REQUIRES(mutex_);
+};
+
+}  // namespace rpc
+}  // namespace xbwd
@@ -19,8 +19,10 @@
 
 #include <xbwd/rpc/ServerHandler.h>
 
+#include <xbwd/app/App.h>
 #include <xbwd/app/BuildInfo.h>
 #include <xbwd/rpc/RPCHandler.h>
+#include <xbwd/rpc/Subscriptions.h>
 
 #include <ripple/basics/Log.h>
 #include <ripple/basics/base64.h>
@@ -41,6 +43,8 @@
 #include <ripple/server/SimpleWriter.h>
 #include <ripple/server/impl/JSONRPCUtil.h>
 
+#include <fmt/core.h>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/trim.hpp>
@@ -49,6 +53,9 @@
 #include <boost/type_traits.hpp>
 
 #include <algorithm>
+#include <exception>
+#include <latch>
+#include <memory>
 #include <mutex>
 #include <sstream>
 #include <stdexcept>
@@ -243,6 +250,9 @@ HTTPReply(
         case 404:
             output("HTTP/1.1 404 Not Found\r\n");
             break;
+        case 429:
+            output("HTTP/1.1 429 Too Many Requests\r\n");
+            break;
         case 500:
             output("HTTP/1.1 500 Internal Server Error\r\n");
             break;
@@ -687,9 +697,23 @@ ServerHandler::ServerHandler(
     beast::Journal j)
     : app_(app)
     , server_(ripple::make_Server(*this, io_service, j))
-    , threadPool_(std::thread::hardware_concurrency())
+    , threadPoolSize_(app.config().threads.rpc.size())
+    , threadPool_(threadPoolSize_)
     , j_(j)
 {
+    // thread_pool has no thread start hook. Keep every pool thread busy until
+    // all of them have registered, so each registers exactly once.
+    auto const& cpus = app.config().threads.rpc.cpus;
+    auto started = std::make_shared<std::latch>(
+        static_cast<std::ptrdiff_t>(threadPoolSize_));
+    for (std::size_t i = 0; i < threadPoolSize_; ++i)
+    {
+        boost::asio::post(threadPool_, [&app, started, cpus, i]() {
+            app.threadMap().enter("rpc", "rpc #" + std::to_string(i), cpus);
+            started->arrive_and_wait();
+        });
+    }
+    started->wait();
 }
 
 ServerHandler::~ServerHandler()
@@ -755,7 +779,24 @@ ServerHandler::onHandoff(
 
     if (websocket::is_upgrade(request))
     {
-        // TODO
+        if (!is_ws)
+            return statusRequestResponse(request, http::status::unauthorized);
+
+        std::shared_ptr<ripple::WSSession> ws;
+        try
+        {
+            ws = session.websocketUpgrade();
+        }
+        catch (std::exception const& e)
+        {
+            JLOG(j_.error())
+                << "Exception upgrading websocket: " << e.what() << "\n";
+            return statusRequestResponse(
+                request, http::status::internal_server_error);
+        }
+
+        ws->appDefined = std::make_shared<WSSessionState>();
+        ws->run();
         ripple::Handoff handoff;
         handoff.moved = true;
         return handoff;
@@ -782,6 +823,14 @@ ServerHandler::onHandoff(
 }
 
 namespace {
+// Largest request body accepted over http or websocket. Large enough for a
+// full batch of witness queries.
+std::size_t constexpr maxRequestSize = 1000000;
+// Most requests in one batch
+std::size_t constexpr maxBatchSize = 1000;
+// Most requests from one websocket session executing at the same time
+int constexpr maxWSInFlight = 16;
+
 inline Json::Output
 makeOutput(ripple::Session& session)
 {
@@ -805,6 +854,15 @@ build_map(boost::beast::http::fields const& h)
     return c;
 }
 
+void
+sendWS(
+    std::shared_ptr<ripple::WSSession> const& session,
+    Json::Value const& jv)
+{
+    session->send(std::make_shared<SharedWSMsg>(
+        std::make_shared<std::string const>(to_string(jv))));
+}
+
 template <class ConstBufferSequence>
 std::string
 buffers_to_string(ConstBufferSequence const& bs)
@@ -841,10 +899,42 @@ ServerHandler::onRequest(ripple::Session& session)
         return;
     }
 
+    auto& resources = app_.resources();
+    auto const remote = session.remoteAddress().address();
+    if (!resources.admit(remote))
+    {
+        HTTPReply(429, "Too Many Requests", makeOutput(session), j_);
+        session.close(true);
+        return;
+    }
+
     std::shared_ptr<ripple::Session> detachedSession = session.detach();
-    boost::asio::post(threadPool_, [this, detachedSession]() {
-        this->processSession(detachedSession);
+    if (!schedule(resources.priority(remote), [this, detachedSession]() {
+            this->processSession(detachedSession);
+        }))
+    {
+        HTTPReply(
+            503, "Server is overloaded", makeOutput(*detachedSession), j_);
+        detachedSession->close(true);
+    }
+}
+
+bool
+ServerHandler::schedule(
+    ResourceManager::Priority p,
+    std::function<void()>&& job)
+{
+    auto& resources = app_.resources();
+    if (!resources.enqueue(p, std::move(job)))
+        return false;
+
+    // One runner per queued job. Each runs whichever job has the highest
+    // priority when it gets a thread, not necessarily the one queued here.
+    boost::asio::post(threadPool_, [&resources]() {
+        if (auto job = resources.next())
+            job();
     });
+    return true;
 }
 
 void
@@ -852,7 +942,89 @@ ServerHandler::onWSMessage(
     std::shared_ptr<ripple::WSSession> session,
     std::vector<boost::asio::const_buffer> const& buffers)
 {
-    // TODO
+    Json::Value jv;
+    auto const size = boost::asio::buffer_size(buffers);
+    if (size > maxRequestSize || !Json::Reader{}.parse(jv, buffers) ||
+        !(jv.isObject() || jv.isArray()))
+    {
+        Json::Value jvResult(Json::objectValue);
+        jvResult[ripple::jss::type] = ripple::jss::error;
+        jvResult[ripple::jss::error] = "jsonInvalid";
+        jvResult[ripple::jss::value] = buffers_to_string(buffers);
+        JLOG(j_.trace()) << "Websocket sending '" << jvResult << "'";
+        sendWS(session, jvResult);
+        session->complete();
+        return;
+    }
+
+    JLOG(j_.trace()) << "Websocket received '" << jv << "'";
+
+    if (jv.isArray() && (jv.size() == 0 || jv.size() > maxBatchSize))
+    {
+        Json::Value jvResult(Json::objectValue);
+        jvResult[ripple::jss::type] = ripple::jss::error;
+        jvResult[ripple::jss::error] = "batchInvalid";
+        sendWS(session, jvResult);
+        session->complete();
+        return;
+    }
+
+    auto& resources = app_.resources();
+    auto const remote = session->remote_endpoint().address();
+    if (!resources.admit(remote))
+    {
+        Json::Value jvResult(Json::objectValue);
+        jvResult[ripple::jss::type] = ripple::jss::error;
+        jvResult[ripple::jss::error] = "slowDown";
+        sendWS(session, jvResult);
+        session->complete();
+        return;
+    }
+
+    // Requests are pipelined: the next message is read while this one runs,
+    // and replies go out as they finish, matched by id. Reading pauses while
+    // maxWSInFlight requests from the session are running.
+    auto const state =
+        std::static_pointer_cast<WSSessionState>(session->appDefined);
+    if (++state->inFlight < maxWSInFlight)
+        session->complete();
+
+    auto const p = resources.priority(remote);
+    auto const scheduled = schedule(
+        p,
+        [this, session, state, p, jv = std::move(jv)]() {
+            Json::Value jr;
+            if (jv.isArray())
+            {
+                std::vector<Json::Value> replies(jv.size());
+                parallelFor(p, replies.size(), [&](std::size_t i) {
+                    replies[i] = this->processSession(
+                        session, jv[static_cast<Json::UInt>(i)]);
+                });
+                jr = Json::Value(Json::arrayValue);
+                for (auto& r : replies)
+                    jr.append(std::move(r));
+            }
+            else
+            {
+                jr = this->processSession(session, jv);
+            }
+            sendWS(session, jr);
+
+            // resume reading if it was paused on this session's limit
+            if (state->inFlight-- == maxWSInFlight)
+                session->complete();
+        });
+
+    if (!scheduled)
+    {
+        Json::Value jvResult(Json::objectValue);
+        jvResult[ripple::jss::type] = ripple::jss::error;
+        jvResult[ripple::jss::error] = "tooBusy";
+        sendWS(session, jvResult);
+        if (state->inFlight-- == maxWSInFlight)
+            session->complete();
+    }
 }
 
 void
@@ -877,12 +1049,21 @@ ServerHandler::processSession(
     std::shared_ptr<ripple::WSSession> const& session,
     Json::Value const& jv)
 {
-    // Requests without "method" are invalid.
+    // Accept the JSON-RPC style "method" as well as "command"
+    if (jv.isObject() && !jv.isMember(ripple::jss::command) &&
+        jv.isMember(ripple::jss::method))
+    {
+        Json::Value withCommand = jv;
+        withCommand[ripple::jss::command] = jv[ripple::jss::method];
+        return processSession(session, withCommand);
+    }
+
+    // Requests without "command" are invalid.
     Json::Value jr(Json::objectValue);
     try
     {
-        if (!jv.isMember(ripple::jss::method) &&
-            !jv[ripple::jss::method].isString())
+        if (!jv.isObject() || !jv.isMember(ripple::jss::command) ||
+            !jv[ripple::jss::command].isString())
         {
             jr[ripple::jss::type] = ripple::jss::response;
             jr[ripple::jss::status] = ripple::jss::error;
@@ -898,11 +1079,23 @@ ServerHandler::processSession(
             return jr;
         }
 
-        rpc::doCommand(
-            app_,
-            beast::IP::from_asio(session->remote_endpoint().address()),
-            jv,
-            jr[ripple::jss::result]);
+        auto const& cmd = jv[ripple::jss::command].asString();
+        app_.resources().charge(session->remote_endpoint().address(), cmd);
+        if (cmd == "subscribe" || cmd == "unsubscribe")
+        {
+            // Needs the session, so it is handled here rather than by
+            // doCommand
+            doSubscribe(
+                session, jv, jr[ripple::jss::result], cmd == "subscribe");
+        }
+        else
+        {
+            rpc::doCommand(
+                app_,
+                beast::IP::from_asio(session->remote_endpoint().address()),
+                jv,
+                jr[ripple::jss::result]);
+        }
     }
     catch (std::exception const& ex)
     {
@@ -950,6 +1143,56 @@ ServerHandler::processSession(
     return jr;
 }
 
+void
+ServerHandler::doSubscribe(
+    std::shared_ptr<ripple::WSSession> const& session,
+    Json::Value const& jv,
+    Json::Value& result,
+    bool subscribe)
+{
+    result["request"] = jv;
+    auto const& streams = jv["streams"];
+    if (!streams.isArray() || streams.size() == 0)
+    {
+        result["error"] = "Missing or invalid field: streams";
+        return;
+    }
+
+    std::vector<Subscriptions::Stream> parsed;
+    for (auto const& s : streams)
+    {
+        auto const stream =
+            s.isString() ? Subscriptions::streamFromString(s.asString())
+                         : std::nullopt;
+        if (!stream)
+        {
+            result["error"] =
+                fmt::format("Unknown stream: {}", to_string(s));
+            return;
+        }
+        if (*stream == Subscriptions::Stream::state &&
+            !isAdmin(
+                app_.config().adminConfig,
+                jv,
+                session->remote_endpoint().address()))
+        {
+            result["error"] = "Stream requires admin: state";
+            return;
+        }
+        parsed.push_back(*stream);
+    }
+
+    auto& subs = app_.subscriptions();
+    for (auto const s : parsed)
+    {
+        if (subscribe)
+            subs.subscribe(session, s);
+        else
+            subs.unsubscribe(*session, s);
+    }
+    result["result"]["streams"] = streams;
+}
+
 void
 ServerHandler::processSession(std::shared_ptr<ripple::Session> const& session)
 {
@@ -985,11 +1228,189 @@ make_json_error(Json::Int code, Json::Value&& message)
 }
 
 Json::Int constexpr method_not_found = -32601;
+Json::Int constexpr invalid_params = -32602;
 Json::Int constexpr server_overloaded = -32604;
 Json::Int constexpr forbidden = -32605;
 Json::Int constexpr wrong_version = -32606;
 }  // namespace
 
+Json::Value
+ServerHandler::processJsonRpc(
+    Json::Value const& jsonRPC,
+    beast::IP::Endpoint const& remoteIPAddress,
+    std::string& badRequest)
+{
+    // Malformed requests are answered with a JSON-RPC error object. Outside a
+    // batch the caller replies with an HTTP 400 and `badRequest` instead.
+    auto const malformed = [&](Json::Int code, char const* reason) {
+        badRequest = reason;
+        Json::Value r(Json::objectValue);
+        r[ripple::jss::request] = jsonRPC;
+        r[ripple::jss::error] = make_json_error(code, reason);
+        return r;
+    };
+
+    if (!jsonRPC.isObject())
+        return malformed(method_not_found, "Method not found");
+
+    if (!jsonRPC.isMember(ripple::jss::method) ||
+        jsonRPC[ripple::jss::method].isNull())
+        return malformed(method_not_found, "Null method");
+
+    Json::Value const& method = jsonRPC[ripple::jss::method];
+    if (!method.isString())
+        return malformed(method_not_found, "method is not string");
+
+    std::string strMethod = method.asString();
+    if (strMethod.empty())
+        return malformed(method_not_found, "method is empty");
+
+    // Extract request parameters from the request Json as `params`.
+    //
+    // If the field "params" is empty, `params` is an empty object.
+    //
+    // Otherwise, that field must be an array of length 1 (why?)
+    // and we take that first entry and validate that it's an object.
+    Json::Value params;
+    {
+        params = jsonRPC[ripple::jss::params];
+        if (!params)
+            params = Json::Value(Json::objectValue);
+
+        else if (!params.isArray() || params.size() != 1)
+        {
+            return malformed(invalid_params, "params unparseable");
+        }
+        else
+        {
+            params = std::move(params[0u]);
+            if (!params.isObjectOrNull())
+                return malformed(invalid_params, "params unparseable");
+        }
+    }
+
+    JLOG(j_.debug()) << "Query: " << strMethod << params;
+
+    // Provide the JSON-RPC method as the field "command" in the request.
+    params[ripple::jss::command] = strMethod;
+    JLOG(j_.trace()) << "doRpcCommand:" << strMethod << ":" << params;
+
+    Json::Value result;
+    try
+    {
+        app_.resources().charge(remoteIPAddress.address(), strMethod);
+        rpc::doCommand(app_, remoteIPAddress, params, result);
+    }
+    catch (std::exception const& ex)
+    {
+        JLOG(j_.error()) << "Exception while processing RPC: " << ex.what();
+        result = Json::Value(Json::objectValue);
+        result[ripple::jss::error] = "internal error";
+    }
+
+    Json::Value r(Json::objectValue);
+    if (result.isMember(ripple::jss::error))
+    {
+        result[ripple::jss::status] = ripple::jss::error;
+        result["code"] = result[ripple::jss::error_code];
+        result["message"] = result[ripple::jss::error_message];
+        result.removeMember(ripple::jss::error_message);
+        JLOG(j_.debug()) << "rpcError: " << result[ripple::jss::error] << ": "
+                         << result[ripple::jss::error_message];
+        r[ripple::jss::error] = std::move(result);
+    }
+    else
+    {
+        result[ripple::jss::status] = ripple::jss::success;
+        r[ripple::jss::result] = std::move(result);
+    }
+
+    if (params.isMember(ripple::jss::jsonrpc))
+        r[ripple::jss::jsonrpc] = params[ripple::jss::jsonrpc];
+    if (params.isMember(ripple::jss::ripplerpc))
+        r[ripple::jss::ripplerpc] = params[ripple::jss::ripplerpc];
+    if (params.isMember(ripple::jss::id))
+        r[ripple::jss::id] = params[ripple::jss::id];
+    Json::Value reply = std::move(r);
+
+    if (reply.isMember(ripple::jss::result) &&
+        reply[ripple::jss::result].isMember(ripple::jss::result))
+    {
+        reply = reply[ripple::jss::result];
+        if (reply.isMember(ripple::jss::status))
+        {
+            reply[ripple::jss::result][ripple::jss::status] =
+                reply[ripple::jss::status];
+            reply.removeMember(ripple::jss::status);
+        }
+    }
+    return reply;
+}
+
+void
+ServerHandler::parallelFor(
+    ResourceManager::Priority p,
+    std::size_t n,
+    std::function<void(std::size_t)> const& f)
+{
+    // The calling thread takes part and only waits for items that another
+    // thread has already started, so this cannot deadlock even when every
+    // pool thread is itself inside a parallelFor. Helpers that start after
+    // all items are claimed exit without touching `f`.
+    if (n == 0)
+        return;
+
+    struct State
+    {
+        std::atomic<std::size_t> next{0};
+        std::size_t done = 0;
+        // The first exception thrown by `f`, rethrown on the calling thread
+        std::exception_ptr error;
+        std::mutex m;
+        std::condition_variable cv;
+    };
+    auto state = std::make_shared<State>();
+    auto const run = [state, n, &f] {
+        for (auto i = state->next++; i < n; i = state->next++)
+        {
+            std::exception_ptr error;
+            try
+            {
+                f(i);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            std::lock_guard l{state->m};
+            if (error && !state->error)
+                state->error = std::move(error);
+            if (++state->done == n)
+                state->cv.notify_all();
+        }
+    };
+
+    // Helpers are queued like any other job, so higher priority work still
+    // gets the next free thread. A batch from a normal priority client is
+    // also kept from taking every thread.
+    auto const threads = p == ResourceManager::Priority::high
+        ? threadPoolSize_
+        : std::max<std::size_t>(threadPoolSize_ / 2, 1);
+    auto const helpers = std::min(n, threads) - 1;
+    for (std::size_t i = 0; i < helpers; ++i)
+    {
+        // Dropped when the queue is full. The calling thread does the rest.
+        if (!schedule(p, run))
+            break;
+    }
+    run();
+
+    std::unique_lock l{state->m};
+    state->cv.wait(l, [&] { return state->done == n; });
+    if (state->error)
+        std::rethrow_exception(state->error);
+}
+
 void
 ServerHandler::processRequest(
     ripple::Port const& port,
@@ -1001,11 +1422,10 @@ ServerHandler::processRequest(
 {
     Json::Value jsonOrig;
     {
-        std::size_t const maxRequestSize = 2048;
         Json::Reader reader;
         if ((request.size() > maxRequestSize) ||
             !reader.parse(request, jsonOrig) || !jsonOrig ||
-            !jsonOrig.isObject())
+            !(jsonOrig.isObject() || jsonOrig.isArray()))
         {
             HTTPReply(
                 400,
@@ -1016,136 +1436,59 @@ ServerHandler::processRequest(
         }
     }
 
-    Json::Value reply(Json::objectValue);
-    auto const start(std::chrono::high_resolution_clock::now());
+    /**
+     * Clear header-assigned values since not positively identified from a
+     * secure_gateway.
+     */
     {
-        Json::Value const& jsonRPC = jsonOrig;
+        forwardedFor.clear();
+        user.clear();
+    }
 
-        if (!jsonRPC.isObject())
-        {
-            Json::Value r(Json::objectValue);
-            r[ripple::jss::request] = jsonRPC;
-            r[ripple::jss::error] =
-                make_json_error(method_not_found, "Method not found");
-            reply.append(r);
-        }
+    // A batch is either a JSON-RPC 2.0 array of requests, or the "batch"
+    // method with the requests in "params" as rippled accepts.
+    Json::Value* batch = nullptr;
+    if (jsonOrig.isArray())
+        batch = &jsonOrig;
+    else if (jsonOrig[ripple::jss::method] == "batch")
+        batch = &jsonOrig[ripple::jss::params];
+
+    if (batch &&
+        (!batch->isArray() || batch->size() == 0 ||
+         batch->size() > maxBatchSize))
+    {
+        HTTPReply(400, "Malformed batch request", output, j_);
+        return;
+    }
 
-        if (!jsonRPC.isMember(ripple::jss::method) ||
-            jsonRPC[ripple::jss::method].isNull())
+    Json::Value reply;
+    if (!batch)
+    {
+        std::string badRequest;
+        reply = processJsonRpc(jsonOrig, remoteIPAddress, badRequest);
+        if (!badRequest.empty())
         {
-            HTTPReply(400, "Null method", output, j_);
+            HTTPReply(400, badRequest, output, j_);
             return;
         }
+    }
+    else
+    {
+        std::vector<Json::Value> replies(batch->size());
+        auto const p = app_.resources().priority(remoteIPAddress.address());
+        parallelFor(p, replies.size(), [&](std::size_t i) {
+            std::string badRequest;
+            replies[i] = processJsonRpc(
+                (*batch)[static_cast<Json::UInt>(i)],
+                remoteIPAddress,
+                badRequest);
+        });
 
-        Json::Value const& method = jsonRPC[ripple::jss::method];
-        if (!method.isString())
-        {
-            {
-                HTTPReply(400, "method is not string", output, j_);
-                return;
-            }
-            Json::Value r = jsonRPC;
-            r[ripple::jss::error] =
-                make_json_error(method_not_found, "method is not string");
-            reply.append(r);
-        }
-
-        std::string strMethod = method.asString();
-        if (strMethod.empty())
-        {
-            {
-                HTTPReply(400, "method is empty", output, j_);
-                return;
-            }
-            Json::Value r = jsonRPC;
-            r[ripple::jss::error] =
-                make_json_error(method_not_found, "method is empty");
-            reply.append(r);
-        }
-
-        // Extract request parameters from the request Json as `params`.
-        //
-        // If the field "params" is empty, `params` is an empty object.
-        //
-        // Otherwise, that field must be an array of length 1 (why?)
-        // and we take that first entry and validate that it's an object.
-        Json::Value params;
-        {
-            params = jsonRPC[ripple::jss::params];
-            if (!params)
-                params = Json::Value(Json::objectValue);
-
-            else if (!params.isArray() || params.size() != 1)
-            {
-                HTTPReply(400, "params unparseable", output, j_);
-                return;
-            }
-            else
-            {
-                params = std::move(params[0u]);
-                if (!params.isObjectOrNull())
-                {
-                    HTTPReply(400, "params unparseable", output, j_);
-                    return;
-                }
-            }
-        }
-
-        /**
-         * Clear header-assigned values since not positively identified from a
-         * secure_gateway.
-         */
-        {
-            forwardedFor.clear();
-            user.clear();
-        }
-
-        JLOG(j_.debug()) << "Query: " << strMethod << params;
-
-        // Provide the JSON-RPC method as the field "command" in the request.
-        params[ripple::jss::command] = strMethod;
-        JLOG(j_.trace()) << "doRpcCommand:" << strMethod << ":" << params;
-
-        Json::Value result;
-        rpc::doCommand(app_, remoteIPAddress, params, result);
-
-        Json::Value r(Json::objectValue);
-        if (result.isMember(ripple::jss::error))
-        {
-            result[ripple::jss::status] = ripple::jss::error;
-            result["code"] = result[ripple::jss::error_code];
-            result["message"] = result[ripple::jss::error_message];
-            result.removeMember(ripple::jss::error_message);
-            JLOG(j_.debug()) << "rpcError: " << result[ripple::jss::error]
-                             << ": " << result[ripple::jss::error_message];
-            r[ripple::jss::error] = std::move(result);
-        }
-        else
-        {
-            result[ripple::jss::status] = ripple::jss::success;
-            r[ripple::jss::result] = std::move(result);
-        }
-
-        if (params.isMember(ripple::jss::jsonrpc))
-            r[ripple::jss::jsonrpc] = params[ripple::jss::jsonrpc];
-        if (params.isMember(ripple::jss::ripplerpc))
-            r[ripple::jss::ripplerpc] = params[ripple::jss::ripplerpc];
-        if (params.isMember(ripple::jss::id))
-            r[ripple::jss::id] = params[ripple::jss::id];
-        reply = std::move(r);
-
-        if (reply.isMember(ripple::jss::result) &&
-            reply[ripple::jss::result].isMember(ripple::jss::result))
-        {
-            reply = reply[ripple::jss::result];
-            if (reply.isMember(ripple::jss::status))
-            {
-                reply[ripple::jss::result][ripple::jss::status] =
-                    reply[ripple::jss::status];
-                reply.removeMember(ripple::jss::status);
-            }
-        }
+        reply = Json::Value(Json::arrayValue);
+        for (auto& r : replies)
+            reply.append(std::move(r));
     }
+
     auto response = to_string(reply);
 
     response += '\n';
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <xbwd/rpc/ResourceManager.h>
+
 #include <ripple/json/Output.h>
 #include <ripple/server/Server.h>
 #include <ripple/server/Session.h>
@@ -11,7 +13,9 @@
 #include <boost/beast/ssl/ssl_stream.hpp>
 #include <boost/utility/string_view.hpp>
 
+#include <atomic>
 #include <condition_variable>
+#include <functional>
 #include <map>
 #include <mutex>
 #include <vector>
@@ -43,9 +47,17 @@ class ServerHandler
     bool stopped_{false};
     std::map<std::reference_wrapper<ripple::Port const>, int, ComparePorts>
         count_;
+    std::size_t const threadPoolSize_;
     boost::asio::thread_pool threadPool_;
     beast::Journal j_;
 
+    // Kept in each websocket session's appDefined
+    struct WSSessionState
+    {
+        // requests read from the session and not yet answered
+        std::atomic<int> inFlight{0};
+    };
+
 public:
     ServerHandler(
         App& app,
@@ -105,6 +117,33 @@ private:
     void
     processSession(std::shared_ptr<ripple::Session> const&);
 
+    // subscribe and unsubscribe commands from a websocket session
+    void
+    doSubscribe(
+        std::shared_ptr<ripple::WSSession> const& session,
+        Json::Value const& jv,
+        Json::Value& result,
+        bool subscribe);
+
+    // Queue a job for threadPool_. Return false if it was dropped.
+    bool
+    schedule(ResourceManager::Priority p, std::function<void()>&& job);
+
+    // Run one JSON-RPC request object and build its reply
+    Json::Value
+    processJsonRpc(
+        Json::Value const& jsonRPC,
+        beast::IP::Endpoint const& remoteIPAddress,
+        std::string& badRequest);
+
+    // Run f(0) .. f(n-1) on threadPool_, at priority `p`, and wait for them
+    // all. Rethrows the first exception `f` threw, once all are done.
+    void
+    parallelFor(
+        ResourceManager::Priority p,
+        std::size_t n,
+        std::function<void(std::size_t)> const& f);
+
     void
     processRequest(
         ripple::Port const& port,
@@ -0,0 +1,132 @@
+#include <xbwd/rpc/Subscriptions.h>
+
+#include <ripple/basics/Log.h>
+#include <ripple/json/to_string.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace xbwd {
+namespace rpc {
+
+SharedWSMsg::SharedWSMsg(std::shared_ptr<std::string const> msg)
+    : msg_(std::move(msg))
+{
+}
+
+std::pair<boost::tribool, std::vector<boost::asio::const_buffer>>
+SharedWSMsg::prepare(std::size_t bytes, std::function<void(void)>)
+{
+    if (pos_ == msg_->size())
+        return {true, {}};
+
+    auto const n = std::min(bytes, msg_->size() - pos_);
+    std::vector<boost::asio::const_buffer> vb{
+        boost::asio::buffer(msg_->data() + pos_, n)};
+    pos_ += n;
+    return {false, std::move(vb)};
+}
+
+Subscriptions::Subscriptions(beast::Journal j) : j_(j)
+{
+}
+
+std::optional<Subscriptions::Stream>
+Subscriptions::streamFromString(std::string const& s)
+{
+    for (std::size_t i = 0; i < numStreams; ++i)
+    {
+        auto const stream = static_cast<Stream>(i);
+        if (s == to_string(stream))
+            return stream;
+    }
+    return std::nullopt;
+}
+
+void
+Subscriptions::subscribe(
+    std::shared_ptr<ripple::WSSession> const& session,
+    Stream s)
+{
+    auto const i = static_cast<std::size_t>(s);
+    std::lock_guard l{mutex_};
+    subs_[i][session.get()] = session;
+    counts_[i] = subs_[i].size();
+}
+
+void
+Subscriptions::unsubscribe(ripple::WSSession const& session, Stream s)
+{
+    auto const i = static_cast<std::size_t>(s);
+    std::lock_guard l{mutex_};
+    subs_[i].erase(&session);
+    counts_[i] = subs_[i].size();
+}
+
+bool
+Subscriptions::hasSubscribers(Stream s) const
+{
+    return counts_[static_cast<std::size_t>(s)] > 0;
+}
+
+void
+Subscriptions::publish(Stream s, Json::Value const& jv)
+{
+    auto const i = static_cast<std::size_t>(s);
+    if (!counts_[i])
+        return;
+
+    std::vector<std::shared_ptr<ripple::WSSession>> sessions;
+    {
+        std::lock_guard l{mutex_};
+        sessions.reserve(subs_[i].size());
+        for (auto it = subs_[i].begin(); it != subs_[i].end();)
+        {
+            if (auto session = it->second.lock())
+            {
+                sessions.push_back(std::move(session));
+                ++it;
+            }
+            else
+            {
+                // closed, possibly as a slow consumer
+                it = subs_[i].erase(it);
+            }
+        }
+        counts_[i] = subs_[i].size();
+    }
+    if (sessions.empty())
+        return;
+
+    auto const msg = std::make_shared<std::string const>(to_string(jv));
+    JLOGV(
+        j_.trace(),
+        "publish",
+        ripple::jv("stream", to_string(s)),
+        ripple::jv(
+            "subscribers", static_cast<std::uint32_t>(sessions.size())));
+
+    for (auto const& session : sessions)
+        session->send(std::make_shared<SharedWSMsg>(msg));
+}
+
+std::string
+to_string(Subscriptions::Stream s)
+{
+    switch (s)
+    {
+        case Subscriptions::Stream::attestations:
+            return "attestations";
+        case Subscriptions::Stream::submissions:
+            return "submissions";
+        case Subscriptions::Stream::results:
+            return "results";
+        case Subscriptions::Stream::state:
+            return "state";
+        default:
+            return "unknown";
+    }
+}
+
+}  // namespace rpc
+}  // namespace xbwd
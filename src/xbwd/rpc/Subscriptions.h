@@ -0,0 +1,90 @@
+#pragma once
+
+#include <xbwd/basics/ThreadSaftyAnalysis.h>
+
+#include <ripple/beast/utility/Journal.h>
+#include <ripple/json/json_value.h>
+#include <ripple/server/WSSession.h>
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace xbwd {
+namespace rpc {
+
+// A websocket message that shares one serialized payload between all the
+// sessions it is sent to, so a publish is serialized once, not per subscriber.
+class SharedWSMsg : public ripple::WSMsg
+{
+    std::shared_ptr<std::string const> msg_;
+    std::size_t pos_ = 0;
+
+public:
+    explicit SharedWSMsg(std::shared_ptr<std::string const> msg);
+
+    std::pair<boost::tribool, std::vector<boost::asio::const_buffer>>
+    prepare(std::size_t bytes, std::function<void(void)>) override;
+};
+
+/** Websocket sessions subscribed to the federator's event streams.
+
+    Delivery goes through the session's own send queue. A session whose queue
+    grows past the port's `ws_queue_limit` is closed by the server as a slow
+    consumer, and is dropped from the subscriptions on the next publish.
+*/
+class Subscriptions
+{
+public:
+    enum class Stream : std::size_t {
+        attestations,  // attestation signed and stored
+        submissions,   // attestation batch submitted
+        results,       // result of a submitted batch received
+        state,         // storage changes a standby mirrors; admin only
+        last
+    };
+
+private:
+    static constexpr std::size_t numStreams =
+        static_cast<std::size_t>(Stream::last);
+
+    mutable std::mutex mutex_;
+    // keyed by session address
+    std::array<
+        std::map<ripple::WSSession const*, std::weak_ptr<ripple::WSSession>>,
+        numStreams>
+        GUARDED_BY(mutex_) subs_;
+    // lets publishers skip building messages nobody will receive
+    std::array<std::atomic<std::size_t>, numStreams> counts_{};
+    beast::Journal j_;
+
+public:
+    explicit Subscriptions(beast::Journal j);
+
+    static std::optional<Stream>
+    streamFromString(std::string const& s);
+
+    void
+    subscribe(std::shared_ptr<ripple::WSSession> const& session, Stream s)
+        EXCLUDES(mutex_);
+
+    void
+    unsubscribe(ripple::WSSession const& session, Stream s) EXCLUDES(mutex_);
+
+    bool
+    hasSubscribers(Stream s) const;
+
+    // Send `jv` to every live subscriber of `s`
+    void
+    publish(Stream s, Json::Value const& jv) EXCLUDES(mutex_);
+};
+
+std::string
+to_string(Subscriptions::Stream s);
+
+}  // namespace rpc
+}  // namespace xbwd